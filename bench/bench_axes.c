@@ -0,0 +1,130 @@
+// bench_axes.c
+// Cost of the per-cycle multi-axis work (unpack, CiA402 state machines, setpoints, pack) for
+// 1..64 L7NH axes on the simulated segment, for the strided (uniform layout) and the pointer-table
+// path of ec_axes. The simulated bus exchange is timed separately and is not part of "app".
+// scope_ns_per_axis is the armed triggered capture (ec_scope.c, all conditions, never firing): trigger
+// evaluation plus the copy of one 32-byte record per axis into the pre-trigger ring; trig_ns_per_axis
+// is the trigger evaluation alone (ec_scope_trigger). Both are timed over SCOPE_REPEAT back-to-back
+// calls per cycle, so the two clock reads around them do not dominate. traj_ns_per_axis is the setpoint generator (ec_traj.c)
+// playing back-to-back chirps on every axis, the most expensive segment kind, into a scratch array.
+// Output: one line per axis count, tab separated.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim_soem.h"
+#include "ec_axes.h"
+#include "ec_pdocfg.h"
+#include "ec_cycle.h"
+#include "ec_scope.h"
+#include "ec_traj.h"
+
+#define BENCH_CYCLES    20000
+#define BENCH_WARMUP    100
+#define SCOPE_REPEAT    16
+#define L7NH_VENDOR     0x00007595
+
+static uint8 iomap[1 << 16];
+static ec_axes_t axes;
+static ec_scope_t scope, trig;
+static ec_traj_t traj;
+static int16_t traj_out[EC_AXES_MAX];
+
+static int connect_axes(int n) {
+    sim_setup(n);
+    sim_set_fixed_step(EC_CYCLE_1MS);
+    if (!ec_init("sim") || ec_config_init(FALSE) != n) return -1;
+    for (int s = 1; s <= n; s++) ec_pdocfg_install((uint16_t)s);
+    ec_config_map(iomap);
+    if (ec_axes_discover(&axes, L7NH_VENDOR) != n) return -1;
+    for (int s = 0; s <= ec_slavecount; s++) ec_slave[s].state = EC_STATE_OPERATIONAL;
+    ec_writestate(0);
+    ec_statecheck(0, EC_STATE_OPERATIONAL, EC_TIMEOUTSTATE);
+    for (int i = 0; i < n; i++) axes.mode[i] = 10;
+    ec_axes_command(&axes, CIA402_TARGET_ENABLED, sim_time_ns());
+    return 0;
+}
+
+typedef struct {
+    double bus, scope, trig, traj;      // mean ns per cycle
+    int enabled;
+} run_t;
+
+// Returns the mean app time per cycle in ns; bus, scope, trigger and generator time and the enabled axes
+// are reported through out.
+static double run(int cycles, run_t *out) {
+    int64_t app = 0, bus = 0, sc = 0, tr = 0, tj = 0;
+    uint64_t hit;
+    uint32_t fired = 0;
+    for (int c = 0; c < cycles; c++) {
+        for (int i = 0; i < axes.count; i++) {
+            if (ec_traj_space(&traj, i) > 0) ec_traj_chirp(&traj, i, 200, 1.0, 100.0, 100000000);
+        }
+        int64_t t0 = ec_cycle_now_ns();
+        ec_send_processdata();
+        ec_receive_processdata(EC_TIMEOUTRET);
+        int64_t t1 = ec_cycle_now_ns();
+        ec_axes_unpack(&axes);
+        ec_axes_update(&axes, sim_time_ns());
+        for (int i = 0; i < axes.count; i++) {
+            // simple velocity-limited torque so the drives stay far from the overspeed trip
+            axes.target_torque[i] = (int16_t)(axes.actual_velocity[i] < 1000 ? 100 : 0);
+        }
+        ec_axes_pack(&axes);
+        int64_t t2 = ec_cycle_now_ns();
+        for (int k = 0; k < SCOPE_REPEAT; k++) ec_scope_cycle(&scope, &axes, t2, (uint32_t)c, 1, 0);
+        int64_t t3 = ec_cycle_now_ns();
+        for (int k = 0; k < SCOPE_REPEAT; k++) fired |= ec_scope_trigger(&trig, &axes, 1, 0, &hit);
+        int64_t t4 = ec_cycle_now_ns();
+        ec_traj_step(&traj, traj_out);
+        int64_t t5 = ec_cycle_now_ns();
+        bus += t1 - t0;
+        app += t2 - t1;
+        sc += t3 - t2;
+        tr += t4 - t3;
+        tj += t5 - t4;
+    }
+    if (fired) fprintf(stderr, "trigger fired (0x%x): the scope timing includes no capture\n", (unsigned)fired);
+    out->bus = (double)bus / cycles;
+    out->scope = (double)sc / cycles / SCOPE_REPEAT;
+    out->trig = (double)tr / cycles / SCOPE_REPEAT;
+    out->traj = (double)tj / cycles;
+    out->enabled = 0;
+    for (int i = 0; i < axes.count; i++) out->enabled += axes.enabled[i];
+    return (double)app / cycles;
+}
+
+int main(int argc, char **argv) {
+    int cycles = argc > 1 ? atoi(argv[1]) : BENCH_CYCLES;
+    static const int counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    printf("axes\tuniform\tapp_ns\tapp_ptr_ns\tapp_ns_per_axis\tscope_ns_per_axis\ttrig_ns_per_axis\ttraj_ns_per_axis"
+           "\tsim_bus_ns\tenabled\n");
+    for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+        double app, app_ptr;
+        run_t r, r_ptr;
+        int n = counts[k];
+        if (connect_axes(n) != 0) {
+            fprintf(stderr, "connect with %d axes failed\n", n);
+            return 1;
+        }
+        if (ec_scope_init(&scope, n, EC_CYCLE_1MS, 1000, 1000, EC_SCOPE_TRIG_ALL, 100000) != 0 ||
+            ec_scope_init(&trig, n, EC_CYCLE_1MS, 0, 0, EC_SCOPE_TRIG_ALL, 100000) != 0) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        ec_scope_arm(&scope);
+        ec_traj_init(&traj, n, EC_CYCLE_1MS, 1000);
+        int uniform = axes.uniform;
+        run(BENCH_WARMUP, &r);
+        app = run(cycles, &r);
+        axes.uniform = 0;       // same work through the pointer table
+        app_ptr = run(cycles, &r_ptr);
+        printf("%d\t%d\t%.1f\t%.1f\t%.2f\t%.2f\t%.2f\t%.2f\t%.1f\t%d\n", n, uniform, app, app_ptr, app / n,
+            r.scope / n, r.trig / n, r.traj / n, r_ptr.bus, r_ptr.enabled);
+        ec_scope_free(&scope);
+        ec_scope_free(&trig);
+        ec_close();
+    }
+    return 0;
+}
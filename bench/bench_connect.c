@@ -0,0 +1,109 @@
+// bench_connect.c
+// Connect time of a simulated segment, cold and with the topology fingerprint of the previous connect
+// (ec_topo.c), per connect phase. Every blocking SDO costs sdo_us (a real CoE round trip is about
+// 1 ms), so the mailbox traffic a fingerprint saves shows up as it would on hardware; SII reads are
+// not modelled.
+// Cases per axis count: cold (no fingerprint), cached (drives kept their mapping since the last
+// connect), remapped (every drive swapped two TxPDO entries of the same size since: the sizes still
+// pass SAFE-OP, the mapping read in PRE-OP does not match and the connect goes cold) and stale (drives
+// power cycled since: the fingerprint matches, SAFE-OP refuses the layout and the connect starts over
+// cold).
+// Output: one line per case, tab separated, times in ms.
+// Exit status 2 when a case came out with another topo result than it has to (ctest runs it).
+// Usage: bench_connect [sdo_us] [max_axes]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_soem.h"
+#include "ec_segment.h"
+#include "ec_topo.h"
+
+#define L7NH_VENDOR     0x00007595
+#define SWAP_A          1           // entries of the first assigned TxPDO swapped by the remap: actual
+#define SWAP_B          3           // velocity 0x606C and actual position 0x6064, both 32 bit
+
+static ec_segment_t seg;
+static ec_topo_t topo;
+
+static const char *topo_name(ec_topo_result_t r) {
+    return r == EC_TOPO_HIT ? "hit" : r == EC_TOPO_STALE ? "stale" : "none";
+}
+
+// Swap two same-size entries of the first assigned TxPDO of every drive, as a reconfiguration by another
+// tool would; the drives keep it over the next connect (sim_keep_pdo_config).
+static int remap(void) {
+    for (int i = 0; i < seg.axes.count; i++) {
+        l7nh_model_t *m = sim_drive_ctx(&seg.context, seg.axes.slave[i]);
+        if (!m || m->tx_assign_count == 0) return -1;
+        l7nh_pdo_t *pdo = &m->txpdo[(m->tx_assign[0] - 0x1A00) % L7NH_NUM_PDO];
+        if (pdo->count <= SWAP_B || (pdo->entry[SWAP_A] & 0xFF) != (pdo->entry[SWAP_B] & 0xFF)) return -1;
+        uint32_t e = pdo->entry[SWAP_A];
+        pdo->entry[SWAP_A] = pdo->entry[SWAP_B];
+        pdo->entry[SWAP_B] = e;
+    }
+    return 0;
+}
+
+// Connect, print the case and close; remap the drives before the close when asked. Returns the topo
+// result, or -1.
+static int run_case(int n, const char *name, int remap_after) {
+    if (ec_segment_connect_cached(&seg, "sim0", NULL, EC_CYCLE_1MS, L7NH_VENDOR,
+                                  EC_SEGMENT_COMPACT_PDO | EC_SEGMENT_DC_SYNC, &topo) != 0) {
+        fprintf(stderr, "%s connect with %d axes: %s\n", name, n, seg.error);
+        return -1;
+    }
+    printf("%d\t%s\t%s\t%.1f", seg.axes.count, name, topo_name(seg.connect.topo), seg.connect.total_ns / 1e6);
+    for (int p = 0; p < EC_CONNECT_PHASES; p++) printf("\t%.2f", seg.connect.phase_ns[p] / 1e6);
+    printf("\n");
+    int result = (int)seg.connect.topo;
+    if (remap_after && remap() != 0) {
+        fprintf(stderr, "%s: cannot remap the drives\n", name);
+        result = -1;
+    }
+    ec_segment_close(&seg);
+    return result;
+}
+
+static int expect(int n, const char *name, int result, ec_topo_result_t want) {
+    if (result == (int)want) return 0;
+    fprintf(stderr, "%s connect with %d axes: topo %s, expected %s\n", name, n,
+        result < 0 ? "-" : topo_name((ec_topo_result_t)result), topo_name(want));
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    int sdo_us = argc > 1 ? atoi(argv[1]) : 1000;
+    int max_axes = argc > 2 ? atoi(argv[2]) : 16;
+    static const int axes[] = { 1, 4, 16, 64 };
+
+    if (sdo_us < 0 || max_axes < 1 || max_axes > EC_TOPO_SLAVES) {
+        fprintf(stderr, "usage: bench_connect [sdo_us >= 0] [max_axes 1..%d]\n", EC_TOPO_SLAVES);
+        return 1;
+    }
+    sim_set_sdo_time((int64_t)sdo_us * 1000);
+    printf("axes\tcase\ttopo\ttotal_ms");
+    for (int p = 0; p < EC_CONNECT_PHASES; p++) printf("\t%s_ms", ec_segment_phase_name((ec_connect_phase_t)p));
+    printf("\n");
+    int wrong = 0;
+    for (size_t k = 0; k < sizeof(axes) / sizeof(axes[0]) && axes[k] <= max_axes; k++) {
+        int n = axes[k], r;
+        sim_setup(n);
+        memset(&topo, 0, sizeof(topo));
+        sim_keep_pdo_config(0);
+        if ((r = run_case(n, "cold", 0)) < 0) return 1;
+        wrong += expect(n, "cold", r, EC_TOPO_NONE);
+        sim_keep_pdo_config(1);
+        if ((r = run_case(n, "cached", 1)) < 0) return 1;
+        wrong += expect(n, "cached", r, EC_TOPO_HIT);
+        if ((r = run_case(n, "remapped", 0)) < 0) return 1;
+        wrong += expect(n, "remapped", r, EC_TOPO_STALE);
+        if ((r = run_case(n, "cached", 0)) < 0) return 1;
+        wrong += expect(n, "cached", r, EC_TOPO_HIT);
+        sim_keep_pdo_config(0);
+        if ((r = run_case(n, "stale", 0)) < 0) return 1;
+        wrong += expect(n, "stale", r, EC_TOPO_STALE);
+    }
+    return wrong ? 2 : 0;
+}
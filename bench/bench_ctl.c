@@ -0,0 +1,222 @@
+// bench_ctl.c
+// Round trip of the local control API (src/l7nh_ctl.h), measured by a client on the socket.
+// - By default the control core runs in this process on the simulated segment, with its service thread
+//   serving the socket as l7nhd -l does; given a socket path, the client talks to a running server
+//   instead (which it connects to sim0 if it is not connected yet).
+// - The client subscribes to the status of every cycle, enables the drives, then for ROUNDS rounds sends
+//   a SET of axis 0 ("single") and a SET of every axis in one frame ("batch"), one at a time:
+//   ack is send -> ACK received, applied is send -> first STATUS of every segment showing the SET as
+//   applied, i.e. the setpoint went out with the process data of that cycle. A round starts right after
+//   a status came in, so just after a cycle boundary: applied is about one period plus the socket.
+// Output: one line per kind, tab separated; dropped: STATUS frames the client lost.
+// Usage: bench_ctl [period_us] [axes] [rounds] [socket]
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "sim_soem.h"
+#include "l7nh_core.h"
+#include "l7nh_ctl.h"
+#include "ec_hist.h"
+
+#define SERVICE_NS      1000000LL       // service loop wait without subscribers
+#define ENABLE_WAIT_NS  3000000000LL    // also how long the stop may take
+#define RECV_TIMEOUT_S  2
+#define TORQUE          20              // small: the simulated motors should not run away over the rounds
+
+static l7nh_core_t core;
+static l7nh_ctl_t ctl;
+static volatile int quit;
+static uint8_t frame[L7NH_CTL_FRAME_MAX];
+static uint32_t applied[EC_SEGMENT_MAX], dropped;
+static int segments;
+
+static void *service(void *arg) {
+    (void)arg;
+    while (!quit) {
+        l7nh_poll(&core);
+        l7nh_ctl_poll(&ctl, SERVICE_NS);
+    }
+    return NULL;
+}
+
+static void on_event(void *user, l7nh_event_kind_t kind, const char *msg) {
+    (void)user;
+    (void)kind;
+    (void)msg;
+}
+
+// Next frame; a STATUS updates what every segment applied so far. Returns its type, or -1.
+static int next_frame(int fd, uint32_t *id, l7nh_ctl_ack_t *ack) {
+    l7nh_ctl_hdr_t hdr;
+    if (l7nh_ctl_recv(fd, frame, sizeof(frame)) < 0) return -1;
+    memcpy(&hdr, frame, sizeof(hdr));
+    if (hdr.type == L7NH_CTL_STATUS) {
+        l7nh_ctl_status_t st;
+        memcpy(&st, frame + sizeof(hdr), sizeof(st));
+        if (st.segment < EC_SEGMENT_MAX) {
+            applied[st.segment] = st.applied;
+            if (st.segment >= segments) segments = st.segment + 1;
+        }
+        dropped = st.dropped;
+    } else if (hdr.type == L7NH_CTL_ACK) {
+        *id = hdr.id;
+        memcpy(ack, frame + sizeof(hdr), sizeof(*ack));
+    }
+    return hdr.type;
+}
+
+// Send a request and wait for its ACK. Returns its result, or INT32_MIN if the connection failed.
+static int32_t request(int fd, uint8_t type, uint32_t id, const void *payload, uint16_t len) {
+    uint32_t got = 0;
+    l7nh_ctl_ack_t ack;
+    if (l7nh_ctl_send(fd, type, 0, id, payload, len) != 0) return INT32_MIN;
+    for (;;) {
+        int t = next_frame(fd, &got, &ack);
+        if (t < 0) return INT32_MIN;
+        if (t == L7NH_CTL_ACK && got == id) return ack.result;
+    }
+}
+
+static int all_applied(uint32_t id) {
+    for (int s = 0; s < segments; s++) {
+        if ((int32_t)(applied[s] - id) < 0) return 0;
+    }
+    return segments > 0;
+}
+
+static int run_rounds(int fd, const char *kind, int axes, int count, int64_t period, int rounds, uint32_t *id) {
+    static l7nh_ctl_set_t set[L7NH_CTL_SET_MAX];
+    ec_hist_t ack_h, applied_h;
+    ec_hist_summary_t a, p;
+
+    ec_hist_init(&ack_h);
+    ec_hist_init(&applied_h);
+    for (int r = 0; r < rounds; r++) {
+        uint32_t me = ++*id, got = 0;
+        int acked = 0;
+        l7nh_ctl_ack_t ack;
+        for (int i = 0; i < count; i++) {
+            set[i].axis = (uint16_t)i;
+            set[i].reserved = 0;
+            set[i].value = (r & 1) ? TORQUE : -TORQUE;
+        }
+        int64_t t0 = ec_cycle_now_ns();
+        if (l7nh_ctl_send(fd, L7NH_CTL_SET, 0, me, set, (uint16_t)(count * sizeof(set[0]))) != 0) return -1;
+        while (!acked || !all_applied(me)) {
+            int t = next_frame(fd, &got, &ack);
+            if (t < 0) return -1;
+            if (t == L7NH_CTL_ACK && got == me) {
+                if (ack.result != L7NH_SET_OK) {
+                    fprintf(stderr, "%s: SET refused (%d)\n", kind, (int)ack.result);
+                    return -1;
+                }
+                ec_hist_record(&ack_h, ec_cycle_now_ns() - t0);
+                acked = 1;
+            }
+        }
+        ec_hist_record(&applied_h, ec_cycle_now_ns() - t0);
+    }
+    ec_hist_summarize(&ack_h, period, &a);
+    ec_hist_summarize(&applied_h, period, &p);
+    printf("%s\t%d\t%lld\t%d\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%u\n", kind, axes, (long long)(period / 1000), rounds,
+        a.p50 / 1e3, a.p99 / 1e3, a.max / 1e3, p.p50 / 1e3, p.p99 / 1e3, p.max / 1e3, (unsigned)dropped);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int64_t period = argc > 1 ? atoll(argv[1]) * 1000 : EC_CYCLE_1MS;
+    int axes = argc > 2 ? atoi(argv[2]) : 8;
+    int rounds = argc > 3 ? atoi(argv[3]) : 500;
+    const char *path = argc > 4 ? argv[4] : NULL;
+    char own[64];
+    pthread_t thread;
+    uint32_t id = 0;
+
+    if (!ec_cycle_valid_period(period) || axes < 1 || axes > EC_AXES_MAX || rounds < 1) {
+        fprintf(stderr, "usage: bench_ctl [period_us 1000|500|250|125] [axes 1..%d] [rounds >= 1] [socket]\n",
+            EC_AXES_MAX);
+        return 1;
+    }
+    if (!path) {
+        l7nh_config_t cfg;
+        l7nh_config_default(&cfg);
+        cfg.record = 0;
+        cfg.scope = 0;
+        cfg.shm = 0;
+        cfg.topo_cache = 0;
+        cfg.torque_set = 0;
+        cfg.cpu0 = -1;
+        sim_setup(axes);
+        snprintf(own, sizeof(own), "/tmp/bench_ctl.%d.sock", (int)getpid());
+        path = own;
+        if (l7nh_ctl_open(&ctl, path, &core, &cfg, on_event, NULL) != 0) {
+            perror(path);
+            return 1;
+        }
+        pthread_create(&thread, NULL, service, NULL);
+    }
+
+    int fd = l7nh_ctl_dial(path);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    struct timeval tv = { RECV_TIMEOUT_S, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    l7nh_ctl_connect_t conn;
+    memset(&conn, 0, sizeof(conn));
+    conn.cycle_us = (uint32_t)(period / 1000);
+    snprintf(conn.ifnames, sizeof(conn.ifnames), "sim0");
+    int32_t connected = request(fd, L7NH_CTL_CONNECT, ++id, &conn, sizeof(conn));
+    uint32_t every = 1;
+    int ok = (connected > 0 || connected == L7NH_CTL_ESTATE) &&
+             request(fd, L7NH_CTL_SUBSCRIBE, ++id, &every, sizeof(every)) == L7NH_CTL_OK;
+    int32_t enable = ok ? request(fd, L7NH_CTL_ENABLE, ++id, NULL, 0) : INT32_MIN;
+    ok = ok && (enable == L7NH_CTL_OK || enable == L7NH_CTL_ESTATE);
+    if (!ok) {
+        fprintf(stderr, "cannot connect and enable (%d / %d)\n", (int)connected, (int)enable);
+    } else {
+        // the first status of the run; then the single / batch rounds
+        uint32_t got;
+        l7nh_ctl_ack_t ack;
+        int64_t deadline = ec_cycle_now_ns() + ENABLE_WAIT_NS;
+        while (segments == 0 && ec_cycle_now_ns() < deadline && next_frame(fd, &got, &ack) >= 0) { }
+        if (segments == 0) {
+            fprintf(stderr, "no status from the cycle\n");
+            ok = 0;
+        }
+    }
+    if (ok) {
+        printf("kind\taxes\tperiod_us\trounds\tack_p50_us\tack_p99_us\tack_max_us\tapplied_p50_us\tapplied_p99_us"
+               "\tapplied_max_us\tdropped\n");
+        ok = run_rounds(fd, "single", axes, 1, period, rounds, &id) == 0 &&
+             run_rounds(fd, "batch", axes, axes, period, rounds, &id) == 0;
+    }
+    if (connected > 0) {
+        request(fd, L7NH_CTL_STOP, ++id, NULL, 0);
+        request(fd, L7NH_CTL_DISCONNECT, ++id, NULL, 0);
+    }
+    close(fd);
+
+    if (path == own) {
+        int64_t deadline = ec_cycle_now_ns() + ENABLE_WAIT_NS;
+        while (l7nh_state(&core) != L7NH_IDLE && ec_cycle_now_ns() < deadline) {
+            struct timespec ts = { 0, 10000000L };
+            nanosleep(&ts, NULL);
+        }
+        quit = 1;
+        pthread_join(thread, NULL);
+        l7nh_ctl_close(&ctl);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+// bench_cycle.c
+// The cyclic engine (ec_cycle) driving the full control path against the simulated segment at
+// 1 ms, 500 us, 250 us and 125 us with 1..64 L7NH axes, on a real-time thread in real time.
+// Per cycle it samples:
+// - wake: lateness of the wakeup against the absolute deadline
+// - rtt:  ec_send_processdata -> ec_receive_processdata
+// - app:  unpack, CiA402 state machines, setpoints, pack
+// - faults: page faults the cyclic thread took over the sampled cycles (Linux; -1 elsewhere)
+// Output: one line per (period, axes), tab separated, percentiles in ns (nearest rank), so runs of
+// different releases can be diffed or loaded as a table. rt = 0 if real-time priority was refused.
+// With a file name, every cycle is also recorded (ec_recorder.c) from inside the cycle and "rec" is 1:
+// into the recorder's ring in memory, which a second thread writes to the file every FLUSH_MS, as the
+// control core's service thread does (on Windows only when the case ends). Compare against a run
+// without to see what recording costs.
+// Usage: bench_cycle [seconds_per_case] [max_axes] [record_file]
+
+#ifdef __linux__
+#define _GNU_SOURCE             // RUSAGE_THREAD
+#elif !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <time.h>
+#endif
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include "sim_soem.h"
+#include "ec_axes.h"
+#include "ec_pdocfg.h"
+#include "ec_cycle.h"
+#include "ec_recorder.h"
+
+#define BENCH_PRIORITY  80
+#define BENCH_WARMUP    200     // cycles not sampled (drives enabling, caches warming up)
+#define L7NH_VENDOR     0x00007595
+#define FLUSH_MS        10
+
+enum { M_WAKE, M_RTT, M_APP, M_COUNT };
+static const char *const metric_names[M_COUNT] = { "wake", "rtt", "app" };
+
+typedef struct {
+    uint64_t target;            // sampled cycles to run
+    uint64_t n;
+    int64_t *sample[M_COUNT];
+    long faults;                // of the cyclic thread: at the first sample, then over the samples
+} bench_t;
+
+static uint8 iomap[1 << 16];
+static ec_axes_t axes;
+static ec_recorder_t recorder;
+static int recording;
+static volatile int flushing;
+
+#ifndef _WIN32
+static void *flush_thread(void *arg) {
+    struct timespec ts = { 0, FLUSH_MS * 1000000L };
+    (void)arg;
+    while (flushing) {
+        ec_recorder_flush(&recorder);
+        nanosleep(&ts, NULL);
+    }
+    return NULL;
+}
+#endif
+
+// Page faults of the calling thread so far, or -1 where not available.
+static long thread_faults(void) {
+#ifdef __linux__
+    struct rusage ru;
+    if (getrusage(RUSAGE_THREAD, &ru) == 0) return ru.ru_minflt + ru.ru_majflt;
+#endif
+    return -1;
+}
+
+static int connect_axes(int n) {
+    sim_setup(n);
+    sim_set_fixed_step(0);
+    if (!ec_init("sim") || ec_config_init(FALSE) != n) return -1;
+    for (int s = 1; s <= n; s++) ec_pdocfg_install((uint16_t)s);
+    ec_config_map(iomap);
+    if (ec_axes_discover(&axes, L7NH_VENDOR) != n) return -1;
+    for (int s = 0; s <= ec_slavecount; s++) ec_slave[s].state = EC_STATE_OPERATIONAL;
+    ec_writestate(0);
+    ec_statecheck(0, EC_STATE_OPERATIONAL, EC_TIMEOUTSTATE);
+    for (int i = 0; i < n; i++) axes.mode[i] = 10;
+    ec_axes_command(&axes, CIA402_TARGET_ENABLED, ec_cycle_now_ns());
+    return 0;
+}
+
+static void bench_hook(ec_cycle_t *cyc, void *user) {
+    bench_t *b = (bench_t *)user;
+    int64_t t0 = ec_cycle_now_ns();
+
+    ec_send_processdata();
+    ec_receive_processdata(EC_TIMEOUTRET);
+    int64_t t1 = ec_cycle_now_ns();
+    ec_axes_unpack(&axes);
+    ec_axes_update(&axes, cyc->wake_ns);
+    for (int i = 0; i < axes.count; i++) {
+        // velocity-limited torque so the drives stay far from the overspeed trip
+        axes.target_torque[i] = (int16_t)(axes.actual_velocity[i] < 1000 ? 100 : 0);
+    }
+    ec_axes_pack(&axes);
+    if (recording) ec_recorder_write(&recorder, &axes, cyc->wake_ns, (uint32_t)cyc->cycles, 1);
+    int64_t t2 = ec_cycle_now_ns();
+
+    if (cyc->cycles < BENCH_WARMUP) return;
+    if (b->n == 0) b->faults = thread_faults();
+    b->sample[M_WAKE][b->n] = cyc->last_late_ns;
+    b->sample[M_RTT][b->n] = t1 - t0;
+    b->sample[M_APP][b->n] = t2 - t1;
+    if (++b->n == b->target) {
+        if (b->faults >= 0) b->faults = thread_faults() - b->faults;
+        ec_cycle_stop(cyc);
+    }
+}
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of a sorted array; per_mille 1000 = max.
+static int64_t percentile(const int64_t *v, uint64_t n, int per_mille) {
+    uint64_t rank = (n * (uint64_t)per_mille + 999) / 1000;
+    return v[rank ? rank - 1 : 0];
+}
+
+int main(int argc, char **argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    int max_axes = argc > 2 ? atoi(argv[2]) : 64;
+    const char *record_path = argc > 3 ? argv[3] : NULL;
+    static const int64_t periods[] = { EC_CYCLE_1MS, EC_CYCLE_500US, EC_CYCLE_250US, EC_CYCLE_125US };
+    static const int counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+    static const int per_mille[] = { 500, 990, 999, 1000 };
+    static const char *const pct_names[] = { "p50", "p99", "p999", "max" };
+    bench_t b;
+
+    int rt = ec_cycle_set_realtime(BENCH_PRIORITY, -1) == 0;
+    printf("period_us\taxes\tcycles\toverruns");
+    for (int m = 0; m < M_COUNT; m++) {
+        for (int p = 0; p < 4; p++) printf("\t%s_%s_ns", metric_names[m], pct_names[p]);
+    }
+    printf("\tfaults\tenabled\trt\trec\n");
+
+    for (size_t pi = 0; pi < sizeof(periods) / sizeof(periods[0]); pi++) {
+        b.target = (uint64_t)(seconds * 1e9 / (double)periods[pi]);
+        if (b.target < 1) b.target = 1;
+        for (int m = 0; m < M_COUNT; m++) {
+            b.sample[m] = (int64_t *)malloc(sizeof(int64_t) * b.target);
+            if (!b.sample[m]) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+            // touch every page now (a zero fill may become calloc and touch nothing): no faults of ours
+            memset(b.sample[m], 0xFF, sizeof(int64_t) * b.target);
+        }
+        for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]) && counts[k] <= max_axes; k++) {
+            ec_cycle_t cyc;
+            int n = counts[k], enabled = 0;
+            if (connect_axes(n) != 0) {
+                fprintf(stderr, "connect with %d axes failed\n", n);
+                return 1;
+            }
+            b.n = 0;
+            if (record_path) {
+                if (ec_recorder_open(&recorder, record_path, 0, n, periods[pi]) != 0) {
+                    fprintf(stderr, "%s: cannot create the recording\n", record_path);
+                    return 1;
+                }
+                recording = 1;
+            }
+#ifndef _WIN32
+            pthread_t flusher;
+            flushing = recording && pthread_create(&flusher, NULL, flush_thread, NULL) == 0;
+#endif
+            ec_cycle_init(&cyc, periods[pi], bench_hook, &b);
+            ec_cycle_run(&cyc);
+            ec_cycle_destroy(&cyc);
+#ifndef _WIN32
+            if (flushing) {
+                flushing = 0;
+                pthread_join(flusher, NULL);
+            }
+#endif
+            if (recording) ec_recorder_close(&recorder);
+            recording = 0;
+            for (int i = 0; i < axes.count; i++) enabled += axes.enabled[i];
+
+            printf("%lld\t%d\t%llu\t%llu", (long long)(periods[pi] / 1000), n, (unsigned long long)b.n,
+                (unsigned long long)cyc.overruns);
+            for (int m = 0; m < M_COUNT; m++) {
+                qsort(b.sample[m], (size_t)b.n, sizeof(int64_t), cmp_i64);
+                for (int p = 0; p < 4; p++) printf("\t%lld", (long long)percentile(b.sample[m], b.n, per_mille[p]));
+            }
+            printf("\t%ld\t%d\t%d\t%d\n", b.faults, enabled, rt, record_path != NULL);
+            fflush(stdout);
+            ec_close();
+        }
+        for (int m = 0; m < M_COUNT; m++) free(b.sample[m]);
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+// bench_failover.c
+// Cable redundancy on a simulated segment with a breakable link: for every cable of the segment, once
+// on a line (ecx_init) and once on a ring (ecx_init_redundant), cycle with all drives enabled, break
+// the cable, keep cycling past the drives' process data watchdog, then locate the break from the
+// port status and count what survived.
+// Output: one line per case, tab separated. cycles_lost is the failover gap seen by the cyclic
+// thread (open = the working counter never came back); drives_enabled counts drives that are still
+// in Operation enabled according to the simulation, not to the master's last inputs.
+// Exit status 2 when a case came out wrong (ctest runs it): the break located elsewhere, a drive in front
+// of a line break or any drive of a ring not enabled any more, or a ring that lost more than the link
+// detection time plus LOST_SLACK cycles.
+// Usage: bench_failover [slaves] [period_us]
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "sim_soem.h"
+#include "ec_segment.h"
+
+#define L7NH_VENDOR     0x00007595
+#define BENCH_PRIORITY  80
+#define SETTLE_MS       300     // before the break: drives enabled
+#define BROKEN_MS       300     // after the break: longer than the watchdog of the simulated slaves
+#define LINK_DETECT_NS  1000000LL   // the ESCs notice the lost link after this long
+#define LOST_SLACK      2       // ring: cycles lost beyond the link detection time
+
+static ec_segment_t segment;
+static ec_segment_group_t group;
+
+static void sleep_ms(int ms) {
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static void hold_hook(ec_segment_t *seg, uint32_t tick, void *user) {
+    (void)tick;
+    (void)user;
+    for (int i = 0; i < seg->axes.count; i++) {
+        seg->axes.mode[i] = 10;
+        seg->axes.target_torque[i] = 0;
+    }
+}
+
+// One case; returns -1 if the segment could not be brought up, 1 if its outcome is wrong.
+static int run_case(int ring, int after, int slaves, int64_t period) {
+    ec_segment_t *seg = &segment;
+
+    if (ec_segment_connect_redundant(seg, "sim0", ring ? "sim1" : NULL, period, L7NH_VENDOR,
+                                     EC_SEGMENT_COMPACT_PDO) != 0) {
+        fprintf(stderr, "connect: %s\n", seg->error);
+        return -1;
+    }
+    ec_axes_command(&seg->axes, CIA402_TARGET_ENABLED, ec_cycle_now_ns());
+    ec_segment_group_init(&group, period, hold_hook, NULL);
+    ec_segment_group_add(&group, seg, 0);
+    if (ec_segment_group_start(&group, BENCH_PRIORITY) != 0) {
+        fprintf(stderr, "cannot start the cyclic thread\n");
+        ec_segment_close(seg);
+        return -1;
+    }
+
+    sleep_ms(SETTLE_MS);
+    int enabled_before = 0;
+    for (int s = 1; s <= slaves; s++) enabled_before += sim_drive_ctx(&seg->context, (uint16)s)->state == L7NH_ST_OPERATION_ENABLED;
+    sim_break_link_ctx(&seg->context, after);
+    sleep_ms(BROKEN_MS);
+    int located = ec_redundancy_check(&seg->red, &seg->context);
+    ec_segment_group_stop(&group);
+    ec_segment_group_join(&group);
+
+    int enabled_after = 0;
+    for (int s = 1; s <= slaves; s++) enabled_after += sim_drive_ctx(&seg->context, (uint16)s)->state == L7NH_ST_OPERATION_ENABLED;
+    const ec_redundancy_t *r = &seg->red;
+    char lost[16];
+    if (r->degraded) snprintf(lost, sizeof(lost), "open");
+    else snprintf(lost, sizeof(lost), "%u", (unsigned)r->last_lost);
+    printf("%s\t%lld\t%d\t%d\t%s\t%u\t%llu\t%d\t%d\t%d\t%d\n", ring ? "ring" : "line", (long long)(period / 1000), after,
+        located, lost, (unsigned)r->failovers, (unsigned long long)r->cycles_lost, seg->wkc == seg->expected_wkc,
+        enabled_before, enabled_after, seg->rt_error == 0);
+    sim_break_link_ctx(&seg->context, -1);
+    ec_segment_close(seg);
+
+    // a line keeps the drives in front of the break, a ring all of them
+    int expect = ring ? slaves : after;
+    uint32_t max_lost = (uint32_t)(LINK_DETECT_NS / period) + LOST_SLACK;
+    if (located != after || enabled_before != slaves || enabled_after != expect ||
+        (ring && (r->degraded || r->last_lost > max_lost))) {
+        fprintf(stderr, "%s, break after slave %d: located %d, %d of %d drives enabled, expected %d%s\n",
+            ring ? "ring" : "line", after, located, enabled_after, enabled_before, expect,
+            ring ? " and the ring to fail over" : "");
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int slaves = argc > 1 ? atoi(argv[1]) : 4;
+    int64_t period = argc > 2 ? atoll(argv[2]) * 1000 : EC_CYCLE_1MS;
+
+    if (!ec_cycle_valid_period(period)) {
+        fprintf(stderr, "period must be 1000, 500, 250 or 125 us\n");
+        return 1;
+    }
+    sim_setup(slaves);
+    sim_set_link_detect(LINK_DETECT_NS);
+    printf("mode\tperiod_us\tbreak_after\tlocated\tcycles_lost\tfailovers\twkc_cycles_lost\twkc_ok"
+           "\tdrives_enabled_before\tdrives_enabled_after\trt\n");
+    int wrong = 0;
+    for (int ring = 0; ring <= 1; ring++) {
+        // a line has no cable behind its last slave
+        for (int after = 0; after <= (ring ? slaves : slaves - 1); after++) {
+            int rc = run_case(ring, after, slaves, period);
+            if (rc < 0) return 1;
+            wrong += rc;
+        }
+    }
+    return wrong ? 2 : 0;
+}
@@ -0,0 +1,144 @@
+// bench_health.c
+// Slave supervision on a simulated segment (ec_health.c): with all drives enabled, take one drive out
+// and bring it back, while the supervisor thread of the group recovers it.
+// - power: the drive stops answering for OUTAGE_MS and comes back in INIT with power-on defaults
+//   (mapping and SYNC0 gone), so the supervisor recovers and reconfigures it.
+// - cable: the cable in front of the last drive of the line is open for OUTAGE_MS, longer than its
+//   process data watchdog; the drive trips to SAFE-OP + ERROR and the supervisor acknowledges it.
+// Output: one line per case, tab separated. detect_ms: fault -> supervisor marks the drive down;
+// recovery_ms: marked down -> back in OP; reenable_ms: fault removed -> drive in Operation enabled
+// again; others_enabled: fewest other drives enabled during the outage (all = they kept their torque);
+// late_max_us: worst wakeup lateness of the cyclic thread over the case; step_max_ms / carried: longest
+// supervisor step and steps that ran out of their slice.
+// Usage: bench_health [slaves] [period_us] [slice_us]
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "sim_soem.h"
+#include "ec_segment.h"
+#include "ec_atomic.h"
+
+#define L7NH_VENDOR     0x00007595
+#define BENCH_PRIORITY  80
+#define SETTLE_MS       300     // before the fault: drives enabled
+#define OUTAGE_MS       200     // longer than the watchdog of the simulated slaves
+#define RECOVER_MS      1000    // at most this long for the drive to be enabled again
+
+static ec_segment_t segment;
+static ec_segment_group_t group;
+
+static void sleep_ms(int ms) {
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static void hold_hook(ec_segment_t *seg, uint32_t tick, void *user) {
+    (void)tick;
+    (void)user;
+    for (int i = 0; i < seg->axes.count; i++) {
+        seg->axes.mode[i] = 10;
+        seg->axes.target_torque[i] = 0;
+    }
+}
+
+static int enabled(ec_segment_t *seg, int slaves, int except) {
+    int n = 0;
+    for (int s = 1; s <= slaves; s++) {
+        if (s != except) n += sim_drive_ctx(&seg->context, (uint16)s)->state == L7NH_ST_OPERATION_ENABLED;
+    }
+    return n;
+}
+
+static void fault(ec_segment_t *seg, int cable, int victim, int on) {
+    if (cable) sim_break_link_ctx(&seg->context, on ? victim - 1 : -1);
+    else sim_set_lost_ctx(&seg->context, (uint16)victim, on);
+}
+
+// One case; returns -1 if the segment could not be brought up.
+static int run_case(int cable, int slaves, int64_t period, int64_t slice) {
+    ec_segment_t *seg = &segment;
+    int victim = cable ? slaves : (slaves + 1) / 2;
+
+    if (ec_segment_connect(seg, "sim0", period, L7NH_VENDOR, EC_SEGMENT_COMPACT_PDO | EC_SEGMENT_DC_SYNC) != 0) {
+        fprintf(stderr, "connect: %s\n", seg->error);
+        return -1;
+    }
+    ec_axes_command(&seg->axes, CIA402_TARGET_ENABLED, ec_cycle_now_ns());
+    ec_segment_group_init(&group, period, hold_hook, NULL);
+    group.health_slice_ns = slice;
+    ec_segment_group_add(&group, seg, 0);
+    if (ec_segment_group_start(&group, BENCH_PRIORITY) != 0) {
+        fprintf(stderr, "cannot start the threads: %s\n", seg->error);
+        ec_segment_close(seg);
+        return -1;
+    }
+
+    sleep_ms(SETTLE_MS);
+    const ec_health_slave_t *hs = &seg->health.slave[victim];
+    int before = enabled(seg, slaves, 0), others = slaves - 1;
+    int64_t t0 = ec_cycle_now_ns(), detect = -1, reenable = -1;
+    fault(seg, cable, victim, 1);
+    while (ec_cycle_now_ns() - t0 < OUTAGE_MS * 1000000LL) {
+        if (detect < 0 && ec_atomic_load_u32(&hs->down)) detect = ec_cycle_now_ns() - t0;
+        int n = enabled(seg, slaves, victim);
+        if (n < others) others = n;
+        sleep_ms(1);
+    }
+    fault(seg, cable, victim, 0);
+    int64_t t1 = ec_cycle_now_ns();
+    while (ec_cycle_now_ns() - t1 < RECOVER_MS * 1000000LL) {
+        int n = enabled(seg, slaves, victim);
+        if (n < others) others = n;
+        if (sim_drive_ctx(&seg->context, (uint16)victim)->state == L7NH_ST_OPERATION_ENABLED) {
+            reenable = ec_cycle_now_ns() - t1;
+            break;
+        }
+        sleep_ms(1);
+    }
+    ec_segment_group_stop(&group);
+    ec_segment_group_join(&group);
+
+    ec_hist_summary_t late;
+    ec_hist_summarize(&seg->hist[EC_HIST_WAKE], period, &late);
+    printf("%s\t%d\t%lld\t%lld\t%d\t%.1f\t%.1f\t%.1f\t%u\t%u\t%u\t%d/%d\t%.1f\t%.2f\t%llu\t%d\n", cable ? "cable" : "power",
+        slaves, (long long)(period / 1000), (long long)(slice / 1000), victim, detect / 1e6,
+        hs->recovered ? hs->last_recovery_ns / 1e6 : -1.0, reenable / 1e6, (unsigned)hs->lost,
+        (unsigned)hs->recovered, (unsigned)hs->reconfigured, others, slaves - 1, late.max / 1e3,
+        seg->health.max_step_ns / 1e6, (unsigned long long)seg->health.carried, before == slaves);
+    ec_segment_close(seg);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int slaves = argc > 1 ? atoi(argv[1]) : 4;
+    int64_t period = argc > 2 ? atoll(argv[2]) * 1000 : EC_CYCLE_1MS;
+    int64_t slice = argc > 3 ? atoll(argv[3]) * 1000 : EC_HEALTH_SLICE_NS;
+
+    if (slaves < 2 || slaves > EC_AXES_MAX || !ec_cycle_valid_period(period) || slice <= 0) {
+        fprintf(stderr, "usage: bench_health [slaves 2..%d] [period_us 1000|500|250|125] [slice_us > 0]\n",
+                EC_AXES_MAX);
+        return 1;
+    }
+    sim_setup(slaves);
+    printf("outage\tslaves\tperiod_us\tslice_us\tslave\tdetect_ms\trecovery_ms\treenable_ms\tlost\trecovered"
+           "\treconfigured\tothers_enabled\tlate_max_us\tstep_max_ms\tcarried\tall_enabled_before\n");
+    for (int cable = 0; cable <= 1; cable++) {
+        if (run_case(cable, slaves, period, slice) != 0) return 1;
+    }
+    return 0;
+}
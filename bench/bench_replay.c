@@ -0,0 +1,287 @@
+// bench_replay.c
+// Replay of a recording (src/ec_replay.h) through the control core, on simulated drives in fixed-step
+// simulation time.
+// - record: the drives are enabled and their torque switches between +TORQUE and -TORQUE every SWITCH_MS
+//   (l7nh_set), every cycle recorded into l7nh_seg0.rec.
+// - replay: fresh drives, the recording played back cycle for cycle. The feedback has to follow it
+//   exactly: no cycle out of band.
+// - mutated: the recording with the velocity of axis 0 raised by MUTATE_RPM over MUTATE_CYCLES cycles
+//   half way through, played on fresh drives: exactly those cycles have to leave the velocity band.
+// - capture: a scope capture (ec_scope_save) of the recording, triggered half way and ending a quarter of it
+//   later: replayed on fresh drives it has to be accepted and followed exactly, like the recording.
+// - load: the same with the inertia of every drive times load. Velocity and position leave their bands,
+//   and l7nh_replay_seg0.txt lists where and by how much.
+// Output: one line per case, tab separated: cycles played of the recording, starved: cycles the streaming
+// window was behind, out-of-band cycles per channel and the episodes they form, p99 / max of the cycle
+// (deadline to the end of its work).
+// Exit status 2 when the replay diverged from its own recording, or the mutated or loaded one did not
+// (ctest runs it).
+// Usage: bench_replay [period_us] [axes] [seconds] [load]
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "sim_soem.h"
+#include "l7nh_core.h"
+#include "ec_hist.h"
+
+#define TORQUE          100
+#define SWITCH_MS       100
+#define WAIT_MS         5000        // for a stop or the end of a replay, on top of the run
+#define SOURCE          "l7nh_seg0.rec"
+#define MUTATED         "l7nh_mutated.rec"
+#define MUTATE_RPM      1000        // far outside the velocity band
+#define MUTATE_CYCLES   100
+#define CAPTURE         "l7nh_capture.rec"
+
+static l7nh_core_t core;
+
+static void sleep_ms(int ms) {
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static void on_event(void *user, l7nh_event_kind_t kind, const char *msg) {
+    (void)user;
+    if (kind == L7NH_EVENT_STATE && strncmp(msg, "Replay ", 7) == 0) fprintf(stderr, "%s\n", msg);
+}
+
+// Service loop until the core is in state, at most ms; the record case also sends its setpoints.
+static int serve(l7nh_state_t state, int ms, int record) {
+    l7nh_setpoint_t sp[EC_AXES_MAX];
+    int axes = core.segments[0].axes.count;
+    for (int t = 0; t < ms; t++) {
+        l7nh_poll(&core);
+        if (l7nh_state(&core) == state) return 0;
+        if (record && t % SWITCH_MS == 0) {
+            for (int i = 0; i < axes; i++) {
+                sp[i].axis = (uint16_t)i;
+                sp[i].value = (t / SWITCH_MS) & 1 ? -TORQUE : TORQUE;
+            }
+            l7nh_set(&core, sp, axes, 0, (uint32_t)t);
+        }
+        sleep_ms(1);
+    }
+    return -1;
+}
+
+static void disconnect(void) {
+    l7nh_disconnect(&core);
+    while (l7nh_poll(&core)) sleep_ms(1);
+}
+
+// Copy the recording src to dst with the velocity of axis 0 raised over MUTATE_CYCLES records half way
+// through. Returns the number of records changed, or -1.
+static int mutate(const char *src, const char *dst) {
+    static uint8_t header[EC_REC_HEADER_SIZE];
+    ec_rec_header_t hdr;
+    ec_rec_t rec;
+    FILE *in = fopen(src, "rb"), *out = fopen(dst, "wb");
+    int changed = -1;
+
+    if (!in || !out || fread(header, sizeof(header), 1, in) != 1) goto done;
+    memcpy(&hdr, header, sizeof(hdr));
+    if (hdr.header_size != sizeof(header) || hdr.head > hdr.capacity || fwrite(header, sizeof(header), 1, out) != 1) {
+        goto done;
+    }
+    // the recording has not wrapped: record n is in slot n, one record per axis and cycle
+    uint64_t first = hdr.head / hdr.axes / 2 * hdr.axes, last = first + (uint64_t)MUTATE_CYCLES * hdr.axes;
+    changed = 0;
+    for (uint64_t n = 0; n < hdr.capacity && changed >= 0; n++) {
+        if (fread(&rec, sizeof(rec), 1, in) != 1) {
+            changed = -1;
+            break;
+        }
+        if (n >= first && n < last && n < hdr.head && rec.axis == 0) {
+            rec.velocity += MUTATE_RPM;
+            changed++;
+        }
+        if (fwrite(&rec, sizeof(rec), 1, out) != 1) changed = -1;
+    }
+done:
+    if (in) fclose(in);
+    if (out && fclose(out) != 0) changed = -1;
+    return changed;
+}
+
+// Feed the recording src cycle by cycle through a scope that triggers (overrun) half way through and
+// keeps every cycle before; save the capture to dst. Its record count is not a power of two, so the file
+// ends before the capacity in its header. Returns the number of cycles captured, or -1.
+static int capture(const char *src, const char *dst) {
+    static ec_axes_t ax;
+    static ec_scope_t sc;
+    ec_rec_header_t hdr;
+    ec_rec_t rec;
+    FILE *in = fopen(src, "rb");
+    int cycles = -1;
+
+    if (!in || fread(&hdr, sizeof(hdr), 1, in) != 1 || hdr.head > hdr.capacity || hdr.axes > EC_AXES_MAX ||
+        fseek(in, (long)hdr.header_size, SEEK_SET) != 0) {
+        goto done;
+    }
+    uint64_t total = hdr.head / hdr.axes, trigger = total / 2;
+    if (ec_scope_init(&sc, (int)hdr.axes, hdr.period_ns, (uint32_t)trigger, (uint32_t)(total / 4),
+                      EC_SCOPE_TRIG_OVERRUN, 0) != 0) {
+        goto done;
+    }
+    ec_scope_arm(&sc);
+    memset(&ax, 0, sizeof(ax));
+    ax.count = (int)hdr.axes;
+    for (uint64_t c = 0; c < total && !ec_scope_frozen(&sc); c++) {
+        int64_t time_ns = 0;
+        uint32_t tick = 0;
+        int wkc_ok = 1;
+        for (int i = 0; i < ax.count; i++) {
+            if (fread(&rec, sizeof(rec), 1, in) != 1) goto freed;
+            time_ns = rec.time_ns;
+            tick = rec.cycle;
+            wkc_ok = (rec.flags & EC_REC_WKC_OK) != 0;
+            ax.statusword[i] = rec.statusword;
+            ax.controlword[i] = rec.controlword;
+            ax.target_torque[i] = rec.target_torque;
+            ax.actual_torque[i] = rec.actual_torque;
+            ax.actual_velocity[i] = rec.velocity;
+            ax.actual_position[i] = rec.position;
+            ax.enabled[i] = (rec.flags & EC_REC_ENABLED) != 0;
+        }
+        ec_scope_cycle(&sc, &ax, time_ns, tick, wkc_ok, c == trigger);
+    }
+    cycles = ec_scope_save(&sc, dst);
+freed:
+    ec_scope_free(&sc);
+done:
+    if (in) fclose(in);
+    return cycles;
+}
+
+static int run_case(const char *kind, const l7nh_config_t *cfg, const char *ifname, int ms, double load,
+                    uint64_t out[EC_REPLAY_CHANNELS]) {
+    ec_hist_summary_t total;
+
+    if (l7nh_connect(&core, ifname, cfg, on_event, NULL) < 0) return -1;
+    ec_axes_t *ax = &core.segments[0].axes;
+    for (int i = 0; i < ax->count; i++) sim_drive_ctx(&core.segments[0].context, ax->slave[i])->inertia *= load;
+    l7nh_start(&core);
+    if (cfg->replay[0]) {
+        // runs until the recording is over and stops by itself
+        if (serve(L7NH_RUNNING, WAIT_MS, 0) != 0 || serve(L7NH_CONNECTED, ms + WAIT_MS, 0) != 0) {
+            fprintf(stderr, "%s: the replay did not run to its end\n", kind);
+            disconnect();
+            return -1;
+        }
+    } else {
+        serve(L7NH_IDLE, ms, 1);
+        l7nh_stop(&core);
+        serve(L7NH_CONNECTED, WAIT_MS, 0);
+    }
+    ec_hist_summarize(&core.segments[0].hist[EC_HIST_TOTAL], cfg->cycle_ns, &total);
+
+    const ec_replay_t *rp = &core.replays[0];
+    for (int c = 0; c < EC_REPLAY_CHANNELS; c++) out[c] = cfg->replay[0] ? ec_replay_out(rp, (ec_replay_channel_t)c) : 0;
+    if (cfg->replay[0] && rp->played != rp->cycles) out[EC_REPLAY_STATE]++;     // not played to its end
+    if (cfg->replay[0]) {
+        uint32_t episodes = 0;
+        for (int i = 0; i < rp->axes; i++) {
+            for (int c = 0; c < EC_REPLAY_CHANNELS; c++) episodes += rp->track[i][c].episodes;
+        }
+        printf("%s\t%d\t%llu\t%llu\t%u\t%llu\t%llu\t%llu\t%llu\t%u\t%.1f\t%.1f\n", kind, ax->count,
+            (unsigned long long)rp->played, (unsigned long long)rp->cycles, (unsigned)rp->starved,
+            (unsigned long long)ec_replay_out(rp, EC_REPLAY_STATE), (unsigned long long)ec_replay_out(rp, EC_REPLAY_TORQUE),
+            (unsigned long long)ec_replay_out(rp, EC_REPLAY_VELOCITY),
+            (unsigned long long)ec_replay_out(rp, EC_REPLAY_POSITION), (unsigned)episodes, total.p99 / 1e3,
+            total.max / 1e3);
+    } else {
+        printf("%s\t%d\t%llu\t%llu\t-\t-\t-\t-\t-\t-\t%.1f\t%.1f\n", kind, ax->count,
+            (unsigned long long)core.segments[0].cycle.cycles, (unsigned long long)core.segments[0].cycle.cycles,
+            total.p99 / 1e3, total.max / 1e3);
+    }
+    disconnect();
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int64_t period = argc > 1 ? atoll(argv[1]) * 1000 : EC_CYCLE_1MS;
+    int axes = argc > 2 ? atoi(argv[2]) : 4;
+    double seconds = argc > 3 ? atof(argv[3]) : 2.0;
+    double load = argc > 4 ? atof(argv[4]) : 1.5;
+    l7nh_config_t cfg;
+
+    if (!ec_cycle_valid_period(period) || axes < 1 || axes > EC_AXES_MAX || seconds <= 0.0 || load <= 0.0) {
+        fprintf(stderr, "usage: bench_replay [period_us 1000|500|250|125] [axes 1..%d] [seconds] [load]\n",
+            EC_AXES_MAX);
+        return 1;
+    }
+    l7nh_config_default(&cfg);
+    cfg.cycle_ns = period;
+    cfg.scope = 0;
+    cfg.shm = 0;
+    cfg.topo_cache = 0;
+    cfg.torque_set = TORQUE;
+    cfg.cpu0 = -1;
+    sim_setup(axes);
+    sim_set_fixed_step(period);
+
+    int ms = (int)(seconds * 1000);
+    uint64_t out[EC_REPLAY_CHANNELS], diverged = 0;
+    int wrong = 0;
+    printf("case\taxes\tplayed\tcycles\tstarved\tstate\ttorque\tvelocity\tposition\tepisodes\tcycle_p99_us"
+           "\tcycle_max_us\n");
+    if (run_case("record", &cfg, "sim0", ms, 1.0, out) != 0) return 1;
+    cfg.record = 0;
+    snprintf(cfg.replay, sizeof(cfg.replay), "%s", SOURCE);
+    if (run_case("replay", &cfg, "sim0", ms, 1.0, out) != 0) return 1;
+    for (int c = 0; c < EC_REPLAY_CHANNELS; c++) diverged += out[c];
+    if (diverged) {
+        fprintf(stderr, "replay: %llu cycles out of band against its own recording\n", (unsigned long long)diverged);
+        wrong++;
+    }
+    if (mutate(SOURCE, MUTATED) != MUTATE_CYCLES) {
+        fprintf(stderr, "%s: cannot mutate into %s\n", SOURCE, MUTATED);
+        return 1;
+    }
+    snprintf(cfg.replay, sizeof(cfg.replay), "%s", MUTATED);
+    if (run_case("mutated", &cfg, "sim0", ms, 1.0, out) != 0) return 1;
+    if (out[EC_REPLAY_VELOCITY] != MUTATE_CYCLES) {
+        fprintf(stderr, "mutated: %llu velocity cycles out of band, expected %d\n",
+            (unsigned long long)out[EC_REPLAY_VELOCITY], MUTATE_CYCLES);
+        wrong++;
+    }
+    remove(MUTATED);
+    int captured = capture(SOURCE, CAPTURE);
+    if (captured <= 0) {
+        fprintf(stderr, "%s: cannot capture into %s\n", SOURCE, CAPTURE);
+        return 1;
+    }
+    snprintf(cfg.replay, sizeof(cfg.replay), "%s", CAPTURE);
+    if (run_case("capture", &cfg, "sim0", ms, 1.0, out) != 0) return 1;
+    diverged = 0;
+    for (int c = 0; c < EC_REPLAY_CHANNELS; c++) diverged += out[c];
+    if (diverged || core.replays[0].played != (uint64_t)captured) {
+        fprintf(stderr, "capture: %llu of %d cycles played, %llu out of band\n",
+            (unsigned long long)core.replays[0].played, captured, (unsigned long long)diverged);
+        wrong++;
+    }
+    remove(CAPTURE);
+    snprintf(cfg.replay, sizeof(cfg.replay), "%s", SOURCE);
+    if (run_case("load", &cfg, "sim0", ms, load, out) != 0) return 1;
+    if (load != 1.0 && out[EC_REPLAY_VELOCITY] == 0) {
+        fprintf(stderr, "load: the heavier drives followed the recording\n");
+        wrong++;
+    }
+    return wrong ? 2 : 0;
+}
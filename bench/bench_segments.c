@@ -0,0 +1,110 @@
+// bench_segments.c
+// Multi-segment scaling: 1..EC_SEGMENT_MAX simulated segments, each on its own context and its own
+// cyclic thread pinned to core i, all driving the same number of axes for a fixed time.
+// Every hook reads the feedback of axis 0 of segment 0 (a cross-segment coordinated setpoint) and
+// checks that every peer segment has unpacked the same cycle ("skew" counts hooks that did not).
+// Output: one line per segment count, tab separated; axis_updates_s is the aggregate throughput.
+// Usage: bench_segments [axes_per_segment] [period_us] [seconds]
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "sim_soem.h"
+#include "ec_segment.h"
+
+#define L7NH_VENDOR     0x00007595
+#define BENCH_PRIORITY  80
+
+static ec_segment_t segments[EC_SEGMENT_MAX];
+static ec_segment_group_t group;
+static volatile uint32_t skew[EC_SEGMENT_MAX];
+
+static void coordinated_hook(ec_segment_t *seg, uint32_t tick, void *user) {
+    ec_segment_group_t *g = (ec_segment_group_t *)user;
+    int32_t lead = g->seg[0]->axes.actual_velocity[0];
+
+    for (int i = 0; i < g->count; i++) {
+        if (g->seg[i]->tick != tick) skew[seg->index]++;
+    }
+    for (int i = 0; i < seg->axes.count; i++) {
+        seg->axes.mode[i] = 10;
+        // follow the lead axis, stay well below the overspeed trip
+        seg->axes.target_torque[i] = (int16_t)(lead < 1000 ? 100 : 0);
+    }
+}
+
+int main(int argc, char **argv) {
+    int axes = argc > 1 ? atoi(argv[1]) : 16;
+    int64_t period = argc > 2 ? atoll(argv[2]) * 1000 : EC_CYCLE_1MS;
+    int seconds = argc > 3 ? atoi(argv[3]) : 2;
+
+    if (!ec_cycle_valid_period(period)) {
+        fprintf(stderr, "period must be 1000, 500, 250 or 125 us\n");
+        return 1;
+    }
+    sim_setup(axes);
+    printf("segments\taxes\tperiod_us\tcycles\toverruns\tmax_late_us\tmax_exchange_us\tmax_barrier_us"
+           "\tbarrier_timeouts\tskew\trt\taxis_updates_s\n");
+    for (int n = 1; n <= EC_SEGMENT_MAX; n++) {
+        ec_segment_group_init(&group, period, coordinated_hook, &group);
+        for (int i = 0; i < n; i++) {
+            char ifname[16];
+            snprintf(ifname, sizeof(ifname), "sim%d", i);
+            if (ec_segment_connect(&segments[i], ifname, period, L7NH_VENDOR, EC_SEGMENT_COMPACT_PDO) != 0) {
+                fprintf(stderr, "%s: %s\n", ifname, segments[i].error);
+                return 1;
+            }
+            ec_axes_command(&segments[i].axes, CIA402_TARGET_ENABLED, ec_cycle_now_ns());
+            ec_segment_group_add(&group, &segments[i], i);
+            skew[i] = 0;
+        }
+        if (ec_segment_group_start(&group, BENCH_PRIORITY) != 0) {
+            fprintf(stderr, "cannot start the cyclic threads\n");
+            return 1;
+        }
+        int64_t t0 = ec_cycle_now_ns();
+        while (ec_cycle_now_ns() - t0 < (int64_t)seconds * 1000000000LL) {
+#ifdef _WIN32
+            Sleep(10);
+#else
+            struct timespec ts = { 0, 10000000 };
+            nanosleep(&ts, NULL);
+#endif
+        }
+        ec_segment_group_stop(&group);
+        ec_segment_group_join(&group);
+        double elapsed = (double)(ec_cycle_now_ns() - t0) * 1e-9;
+
+        uint64_t cycles = 0, overruns = 0, timeouts = 0, updates = 0, skewed = 0;
+        int64_t late = 0, exch = 0, barrier = 0;
+        int rt_ok = 1;
+        for (int i = 0; i < n; i++) {
+            ec_segment_t *seg = &segments[i];
+            cycles += seg->cycle.cycles;
+            overruns += seg->cycle.overruns;
+            timeouts += seg->stats.barrier_timeouts;
+            skewed += skew[i];
+            updates += seg->cycle.cycles * (uint64_t)seg->axes.count;
+            if (seg->cycle.max_late_ns > late) late = seg->cycle.max_late_ns;
+            if (seg->stats.max_exchange_ns > exch) exch = seg->stats.max_exchange_ns;
+            if (seg->stats.max_barrier_ns > barrier) barrier = seg->stats.max_barrier_ns;
+            if (seg->rt_error) rt_ok = 0;
+            ec_segment_close(seg);
+        }
+        printf("%d\t%d\t%lld\t%llu\t%llu\t%.1f\t%.1f\t%.1f\t%llu\t%llu\t%d\t%.0f\n", n, axes,
+            (long long)(period / 1000), (unsigned long long)cycles, (unsigned long long)overruns, late / 1e3,
+            exch / 1e3, barrier / 1e3, (unsigned long long)timeouts, (unsigned long long)skewed, rt_ok,
+            (double)updates / elapsed);
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+// bench_shm.c
+// Shared process image (ec_shm.c) on a simulated segment, seen from a second mapping of the same area
+// as another process would see it.
+// - publish_ns / take_ns: cost of ec_shm_publish and of an ec_shm_take without a new commit per cycle,
+//   measured in a tight loop before the cycle starts.
+// - Then, for ROUNDS rounds, the client commits a new torque for every axis and reads the status in place
+//   (seqlock) until the cycle sends it: latency is commit -> first status that shows it, age is how old
+//   the status was when read (now - cycle wakeup). Both should stay within about one period.
+// Output: one line per axis count, tab separated. retries: in-place reads a cycle overwrote; torn: cycles
+// that found a commit half written; torn_reads: reads the seqlock let through although the status mixed
+// two cycles (the axes of a round all get the same torque, so they must all show the same).
+// Exit status 2 when there was a torn read (ctest runs it).
+// Usage: bench_shm [period_us] [rounds]
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "sim_soem.h"
+#include "ec_segment.h"
+#include "ec_shm.h"
+#include "ec_hist.h"
+
+#define L7NH_VENDOR     0x00007595
+#define BENCH_PRIORITY  80
+#define BENCH_SEGMENT   9       // area l7nh_seg9, clear of a daemon running next to the bench
+#define LOOPS           100000
+#define SETTLE_MS       200
+
+static ec_segment_t segment;
+static ec_segment_group_t group;
+static ec_shm_t owner, client;
+static uint64_t torn_reads;
+
+static void sleep_ms(int ms) {
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// Torque from the shared input on the axes it drives, 0 on the others.
+static void shm_hook(ec_segment_t *seg, uint32_t tick, void *user) {
+    uint64_t mask = ec_shm_take(seg->shm, seg->cycle.wake_ns);
+    (void)tick;
+    (void)user;
+    for (int i = 0; i < seg->axes.count; i++) {
+        seg->axes.mode[i] = 10;
+        seg->axes.target_torque[i] = (int16_t)((mask >> i) & 1u ? seg->shm->value[i] : 0);
+    }
+}
+
+static int run_case(int axes, int64_t period, int rounds) {
+    ec_segment_t *seg = &segment;
+    ec_hist_t latency, age;
+    uint64_t retries = 0;
+
+    sim_setup(axes);
+    if (ec_segment_connect(seg, "sim0", period, L7NH_VENDOR, EC_SEGMENT_COMPACT_PDO) != 0) {
+        fprintf(stderr, "connect: %s\n", seg->error);
+        return -1;
+    }
+    if (ec_shm_create(&owner, BENCH_SEGMENT, &seg->axes, period, 0) != 0 || ec_shm_attach(&client, BENCH_SEGMENT) != 0) {
+        fprintf(stderr, "cannot create or attach the shared process image\n");
+        ec_shm_close(&owner);
+        ec_segment_close(seg);
+        return -1;
+    }
+
+    int64_t t0 = ec_cycle_now_ns();
+    for (int n = 0; n < LOOPS; n++) ec_shm_publish(&owner, &seg->axes, t0, (uint32_t)n, 0, 0);
+    double publish_ns = (double)(ec_cycle_now_ns() - t0) / LOOPS;
+    t0 = ec_cycle_now_ns();
+    for (int n = 0; n < LOOPS; n++) ec_shm_take(&owner, t0);
+    double take_ns = (double)(ec_cycle_now_ns() - t0) / LOOPS;
+
+    ec_axes_command(&seg->axes, CIA402_TARGET_ENABLED, ec_cycle_now_ns());
+    ec_segment_group_init(&group, period, shm_hook, NULL);
+    ec_segment_group_add(&group, seg, 0);
+    seg->shm = &owner;
+    ec_shm_set_running(&owner, 1);
+    if (ec_segment_group_start(&group, BENCH_PRIORITY) != 0) {
+        fprintf(stderr, "cannot start the threads: %s\n", seg->error);
+        ec_shm_close(&client);
+        ec_shm_close(&owner);
+        ec_segment_close(seg);
+        return -1;
+    }
+    sleep_ms(SETTLE_MS);
+
+    ec_hist_init(&latency);
+    ec_hist_init(&age);
+    int32_t value[EC_AXES_MAX];
+    for (int r = 0; r < rounds; r++) {
+        int16_t torque = (int16_t)(1 + r % 50);
+        for (int i = 0; i < EC_AXES_MAX; i++) value[i] = torque;
+        int64_t commit = ec_cycle_now_ns();
+        ec_shm_set(&client, ~0ull >> (64 - axes), value);
+        for (;;) {
+            const ec_shm_status_t *st = &client.area->status;
+            int16_t sent[EC_AXES_MAX];
+            uint32_t begin = ec_shm_read_begin(&client);
+            memcpy(sent, (const void *)st->target_torque, sizeof(int16_t) * (size_t)axes);
+            int64_t cycle_ns = st->time_ns;
+            if (ec_shm_read_retry(&client, begin)) {
+                retries++;
+                continue;
+            }
+            for (int i = 1; i < axes; i++) {
+                if (sent[i] != sent[0]) {
+                    torn_reads++;
+                    break;
+                }
+            }
+            int64_t now = ec_cycle_now_ns();
+            ec_hist_record(&age, now - cycle_ns);
+            if (sent[axes - 1] == torque) {
+                ec_hist_record(&latency, now - commit);
+                break;
+            }
+            if (now - commit > 100 * period) break;     // never arrived: shows as a missing round
+        }
+        sleep_ms(2);
+    }
+    ec_segment_group_stop(&group);
+    ec_segment_group_join(&group);
+    ec_shm_set_running(&owner, 0);
+
+    ec_hist_summary_t lat, ag;
+    ec_hist_summarize(&latency, period, &lat);
+    ec_hist_summarize(&age, period, &ag);
+    printf("%d\t%lld\t%.0f\t%.0f\t%d\t%llu\t%.1f\t%.1f\t%.1f\t%.1f\t%llu\t%u\t%llu\n", axes,
+        (long long)(period / 1000), publish_ns, take_ns, rounds, (unsigned long long)lat.count, lat.p50 / 1e3,
+        lat.max / 1e3, ag.p99 / 1e3, ag.max / 1e3, (unsigned long long)retries, (unsigned)client.area->input.torn,
+        (unsigned long long)torn_reads);
+    ec_shm_close(&client);
+    ec_shm_close(&owner);
+    ec_segment_close(seg);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static const int axes[] = { 1, 8, 64 };
+    int64_t period = argc > 1 ? atoll(argv[1]) * 1000 : EC_CYCLE_1MS;
+    int rounds = argc > 2 ? atoi(argv[2]) : 200;
+
+    if (!ec_cycle_valid_period(period) || rounds < 1) {
+        fprintf(stderr, "usage: bench_shm [period_us 1000|500|250|125] [rounds >= 1]\n");
+        return 1;
+    }
+    printf("axes\tperiod_us\tpublish_ns\ttake_ns\trounds\tarrived\tlatency_p50_us\tlatency_max_us\tage_p99_us"
+           "\tage_max_us\tretries\ttorn\ttorn_reads\n");
+    uint64_t torn = 0;
+    for (size_t k = 0; k < sizeof(axes) / sizeof(axes[0]); k++) {
+        torn_reads = 0;
+        if (run_case(axes[k], period, rounds) != 0) return 1;
+        torn += torn_reads;
+    }
+    return torn ? 2 : 0;
+}
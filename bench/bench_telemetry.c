@@ -0,0 +1,215 @@
+// bench_telemetry.c
+// What a GUI that stops pumping messages does to the cycle. The cyclic engine (ec_cycle) runs one simulated
+// axis at 1 ms on a real-time thread; a second thread stands in for the GUI thread and takes what the cycle
+// hands it every GUI_REFRESH_MS, except for STALL_MS in the middle of the run, as a GUI thread does while
+// the window is dragged or resized (the modal move/size loop) or while it waits for the control thread.
+// - ring:  every cycle pushes a record into the telemetry ring (src/telemetry.h) and goes on; the GUI
+//          drains it on its timer. A stall loses records (dropped), never time.
+// - sync:  every STATUS_CYCLES the cycle hands over a status text and waits until the GUI took it, as
+//          SetWindowText from another thread does (a SendMessage). An idle GUI takes it at once, as
+//          GetMessage dispatches sent messages; a stalled one only afterwards, and holds the cycle.
+// Output: one line per case, tab separated: wakeup lateness p50 / p99 / max, the longest hand-off (push or
+// wait for the GUI) of a cycle, overruns (deadlines the engine skipped because a cycle ran into the next one)
+// and dropped records.
+// Usage: bench_telemetry [seconds] [stall_ms]
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim_soem.h"
+#include "ec_axes.h"
+#include "ec_pdocfg.h"
+#include "ec_cycle.h"
+#include "telemetry.h"
+
+#define BENCH_PRIORITY  80
+#define BENCH_WARMUP    200     // cycles not sampled (drive enabling)
+#define GUI_REFRESH_MS  50      // as the GUI timers
+#define STATUS_CYCLES   100     // as the velocity display of the v1 GUI (SDO_DECIMATION)
+#define L7NH_VENDOR     0x00007595
+
+enum { CASE_RING, CASE_SYNC };
+
+typedef struct {
+    int kind;
+    uint64_t target;            // sampled cycles to run
+    uint64_t n;
+    int64_t *late;
+    int stalled;                // set by the GUI thread once it stalled
+    int64_t handoff_max_ns;     // longest hand-off of a cycle to the GUI
+    telemetry_ring_t ring;
+    // sync hand-off: posted by the cycle, taken by the GUI
+    pthread_mutex_t lock;
+    pthread_cond_t to_gui, to_cycle;
+    int posted;
+    volatile int quit;
+} bench_t;
+
+static uint8 iomap[1 << 16];
+static ec_axes_t axes;
+static int stall_ms;
+
+static int connect_axes(void) {
+    sim_setup(1);
+    sim_set_fixed_step(0);
+    if (!ec_init("sim") || ec_config_init(FALSE) != 1) return -1;
+    ec_pdocfg_install(1);
+    ec_config_map(iomap);
+    if (ec_axes_discover(&axes, L7NH_VENDOR) != 1) return -1;
+    for (int s = 0; s <= ec_slavecount; s++) ec_slave[s].state = EC_STATE_OPERATIONAL;
+    ec_writestate(0);
+    ec_statecheck(0, EC_STATE_OPERATIONAL, EC_TIMEOUTSTATE);
+    axes.mode[0] = 10;
+    ec_axes_command(&axes, CIA402_TARGET_ENABLED, ec_cycle_now_ns());
+    return 0;
+}
+
+static void sleep_ns(int64_t ns) {
+    struct timespec ts = { (time_t)(ns / 1000000000LL), (long)(ns % 1000000000LL) };
+    nanosleep(&ts, NULL);
+}
+
+static void bench_hook(ec_cycle_t *cyc, void *user) {
+    bench_t *b = (bench_t *)user;
+
+    ec_send_processdata();
+    int wkc = ec_receive_processdata(EC_TIMEOUTRET);
+    ec_axes_unpack(&axes);
+    ec_axes_update(&axes, cyc->wake_ns);
+    axes.target_torque[0] = (int16_t)(axes.actual_velocity[0] < 1000 ? 100 : 0);
+    ec_axes_pack(&axes);
+
+    int64_t t0 = ec_cycle_now_ns();
+    if (b->kind == CASE_RING) {
+        telemetry_rec_t rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.timestamp_ns = cyc->wake_ns;
+        rec.velocity = axes.actual_velocity[0];
+        rec.wkc = wkc;
+        rec.late_ns = (int32_t)cyc->last_late_ns;
+        rec.statusword = axes.statusword[0];
+        rec.torque = axes.target_torque[0];
+        telemetry_push(&b->ring, &rec);
+    } else if (cyc->cycles % STATUS_CYCLES == 0) {
+        pthread_mutex_lock(&b->lock);
+        b->posted = 1;
+        pthread_cond_signal(&b->to_gui);
+        while (b->posted) pthread_cond_wait(&b->to_cycle, &b->lock);
+        pthread_mutex_unlock(&b->lock);
+    }
+    int64_t handoff = ec_cycle_now_ns() - t0;
+
+    if (cyc->cycles < BENCH_WARMUP) return;
+    b->late[b->n] = cyc->last_late_ns;
+    if (handoff > b->handoff_max_ns) b->handoff_max_ns = handoff;
+    if (++b->n == b->target) ec_cycle_stop(cyc);
+}
+
+// The GUI thread: its timer every GUI_REFRESH_MS, in between waiting for sent messages; stalled once for
+// stall_ms half way through the run.
+static void *gui_thread(void *arg) {
+    bench_t *b = (bench_t *)arg;
+    telemetry_summary_t sum;
+    int64_t stall_at = ec_cycle_now_ns() + (int64_t)b->target * EC_CYCLE_1MS / 2;
+
+    while (!b->quit) {
+        if (!b->stalled && ec_cycle_now_ns() >= stall_at) {
+            b->stalled = 1;
+            sleep_ns((int64_t)stall_ms * 1000000LL);
+        }
+        if (b->kind == CASE_RING) {
+            telemetry_drain(&b->ring, &sum);
+            sleep_ns(GUI_REFRESH_MS * 1000000LL);
+            continue;
+        }
+        int64_t tick = ec_cycle_now_ns() + GUI_REFRESH_MS * 1000000LL;
+        struct timespec ts = { (time_t)(tick / 1000000000LL), (long)(tick % 1000000000LL) };
+        pthread_mutex_lock(&b->lock);
+        while (!b->quit && ec_cycle_now_ns() < tick) {
+            if (b->posted) {
+                b->posted = 0;
+                pthread_cond_signal(&b->to_cycle);
+            }
+            pthread_cond_timedwait(&b->to_gui, &b->lock, &ts);
+        }
+        pthread_mutex_unlock(&b->lock);
+    }
+    return NULL;
+}
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of a sorted array; per_mille 1000 = max.
+static int64_t percentile(const int64_t *v, uint64_t n, int per_mille) {
+    uint64_t rank = (n * (uint64_t)per_mille + 999) / 1000;
+    return v[rank ? rank - 1 : 0];
+}
+
+static int run_case(bench_t *b, int kind, const char *name) {
+    ec_cycle_t cyc;
+    pthread_t gui;
+
+    if (connect_axes() != 0) {
+        fprintf(stderr, "connect failed\n");
+        return -1;
+    }
+    b->kind = kind;
+    b->n = 0;
+    b->stalled = 0;
+    b->handoff_max_ns = 0;
+    b->posted = 0;
+    b->quit = 0;
+    telemetry_init(&b->ring);
+    if (pthread_create(&gui, NULL, gui_thread, b) != 0) return -1;
+    ec_cycle_init(&cyc, EC_CYCLE_1MS, bench_hook, b);
+    ec_cycle_run(&cyc);
+    uint64_t overruns = cyc.overruns;
+    ec_cycle_destroy(&cyc);
+    b->quit = 1;
+    pthread_join(gui, NULL);
+
+    qsort(b->late, b->n, sizeof(int64_t), cmp_i64);
+    printf("%s\t%llu\t%lld\t%lld\t%lld\t%d\t%lld\t%llu\t%u\n", name, (unsigned long long)b->n,
+        (long long)percentile(b->late, b->n, 500), (long long)percentile(b->late, b->n, 990),
+        (long long)percentile(b->late, b->n, 1000), stall_ms, (long long)b->handoff_max_ns,
+        (unsigned long long)overruns, (unsigned)b->ring.dropped);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+    static bench_t b;
+
+    stall_ms = argc > 2 ? atoi(argv[2]) : 500;
+    b.target = (uint64_t)(seconds * 1e9 / (double)EC_CYCLE_1MS);
+    if (seconds <= 0.0 || stall_ms < 0 || b.target < 2 * (uint64_t)stall_ms) {
+        fprintf(stderr, "usage: bench_telemetry [seconds] [stall_ms < half the run]\n");
+        return 1;
+    }
+    b.late = (int64_t *)malloc(sizeof(int64_t) * b.target);
+    if (!b.late) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);     // the clock of ec_cycle_now_ns
+    pthread_mutex_init(&b.lock, NULL);
+    pthread_cond_init(&b.to_gui, &attr);
+    pthread_cond_init(&b.to_cycle, NULL);
+
+    int rt = ec_cycle_set_realtime(BENCH_PRIORITY, -1) == 0;
+    printf("case\tcycles\twake_p50_ns\twake_p99_ns\twake_max_ns\tstall_ms\thandoff_max_ns\toverruns\tdropped\n");
+    if (run_case(&b, CASE_RING, "ring") != 0 || run_case(&b, CASE_SYNC, "sync") != 0) return 1;
+    if (!rt) fprintf(stderr, "real-time priority refused, lateness includes scheduling noise\n");
+    free(b.late);
+    return 0;
+}
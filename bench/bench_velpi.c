@@ -0,0 +1,142 @@
+// bench_velpi.c
+// Step response of the in-cycle velocity PI (ec_velpi.c) against the simulated L7NH in CST: every
+// axis is enabled at zero speed, then the velocity target steps to step_rpm. Cases: 1 ms and 250 us
+// cycle, nominal and 4x inertia (same gains). Built twice: bench_velpi (float) and bench_velpi_fixed
+// (EC_VELPI_FIXED, Q16.16).
+// Response figures are for axis 0: 10-90 % rise time, overshoot, time to stay within 2 % of the step,
+// mean error over the last 50 ms and the largest torque commanded; update_ns_per_axis is the cost of
+// ec_velpi_update.
+// Output: one line per case, tab separated.
+// Usage: bench_velpi [axes] [step_rpm] [kp] [ki] [ka]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim_soem.h"
+#include "ec_axes.h"
+#include "ec_pdocfg.h"
+#include "ec_cycle.h"
+#include "ec_velpi.h"
+
+#define L7NH_VENDOR     0x00007595
+#define MODE_CST        10
+#define TORQUE_LIMIT    3000            // 300 % of rated, the drive's own 0x6072 default
+#define RESPONSE_NS     300000000LL     // recorded after the step
+#define TAIL_NS         50000000LL      // window for the steady-state error
+#define MAX_CYCLES      (RESPONSE_NS / EC_CYCLE_125US)
+
+#ifdef EC_VELPI_FIXED
+#define ARITH "fixed"
+#else
+#define ARITH "float"
+#endif
+
+static uint8 iomap[1 << 16];
+static ec_axes_t axes;
+static ec_velpi_t pi;
+static int32_t vel[MAX_CYCLES];
+static int reached;                     // axes enabled, from the last cycle
+
+static int connect_axes(int n, int64_t period_ns, double inertia_x) {
+    sim_setup(n);
+    sim_set_fixed_step(period_ns);
+    if (!ec_init("sim") || ec_config_init(FALSE) != n) return -1;
+    for (int s = 1; s <= n; s++) {
+        ec_pdocfg_install((uint16_t)s);
+        sim_drive((uint16)s)->inertia *= inertia_x;
+    }
+    ec_config_map(iomap);
+    if (ec_axes_discover(&axes, L7NH_VENDOR) != n) return -1;
+    for (int s = 0; s <= ec_slavecount; s++) ec_slave[s].state = EC_STATE_OPERATIONAL;
+    ec_writestate(0);
+    ec_statecheck(0, EC_STATE_OPERATIONAL, EC_TIMEOUTSTATE);
+    for (int i = 0; i < n; i++) axes.mode[i] = MODE_CST;
+    ec_axes_command(&axes, CIA402_TARGET_ENABLED, sim_time_ns());
+    return 0;
+}
+
+// One cycle; returns the time ec_velpi_update took.
+static int64_t cycle(void) {
+    ec_send_processdata();
+    ec_receive_processdata(EC_TIMEOUTRET);
+    ec_axes_unpack(&axes);
+    reached = ec_axes_update(&axes, sim_time_ns());
+    int64_t t0 = ec_cycle_now_ns();
+    ec_velpi_update(&pi, axes.actual_velocity, axes.enabled, axes.target_torque);
+    int64_t t1 = ec_cycle_now_ns();
+    ec_axes_pack(&axes);
+    return t1 - t0;
+}
+
+static int run_case(int n, int64_t period_ns, double inertia_x, int32_t step, double kp, double ki, double ka) {
+    int cycles = (int)(RESPONSE_NS / period_ns), tail = (int)(TAIL_NS / period_ns);
+    int64_t cost = 0;
+    int16_t peak = 0;
+
+    if (connect_axes(n, period_ns, inertia_x) != 0) {
+        fprintf(stderr, "connect with %d axes failed\n", n);
+        return -1;
+    }
+    ec_velpi_init(&pi, n, period_ns, kp, ki, ka, TORQUE_LIMIT);
+    reached = 0;
+    for (int c = 0; c < 2000 && reached < n; c++) cycle();
+    if (reached < n) {
+        fprintf(stderr, "drives not enabled\n");
+        ec_close();
+        return -1;
+    }
+
+    ec_velpi_reset(&pi);
+    for (int i = 0; i < n; i++) pi.target[i] = step;
+    for (int c = 0; c < cycles; c++) {
+        cost += cycle();
+        vel[c] = axes.actual_velocity[0];
+        int16_t t = axes.target_torque[0] < 0 ? (int16_t)-axes.target_torque[0] : axes.target_torque[0];
+        if (t > peak) peak = t;
+    }
+
+    // 10-90 % rise, overshoot, 2 % settling, steady-state error
+    int c10 = -1, c90 = -1, settle = 0;
+    int32_t max = 0, band = step / 50;
+    double err = 0.0;
+    for (int c = 0; c < cycles; c++) {
+        if (c10 < 0 && vel[c] >= step / 10) c10 = c;
+        if (c90 < 0 && vel[c] >= step - step / 10) c90 = c;
+        if (vel[c] > max) max = vel[c];
+        if (vel[c] > step + band || vel[c] < step - band) settle = c + 1;
+        if (c >= cycles - tail) err += step - vel[c];
+    }
+    double ms = (double)period_ns * 1e-6;
+    printf("%s\t%lld\t%.0f\t%d\t", ARITH, (long long)(period_ns / 1000), inertia_x, (int)step);
+    if (c10 >= 0 && c90 >= 0) printf("%.2f\t", (c90 - c10) * ms);
+    else printf("-\t");
+    printf("%.1f\t", max > step ? 100.0 * (max - step) / step : 0.0);
+    if (settle < cycles) printf("%.2f\t", settle * ms);
+    else printf("-\t");
+    printf("%.2f\t%d\t%u\t%.2f\n", err / tail, (int)peak, (unsigned)pi.saturated[0], (double)cost / cycles / n);
+    ec_close();
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 4;
+    int32_t step = argc > 2 ? atoi(argv[2]) : 1000;
+    double kp = argc > 3 ? atof(argv[3]) : 8.0;
+    double ki = argc > 4 ? atof(argv[4]) : 800.0;
+    double ka = argc > 5 ? atof(argv[5]) : 0.0;
+    static const int64_t periods[] = { EC_CYCLE_1MS, EC_CYCLE_250US };
+    static const double inertia[] = { 1.0, 4.0 };
+
+    if (n < 1 || n > EC_AXES_MAX || step <= 0) {
+        fprintf(stderr, "usage: bench_velpi [axes 1..%d] [step_rpm > 0] [kp] [ki] [ka]\n", EC_AXES_MAX);
+        return 1;
+    }
+    printf("arith\tperiod_us\tinertia_x\tstep_rpm\trise_ms\tovershoot_pct\tsettle_ms\tss_err_rpm\tpeak_torque"
+           "\tsaturated\tupdate_ns_per_axis\n");
+    for (size_t p = 0; p < sizeof(periods) / sizeof(periods[0]); p++) {
+        for (size_t j = 0; j < sizeof(inertia) / sizeof(inertia[0]); j++) {
+            if (run_case(n, periods[p], inertia[j], step, kp, ki, ka) != 0) return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,267 @@
+// bench_vslave.c
+// Frame round trip and frame-level behaviour of the wire-level slave emulator (sim/ecat_vslave.c) on a
+// veth pair, from a raw socket on the master end: one datagram per frame, as SOEM's NIC layer sends them.
+// - scan: BRD counts the slaves; APWR gives each a station address and FPRD reads it back; the SII
+//   vendor id is read through the EEPROM interface of every slave.
+// - fmmu: an FMMU of the last slave that reaches past the end of the ESC memory; an LRW over it in
+//   SAFE-OP reads the bytes that exist and leaves the rest of the datagram as sent.
+// - rtt: BRD round trips, send to receive of the answered frame.
+// Output: one line per case, tab separated, round trips in us.
+// Exit status 2 when an answer is wrong (ctest runs it through tests/vslave_wire.sh).
+// Usage: bench_vslave <ifname> [slaves] [frames]
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+
+#define ETH_P_ECAT      0x88A4
+#define FRAME_MAX       1518
+#define FRAME_MIN       60
+#define DG_HEAD         10
+#define REPLY_MS        100         // an answer later than this counts as lost
+#define ATTACH_MS       5000        // the emulator may still be opening its socket
+#define ESC_MEM_SIZE    0x10000
+
+// EtherCAT commands and ESC registers, as in sim/ecat_vslave.c
+enum { CMD_APWR = 2, CMD_FPRD = 4, CMD_FPWR = 5, CMD_BRD = 7, CMD_LRW = 12 };
+#define REG_STADR       0x0010
+#define REG_ALCTL       0x0120
+#define REG_EEPCTL      0x0502
+#define REG_EEPDAT      0x0508
+#define REG_FMMU0       0x0600
+#define SII_MAN         0x0008
+#define L7NH_VENDOR     0x00007595
+#define STATION0        0x1001
+#define FMMU_LADDR      0x00100000
+#define FMMU_LEN        64
+#define FMMU_INSIDE     32          // bytes of the FMMU inside the ESC memory
+#define PATTERN         0xA5
+
+static int fd;
+static uint8_t index_seq;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static uint16_t rd16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t rd32(const uint8_t *p) { return (uint32_t)rd16(p) | ((uint32_t)rd16(p + 2) << 16); }
+static void wr16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void wr32(uint8_t *p, uint32_t v) { wr16(p, (uint16_t)v); wr16(p + 2, (uint16_t)(v >> 16)); }
+
+static int open_socket(const char *ifname) {
+    struct sockaddr_ll sll;
+    struct ifreq ifr;
+    int s = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ECAT));
+    if (s < 0) return -1;
+
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (ioctl(s, SIOCGIFINDEX, &ifr) < 0) {
+        close(s);
+        return -1;
+    }
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_ifindex = ifr.ifr_ifindex;
+    sll.sll_protocol = htons(ETH_P_ECAT);
+    if (bind(s, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+// One datagram in one frame, sent and answered within REPLY_MS. addr is ADP | ADO << 16, or the logical
+// address. On an answer data holds what came back; returns its working counter, or -1 when none came.
+static int transact(uint8_t cmd, uint32_t addr, uint8_t *data, uint16_t len, int64_t *rtt_ns) {
+    uint8_t frame[FRAME_MAX], reply[FRAME_MAX];
+    int size = ETH_HLEN + 2 + DG_HEAD + len + 2;
+    uint8_t idx = index_seq++;
+
+    if (size > FRAME_MAX) return -1;
+    memset(frame, 0, sizeof(frame));
+    memset(frame, 0xFF, 6);                                 // broadcast
+    memset(frame + 6, 0x01, 6);                             // SOEM's primary MAC
+    frame[12] = ETH_P_ECAT >> 8;
+    frame[13] = ETH_P_ECAT & 0xFF;
+    uint8_t *ecat = frame + ETH_HLEN;
+    wr16(ecat, (uint16_t)((DG_HEAD + len + 2) | 0x1000));   // length, type 1
+    uint8_t *dg = ecat + 2;
+    dg[0] = cmd;
+    dg[1] = idx;
+    wr32(dg + 2, addr);
+    wr16(dg + 6, len);                                      // last datagram
+    memcpy(dg + DG_HEAD, data, len);
+    if (size < FRAME_MIN) size = FRAME_MIN;
+
+    int64_t t0 = now_ns();
+    if (send(fd, frame, (size_t)size, 0) != size) return -1;
+    int64_t deadline = t0 + REPLY_MS * 1000000LL;
+    for (;;) {
+        int64_t left = deadline - now_ns();
+        struct pollfd p = { fd, POLLIN, 0 };
+        if (left <= 0 || poll(&p, 1, (int)(left / 1000000) + 1) <= 0) return -1;
+        struct sockaddr_ll from;
+        socklen_t fromlen = sizeof(from);
+        int n = (int)recvfrom(fd, reply, sizeof(reply), 0, (struct sockaddr *)&from, &fromlen);
+        if (n < 0 || from.sll_pkttype == PACKET_OUTGOING) continue;     // our own frame
+        // processed by the first ESC (U/L bit of the source MAC), the datagram we sent
+        if (n < ETH_HLEN + 2 + DG_HEAD + len + 2 || !(reply[6] & 0x02) || reply[ETH_HLEN + 3] != idx) continue;
+        if (rtt_ns) *rtt_ns = now_ns() - t0;
+        memcpy(data, reply + ETH_HLEN + 2 + DG_HEAD, len);
+        return rd16(reply + ETH_HLEN + 2 + DG_HEAD + len);
+    }
+}
+
+static uint32_t phys(uint16_t adp, uint16_t ado) {
+    return adp | (uint32_t)ado << 16;
+}
+
+// Station addresses, read back, and the SII vendor id of every slave. Returns the wrong answers.
+static int scan(int slaves) {
+    uint8_t d[8];
+    int wrong = 0, wkc = -1;
+
+    memset(d, 0, sizeof(d));
+    for (int64_t until = now_ns() + ATTACH_MS * 1000000LL; wkc < 0 && now_ns() < until;) {
+        wkc = transact(CMD_BRD, phys(0, 0), d, 2, NULL);
+    }
+    if (wkc != slaves) {
+        fprintf(stderr, "scan: BRD answered by %d slaves, expected %d\n", wkc, slaves);
+        return 1;
+    }
+    for (int s = 0; s < slaves; s++) {
+        uint16_t station = (uint16_t)(STATION0 + s);
+        wr16(d, station);
+        if ((wkc = transact(CMD_APWR, phys((uint16_t)-s, REG_STADR), d, 2, NULL)) != 1) {
+            fprintf(stderr, "scan: APWR to slave %d, wkc %d\n", s + 1, wkc);
+            wrong++;
+        }
+        memset(d, 0, sizeof(d));
+        if ((wkc = transact(CMD_FPRD, phys(station, REG_STADR), d, 2, NULL)) != 1 || rd16(d) != station) {
+            fprintf(stderr, "scan: FPRD of 0x%04x, wkc %d, address 0x%04x\n", station, wkc, rd16(d));
+            wrong++;
+        }
+        wr16(d, 0x0100);                                    // read command
+        wr32(d + 2, SII_MAN);
+        if ((wkc = transact(CMD_FPWR, phys(station, REG_EEPCTL), d, 6, NULL)) != 1) {
+            fprintf(stderr, "scan: SII read command to 0x%04x, wkc %d\n", station, wkc);
+            wrong++;
+        }
+        memset(d, 0, sizeof(d));
+        if ((wkc = transact(CMD_FPRD, phys(station, REG_EEPDAT), d, 4, NULL)) != 1 || rd32(d) != L7NH_VENDOR) {
+            fprintf(stderr, "scan: SII vendor of 0x%04x 0x%08x, wkc %d\n", station, (unsigned)rd32(d), wkc);
+            wrong++;
+        }
+    }
+    printf("scan\t%d\t%s\n", slaves, wrong ? "wrong" : "ok");
+    return wrong;
+}
+
+// An FMMU of the last slave from 32 bytes below the end of its memory; an LRW over all of it in SAFE-OP.
+static int fmmu_edge(int slaves) {
+    uint8_t fm[16], d[FMMU_LEN];
+    uint16_t station = (uint16_t)(STATION0 + slaves - 1);
+    int wrong = 0, wkc;
+
+    memset(fm, 0, sizeof(fm));
+    wr32(fm, FMMU_LADDR);
+    wr16(fm + 4, FMMU_LEN);
+    wr16(fm + 8, (uint16_t)(ESC_MEM_SIZE - FMMU_INSIDE));
+    fm[11] = 0x03;                                          // read and write
+    fm[12] = 1;                                             // enabled
+    wr16(d, 4);                                             // SAFE-OP: the FMMU reads
+    if (transact(CMD_FPWR, phys(station, REG_FMMU0), fm, sizeof(fm), NULL) != 1 ||
+        transact(CMD_FPWR, phys(station, REG_ALCTL), d, 2, NULL) != 1) {
+        fprintf(stderr, "fmmu: cannot configure slave 0x%04x\n", station);
+        return 1;
+    }
+    memset(d, PATTERN, sizeof(d));
+    if ((wkc = transact(CMD_LRW, FMMU_LADDR, d, sizeof(d), NULL)) != 1) {
+        fprintf(stderr, "fmmu: LRW wkc %d, expected 1\n", wkc);
+        wrong++;
+    }
+    for (int i = 0; i < FMMU_LEN; i++) {
+        uint8_t want = i < FMMU_INSIDE ? 0 : PATTERN;      // process RAM there is zero
+        if (d[i] != want) {
+            fprintf(stderr, "fmmu: byte %d is 0x%02x, expected 0x%02x\n", i, d[i], want);
+            wrong++;
+            break;
+        }
+    }
+    memset(d, 0, sizeof(d));
+    if (transact(CMD_BRD, phys(0, 0), d, 2, NULL) != slaves) {
+        fprintf(stderr, "fmmu: the segment stopped answering\n");
+        wrong++;
+    }
+    // back to INIT, FMMU off
+    memset(fm, 0, sizeof(fm));
+    wr16(d, 1);
+    transact(CMD_FPWR, phys(station, REG_FMMU0), fm, sizeof(fm), NULL);
+    transact(CMD_FPWR, phys(station, REG_ALCTL), d, 2, NULL);
+    printf("fmmu\t%d\t%s\n", slaves, wrong ? "wrong" : "ok");
+    return wrong;
+}
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int rtt(int slaves, int frames) {
+    int64_t *t = (int64_t *)malloc(sizeof(int64_t) * (size_t)frames);
+    uint8_t d[2];
+    int n = 0, lost = 0;
+
+    if (!t) return 1;
+    for (int i = 0; i < frames; i++) {
+        memset(d, 0, sizeof(d));
+        if (transact(CMD_BRD, phys(0, 0), d, 2, &t[n]) == slaves) n++;
+        else lost++;
+    }
+    qsort(t, (size_t)n, sizeof(int64_t), cmp_i64);
+    if (n) {
+        printf("rtt\t%d\t%d\t%d\t%.1f\t%.1f\t%.1f\n", slaves, n, lost, t[n / 2] / 1e3,
+            t[(int)(((int64_t)n * 99 + 99) / 100) - 1] / 1e3, t[n - 1] / 1e3);
+    }
+    free(t);
+    if (lost) fprintf(stderr, "rtt: %d of %d frames lost or answered wrong\n", lost, frames);
+    return lost != 0;
+}
+
+int main(int argc, char **argv) {
+    int slaves = argc > 2 ? atoi(argv[2]) : 2;
+    int frames = argc > 3 ? atoi(argv[3]) : 10000;
+
+    if (argc < 2 || slaves < 1 || slaves > 64 || frames < 1) {
+        fprintf(stderr, "usage: bench_vslave <ifname> [slaves 1..64] [frames]\n");
+        return 1;
+    }
+    fd = open_socket(argv[1]);
+    if (fd < 0) {
+        fprintf(stderr, "cannot open raw socket on %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+    printf("case\tslaves\tframes\tlost\trtt_p50_us\trtt_p99_us\trtt_max_us\n");
+    int wrong = scan(slaves);
+    if (!wrong) wrong += fmmu_edge(slaves);
+    if (!wrong) wrong += rtt(slaves, frames);
+    close(fd);
+    return wrong ? 2 : 0;
+}
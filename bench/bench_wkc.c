@@ -0,0 +1,138 @@
+// bench_wkc.c
+// Frame-loss accounting on a simulated segment (ec_wkc.c): with all drives enabled and commanded a small
+// torque, inject a burst of bad frames of one class and check what was counted and whether the torque
+// was dropped. Every class is run with a burst one short of its limit and with a burst of the limit.
+// - missing: the frames do not come back (sim_drop_frames_ctx);
+// - partial: the last drive skips them, the working counter comes back short (sim_skip_frames_ctx);
+// - late:    they come back complete after 3/4 of a period (sim_delay_frames_ctx).
+// Output: one line per case, tab separated. counted: cycles of the class, max_run: longest bad run,
+// tripped: the class that dropped the torque ("-" = none), torque: what drive 1 was given after the burst
+// (TORQUE = kept, 0 = dropped), others: cycles of the other bad classes (0 = classified cleanly).
+// Exit status 2 when a case came out wrong: a burst below the limit dropped the torque, a burst of the limit
+// kept it or tripped another class, or fewer bad frames were counted than injected (ctest runs it).
+// Usage: bench_wkc [slaves] [period_us] [limit]
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "sim_soem.h"
+#include "ec_segment.h"
+#include "ec_atomic.h"
+
+#define L7NH_VENDOR     0x00007595
+#define BENCH_PRIORITY  80
+#define SETTLE_MS       300     // before the burst: drives enabled
+#define AFTER_MS        100     // after the burst, before reading the counters
+#define TORQUE          100
+
+static ec_segment_t segment;
+static ec_segment_group_t group;
+static volatile uint32_t inject;    // class to inject on the next cycle, EC_WKC_GOOD = none
+static int burst;
+
+static void sleep_ms(int ms) {
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// Torque on every axis; the burst starts from the cyclic thread, so it covers whole cycles.
+static void torque_hook(ec_segment_t *seg, uint32_t tick, void *user) {
+    (void)tick;
+    (void)user;
+    for (int i = 0; i < seg->axes.count; i++) {
+        seg->axes.mode[i] = 10;
+        seg->axes.target_torque[i] = TORQUE;
+    }
+    switch ((ec_wkc_class_t)ec_atomic_load_u32(&inject)) {
+    case EC_WKC_MISSING: sim_drop_frames_ctx(&seg->context, burst); break;
+    case EC_WKC_PARTIAL: sim_skip_frames_ctx(&seg->context, (uint16)seg->slavecount, burst); break;
+    case EC_WKC_LATE: sim_delay_frames_ctx(&seg->context, burst, seg->period_ns * 3 / 4); break;
+    default: return;
+    }
+    ec_atomic_store_u32(&inject, EC_WKC_GOOD);
+}
+
+// One case; returns -1 if the segment could not be brought up, 1 if its outcome is wrong.
+static int run_case(ec_wkc_class_t c, int n, int slaves, int64_t period, uint32_t limit) {
+    ec_segment_t *seg = &segment;
+
+    if (ec_segment_connect(seg, "sim0", period, L7NH_VENDOR, EC_SEGMENT_COMPACT_PDO | EC_SEGMENT_DC_SYNC) != 0) {
+        fprintf(stderr, "connect: %s\n", seg->error);
+        return -1;
+    }
+    for (int k = EC_WKC_MISSING; k < EC_WKC_CLASSES; k++) seg->frames.limit[k] = limit;
+    ec_axes_command(&seg->axes, CIA402_TARGET_ENABLED, ec_cycle_now_ns());
+    ec_segment_group_init(&group, period, torque_hook, NULL);
+    group.health_slice_ns = 0;      // the skipped drive is not a slave outage
+    ec_segment_group_add(&group, seg, 0);
+    if (ec_segment_group_start(&group, BENCH_PRIORITY) != 0) {
+        fprintf(stderr, "cannot start the threads: %s\n", seg->error);
+        ec_segment_close(seg);
+        return -1;
+    }
+
+    sleep_ms(SETTLE_MS);
+    ec_wkc_counts_t before, after;
+    ec_wkc_read(&seg->frames, &before);
+    burst = n;
+    ec_atomic_store_u32(&inject, c);
+    sleep_ms(AFTER_MS);
+    ec_wkc_read(&seg->frames, &after);
+    int torque = sim_drive_ctx(&seg->context, 1)->target_torque;
+    ec_segment_group_stop(&group);
+    ec_segment_group_join(&group);
+
+    uint64_t others = 0;
+    for (int k = EC_WKC_MISSING; k < EC_WKC_CLASSES; k++) {
+        if (k != (int)c) others += after.count[k] - before.count[k];
+    }
+    printf("%s\t%d\t%lld\t%d\t%u\t%llu\t%u\t%s\t%d\t%llu\n", ec_wkc_class_name(c), slaves, (long long)(period / 1000),
+        n, (unsigned)limit, (unsigned long long)(after.count[c] - before.count[c]), (unsigned)after.max_run,
+        after.tripped ? ec_wkc_class_name(after.tripped) : "-", torque, (unsigned long long)others);
+    ec_segment_close(seg);
+
+    int trip = n >= (int)limit;
+    if (after.count[c] - before.count[c] < (uint64_t)n || after.tripped != (trip ? c : EC_WKC_GOOD) ||
+        torque != (trip ? 0 : TORQUE)) {
+        fprintf(stderr, "%s burst of %d, limit %u: expected the torque %s\n", ec_wkc_class_name(c), n,
+            (unsigned)limit, trip ? "dropped" : "kept");
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int slaves = argc > 1 ? atoi(argv[1]) : 4;
+    int64_t period = argc > 2 ? atoll(argv[2]) * 1000 : EC_CYCLE_1MS;
+    int limit = argc > 3 ? atoi(argv[3]) : EC_WKC_MISSING_LIMIT;
+
+    if (slaves < 1 || slaves > EC_AXES_MAX || !ec_cycle_valid_period(period) || limit < 2) {
+        fprintf(stderr, "usage: bench_wkc [slaves 1..%d] [period_us 1000|500|250|125] [limit >= 2]\n", EC_AXES_MAX);
+        return 1;
+    }
+    sim_setup(slaves);
+    printf("class\tslaves\tperiod_us\tburst\tlimit\tcounted\tmax_run\ttripped\ttorque\tothers\n");
+    int wrong = 0;
+    for (int c = EC_WKC_MISSING; c < EC_WKC_CLASSES; c++) {
+        for (int n = limit - 1; n <= limit; n++) {
+            int rc = run_case((ec_wkc_class_t)c, n, slaves, period, (uint32_t)limit);
+            if (rc < 0) return 1;
+            wrong += rc;
+        }
+    }
+    return wrong ? 2 : 0;
+}
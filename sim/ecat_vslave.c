@@ -0,0 +1,557 @@
+// ecat_vslave.c
+// User-space EtherCAT slave emulator for end-to-end tests over a Linux veth pair.
+// - Attaches a raw AF_PACKET socket (EtherType 0x88A4) to one end of the pair; the master (real SOEM,
+//   including its raw-socket NIC layer) runs on the other end.
+// - Emulates a chain of N ESCs: register file + process RAM, auto-increment/configured/broadcast/
+//   logical addressing (APxx/FPxx/Bxx/LRD/LWR/LRW/ARMW/FRMW) with FMMU translation and
+//   per-command working-counter rules, AL state machine, SII EEPROM interface and DC time registers.
+// - The SII presents an L7NH identity (LS Mecapion vendor 0x7595) without mailbox; SOEM therefore
+//   sizes the SyncManagers from the SII PDO categories, which are generated from the drive model's
+//   mapping. Behind the PDI each slave runs the l7nh_model, so CiA402 enable/torque works end to end.
+// Usage: sim/veth_setup.sh, then   ecat_vslave <ifname> [-n slaves] [-v]
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+
+#include "l7nh_model.h"
+
+#define ETH_P_ECAT      0x88A4
+#define ESC_MEM_SIZE    0x10000     // registers 0x0000-0x0FFF + process RAM
+#define EEP_WORDS       1024        // 2 KB SII
+#define MAX_SLAVES      64
+#define FRAME_MAX       1518
+
+// EtherCAT commands
+enum { CMD_NOP, CMD_APRD, CMD_APWR, CMD_APRW, CMD_FPRD, CMD_FPWR, CMD_FPRW, CMD_BRD, CMD_BWR, CMD_BRW,
+       CMD_LRD, CMD_LWR, CMD_LRW, CMD_ARMW, CMD_FRMW };
+
+// ESC registers
+#define REG_TYPE        0x0000
+#define REG_FMMUS       0x0004
+#define REG_SMS         0x0005
+#define REG_RAMSIZE     0x0006
+#define REG_PORTDES     0x0007
+#define REG_FEATURES    0x0008
+#define REG_STADR       0x0010
+#define REG_DLSTAT      0x0110
+#define REG_ALCTL       0x0120
+#define REG_ALSTAT      0x0130
+#define REG_ALSTATCODE  0x0134
+#define REG_EEPCTL      0x0502
+#define REG_EEPADR      0x0504
+#define REG_EEPDAT      0x0508
+#define REG_FMMU0       0x0600
+#define REG_SM0         0x0800
+#define REG_DCTIME0     0x0900
+#define REG_DCSYSTIME   0x0910
+#define REG_DCSOF       0x0918
+#define REG_DCSYSOFFSET 0x0920
+#define REG_DCSYSDELAY  0x0928
+
+#define N_FMMU          3
+#define N_SM            4
+#define PD_OUT_ADDR     0x1000      // SII default SM0 (outputs)
+#define PD_IN_ADDR      0x1100      // SII default SM1 (inputs)
+
+// SII word addresses / categories
+#define SII_MAN         0x0008
+#define SII_ID          0x000A
+#define SII_REV         0x000C
+#define SII_SIZE        0x003E
+#define SII_VERSION     0x003F
+#define SII_CAT_START   0x0040
+#define SII_STRINGS     10
+#define SII_GENERAL     30
+#define SII_FMMU        40
+#define SII_SM          41
+#define SII_TXPDO       50
+#define SII_RXPDO       51
+#define SII_END         0xFFFF
+
+#define L7NH_VENDOR     0x00007595
+#define L7NH_PRODUCT    0x00010001
+#define L7NH_REVISION   0x00000001
+
+typedef struct {
+    uint8_t mem[ESC_MEM_SIZE];
+    uint16_t eep[EEP_WORDS];
+    l7nh_model_t drive;
+    int last;               // last slave in the chain (port 1 loop closed)
+} vslave_t;
+
+static vslave_t slaves[MAX_SLAVES];
+static int nslaves = 1;
+static int verbose = 0;
+static volatile sig_atomic_t stop_flag = 0;
+static int64_t last_app_ns;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_flag = 1;
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static uint16_t rd16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t rd32(const uint8_t *p) { return (uint32_t)rd16(p) | ((uint32_t)rd16(p + 2) << 16); }
+static void wr16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void wr32(uint8_t *p, uint32_t v) { wr16(p, (uint16_t)v); wr16(p + 2, (uint16_t)(v >> 16)); }
+static void wr64(uint8_t *p, uint64_t v) { wr32(p, (uint32_t)v); wr32(p + 4, (uint32_t)(v >> 32)); }
+static uint64_t rd64(const uint8_t *p) { return (uint64_t)rd32(p) | ((uint64_t)rd32(p + 4) << 32); }
+
+// ---------------------------------------------------------------------------------------------
+// SII image
+// ---------------------------------------------------------------------------------------------
+
+typedef struct {
+    uint16_t *w;
+    int pos;        // byte position
+} sii_writer_t;
+
+static void sii_byte(sii_writer_t *sw, uint8_t b) {
+    uint16_t *word = &sw->w[sw->pos / 2];
+    if (sw->pos & 1) *word = (uint16_t)((*word & 0x00FF) | (b << 8));
+    else *word = (uint16_t)((*word & 0xFF00) | b);
+    sw->pos++;
+}
+static void sii_word(sii_writer_t *sw, uint16_t v) { sii_byte(sw, (uint8_t)v); sii_byte(sw, (uint8_t)(v >> 8)); }
+
+// Category header with placeholder size; returns position of the size word.
+static int sii_cat_begin(sii_writer_t *sw, uint16_t type) {
+    sii_word(sw, type);
+    int at = sw->pos;
+    sii_word(sw, 0);
+    return at;
+}
+static void sii_cat_end(sii_writer_t *sw, int size_at) {
+    if (sw->pos & 1) sii_byte(sw, 0);
+    sw->w[size_at / 2] = (uint16_t)((sw->pos - size_at - 2) / 2);
+}
+
+static uint8_t pdo_datatype(uint8_t bits) {
+    return bits == 8 ? 0x05 : bits == 16 ? 0x06 : 0x07;     // USINT / UINT / UDINT
+}
+
+static void sii_pdos(sii_writer_t *sw, uint16_t cat, const l7nh_pdo_t *pdos, uint16_t base,
+                     const uint16_t *assign, uint8_t count, uint8_t sm) {
+    int at = sii_cat_begin(sw, cat);
+    for (int i = 0; i < count; i++) {
+        const l7nh_pdo_t *p = &pdos[assign[i] - base];
+        sii_word(sw, assign[i]);
+        sii_byte(sw, p->count);
+        sii_byte(sw, sm);       // SyncManager
+        sii_byte(sw, 0);        // synchronisation
+        sii_byte(sw, 0);        // name index
+        sii_word(sw, 0);        // flags
+        for (int e = 0; e < p->count; e++) {
+            uint32_t raw = p->entry[e];
+            uint8_t bits = (uint8_t)raw;
+            sii_word(sw, (uint16_t)(raw >> 16));
+            sii_byte(sw, (uint8_t)(raw >> 8));
+            sii_byte(sw, 0);
+            sii_byte(sw, (raw >> 16) ? pdo_datatype(bits) : 0);
+            sii_byte(sw, bits);
+            sii_word(sw, 0);
+        }
+    }
+    sii_cat_end(sw, at);
+}
+
+static void sii_sm(sii_writer_t *sw, uint16_t start, uint16_t len, uint8_t ctrl, uint8_t type) {
+    sii_word(sw, start);
+    sii_word(sw, len);
+    sii_byte(sw, ctrl);
+    sii_byte(sw, 0);        // status
+    sii_byte(sw, 1);        // enable
+    sii_byte(sw, type);     // 3 = process data outputs, 4 = process data inputs
+}
+
+static void build_sii(vslave_t *sl) {
+    static const char name[] = "L7NH";
+    sii_writer_t sw = { sl->eep, 0 };
+    int at;
+
+    memset(sl->eep, 0, sizeof(sl->eep));
+    sl->eep[SII_MAN] = (uint16_t)L7NH_VENDOR;
+    sl->eep[SII_MAN + 1] = (uint16_t)(L7NH_VENDOR >> 16);
+    sl->eep[SII_ID] = (uint16_t)L7NH_PRODUCT;
+    sl->eep[SII_ID + 1] = (uint16_t)(L7NH_PRODUCT >> 16);
+    sl->eep[SII_REV] = (uint16_t)L7NH_REVISION;
+    sl->eep[SII_REV + 1] = (uint16_t)(L7NH_REVISION >> 16);
+    sl->eep[SII_SIZE] = (EEP_WORDS * 16 / 1024) - 1;       // size in kbit - 1
+    sl->eep[SII_VERSION] = 1;
+
+    sw.pos = SII_CAT_START * 2;
+
+    at = sii_cat_begin(&sw, SII_STRINGS);
+    sii_byte(&sw, 1);
+    sii_byte(&sw, (uint8_t)(sizeof(name) - 1));
+    for (size_t i = 0; i < sizeof(name) - 1; i++) sii_byte(&sw, (uint8_t)name[i]);
+    sii_cat_end(&sw, at);
+
+    at = sii_cat_begin(&sw, SII_GENERAL);
+    for (int i = 0; i < 32; i++) sii_byte(&sw, i == 3 ? 1 : 0);   // NameIdx = string 1, no mailbox protocols
+    sii_cat_end(&sw, at);
+
+    at = sii_cat_begin(&sw, SII_FMMU);
+    sii_byte(&sw, 0x01);    // FMMU0 outputs
+    sii_byte(&sw, 0x02);    // FMMU1 inputs
+    sii_cat_end(&sw, at);
+
+    at = sii_cat_begin(&sw, SII_SM);
+    sii_sm(&sw, PD_OUT_ADDR, (uint16_t)l7nh_rx_bytes(&sl->drive), 0x64, 3);
+    sii_sm(&sw, PD_IN_ADDR, (uint16_t)l7nh_tx_bytes(&sl->drive), 0x20, 4);
+    sii_cat_end(&sw, at);
+
+    sii_pdos(&sw, SII_TXPDO, sl->drive.txpdo, 0x1A00, sl->drive.tx_assign, sl->drive.tx_assign_count, 1);
+    sii_pdos(&sw, SII_RXPDO, sl->drive.rxpdo, 0x1600, sl->drive.rx_assign, sl->drive.rx_assign_count, 0);
+
+    sii_word(&sw, SII_END);
+}
+
+// ---------------------------------------------------------------------------------------------
+// ESC register file
+// ---------------------------------------------------------------------------------------------
+
+static void esc_reset(vslave_t *sl, int last) {
+    memset(sl->mem, 0, sizeof(sl->mem));
+    l7nh_model_init(&sl->drive);
+    sl->last = last;
+    sl->mem[REG_TYPE] = 0x04;
+    sl->mem[REG_FMMUS] = N_FMMU;
+    sl->mem[REG_SMS] = N_SM;
+    sl->mem[REG_RAMSIZE] = 8;               // kB
+    sl->mem[REG_PORTDES] = 0x0F;            // ports 0/1 MII
+    wr16(&sl->mem[REG_FEATURES], 0x000C);   // DC supported, 64-bit DC
+    // port 0 link + communication; port 1 communication when a successor exists, else loop closed
+    wr16(&sl->mem[REG_DLSTAT], (uint16_t)(0x0010 | 0x0200 | (last ? 0x0400 : 0x0020 | 0x0800)));
+    wr16(&sl->mem[REG_ALSTAT], 0x0001);     // INIT
+    wr16(&sl->mem[REG_EEPCTL], 0x0040);     // 8-byte reads
+    build_sii(sl);
+}
+
+static int in_range(uint16_t ado, uint16_t len, uint16_t reg, uint16_t reglen) {
+    return ado < reg + reglen && ado + len > reg;
+}
+
+// Refresh registers that are computed on read.
+static void esc_pre_read(vslave_t *sl, uint16_t ado, uint16_t len) {
+    if (in_range(ado, len, REG_DCSYSTIME, 8)) {
+        wr64(&sl->mem[REG_DCSYSTIME], (uint64_t)now_ns() + rd64(&sl->mem[REG_DCSYSOFFSET]));
+    }
+}
+
+static void al_control(vslave_t *sl) {
+    uint16_t ctl = rd16(&sl->mem[REG_ALCTL]);
+    uint16_t req = ctl & 0x0F;
+    uint16_t st = rd16(&sl->mem[REG_ALSTAT]);
+    if (ctl & 0x10) st &= (uint16_t)~0x10;  // error acknowledge
+    if (req == 1 || req == 2 || req == 4 || req == 8) {
+        // OP is only reachable from SAFE-OP or OP
+        if (req == 8 && (st & 0x0F) < 4) {
+            st = (uint16_t)((st & 0x0F) | 0x10);
+            wr16(&sl->mem[REG_ALSTATCODE], 0x0011);    // invalid requested state change
+        } else {
+            st = req;
+            wr16(&sl->mem[REG_ALSTATCODE], 0);
+        }
+    }
+    wr16(&sl->mem[REG_ALSTAT], st);
+}
+
+static void eeprom_command(vslave_t *sl) {
+    uint16_t ctl = rd16(&sl->mem[REG_EEPCTL]);
+    uint32_t adr = rd32(&sl->mem[REG_EEPADR]);
+    uint16_t status = 0x0040;   // 8-byte reads supported
+    if ((ctl & 0x0700) == 0x0100) {             // read
+        for (int i = 0; i < 4; i++) {
+            uint32_t a = adr + (uint32_t)i;
+            wr16(&sl->mem[REG_EEPDAT + 2 * i], a < EEP_WORDS ? sl->eep[a] : 0xFFFF);
+        }
+    } else if ((ctl & 0x0700) == 0x0200) {      // write (one word)
+        if (adr < EEP_WORDS) sl->eep[adr] = rd16(&sl->mem[REG_EEPDAT]);
+    }
+    wr16(&sl->mem[REG_EEPCTL], status);         // never busy
+}
+
+static void dc_latch(vslave_t *sl) {
+    int64_t t = now_ns();
+    wr32(&sl->mem[REG_DCTIME0], (uint32_t)t);
+    wr32(&sl->mem[REG_DCTIME0 + 4], sl->last ? 0 : (uint32_t)(t + 100 * (nslaves)));
+    wr64(&sl->mem[REG_DCSOF], (uint64_t)t);
+}
+
+static int writable(uint16_t a) {
+    if (a < 0x0010) return 0;                              // identification
+    if (a >= REG_DLSTAT && a < REG_DLSTAT + 2) return 0;
+    if (a >= REG_ALSTAT && a < REG_ALSTAT + 6) return 0;
+    if (a >= REG_DCSOF && a < REG_DCSOF + 8) return 0;
+    return 1;
+}
+
+static void esc_write(vslave_t *sl, uint16_t ado, const uint8_t *data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        uint16_t a = (uint16_t)(ado + i);
+        if (writable(a)) sl->mem[a] = data[i];
+    }
+    if (in_range(ado, len, REG_ALCTL, 2)) al_control(sl);
+    if (in_range(ado, len, REG_EEPCTL, 2)) eeprom_command(sl);
+    if (in_range(ado, len, REG_DCTIME0, 4)) dc_latch(sl);
+}
+
+static void esc_read(vslave_t *sl, uint16_t ado, uint8_t *data, uint16_t len) {
+    esc_pre_read(sl, ado, len);
+    memcpy(data, &sl->mem[ado], len);
+}
+
+static uint8_t al_state(const vslave_t *sl) {
+    return sl->mem[REG_ALSTAT] & 0x0F;
+}
+
+// Logical access through the FMMUs. Returns WKC increment.
+static int esc_logical(vslave_t *sl, uint8_t cmd, uint32_t laddr, uint8_t *data, uint16_t len) {
+    int did_read = 0, did_write = 0;
+    for (int f = 0; f < N_FMMU; f++) {
+        uint8_t *fm = &sl->mem[REG_FMMU0 + 16 * f];
+        if (!fm[12]) continue;
+        uint32_t lstart = rd32(fm);
+        uint16_t flen = rd16(fm + 4);
+        uint16_t pstart = rd16(fm + 8);
+        uint8_t type = fm[11];
+        // overlap of [laddr, laddr+len) and [lstart, lstart+flen)
+        uint32_t lo = laddr > lstart ? laddr : lstart;
+        uint32_t hi = (laddr + len) < (lstart + flen) ? (laddr + len) : (lstart + flen);
+        if (lo >= hi) continue;
+        uint32_t paddr = pstart + (lo - lstart);
+        uint8_t *d = data + (lo - laddr);
+        uint32_t n = hi - lo;
+        // an FMMU may reach past the end of the ESC memory: those bytes do not exist and pass untouched
+        if (paddr >= ESC_MEM_SIZE) continue;
+        if (paddr + n > ESC_MEM_SIZE) n = ESC_MEM_SIZE - paddr;
+        if ((type & 0x01) && cmd != CMD_LWR && al_state(sl) >= 4) {
+            esc_read(sl, (uint16_t)paddr, d, (uint16_t)n);
+            did_read = 1;
+        }
+        if ((type & 0x02) && cmd != CMD_LRD && al_state(sl) == 8) {
+            // outputs are taken from the frame before it continues; LRW reads never see them
+            esc_write(sl, (uint16_t)paddr, d, (uint16_t)n);
+            did_write = 1;
+        }
+    }
+    if (cmd == CMD_LRD || cmd == CMD_LWR) return did_read || did_write;
+    return did_read + 2 * did_write;
+}
+
+// Process one datagram at one slave. Returns WKC increment.
+static int esc_datagram(vslave_t *sl, uint8_t *dg, uint8_t *data, uint16_t len) {
+    uint8_t cmd = dg[0];
+    uint16_t adp = rd16(dg + 2);
+    uint16_t ado = rd16(dg + 4);
+    uint8_t tmp[FRAME_MAX];
+    int addressed;
+
+    switch (cmd) {
+    case CMD_APRD: case CMD_APWR: case CMD_APRW: case CMD_ARMW:
+        addressed = adp == 0;
+        wr16(dg + 2, (uint16_t)(adp + 1));  // auto-increment address
+        break;
+    case CMD_FPRD: case CMD_FPWR: case CMD_FPRW: case CMD_FRMW:
+        addressed = adp == rd16(&sl->mem[REG_STADR]);
+        break;
+    case CMD_BRD: case CMD_BWR: case CMD_BRW:
+        wr16(dg + 2, (uint16_t)(adp + 1));
+        addressed = 1;
+        break;
+    case CMD_LRD: case CMD_LWR: case CMD_LRW:
+        return esc_logical(sl, cmd, rd32(dg + 2), data, len);
+    default:
+        return 0;
+    }
+
+    if ((uint32_t)ado + len > ESC_MEM_SIZE) return 0;
+    switch (cmd) {
+    case CMD_APRD: case CMD_FPRD:
+        if (!addressed) return 0;
+        esc_read(sl, ado, data, len);
+        return 1;
+    case CMD_APWR: case CMD_FPWR:
+        if (!addressed) return 0;
+        esc_write(sl, ado, data, len);
+        return 1;
+    case CMD_APRW: case CMD_FPRW:
+        if (!addressed) return 0;
+        esc_read(sl, ado, tmp, len);
+        esc_write(sl, ado, data, len);
+        memcpy(data, tmp, len);
+        return 3;
+    case CMD_BRD:
+        esc_read(sl, ado, tmp, len);
+        for (uint16_t i = 0; i < len; i++) data[i] |= tmp[i];
+        return 1;
+    case CMD_BWR:
+        esc_write(sl, ado, data, len);
+        return 1;
+    case CMD_BRW:
+        esc_read(sl, ado, tmp, len);
+        esc_write(sl, ado, data, len);
+        for (uint16_t i = 0; i < len; i++) data[i] |= tmp[i];
+        return 3;
+    case CMD_ARMW: case CMD_FRMW:
+        // addressed slave reads (e.g. reference clock), every other slave writes
+        if (addressed) esc_read(sl, ado, data, len);
+        else esc_write(sl, ado, data, len);
+        return 1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------------------------
+// PDI side: run the drive model on the process RAM
+// ---------------------------------------------------------------------------------------------
+
+static void run_application(void) {
+    int64_t t = now_ns();
+    double dt = last_app_ns ? (double)(t - last_app_ns) * 1e-9 : 0.0;
+    if (dt > 0.01) dt = 0.01;
+    last_app_ns = t;
+
+    for (int s = 0; s < nslaves; s++) {
+        vslave_t *sl = &slaves[s];
+        uint16_t out = rd16(&sl->mem[REG_SM0]);
+        uint16_t in = rd16(&sl->mem[REG_SM0 + 8]);
+        if (al_state(sl) == 8 && out) l7nh_rx_decode(&sl->drive, &sl->mem[out]);
+        l7nh_model_step(&sl->drive, dt);
+        if (al_state(sl) >= 4 && in) l7nh_tx_encode(&sl->drive, &sl->mem[in]);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Frame handling
+// ---------------------------------------------------------------------------------------------
+
+// Walk the datagrams of an EtherCAT frame through every slave. Returns 0 if the frame is valid.
+static int process_frame(uint8_t *frame, int flen) {
+    uint8_t *ecat = frame + ETH_HLEN;
+    int ecat_len = flen - ETH_HLEN;
+    if (ecat_len < 2) return -1;
+    uint16_t hdr = rd16(ecat);
+    int plen = hdr & 0x07FF;
+    if ((hdr >> 12) != 1 || plen + 2 > ecat_len) return -1;
+
+    for (int s = 0; s < nslaves; s++) {
+        int off = 2;
+        while (off + 10 <= plen + 2) {
+            uint8_t *dg = ecat + off;
+            uint16_t lenf = rd16(dg + 6);
+            uint16_t len = lenf & 0x07FF;
+            if (off + 10 + len + 2 > plen + 2) return -1;
+            uint8_t *data = dg + 10;
+            uint8_t *wkc = data + len;
+            int inc = esc_datagram(&slaves[s], dg, data, len);
+            wr16(wkc, (uint16_t)(rd16(wkc) + inc));
+            off += 10 + len + 2;
+            if (!(lenf & 0x8000)) break;   // no more datagrams
+        }
+    }
+    // port 0 of the first ESC marks the frame as processed (U/L bit of the source MAC)
+    frame[6] |= 0x02;
+    return 0;
+}
+
+static int open_socket(const char *ifname) {
+    struct sockaddr_ll sll;
+    struct ifreq ifr;
+    struct packet_mreq mr;
+    int fd = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ECAT));
+    if (fd < 0) return -1;
+
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+        close(fd);
+        return -1;
+    }
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_ifindex = ifr.ifr_ifindex;
+    sll.sll_protocol = htons(ETH_P_ECAT);
+    if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        close(fd);
+        return -1;
+    }
+    memset(&mr, 0, sizeof(mr));
+    mr.mr_ifindex = ifr.ifr_ifindex;
+    mr.mr_type = PACKET_MR_PROMISC;
+    setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mr, sizeof(mr));
+    return fd;
+}
+
+int main(int argc, char **argv) {
+    uint8_t frame[FRAME_MAX];
+    const char *ifname = NULL;
+    uint64_t frames = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) nslaves = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-v") == 0) verbose = 1;
+        else ifname = argv[i];
+    }
+    if (!ifname || nslaves < 1 || nslaves > MAX_SLAVES) {
+        fprintf(stderr, "usage: %s <ifname> [-n slaves(1..%d)] [-v]\n", argv[0], MAX_SLAVES);
+        return 2;
+    }
+
+    int fd = open_socket(ifname);
+    if (fd < 0) {
+        fprintf(stderr, "cannot open raw socket on %s: %s\n", ifname, strerror(errno));
+        return 1;
+    }
+    for (int s = 0; s < nslaves; s++) esc_reset(&slaves[s], s == nslaves - 1);
+
+    // without SA_RESTART: a signal ends the blocking recvfrom, not only the next frame
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    printf("ecat_vslave: %d x L7NH on %s\n", nslaves, ifname);
+
+    while (!stop_flag) {
+        struct sockaddr_ll from;
+        socklen_t fromlen = sizeof(from);
+        int n = (int)recvfrom(fd, frame, sizeof(frame), 0, (struct sockaddr *)&from, &fromlen);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("recvfrom");
+            break;
+        }
+        if (from.sll_pkttype == PACKET_OUTGOING) continue;     // our own replies
+        if (process_frame(frame, n) != 0) continue;
+        run_application();
+        if (send(fd, frame, (size_t)n, 0) < 0 && verbose) perror("send");
+        frames++;
+        if (verbose && frames % 10000 == 0) printf("%llu frames\n", (unsigned long long)frames);
+    }
+    printf("ecat_vslave: %llu frames processed\n", (unsigned long long)frames);
+    close(fd);
+    return 0;
+}
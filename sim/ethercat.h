@@ -0,0 +1,227 @@
+// ethercat.h (simulation)
+// Drop-in subset of SOEM's public API backed by simulated L7NH drives (sim_soem.c, l7nh_model.c).
+// Put this directory on the include path instead of SOEM's to run the control code without hardware.
+// Names, types and semantics follow SOEM 1.4: the same ec_slave[]/ec_group[] globals, the same
+// return conventions (WKC, EC_NOFRAME, SDO return 1/0) and the same state constants.
+// Like SOEM, every ec_* call is a wrapper around its ecx_* counterpart on the global ecx_context;
+// each further ecx_contextt is an independent simulated segment (one per NIC in a real setup).
+
+#ifndef SIM_ETHERCAT_H
+#define SIM_ETHERCAT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t  boolean;
+typedef int8_t   int8;
+typedef int16_t  int16;
+typedef int32_t  int32;
+typedef int64_t  int64;
+typedef uint8_t  uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+
+#ifndef TRUE
+#define TRUE  1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#define EC_MAXSLAVE     200
+#define EC_MAXGROUP     2
+#define EC_MAXNAME      40
+
+#define EC_TIMEOUTRET   2000
+#define EC_TIMEOUTRET3  (EC_TIMEOUTRET * 3)
+#define EC_TIMEOUTMON   500
+#define EC_TIMEOUTSAFE  20000
+#define EC_TIMEOUTEEP   20000
+#define EC_TIMEOUTTXM   20000
+#define EC_TIMEOUTRXM   700000
+#define EC_TIMEOUTSTATE 2000000
+
+#define EC_NOFRAME      -1
+
+#define EC_STATE_NONE           0x00
+#define EC_STATE_INIT           0x01
+#define EC_STATE_PRE_OP         0x02
+#define EC_STATE_BOOT           0x03
+#define EC_STATE_SAFE_OP        0x04
+#define EC_STATE_OPERATIONAL    0x08
+#define EC_STATE_ACK            0x10
+#define EC_STATE_ERROR          0x10
+
+#define ECT_REG_DLSTAT  0x0110
+
+#define ECT_MBXPROT_COE 0x0004
+#define ECT_MBXT_COE    0x03
+
+#define EC_MAXMBX       1486
+typedef uint8 ec_mbxbuft[EC_MAXMBX + 1];
+
+#define EC_MAXSM        8
+
+#define EC_MAXEEPBITMAP 128
+#define EC_MAXEEPBUF    (EC_MAXEEPBITMAP << 5)
+#define EC_MAX_MAPT     1
+
+typedef struct ec_sm {
+    uint16 StartAddr;
+    uint16 SMlength;
+    uint32 SMflags;
+} ec_smt;
+
+typedef struct ecx_context ecx_contextt;
+
+typedef struct ec_slave {
+    uint16 state;
+    uint16 ALstatuscode;
+    uint16 configadr;
+    uint16 aliasadr;
+    uint32 eep_man;
+    uint32 eep_id;
+    uint32 eep_rev;
+    uint16 Obits;
+    uint32 Obytes;
+    uint8 *outputs;
+    uint8 Ostartbit;
+    uint16 Ibits;
+    uint32 Ibytes;
+    uint8 *inputs;
+    uint8 Istartbit;
+    uint16 mbx_l;
+    uint16 mbx_proto;
+    uint8 mbx_cnt;
+    ec_smt SM[EC_MAXSM];
+    uint8 SMtype[EC_MAXSM];
+    uint8 CoEdetails;
+    uint16 configindex;         // != 0: SM layout and Obits/Ibits preset, ec_config_map reads no PDO mapping
+    boolean hasdc;
+    uint8 topology;
+    uint8 activeports;
+    int32 pdelay;
+    uint32 DCcycle;
+    int32 DCshift;
+    uint8 DCactive;
+    uint8 group;
+    boolean islost;
+    int (*PO2SOconfig)(uint16 slave);
+    int (*PO2SOconfigx)(ecx_contextt *context, uint16 slave);
+    char name[EC_MAXNAME + 1];
+} ec_slavet;
+
+typedef struct ec_group {
+    uint32 logstartaddr;
+    uint32 Obytes;
+    uint8 *outputs;
+    uint32 Ibytes;
+    uint8 *inputs;
+    boolean hasdc;
+    uint16 DCnext;
+    uint16 outputsWKC;
+    uint16 inputsWKC;
+    boolean docheckstate;
+} ec_groupt;
+
+// Context members that only matter to SOEM's internals. They exist (with placeholder content) so
+// code that sets up its own contexts compiles against the simulation and against SOEM alike.
+typedef struct { int unused; } ec_eringt;
+typedef struct { int unused; } ec_idxstackT;
+typedef struct { int unused; } ec_SMcommtypet;
+typedef struct { int unused; } ec_PDOassignt;
+typedef struct { int unused; } ec_PDOdesct;
+typedef struct { int unused; } ec_eepromSMt;
+typedef struct { int unused; } ec_eepromFMMUt;
+typedef struct { int unused; } ecx_redportt;
+
+// In SOEM the port holds the NIC handle and frame buffers; here it holds the simulated segment
+// (bound by ecx_init, released by ecx_close).
+typedef struct ecx_port {
+    struct sim_segment *seg;
+} ecx_portt;
+
+struct ecx_context {
+    ecx_portt *port;
+    ec_slavet *slavelist;
+    int *slavecount;
+    int maxslave;
+    ec_groupt *grouplist;
+    int maxgroup;
+    uint8 *esibuf;
+    uint32 *esimap;
+    uint16 esislave;
+    ec_eringt *elist;
+    ec_idxstackT *idxstack;
+    boolean *ecaterror;
+    int64 *DCtime;
+    ec_SMcommtypet *SMcommtype;
+    ec_PDOassignt *PDOassign;
+    ec_PDOdesct *PDOdesc;
+    ec_eepromSMt *eepSM;
+    ec_eepromFMMUt *eepFMMU;
+    int (*FOEhook)(uint16 slave, int packetnumber, int datasize);
+    int (*EOEhook)(ecx_contextt *context, uint16 slave, void *eoembx);
+    int manualstatechange;
+    void *userdata;
+};
+
+extern ec_slavet ec_slave[EC_MAXSLAVE];
+extern int ec_slavecount;
+extern ec_groupt ec_group[EC_MAXGROUP];
+extern int64 ec_DCtime;
+extern ecx_contextt ecx_context;
+
+int ecx_init(ecx_contextt *context, const char *ifname);
+int ecx_init_redundant(ecx_contextt *context, ecx_redportt *redport, const char *ifname, char *if2name);
+void ecx_close(ecx_contextt *context);
+int ecx_config_init(ecx_contextt *context, uint8 usetable);
+int ecx_config_map_group(ecx_contextt *context, void *pIOmap, uint8 group);
+boolean ecx_configdc(ecx_contextt *context);
+uint16 ecx_statecheck(ecx_contextt *context, uint16 slave, uint16 reqstate, int timeout);
+int ecx_writestate(ecx_contextt *context, uint16 slave);
+int ecx_readstate(ecx_contextt *context);
+int ecx_send_processdata(ecx_contextt *context);
+int ecx_receive_processdata(ecx_contextt *context, int timeout);
+int ecx_SDOread(ecx_contextt *context, uint16 slave, uint16 index, uint8 subindex, boolean CA, int *psize,
+                void *p, int timeout);
+int ecx_SDOwrite(ecx_contextt *context, uint16 Slave, uint16 Index, uint8 SubIndex, boolean CA, int psize,
+                 void *p, int Timeout);
+int ecx_mbxsend(ecx_contextt *context, uint16 slave, ec_mbxbuft *mbx, int timeout);
+int ecx_mbxreceive(ecx_contextt *context, uint16 slave, ec_mbxbuft *mbx, int timeout);
+void ecx_dcsync0(ecx_contextt *context, uint16 slave, boolean act, uint32 CyclTime, int32 CyclShift);
+int ecx_FPRD(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data, int timeout);
+int ecx_reconfig_slave(ecx_contextt *context, uint16 slave, int timeout);
+int ecx_recover_slave(ecx_contextt *context, uint16 slave, int timeout);
+
+int ec_init(const char *ifname);
+int ec_init_redundant(const char *ifname, char *if2name);
+void ec_close(void);
+int ec_config_init(uint8 usetable);
+int ec_config_map(void *pIOmap);
+boolean ec_configdc(void);
+uint16 ec_statecheck(uint16 slave, uint16 reqstate, int timeout);
+int ec_writestate(uint16 slave);
+int ec_readstate(void);
+int ec_send_processdata(void);
+int ec_receive_processdata(int timeout);
+int ec_SDOread(uint16 slave, uint16 index, uint8 subindex, boolean CA, int *psize, void *p, int timeout);
+int ec_SDOwrite(uint16 Slave, uint16 Index, uint8 SubIndex, boolean CA, int psize, void *p, int Timeout);
+void ec_clearmbx(ec_mbxbuft *Mbx);
+uint8 ec_nextmbxcnt(uint8 cnt);
+int ec_mbxsend(uint16 slave, ec_mbxbuft *mbx, int timeout);
+int ec_mbxreceive(uint16 slave, ec_mbxbuft *mbx, int timeout);
+void ec_dcsync0(uint16 slave, boolean act, uint32 CyclTime, int32 CyclShift);
+int ec_FPRD(uint16 ADP, uint16 ADO, uint16 length, void *data, int timeout);
+int ec_reconfig_slave(uint16 slave, int timeout);
+int ec_recover_slave(uint16 slave, int timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_ETHERCAT_H
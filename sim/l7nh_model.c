@@ -0,0 +1,365 @@
+// l7nh_model.c
+// Behavioural L7NH drive model (see l7nh_model.h).
+
+#include "l7nh_model.h"
+
+#include <math.h>
+#include <string.h>
+
+#define TWO_PI          6.283185307179586
+#define MAX_SUBSTEP_S   100e-6  // integrate the mechanics in steps of at most 100 us
+#define STOPPED_RAD_S   0.05    // below this the shaft is considered standing still
+
+#define MODE_PROFILE_TORQUE 4
+#define MODE_CST            10
+
+// ---------------------------------------------------------------------------------------------
+// Object dictionary
+// ---------------------------------------------------------------------------------------------
+
+typedef struct {
+    void *ptr;
+    int size;
+    int writable;
+} od_ref_t;
+
+static int od_lookup(l7nh_model_t *m, uint16_t index, uint8_t sub, od_ref_t *ref) {
+    ref->writable = 0;
+    if (sub != 0 && (index & 0xF000) == 0x6000) return 0;
+    switch (index) {
+    case 0x6040: ref->ptr = &m->controlword;     ref->size = 2; ref->writable = 1; return 1;
+    case 0x6041: ref->ptr = &m->statusword;      ref->size = 2; return 1;
+    case 0x6060: ref->ptr = &m->mode;            ref->size = 1; ref->writable = 1; return 1;
+    case 0x6061: ref->ptr = &m->mode_display;    ref->size = 1; return 1;
+    case 0x6071: ref->ptr = &m->target_torque;   ref->size = 2; ref->writable = 1; return 1;
+    case 0x6072: ref->ptr = &m->max_torque;      ref->size = 2; ref->writable = 1; return 1;
+    case 0x6077: ref->ptr = &m->actual_torque;   ref->size = 2; return 1;
+    case 0x606C: ref->ptr = &m->actual_velocity; ref->size = 4; return 1;
+    case 0x6064: ref->ptr = &m->actual_position; ref->size = 4; return 1;
+    case 0x603F: ref->ptr = &m->error_code;      ref->size = 2; return 1;
+    case 0x60FF: ref->ptr = &m->target_velocity; ref->size = 4; ref->writable = 1; return 1;
+    case 0x607A: ref->ptr = &m->target_position; ref->size = 4; ref->writable = 1; return 1;
+    default: break;
+    }
+    return 0;
+}
+
+static l7nh_pdo_t *pdo_object(l7nh_model_t *m, uint16_t index) {
+    if (index >= 0x1600 && index < 0x1600 + L7NH_NUM_PDO) return &m->rxpdo[index - 0x1600];
+    if (index >= 0x1A00 && index < 0x1A00 + L7NH_NUM_PDO) return &m->txpdo[index - 0x1A00];
+    return NULL;
+}
+
+static uint32_t put(void *buf, int *size, const void *src, int n) {
+    if (*size < n) return L7NH_ABORT_LENGTH;
+    memcpy(buf, src, (size_t)n);
+    *size = n;
+    return 0;
+}
+
+uint32_t l7nh_od_read(l7nh_model_t *m, uint16_t index, uint8_t sub, void *buf, int *size) {
+    od_ref_t ref;
+    l7nh_pdo_t *pdo;
+
+    if (index == 0x1C12 || index == 0x1C13) {
+        uint8_t count = index == 0x1C12 ? m->rx_assign_count : m->tx_assign_count;
+        uint16_t *tab = index == 0x1C12 ? m->rx_assign : m->tx_assign;
+        if (sub == 0) return put(buf, size, &count, 1);
+        if (sub > L7NH_NUM_PDO) return L7NH_ABORT_NO_SUBINDEX;
+        return put(buf, size, &tab[sub - 1], 2);
+    }
+    if ((pdo = pdo_object(m, index)) != NULL) {
+        if (sub == 0) return put(buf, size, &pdo->count, 1);
+        if (sub > L7NH_MAX_PDO_ENTRIES) return L7NH_ABORT_NO_SUBINDEX;
+        return put(buf, size, &pdo->entry[sub - 1], 4);
+    }
+    if (!od_lookup(m, index, sub, &ref)) return L7NH_ABORT_NO_OBJECT;
+    return put(buf, size, ref.ptr, ref.size);
+}
+
+// A mapping entry is valid if it is padding or an existing object of matching width
+// (and writable when it goes into an RxPDO).
+static int entry_valid(l7nh_model_t *m, uint32_t raw, int rx) {
+    od_ref_t ref;
+    uint16_t idx = (uint16_t)(raw >> 16);
+    uint8_t bits = (uint8_t)(raw & 0xFF);
+    if (idx == 0) return bits > 0 && (bits % 8) == 0;
+    if (!od_lookup(m, idx, (uint8_t)(raw >> 8), &ref)) return 0;
+    if (ref.size * 8 != bits) return 0;
+    return rx ? ref.writable : 1;
+}
+
+uint32_t l7nh_od_write(l7nh_model_t *m, uint16_t index, uint8_t sub, const void *buf, int size) {
+    od_ref_t ref;
+    l7nh_pdo_t *pdo;
+
+    if (index == 0x1C12 || index == 0x1C13) {
+        int rx = index == 0x1C12;
+        uint8_t *count = rx ? &m->rx_assign_count : &m->tx_assign_count;
+        uint16_t *tab = rx ? m->rx_assign : m->tx_assign;
+        if (sub == 0) {
+            uint8_t v;
+            if (size != 1) return L7NH_ABORT_LENGTH;
+            v = *(const uint8_t *)buf;
+            if (v > L7NH_NUM_PDO) return L7NH_ABORT_MAPPING;
+            *count = v;
+            return 0;
+        }
+        if (sub > L7NH_NUM_PDO) return L7NH_ABORT_NO_SUBINDEX;
+        if (size != 2) return L7NH_ABORT_LENGTH;
+        if (*count != 0) return L7NH_ABORT_STATE;   // assignment must be cleared first
+        uint16_t v;
+        memcpy(&v, buf, 2);
+        if (v < (rx ? 0x1600 : 0x1A00) || v >= (rx ? 0x1600 : 0x1A00) + L7NH_NUM_PDO) return L7NH_ABORT_MAPPING;
+        tab[sub - 1] = v;
+        return 0;
+    }
+    if ((pdo = pdo_object(m, index)) != NULL) {
+        int rx = index < 0x1A00;
+        if (sub == 0) {
+            if (size != 1) return L7NH_ABORT_LENGTH;
+            uint8_t v = *(const uint8_t *)buf;
+            if (v > L7NH_MAX_PDO_ENTRIES) return L7NH_ABORT_MAPPING;
+            pdo->count = v;
+            return 0;
+        }
+        if (sub > L7NH_MAX_PDO_ENTRIES) return L7NH_ABORT_NO_SUBINDEX;
+        if (size != 4) return L7NH_ABORT_LENGTH;
+        if (pdo->count != 0) return L7NH_ABORT_STATE;   // mapping must be cleared first
+        uint32_t raw;
+        memcpy(&raw, buf, 4);
+        if (!entry_valid(m, raw, rx)) return L7NH_ABORT_MAPPING;
+        pdo->entry[sub - 1] = raw;
+        return 0;
+    }
+    if (!od_lookup(m, index, sub, &ref)) return L7NH_ABORT_NO_OBJECT;
+    if (!ref.writable) return L7NH_ABORT_READ_ONLY;
+    if (size != ref.size) return L7NH_ABORT_LENGTH;
+    memcpy(ref.ptr, buf, (size_t)size);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Process data
+// ---------------------------------------------------------------------------------------------
+
+static int pdo_bytes(const l7nh_pdo_t *pdos, uint16_t base, const uint16_t *assign, uint8_t count) {
+    int bits = 0;
+    for (int i = 0; i < count; i++) {
+        const l7nh_pdo_t *p = &pdos[assign[i] - base];
+        for (int e = 0; e < p->count; e++) bits += (int)(p->entry[e] & 0xFF);
+    }
+    return (bits + 7) / 8;
+}
+
+int l7nh_rx_bytes(const l7nh_model_t *m) {
+    return pdo_bytes(m->rxpdo, 0x1600, m->rx_assign, m->rx_assign_count);
+}
+
+int l7nh_tx_bytes(const l7nh_model_t *m) {
+    return pdo_bytes(m->txpdo, 0x1A00, m->tx_assign, m->tx_assign_count);
+}
+
+// Copy between the process image and the object dictionary following the assignment.
+static void pdo_copy(l7nh_model_t *m, int rx, uint8_t *data) {
+    const uint16_t *assign = rx ? m->rx_assign : m->tx_assign;
+    uint8_t count = rx ? m->rx_assign_count : m->tx_assign_count;
+    int off = 0;
+    for (int i = 0; i < count; i++) {
+        l7nh_pdo_t *p = pdo_object(m, assign[i]);
+        for (int e = 0; e < p->count; e++) {
+            uint32_t raw = p->entry[e];
+            int bytes = (int)(raw & 0xFF) / 8;
+            od_ref_t ref;
+            if ((raw >> 16) != 0 && od_lookup(m, (uint16_t)(raw >> 16), (uint8_t)(raw >> 8), &ref)) {
+                if (rx) {
+                    if (ref.writable) memcpy(ref.ptr, data + off, (size_t)bytes);
+                } else {
+                    memcpy(data + off, ref.ptr, (size_t)bytes);
+                }
+            } else if (!rx) {
+                memset(data + off, 0, (size_t)bytes);
+            }
+            off += bytes;
+        }
+    }
+}
+
+void l7nh_rx_decode(l7nh_model_t *m, const uint8_t *data) {
+    pdo_copy(m, 1, (uint8_t *)data);
+}
+
+void l7nh_tx_encode(l7nh_model_t *m, uint8_t *data) {
+    pdo_copy(m, 0, data);
+}
+
+// ---------------------------------------------------------------------------------------------
+// CiA402 state machine
+// ---------------------------------------------------------------------------------------------
+
+static const uint16_t state_sw[] = {
+    [L7NH_ST_NOT_READY]          = 0x0000,
+    [L7NH_ST_SWITCH_ON_DISABLED] = 0x0040,
+    [L7NH_ST_READY_TO_SWITCH_ON] = 0x0031,
+    [L7NH_ST_SWITCHED_ON]        = 0x0033,
+    [L7NH_ST_OPERATION_ENABLED]  = 0x0037,
+    [L7NH_ST_QUICK_STOP_ACTIVE]  = 0x0017,
+    [L7NH_ST_FAULT_REACTION]     = 0x001F,
+    [L7NH_ST_FAULT]              = 0x0008,
+};
+
+#define SW_REMOTE 0x0200
+
+static void set_state(l7nh_model_t *m, int st) {
+    if (m->state != st) m->transitions++;
+    m->state = st;
+}
+
+static void run_state_machine(l7nh_model_t *m) {
+    uint16_t cw = m->controlword;
+    int disable_voltage = (cw & 0x0002) == 0;
+    int quick_stop = (cw & 0x0006) == 0x0002;
+    int shutdown = (cw & 0x0087) == 0x0006;
+    int switch_on = (cw & 0x008F) == 0x0007;
+    int enable_op = (cw & 0x008F) == 0x000F;
+    int fault_reset = (cw & 0x0080) && !(m->prev_controlword & 0x0080);
+
+    switch (m->state) {
+    case L7NH_ST_NOT_READY:
+        set_state(m, L7NH_ST_SWITCH_ON_DISABLED);
+        break;
+    case L7NH_ST_SWITCH_ON_DISABLED:
+        if (shutdown) set_state(m, L7NH_ST_READY_TO_SWITCH_ON);
+        break;
+    case L7NH_ST_READY_TO_SWITCH_ON:
+        if (disable_voltage || quick_stop) set_state(m, L7NH_ST_SWITCH_ON_DISABLED);
+        else if (switch_on || enable_op) set_state(m, L7NH_ST_SWITCHED_ON);
+        break;
+    case L7NH_ST_SWITCHED_ON:
+        if (disable_voltage || quick_stop) set_state(m, L7NH_ST_SWITCH_ON_DISABLED);
+        else if (shutdown) set_state(m, L7NH_ST_READY_TO_SWITCH_ON);
+        else if (enable_op) set_state(m, L7NH_ST_OPERATION_ENABLED);
+        break;
+    case L7NH_ST_OPERATION_ENABLED:
+        if (disable_voltage) set_state(m, L7NH_ST_SWITCH_ON_DISABLED);
+        else if (quick_stop) set_state(m, L7NH_ST_QUICK_STOP_ACTIVE);
+        else if (shutdown) set_state(m, L7NH_ST_READY_TO_SWITCH_ON);
+        else if (switch_on) set_state(m, L7NH_ST_SWITCHED_ON);
+        break;
+    case L7NH_ST_QUICK_STOP_ACTIVE:
+        if (disable_voltage) set_state(m, L7NH_ST_SWITCH_ON_DISABLED);
+        else if (fabs(m->omega) < STOPPED_RAD_S) set_state(m, L7NH_ST_SWITCH_ON_DISABLED);
+        break;
+    case L7NH_ST_FAULT_REACTION:
+        set_state(m, L7NH_ST_FAULT);
+        break;
+    case L7NH_ST_FAULT:
+        if (fault_reset) {
+            m->error_code = 0;
+            set_state(m, L7NH_ST_SWITCH_ON_DISABLED);
+        }
+        break;
+    }
+    m->prev_controlword = cw;
+    m->statusword = state_sw[m->state] | SW_REMOTE;
+    m->mode_display = m->mode;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Mechanics
+// ---------------------------------------------------------------------------------------------
+
+static double sign(double v) { return v > 0 ? 1.0 : (v < 0 ? -1.0 : 0.0); }
+
+static double drive_torque(const l7nh_model_t *m) {
+    if (m->state == L7NH_ST_QUICK_STOP_ACTIVE) return -sign(m->omega) * m->quickstop_torque;
+    if (m->state != L7NH_ST_OPERATION_ENABLED) return 0.0;
+    if (m->mode != MODE_CST && m->mode != MODE_PROFILE_TORQUE) return 0.0;
+    int32_t t = m->target_torque;
+    if (t > (int32_t)m->max_torque) t = m->max_torque;
+    if (t < -(int32_t)m->max_torque) t = -(int32_t)m->max_torque;
+    return t * m->rated_torque / 1000.0;
+}
+
+static void integrate(l7nh_model_t *m, double torque, double dt) {
+    double fric = m->viscous * m->omega + m->coulomb * sign(m->omega);
+    if (fabs(m->omega) < STOPPED_RAD_S && fabs(torque) <= m->coulomb) {
+        // static friction holds the shaft
+        m->omega = 0.0;
+        return;
+    }
+    double next = m->omega + (torque - fric) / m->inertia * dt;
+    // friction alone must not reverse the direction of motion
+    if (sign(next) != sign(m->omega) && fabs(torque) <= m->coulomb && m->omega != 0.0) next = 0.0;
+    m->position += 0.5 * (m->omega + next) * dt;
+    m->omega = next;
+}
+
+void l7nh_model_step(l7nh_model_t *m, double dt) {
+    run_state_machine(m);
+
+    double torque = drive_torque(m);
+    while (dt > 0) {
+        double h = dt > MAX_SUBSTEP_S ? MAX_SUBSTEP_S : dt;
+        double before = m->omega;
+        integrate(m, torque, h);
+        // the quick stop ramp brakes to standstill, it does not drive the shaft the other way
+        if (m->state == L7NH_ST_QUICK_STOP_ACTIVE && sign(m->omega) != sign(before)) {
+            m->omega = 0.0;
+            torque = 0.0;
+        }
+        dt -= h;
+    }
+
+    double rpm = m->omega * 60.0 / TWO_PI;
+    m->actual_velocity = (int32_t)lround(rpm);
+    m->actual_position = (int32_t)llround(fmod(m->position / TWO_PI * m->counts_per_rev, 4294967296.0));
+    m->actual_torque = (int16_t)lround(torque * 1000.0 / m->rated_torque);
+
+    if (m->overspeed_rpm > 0 && fabs(rpm) > m->overspeed_rpm &&
+        m->state != L7NH_ST_FAULT && m->state != L7NH_ST_FAULT_REACTION) {
+        l7nh_model_fault(m, L7NH_ERR_OVERSPEED);
+    }
+}
+
+void l7nh_model_fault(l7nh_model_t *m, uint16_t error_code) {
+    m->error_code = error_code;
+    set_state(m, L7NH_ST_FAULT_REACTION);
+    m->statusword = state_sw[m->state] | SW_REMOTE;
+}
+
+void l7nh_model_init(l7nh_model_t *m) {
+    memset(m, 0, sizeof(*m));
+    m->max_torque = 3000;           // 300 % of rated
+    m->inertia = 0.00026;           // 400 W motor rotor + small load
+    m->rated_torque = 1.27;
+    m->viscous = 0.0002;
+    m->coulomb = 0.02;
+    m->quickstop_torque = 1.27;
+    m->counts_per_rev = 524288.0;   // 19-bit encoder
+    m->overspeed_rpm = 6000;
+    m->state = L7NH_ST_NOT_READY;
+
+    // ESI-like default mapping (deliberately wider than what the torque loop needs)
+    m->rxpdo[0].count = 6;
+    m->rxpdo[0].entry[0] = 0x60400010;  // controlword
+    m->rxpdo[0].entry[1] = 0x607A0020;  // target position
+    m->rxpdo[0].entry[2] = 0x60FF0020;  // target velocity
+    m->rxpdo[0].entry[3] = 0x60710010;  // target torque
+    m->rxpdo[0].entry[4] = 0x60600008;  // modes of operation
+    m->rxpdo[0].entry[5] = 0x00000008;  // padding
+    m->txpdo[0].count = 7;
+    m->txpdo[0].entry[0] = 0x60410010;  // statusword
+    m->txpdo[0].entry[1] = 0x60640020;  // position actual
+    m->txpdo[0].entry[2] = 0x606C0020;  // velocity actual
+    m->txpdo[0].entry[3] = 0x60770010;  // torque actual
+    m->txpdo[0].entry[4] = 0x603F0010;  // error code
+    m->txpdo[0].entry[5] = 0x60610008;  // modes of operation display
+    m->txpdo[0].entry[6] = 0x00000008;  // padding
+    m->rx_assign_count = 1;
+    m->rx_assign[0] = 0x1600;
+    m->tx_assign_count = 1;
+    m->tx_assign[0] = 0x1A00;
+
+    m->statusword = state_sw[m->state] | SW_REMOTE;
+}
@@ -0,0 +1,107 @@
+// l7nh_model.h
+// Behavioural model of one LS Mecapion L7NH drive for the simulator.
+// - CiA402 power state machine driven by 0x6040, reported in 0x6041 (incl. quick stop and fault reset).
+// - Object dictionary for the objects the control code uses (0x6040/0x6041/0x6060/0x6061/0x6071/
+//   0x6072/0x6077/0x606C/0x6064/0x603F/0x60FF) plus PDO assignment/mapping objects
+//   (0x1C12/0x1C13, 0x1600..0x1603, 0x1A00..0x1A03) so PDO discovery and PO2SO remapping work.
+// - Rigid-body motor: inertia, viscous + Coulomb friction, torque limit, overspeed fault.
+// Units: torque in 0.1 % of rated torque (like 0x6071/0x6077), velocity in rpm, position in encoder counts.
+
+#ifndef L7NH_MODEL_H
+#define L7NH_MODEL_H
+
+#include <stdint.h>
+
+#define L7NH_MAX_PDO_ENTRIES 8
+#define L7NH_NUM_PDO         4   // 0x1600..0x1603 / 0x1A00..0x1A03
+
+// CiA402 SDO abort codes used by the object dictionary
+#define L7NH_ABORT_NO_OBJECT    0x06020000u
+#define L7NH_ABORT_NO_SUBINDEX  0x06090011u
+#define L7NH_ABORT_READ_ONLY    0x06010002u
+#define L7NH_ABORT_LENGTH       0x06070010u
+#define L7NH_ABORT_MAPPING      0x06040041u
+#define L7NH_ABORT_STATE        0x08000022u
+
+// Error codes reported in 0x603F
+#define L7NH_ERR_OVERSPEED      0x8400
+#define L7NH_ERR_INJECTED       0x5000
+#define L7NH_ERR_WATCHDOG       0x8130  // process data watchdog (outputs no longer refreshed)
+
+typedef struct {
+    uint8_t count;
+    uint32_t entry[L7NH_MAX_PDO_ENTRIES];   // index(16) | sub(8) | bits(8)
+} l7nh_pdo_t;
+
+typedef struct {
+    // object dictionary values
+    uint16_t controlword;       // 0x6040
+    uint16_t statusword;        // 0x6041
+    int8_t mode;                // 0x6060
+    int8_t mode_display;        // 0x6061
+    int16_t target_torque;      // 0x6071
+    uint16_t max_torque;        // 0x6072
+    int16_t actual_torque;      // 0x6077
+    int32_t actual_velocity;    // 0x606C
+    int32_t actual_position;    // 0x6064
+    uint16_t error_code;        // 0x603F
+    int32_t target_velocity;    // 0x60FF
+    int32_t target_position;    // 0x607A
+
+    // PDO configuration
+    uint8_t rx_assign_count;    // 0x1C12:0
+    uint16_t rx_assign[L7NH_NUM_PDO];
+    uint8_t tx_assign_count;    // 0x1C13:0
+    uint16_t tx_assign[L7NH_NUM_PDO];
+    l7nh_pdo_t rxpdo[L7NH_NUM_PDO]; // 0x1600..
+    l7nh_pdo_t txpdo[L7NH_NUM_PDO]; // 0x1A00..
+
+    // motor / load model
+    double inertia;             // kg m^2 (motor + load)
+    double rated_torque;        // Nm
+    double viscous;             // Nm / (rad/s)
+    double coulomb;             // Nm
+    double quickstop_torque;    // Nm used for the quick-stop ramp
+    double counts_per_rev;
+    int32_t overspeed_rpm;      // fault above this speed
+    double omega;               // rad/s
+    double position;            // rad
+
+    // internal state
+    int state;                  // L7NH_ST_*
+    uint16_t prev_controlword;
+    uint64_t transitions;       // number of CiA402 state changes (diagnostics)
+} l7nh_model_t;
+
+// CiA402 power states
+enum {
+    L7NH_ST_NOT_READY = 0,
+    L7NH_ST_SWITCH_ON_DISABLED,
+    L7NH_ST_READY_TO_SWITCH_ON,
+    L7NH_ST_SWITCHED_ON,
+    L7NH_ST_OPERATION_ENABLED,
+    L7NH_ST_QUICK_STOP_ACTIVE,
+    L7NH_ST_FAULT_REACTION,
+    L7NH_ST_FAULT
+};
+
+// Defaults: 400 W motor (1.27 Nm rated), small load, ESI-like default PDO mapping.
+void l7nh_model_init(l7nh_model_t *m);
+
+// Evaluate the controlword and advance state machine and mechanics by dt seconds.
+void l7nh_model_step(l7nh_model_t *m, double dt);
+
+// Force the drive into fault with the given 0x603F code.
+void l7nh_model_fault(l7nh_model_t *m, uint16_t error_code);
+
+// Object dictionary access. Return 0 on success or an L7NH_ABORT_* code.
+uint32_t l7nh_od_read(l7nh_model_t *m, uint16_t index, uint8_t sub, void *buf, int *size);
+uint32_t l7nh_od_write(l7nh_model_t *m, uint16_t index, uint8_t sub, const void *buf, int size);
+
+// Process data: size in bytes of the active RxPDO/TxPDO assignment, and (de)serialisation.
+int l7nh_rx_bytes(const l7nh_model_t *m);
+int l7nh_tx_bytes(const l7nh_model_t *m);
+void l7nh_rx_decode(l7nh_model_t *m, const uint8_t *data);
+void l7nh_tx_encode(l7nh_model_t *m, uint8_t *data);
+
+#endif // L7NH_MODEL_H
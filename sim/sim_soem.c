@@ -0,0 +1,781 @@
+// sim_soem.c
+// SOEM API surface (sim/ethercat.h) on top of simulated L7NH drives.
+// The segment behaves like SOEM 1.4 does against real slaves: ec_config_map() runs the PO2SO hooks
+// and lays out all outputs followed by all inputs in the IOmap, writestate(0) broadcasts
+// ec_slave[0].state, and the LRW working counter counts +2 per slave whose outputs were taken
+// (OP only) and +1 per slave whose inputs were read (SAFE-OP and OP).
+// The slaves form a line; a cable of it can be broken. Opened with ecx_init_redundant, the line is a
+// ring through a second NIC and, once the ESCs next to the break have closed their ports, every slave
+// is reached from one of the two ends again. Without the ring the slaves behind the break are cut off
+// and trip on their SyncManager watchdog.
+// A slave whose SyncManager layout was preset (configindex != 0) and disagrees with its PDO mapping
+// refuses SAFE-OP, like an ESC with a wrong SM length; so does a slave ecx_reconfig_slave brings back
+// with a mapping other than the one the IOmap was laid out for. A tripped SM watchdog leaves the slave
+// in SAFE-OP + ERROR until the master acknowledges it.
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "sim_soem.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define SIM_DC_BASE_NS  1000000000LL    // reference clock value at ec_init
+#define SIM_MAX_DT_NS   10000000LL      // never integrate more than 10 ms in one step
+#define SIM_MAX_SEGMENTS 8              // global context + further ecx contexts open at the same time
+#define SIM_WATCHDOG_NS 100000000LL     // SM watchdog: OP slaves without outputs this long go SAFE-OP
+#define SIM_NO_BREAK    -1
+#define SIM_AL_BAD_LAYOUT 0x001E        // AL status: invalid input configuration
+#define SIM_AL_WATCHDOG 0x001B          // AL status: sync manager watchdog
+
+// Everything behind one port: the drives and what the wire would know about them.
+typedef struct sim_segment {
+    int used;
+    l7nh_model_t drives[EC_MAXSLAVE];
+    uint16 al_state[EC_MAXSLAVE];       // state the simulated slave is really in
+    int lost[EC_MAXSLAVE];
+    int bad_layout[EC_MAXSLAVE];        // preset SM layout disagrees with the mapping: no SAFE-OP
+    int64_t now;                        // simulation time
+    int64_t last_wall;
+    int frame_pending;
+    int frames_to_drop;
+    int frames_to_delay;
+    int64_t frame_delay_ns;
+    int frames_to_skip;
+    uint16 skip_slave;
+    int redundant;                      // opened on two NICs: the line is a ring
+    int link_break;                     // cable behind this slave is open (0 = at the master), or SIM_NO_BREAK
+    int64_t break_ns;                   // simulation time of the break
+    int64_t last_out[EC_MAXSLAVE];      // simulation time the slave last took outputs in OP
+    uint32_t abort;
+    ec_mbxbuft mbx_out[EC_MAXSLAVE];    // slave -> master mailbox
+    int64_t mbx_ready[EC_MAXSLAVE];     // wall time the reply becomes readable, 0 = empty
+    ec_mbxbuft mbx_in[EC_MAXSLAVE];     // master -> slave mailbox: a request waiting for mbx_out to be read
+    int mbx_held[EC_MAXSLAVE];
+} sim_segment_t;
+
+static sim_segment_t sim_segments[SIM_MAX_SEGMENTS];   // [0] belongs to the global context
+static int sim_nslaves = 1;
+static int64_t sim_step_ns;
+static int64_t sim_mbx_delay = 1000000;
+static int64_t sim_link_detect_ns = 1000000;
+static int64_t sim_sdo_ns;
+static int sim_keep_pdo;
+
+ec_slavet ec_slave[EC_MAXSLAVE];
+int ec_slavecount;
+ec_groupt ec_group[EC_MAXGROUP];
+int64 ec_DCtime;
+
+static ecx_portt ecx_port = { &sim_segments[0] };
+ecx_contextt ecx_context = {
+    &ecx_port, &ec_slave[0], &ec_slavecount, EC_MAXSLAVE, &ec_group[0], EC_MAXGROUP,
+    NULL, NULL, 0, NULL, NULL, NULL, &ec_DCtime, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, NULL
+};
+
+#define SEG(ctx)    ((ctx)->port->seg)
+#define SLAVE(ctx, s) ((ctx)->slavelist[s])
+#define NSLAVES(ctx) (*(ctx)->slavecount)
+
+static int64_t wall_ns(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (int64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+void sim_setup(int nslaves) {
+    if (nslaves < 1) nslaves = 1;
+    if (nslaves > EC_MAXSLAVE - 1) nslaves = EC_MAXSLAVE - 1;
+    sim_nslaves = nslaves;
+}
+
+l7nh_model_t *sim_drive(uint16 slave) {
+    return &sim_segments[0].drives[slave];
+}
+
+l7nh_model_t *sim_drive_ctx(ecx_contextt *context, uint16 slave) {
+    return SEG(context) ? &SEG(context)->drives[slave] : NULL;
+}
+
+void sim_set_fixed_step(int64_t step_ns) {
+    sim_step_ns = step_ns;
+}
+
+int64_t sim_time_ns(void) {
+    return sim_segments[0].now;
+}
+
+void sim_drop_frames(int n) {
+    sim_segments[0].frames_to_drop = n;
+}
+
+void sim_drop_frames_ctx(ecx_contextt *context, int n) {
+    if (SEG(context)) SEG(context)->frames_to_drop = n;
+}
+
+void sim_delay_frames(int n, int64_t delay_ns) {
+    sim_segments[0].frames_to_delay = n;
+    sim_segments[0].frame_delay_ns = delay_ns;
+}
+
+void sim_delay_frames_ctx(ecx_contextt *context, int n, int64_t delay_ns) {
+    if (!SEG(context)) return;
+    SEG(context)->frames_to_delay = n;
+    SEG(context)->frame_delay_ns = delay_ns;
+}
+
+void sim_skip_frames_ctx(ecx_contextt *context, uint16 slave, int n) {
+    if (!SEG(context)) return;
+    SEG(context)->skip_slave = slave;
+    SEG(context)->frames_to_skip = n;
+}
+
+void sim_skip_frames(uint16 slave, int n) {
+    sim_skip_frames_ctx(&ecx_context, slave, n);
+}
+
+void sim_set_lost_ctx(ecx_contextt *context, uint16 slave, int lost) {
+    sim_segment_t *seg = SEG(context);
+    if (!seg) return;
+    seg->lost[slave] = lost;
+    if (!lost) {
+        // a slave that lost power comes back in INIT with power-on defaults
+        seg->al_state[slave] = EC_STATE_INIT;
+        l7nh_model_init(&seg->drives[slave]);
+    }
+}
+
+void sim_set_lost(uint16 slave, int lost) {
+    sim_set_lost_ctx(&ecx_context, slave, lost);
+}
+
+void sim_break_link_ctx(ecx_contextt *context, int after_slave) {
+    sim_segment_t *seg = SEG(context);
+    if (!seg) return;
+    seg->link_break = after_slave < 0 ? SIM_NO_BREAK : after_slave;
+    seg->break_ns = seg->now;
+}
+
+void sim_break_link(int after_slave) {
+    sim_break_link_ctx(&ecx_context, after_slave);
+}
+
+void sim_set_link_detect(int64_t detect_ns) {
+    sim_link_detect_ns = detect_ns < 0 ? 0 : detect_ns;
+}
+
+void sim_set_mbx_delay(int64_t delay_ns) {
+    sim_mbx_delay = delay_ns < 0 ? 0 : delay_ns;
+}
+
+void sim_set_sdo_time(int64_t sdo_ns) {
+    sim_sdo_ns = sdo_ns < 0 ? 0 : sdo_ns;
+}
+
+void sim_keep_pdo_config(int keep) {
+    sim_keep_pdo = keep;
+}
+
+uint32_t sim_last_abort(void) {
+    return sim_segments[0].abort;
+}
+
+// Until the ESCs next to a break have seen the link go down, frames run into the open cable and are lost.
+static int break_settled(const sim_segment_t *seg) {
+    return seg->link_break != SIM_NO_BREAK && seg->now - seg->break_ns >= sim_link_detect_ns;
+}
+
+// Whether frames from the master get to slave s (and back).
+static int reached(const sim_segment_t *seg, int s) {
+    if (seg->lost[s]) return 0;
+    if (seg->link_break == SIM_NO_BREAK || s <= seg->link_break) return 1;
+    return seg->redundant && break_settled(seg);
+}
+
+static int frame_returns(const sim_segment_t *seg) {
+    if (seg->link_break == SIM_NO_BREAK) return 1;
+    return break_settled(seg) && (seg->redundant || seg->link_break > 0);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Init / configuration
+// ---------------------------------------------------------------------------------------------
+
+// A blocking mailbox transfer: the caller waits the full round trip.
+static void sdo_wait(int transfers) {
+    int64_t until = wall_ns() + (int64_t)transfers * sim_sdo_ns;
+    while (sim_sdo_ns > 0 && wall_ns() < until) {
+    }
+}
+
+// SDO uploads SOEM's PDO map read needs: 0x1C12/0x1C13 count, then per assigned PDO its index,
+// entry count and entries.
+static int assign_reads(const uint16_t *assign, int count, const l7nh_pdo_t *pdo, uint16 base) {
+    int reads = 1;
+    for (int i = 0; i < count && i < L7NH_NUM_PDO; i++) {
+        int k = assign[i] - base;
+        reads += 2 + (k >= 0 && k < L7NH_NUM_PDO ? pdo[k].count : 0);
+    }
+    return reads;
+}
+
+static int pdo_map_reads(const l7nh_model_t *m) {
+    return assign_reads(m->rx_assign, m->rx_assign_count, m->rxpdo, 0x1600) +
+           assign_reads(m->tx_assign, m->tx_assign_count, m->txpdo, 0x1A00);
+}
+
+// A context other than the global one gets a free segment of the pool on ecx_init.
+static sim_segment_t *bind_segment(ecx_contextt *context) {
+    if (context == &ecx_context) return &sim_segments[0];
+    if (SEG(context)) return SEG(context);
+    for (int i = 1; i < SIM_MAX_SEGMENTS; i++) {
+        if (!sim_segments[i].used) return &sim_segments[i];
+    }
+    return NULL;
+}
+
+int ecx_init(ecx_contextt *context, const char *ifname) {
+    sim_segment_t *seg = bind_segment(context);
+
+    (void)ifname;
+    if (!seg) return 0;
+    memset(seg->al_state, 0, sizeof(seg->al_state));
+    memset(seg->lost, 0, sizeof(seg->lost));
+    memset(seg->bad_layout, 0, sizeof(seg->bad_layout));
+    memset(seg->mbx_ready, 0, sizeof(seg->mbx_ready));
+    memset(seg->mbx_held, 0, sizeof(seg->mbx_held));
+    seg->used = 1;
+    seg->now = 0;
+    seg->last_wall = wall_ns();
+    seg->frame_pending = 0;
+    seg->frames_to_drop = 0;
+    seg->frames_to_delay = 0;
+    seg->frames_to_skip = 0;
+    seg->redundant = 0;
+    seg->link_break = SIM_NO_BREAK;
+    seg->abort = 0;
+    context->port->seg = seg;
+    memset(context->slavelist, 0, sizeof(ec_slavet) * (size_t)context->maxslave);
+    memset(context->grouplist, 0, sizeof(ec_groupt) * (size_t)context->maxgroup);
+    NSLAVES(context) = 0;
+    *context->DCtime = SIM_DC_BASE_NS;
+    return 1;
+}
+
+int ecx_init_redundant(ecx_contextt *context, ecx_redportt *redport, const char *ifname, char *if2name) {
+    (void)redport;
+    if (!ecx_init(context, ifname)) return 0;
+    SEG(context)->redundant = if2name != NULL && if2name[0] != '\0';
+    return 1;
+}
+
+void ecx_close(ecx_contextt *context) {
+    NSLAVES(context) = 0;
+    if (!SEG(context)) return;
+    SEG(context)->frame_pending = 0;
+    if (context != &ecx_context) {
+        SEG(context)->used = 0;
+        context->port->seg = NULL;
+    }
+}
+
+int ecx_config_init(ecx_contextt *context, uint8 usetable) {
+    sim_segment_t *seg = SEG(context);
+    int n = sim_nslaves < context->maxslave ? sim_nslaves : context->maxslave - 1;
+
+    (void)usetable;
+    if (!seg) return 0;
+    NSLAVES(context) = n;
+    for (int s = 1; s <= n; s++) {
+        ec_slavet *sl = &SLAVE(context, s);
+        l7nh_model_t *m = &seg->drives[s];
+        if (sim_keep_pdo && m->rx_assign_count) {
+            l7nh_model_t kept = *m;
+            l7nh_model_init(m);
+            m->rx_assign_count = kept.rx_assign_count;
+            m->tx_assign_count = kept.tx_assign_count;
+            memcpy(m->rx_assign, kept.rx_assign, sizeof(m->rx_assign));
+            memcpy(m->tx_assign, kept.tx_assign, sizeof(m->tx_assign));
+            memcpy(m->rxpdo, kept.rxpdo, sizeof(m->rxpdo));
+            memcpy(m->txpdo, kept.txpdo, sizeof(m->txpdo));
+        } else {
+            l7nh_model_init(m);
+        }
+        memset(sl, 0, sizeof(*sl));
+        strcpy(sl->name, "L7NH");
+        sl->eep_man = 0x00007595;   // LS Mecapion
+        sl->eep_id = 0x00010001;
+        sl->eep_rev = 0x00000001;
+        sl->configadr = (uint16)(0x1000 + s);
+        sl->mbx_l = 128;
+        sl->mbx_proto = ECT_MBXPROT_COE;
+        // ESI layout: mailbox out / in, process data out / in (lengths set by ec_config_map)
+        sl->SM[0].StartAddr = 0x1000; sl->SM[0].SMlength = 128; sl->SM[0].SMflags = 0x00010026;
+        sl->SM[1].StartAddr = 0x1080; sl->SM[1].SMlength = 128; sl->SM[1].SMflags = 0x00010022;
+        sl->SM[2].StartAddr = 0x1100; sl->SM[2].SMflags = 0x00010064;
+        sl->SM[3].StartAddr = 0x1400; sl->SM[3].SMflags = 0x00010020;
+        for (int k = 0; k < 4; k++) sl->SMtype[k] = (uint8)(k + 1);
+        sl->hasdc = TRUE;
+        sl->topology = (uint8)(s < n || seg->redundant ? 2 : 1);   // ring: the last slave leads to NIC 2
+        sl->activeports = sl->topology == 2 ? 0x03 : 0x01;
+        seg->al_state[s] = EC_STATE_PRE_OP;
+        sl->state = EC_STATE_PRE_OP;
+    }
+    SLAVE(context, 0).state = EC_STATE_PRE_OP;
+    return n;
+}
+
+int ecx_config_map_group(ecx_contextt *context, void *pIOmap, uint8 group) {
+    sim_segment_t *seg = SEG(context);
+    ec_groupt *grp = &context->grouplist[group];
+    uint8 *map = (uint8 *)pIOmap;
+    uint32 obytes = 0, ibytes = 0;
+    uint16 owkc = 0, iwkc = 0;
+    int n = NSLAVES(context);
+
+    if (!seg) return 0;
+    // PRE-OP -> SAFE-OP hooks run before the mapping is read
+    for (int s = 1; s <= n; s++) {
+        if (seg->lost[s]) continue;
+        if (SLAVE(context, s).PO2SOconfig) SLAVE(context, s).PO2SOconfig((uint16)s);
+        if (SLAVE(context, s).PO2SOconfigx) SLAVE(context, s).PO2SOconfigx(context, (uint16)s);
+    }
+    // without a preset layout SOEM reads the assignment and every mapping object over CoE
+    for (int s = 1; s <= n; s++) {
+        ec_slavet *sl = &SLAVE(context, s);
+        int rx = l7nh_rx_bytes(&seg->drives[s]), tx = l7nh_tx_bytes(&seg->drives[s]);
+        if (sl->configindex) {
+            seg->bad_layout[s] = (sl->Obits + 7) / 8 != rx || (sl->Ibits + 7) / 8 != tx;
+        } else {
+            seg->bad_layout[s] = 0;
+            sl->Obits = (uint16)(rx * 8);
+            sl->Ibits = (uint16)(tx * 8);
+            if (!seg->lost[s]) sdo_wait(pdo_map_reads(&seg->drives[s]));
+        }
+    }
+    for (int s = 1; s <= n; s++) {
+        ec_slavet *sl = &SLAVE(context, s);
+        sl->Obytes = (uint32)(sl->Obits + 7) / 8;
+        sl->SM[2].SMlength = (uint16)sl->Obytes;
+        sl->outputs = sl->Obytes ? map + obytes : NULL;
+        obytes += sl->Obytes;
+        if (sl->Obytes) owkc++;
+    }
+    for (int s = 1; s <= n; s++) {
+        ec_slavet *sl = &SLAVE(context, s);
+        sl->Ibytes = (uint32)(sl->Ibits + 7) / 8;
+        sl->SM[3].SMlength = (uint16)sl->Ibytes;
+        sl->inputs = sl->Ibytes ? map + obytes + ibytes : NULL;
+        ibytes += sl->Ibytes;
+        if (sl->Ibytes) iwkc++;
+    }
+    memset(map, 0, obytes + ibytes);
+
+    SLAVE(context, 0).outputs = map;
+    SLAVE(context, 0).Obytes = obytes;
+    SLAVE(context, 0).inputs = map + obytes;
+    SLAVE(context, 0).Ibytes = ibytes;
+    grp->outputs = map;
+    grp->Obytes = obytes;
+    grp->inputs = map + obytes;
+    grp->Ibytes = ibytes;
+    grp->outputsWKC = owkc;
+    grp->inputsWKC = iwkc;
+    grp->hasdc = TRUE;
+
+    // like SOEM, request SAFE-OP once the slave is mapped
+    for (int s = 1; s <= n; s++) {
+        if (!seg->lost[s] && !seg->bad_layout[s]) seg->al_state[s] = EC_STATE_SAFE_OP;
+    }
+    return (int)(obytes + ibytes);
+}
+
+boolean ecx_configdc(ecx_contextt *context) {
+    for (int s = 0; s <= NSLAVES(context); s++) SLAVE(context, s).hasdc = TRUE;
+    return TRUE;
+}
+
+void ecx_dcsync0(ecx_contextt *context, uint16 slave, boolean act, uint32 CyclTime, int32 CyclShift) {
+    SLAVE(context, slave).DCactive = act ? 1 : 0;
+    SLAVE(context, slave).DCcycle = CyclTime;
+    SLAVE(context, slave).DCshift = CyclShift;
+}
+
+// ---------------------------------------------------------------------------------------------
+// AL state handling
+// ---------------------------------------------------------------------------------------------
+
+static void request_state(sim_segment_t *seg, uint16 s, uint16 req) {
+    if (!reached(seg, s)) return;
+    // with an error indication only a request that acknowledges it or goes down is taken
+    if ((seg->al_state[s] & EC_STATE_ERROR) && !(req & EC_STATE_ACK) && (req & 0x0F) > (seg->al_state[s] & 0x0F)) {
+        return;
+    }
+    req &= 0x0F;
+    if (req >= EC_STATE_SAFE_OP && seg->bad_layout[s]) return;
+    // only OP needs mapped process data; everything else is accepted as requested
+    if (req == EC_STATE_OPERATIONAL && seg->al_state[s] < EC_STATE_SAFE_OP) return;
+    if (req == EC_STATE_OPERATIONAL && seg->al_state[s] != req) seg->last_out[s] = seg->now;
+    seg->al_state[s] = req;
+}
+
+int ecx_writestate(ecx_contextt *context, uint16 slave) {
+    if (!SEG(context)) return 0;
+    if (slave == 0) {
+        for (int s = 1; s <= NSLAVES(context); s++) request_state(SEG(context), (uint16)s, SLAVE(context, 0).state);
+    } else {
+        request_state(SEG(context), slave, SLAVE(context, slave).state);
+    }
+    return 1;
+}
+
+static uint16 actual_state(const sim_segment_t *seg, uint16 s) {
+    return reached(seg, s) ? seg->al_state[s] : EC_STATE_NONE;
+}
+
+int ecx_readstate(ecx_contextt *context) {
+    uint16 lowest = EC_STATE_OPERATIONAL;
+    if (!SEG(context)) return 0;
+    for (int s = 1; s <= NSLAVES(context); s++) {
+        SLAVE(context, s).state = actual_state(SEG(context), (uint16)s);
+        SLAVE(context, s).ALstatuscode = SEG(context)->bad_layout[s] ? SIM_AL_BAD_LAYOUT
+                                       : (SEG(context)->al_state[s] & EC_STATE_ERROR) ? SIM_AL_WATCHDOG : 0;
+        if (SLAVE(context, s).state < lowest) lowest = SLAVE(context, s).state;
+    }
+    SLAVE(context, 0).state = lowest;
+    return lowest;
+}
+
+uint16 ecx_statecheck(ecx_contextt *context, uint16 slave, uint16 reqstate, int timeout) {
+    (void)reqstate;
+    (void)timeout;
+    if (!SEG(context)) return EC_STATE_NONE;
+    if (slave == 0) return (uint16)ecx_readstate(context);
+    SLAVE(context, slave).state = actual_state(SEG(context), slave);
+    return SLAVE(context, slave).state;
+}
+
+// INIT -> PRE-OP -> hooks -> SAFE-OP with the SyncManager layout of the IOmap. Returns the state
+// reached, like SOEM.
+int ecx_reconfig_slave(ecx_contextt *context, uint16 slave, int timeout) {
+    sim_segment_t *seg = SEG(context);
+    ec_slavet *sl = &SLAVE(context, slave);
+    (void)timeout;
+    if (!seg || seg->lost[slave]) return 0;
+    seg->al_state[slave] = EC_STATE_PRE_OP;
+    if (sl->PO2SOconfig) sl->PO2SOconfig(slave);
+    if (sl->PO2SOconfigx) sl->PO2SOconfigx(context, slave);
+    seg->bad_layout[slave] = (sl->Obits + 7) / 8 != l7nh_rx_bytes(&seg->drives[slave]) ||
+                             (sl->Ibits + 7) / 8 != l7nh_tx_bytes(&seg->drives[slave]);
+    if (!seg->bad_layout[slave]) seg->al_state[slave] = EC_STATE_SAFE_OP;
+    sl->state = seg->al_state[slave];
+    return sl->state;
+}
+
+int ecx_recover_slave(ecx_contextt *context, uint16 slave, int timeout) {
+    sim_segment_t *seg = SEG(context);
+    (void)timeout;
+    if (!seg || seg->lost[slave]) return 0;
+    if (seg->al_state[slave] == EC_STATE_NONE) seg->al_state[slave] = EC_STATE_INIT;
+    return 1;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Process data
+// ---------------------------------------------------------------------------------------------
+
+int ecx_send_processdata(ecx_contextt *context) {
+    sim_segment_t *seg = SEG(context);
+    if (!seg) return 0;
+    for (int s = 1; s <= NSLAVES(context); s++) {
+        if (seg->frames_to_skip > 0 && s == seg->skip_slave) continue;
+        if (reached(seg, s) && seg->al_state[s] == EC_STATE_OPERATIONAL && SLAVE(context, s).outputs) {
+            l7nh_rx_decode(&seg->drives[s], SLAVE(context, s).outputs);
+            seg->last_out[s] = seg->now;
+        }
+    }
+    seg->frame_pending = 1;
+    return 1;
+}
+
+int ecx_receive_processdata(ecx_contextt *context, int timeout) {
+    sim_segment_t *seg = SEG(context);
+    int64_t wall = wall_ns();
+    int64_t dt;
+    int wkc = 0;
+
+    (void)timeout;
+    if (!seg || !seg->frame_pending) return EC_NOFRAME;
+    seg->frame_pending = 0;
+
+    dt = sim_step_ns > 0 ? sim_step_ns : wall - seg->last_wall;
+    if (dt > SIM_MAX_DT_NS) dt = SIM_MAX_DT_NS;
+    if (dt < 0) dt = 0;
+    seg->last_wall = wall;
+    seg->now += dt;
+
+    for (int s = 1; s <= NSLAVES(context); s++) {
+        if (seg->lost[s]) continue;
+        l7nh_model_step(&seg->drives[s], (double)dt * 1e-9);
+        if (seg->al_state[s] == EC_STATE_OPERATIONAL && seg->now - seg->last_out[s] > SIM_WATCHDOG_NS) {
+            seg->al_state[s] = EC_STATE_SAFE_OP | EC_STATE_ERROR;    // SM watchdog: outputs invalid, drive trips
+            l7nh_model_fault(&seg->drives[s], L7NH_ERR_WATCHDOG);
+        }
+    }
+
+    if (!frame_returns(seg)) return EC_NOFRAME;
+    if (seg->frames_to_drop > 0) {
+        seg->frames_to_drop--;
+        return EC_NOFRAME;
+    }
+
+    for (int s = 1; s <= NSLAVES(context); s++) {
+        ec_slavet *sl = &SLAVE(context, s);
+        if (!reached(seg, s) || (seg->frames_to_skip > 0 && s == seg->skip_slave)) continue;
+        if (seg->al_state[s] == EC_STATE_OPERATIONAL && sl->Obytes) wkc += 2;
+        if (seg->al_state[s] >= EC_STATE_SAFE_OP && sl->Ibytes) {
+            l7nh_tx_encode(&seg->drives[s], sl->inputs);
+            wkc += 1;
+        }
+    }
+    *context->DCtime = SIM_DC_BASE_NS + seg->now;
+    if (seg->frames_to_skip > 0) seg->frames_to_skip--;
+    if (seg->frames_to_delay > 0) {
+        seg->frames_to_delay--;
+        while (wall_ns() - wall < seg->frame_delay_ns) { }
+    }
+    return wkc;
+}
+
+// ---------------------------------------------------------------------------------------------
+// CoE SDO
+// ---------------------------------------------------------------------------------------------
+
+static int is_pdo_config(uint16 index) {
+    return index == 0x1C12 || index == 0x1C13 || (index >= 0x1600 && index < 0x1700) ||
+           (index >= 0x1A00 && index < 0x1B00);
+}
+
+static int mbx_reachable(ecx_contextt *context, uint16 slave) {
+    sim_segment_t *seg = SEG(context);
+    return seg && slave >= 1 && slave <= NSLAVES(context) && reached(seg, slave) &&
+           seg->al_state[slave] >= EC_STATE_PRE_OP;
+}
+
+int ecx_SDOread(ecx_contextt *context, uint16 slave, uint16 index, uint8 subindex, boolean CA, int *psize,
+                void *p, int timeout) {
+    sim_segment_t *seg = SEG(context);
+    (void)CA;
+    (void)timeout;
+    if (!mbx_reachable(context, slave)) return 0;
+    sdo_wait(1);
+    seg->abort = l7nh_od_read(&seg->drives[slave], index, subindex, p, psize);
+    return seg->abort == 0 ? 1 : 0;
+}
+
+int ecx_SDOwrite(ecx_contextt *context, uint16 Slave, uint16 Index, uint8 SubIndex, boolean CA, int psize,
+                 void *p, int Timeout) {
+    sim_segment_t *seg = SEG(context);
+    (void)CA;
+    (void)Timeout;
+    if (!mbx_reachable(context, Slave)) return 0;
+    sdo_wait(1);
+    if (is_pdo_config(Index) && seg->al_state[Slave] != EC_STATE_PRE_OP) {
+        seg->abort = L7NH_ABORT_STATE;  // PDO mapping can only change in PRE-OP
+        return 0;
+    }
+    seg->abort = l7nh_od_write(&seg->drives[Slave], Index, SubIndex, p, psize);
+    return seg->abort == 0 ? 1 : 0;
+}
+
+// ---------------------------------------------------------------------------------------------
+// CoE mailbox (SDO requests only; replies become readable after sim_mbx_delay). Like an ESC, the slave
+// answers a request only once its previous reply has been read: a late reply to an abandoned request is
+// still the first one the master gets.
+// ---------------------------------------------------------------------------------------------
+
+static uint16 get16(const uint8 *p) { return (uint16)(p[0] | (p[1] << 8)); }
+static void put16(uint8 *p, uint16 v) { p[0] = (uint8)v; p[1] = (uint8)(v >> 8); }
+static void put32(uint8 *p, uint32 v) { put16(p, (uint16)v); put16(p + 2, (uint16)(v >> 16)); }
+
+void ec_clearmbx(ec_mbxbuft *Mbx) {
+    memset(Mbx, 0, sizeof(ec_mbxbuft));
+}
+
+uint8 ec_nextmbxcnt(uint8 cnt) {
+    cnt++;
+    if (cnt > 7) cnt = 1;
+    return cnt;
+}
+
+// The slave processes the request in and posts its reply.
+static void mbx_answer(sim_segment_t *seg, uint16 slave, const uint8 *in) {
+    uint8 *out = seg->mbx_out[slave];
+    uint16 index;
+    uint8 sub, cmd;
+    uint8 buf[64];
+    int size;
+
+    if ((in[5] & 0x0F) != ECT_MBXT_COE || (get16(in + 6) >> 12) != 0x02) return;    // only SDO requests
+    cmd = in[8];
+    index = get16(in + 9);
+    sub = in[11];
+
+    memset(out, 0, sizeof(ec_mbxbuft));
+    put16(out, 10);
+    out[5] = (uint8)(ECT_MBXT_COE | (in[5] & 0x70));
+    put16(out + 6, 0x03 << 12);     // SDO response
+    put16(out + 9, index);
+    out[11] = sub;
+
+    if ((cmd >> 5) == 1) {          // download
+        if (cmd & 0x02) {
+            size = (cmd & 0x01) ? 4 - ((cmd >> 2) & 0x03) : 4;
+            memcpy(buf, in + 12, (size_t)size);
+        } else {
+            size = (int)(get16(in + 12) | ((uint32)get16(in + 14) << 16));
+            if (size > (int)sizeof(buf)) size = (int)sizeof(buf);
+            memcpy(buf, in + 16, (size_t)size);
+        }
+        if (is_pdo_config(index) && seg->al_state[slave] != EC_STATE_PRE_OP) seg->abort = L7NH_ABORT_STATE;
+        else seg->abort = l7nh_od_write(&seg->drives[slave], index, sub, buf, size);
+        out[8] = 0x60;
+    } else if ((cmd >> 5) == 2) {   // upload
+        size = (int)sizeof(buf);
+        seg->abort = l7nh_od_read(&seg->drives[slave], index, sub, buf, &size);
+        if (seg->abort == 0 && size <= 4) {
+            out[8] = (uint8)(0x43 | ((4 - size) << 2));
+            memcpy(out + 12, buf, (size_t)size);
+        } else if (seg->abort == 0) {
+            out[8] = 0x41;
+            put32(out + 12, (uint32)size);
+            memcpy(out + 16, buf, (size_t)size);
+            put16(out, (uint16)(10 + size));
+        }
+    } else {
+        seg->abort = L7NH_ABORT_NO_OBJECT;
+    }
+    if (seg->abort) {
+        put16(out + 6, 0x02 << 12);
+        out[8] = 0x80;
+        put32(out + 12, seg->abort);
+    }
+    seg->mbx_ready[slave] = wall_ns() + sim_mbx_delay;
+    if (seg->mbx_ready[slave] == 0) seg->mbx_ready[slave] = 1;
+}
+
+int ecx_mbxsend(ecx_contextt *context, uint16 slave, ec_mbxbuft *mbx, int timeout) {
+    sim_segment_t *seg = SEG(context);
+    (void)timeout;
+
+    if (!mbx_reachable(context, slave) || seg->mbx_held[slave]) return 0;   // receive mailbox still full
+    if (seg->mbx_ready[slave]) {
+        // the previous reply has not been read: the request waits for it
+        memcpy(seg->mbx_in[slave], mbx, sizeof(ec_mbxbuft));
+        seg->mbx_held[slave] = 1;
+        return 1;
+    }
+    mbx_answer(seg, slave, *mbx);
+    return 1;
+}
+
+int ecx_mbxreceive(ecx_contextt *context, uint16 slave, ec_mbxbuft *mbx, int timeout) {
+    sim_segment_t *seg = SEG(context);
+    int64_t until = wall_ns() + (int64_t)timeout * 1000;
+
+    if (!seg || slave < 1 || slave > NSLAVES(context) || !reached(seg, slave)) return 0;
+    for (;;) {
+        int64_t now = wall_ns();
+        if (seg->mbx_ready[slave] && now >= seg->mbx_ready[slave]) break;
+        if (!seg->mbx_ready[slave] || now >= until) return 0;
+    }
+    memcpy(mbx, seg->mbx_out[slave], sizeof(ec_mbxbuft));
+    seg->mbx_ready[slave] = 0;
+    if (seg->mbx_held[slave]) {
+        seg->mbx_held[slave] = 0;
+        mbx_answer(seg, slave, seg->mbx_in[slave]);
+    }
+    return 1;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Register access (ESC DL status only)
+// ---------------------------------------------------------------------------------------------
+
+// DL status of slave s: ports 0 (towards the master) and 1 (towards the next slave, or NIC 2 on the
+// last slave of a ring). A port whose cable is open has no link and its loop closed; 2 and 3 are unused.
+static uint16 dl_status(const sim_segment_t *seg, int s, int n) {
+    int broken = break_settled(seg);
+    int link0 = !(broken && seg->link_break == s - 1);
+    int link1 = (s < n || seg->redundant) && !(broken && seg->link_break == s);
+    uint16 st = 0x0003 | 0x1000 | 0x4000;   // PDI operational, watchdog ok, ports 2/3 closed
+    st |= link0 ? 0x0210 : 0x0100;
+    st |= link1 ? 0x0820 : 0x0400;
+    return st;
+}
+
+int ecx_FPRD(ecx_portt *port, uint16 ADP, uint16 ADO, uint16 length, void *data, int timeout) {
+    sim_segment_t *seg = port->seg;
+    int s = ADP - 0x1000;   // configured addresses are 0x1000 + position (ecx_config_init)
+    uint16 st;
+    (void)timeout;
+    if (!seg || !seg->used || s < 1 || s >= EC_MAXSLAVE || !reached(seg, s)) return EC_NOFRAME;
+    if (ADO != ECT_REG_DLSTAT || length != sizeof(st)) return 0;
+    st = dl_status(seg, s, sim_nslaves);
+    ((uint8 *)data)[0] = (uint8)st;
+    ((uint8 *)data)[1] = (uint8)(st >> 8);
+    return 1;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Global API: the same calls on ecx_context
+// ---------------------------------------------------------------------------------------------
+
+int ec_init(const char *ifname) { return ecx_init(&ecx_context, ifname); }
+int ec_init_redundant(const char *ifname, char *if2name) {
+    return ecx_init_redundant(&ecx_context, NULL, ifname, if2name);
+}
+void ec_close(void) { ecx_close(&ecx_context); }
+int ec_FPRD(uint16 ADP, uint16 ADO, uint16 length, void *data, int timeout) {
+    return ecx_FPRD(&ecx_port, ADP, ADO, length, data, timeout);
+}
+int ec_config_init(uint8 usetable) { return ecx_config_init(&ecx_context, usetable); }
+int ec_config_map(void *pIOmap) { return ecx_config_map_group(&ecx_context, pIOmap, 0); }
+boolean ec_configdc(void) { return ecx_configdc(&ecx_context); }
+uint16 ec_statecheck(uint16 slave, uint16 reqstate, int timeout) {
+    return ecx_statecheck(&ecx_context, slave, reqstate, timeout);
+}
+int ec_writestate(uint16 slave) { return ecx_writestate(&ecx_context, slave); }
+int ec_readstate(void) { return ecx_readstate(&ecx_context); }
+int ec_send_processdata(void) { return ecx_send_processdata(&ecx_context); }
+int ec_receive_processdata(int timeout) { return ecx_receive_processdata(&ecx_context, timeout); }
+int ec_SDOread(uint16 slave, uint16 index, uint8 subindex, boolean CA, int *psize, void *p, int timeout) {
+    return ecx_SDOread(&ecx_context, slave, index, subindex, CA, psize, p, timeout);
+}
+int ec_SDOwrite(uint16 Slave, uint16 Index, uint8 SubIndex, boolean CA, int psize, void *p, int Timeout) {
+    return ecx_SDOwrite(&ecx_context, Slave, Index, SubIndex, CA, psize, p, Timeout);
+}
+int ec_mbxsend(uint16 slave, ec_mbxbuft *mbx, int timeout) { return ecx_mbxsend(&ecx_context, slave, mbx, timeout); }
+int ec_mbxreceive(uint16 slave, ec_mbxbuft *mbx, int timeout) {
+    return ecx_mbxreceive(&ecx_context, slave, mbx, timeout);
+}
+void ec_dcsync0(uint16 slave, boolean act, uint32 CyclTime, int32 CyclShift) {
+    ecx_dcsync0(&ecx_context, slave, act, CyclTime, CyclShift);
+}
+int ec_reconfig_slave(uint16 slave, int timeout) { return ecx_reconfig_slave(&ecx_context, slave, timeout); }
+int ec_recover_slave(uint16 slave, int timeout) { return ecx_recover_slave(&ecx_context, slave, timeout); }
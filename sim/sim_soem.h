@@ -0,0 +1,75 @@
+// sim_soem.h
+// Control interface of the simulated EtherCAT segment behind sim/ethercat.h.
+// Lets a test or benchmark size the segment, choose between real-time and fixed-step
+// simulation time, reach into the drive models and inject communication faults.
+
+#ifndef SIM_SOEM_H
+#define SIM_SOEM_H
+
+#include <stdint.h>
+#include "ethercat.h"
+#include "l7nh_model.h"
+
+// Number of L7NH drives found by ec_config_init (default 1). Call before ec_config_init.
+void sim_setup(int nslaves);
+
+// Model of drive 'slave' (1-based, like ec_slave[]).
+l7nh_model_t *sim_drive(uint16 slave);
+
+// Same for the segment behind an ecx context (NULL before ecx_init). Every context opened with
+// ecx_init is its own segment of sim_setup() drives; the other sim_* controls act on the global one.
+l7nh_model_t *sim_drive_ctx(ecx_contextt *context, uint16 slave);
+
+// 0 (default): the drives advance by the real monotonic time between ec_receive_processdata calls.
+// >0: every ec_receive_processdata advances exactly step_ns (deterministic, faster than real time).
+void sim_set_fixed_step(int64_t step_ns);
+
+// Simulation time in ns since ec_init.
+int64_t sim_time_ns(void);
+
+// Lose the next n process-data frames (ec_receive_processdata returns EC_NOFRAME).
+void sim_drop_frames(int n);
+void sim_drop_frames_ctx(ecx_contextt *context, int n);
+
+// Return the next n process-data frames delay_ns (monotonic wall time) late, complete.
+void sim_delay_frames(int n, int64_t delay_ns);
+void sim_delay_frames_ctx(ecx_contextt *context, int n, int64_t delay_ns);
+
+// Slave 'slave' neither takes the outputs of the next n returned frames nor fills in its inputs, so they
+// come back with a working counter short by its share (a corrupted datagram, an ESC that missed it).
+void sim_skip_frames(uint16 slave, int n);
+void sim_skip_frames_ctx(ecx_contextt *context, uint16 slave, int n);
+
+// Make a slave stop answering (lost = 1) or come back (lost = 0, it restarts in INIT with power-on
+// defaults, PDO mapping included).
+void sim_set_lost(uint16 slave, int lost);
+void sim_set_lost_ctx(ecx_contextt *context, uint16 slave, int lost);
+
+// Break the cable behind slave 'after_slave' (0 = between the master and slave 1, slave count = the
+// ring's return cable to NIC 2); -1 repairs it. Frames are lost until the neighbouring ESCs have
+// detected the link loss (sim_set_link_detect). After that a ring (ecx_init_redundant) reaches every
+// slave from one of its ends again, a line only the slaves in front of the break.
+void sim_break_link(int after_slave);
+void sim_break_link_ctx(ecx_contextt *context, int after_slave);
+
+// Link-loss detection time of the ESC ports in simulation time. Default 1 ms.
+void sim_set_link_detect(int64_t detect_ns);
+
+// Turnaround of the CoE mailbox: a reply posted with ec_mbxsend can be fetched with ec_mbxreceive
+// this many ns (monotonic wall time) later. Default 1 ms. A reply stays in the slave's mailbox until it
+// is fetched; a request sent meanwhile is answered after that (a second one is refused).
+void sim_set_mbx_delay(int64_t delay_ns);
+
+// Time every blocking SDO transfer (ec_SDOread / ec_SDOwrite) takes, and every PDO mapping object
+// ec_config_map reads from a slave without a preset layout (configindex 0). Default 0; a real CoE
+// round trip is about a millisecond.
+void sim_set_sdo_time(int64_t sdo_ns);
+
+// keep = 1: drives keep their PDO assignment and mapping across ec_close / ec_init, like powered
+// drives behind a restarted master; the default 0 brings them back with power-on defaults.
+void sim_keep_pdo_config(int keep);
+
+// Abort code of the last failed SDO transfer (0 if none).
+uint32_t sim_last_abort(void);
+
+#endif // SIM_SOEM_H
@@ -0,0 +1,31 @@
+#!/bin/sh
+# veth_setup.sh
+# Create (or remove) the veth pair for wire-level tests: the master opens ecat0, ecat_vslave serves ecat1.
+#   sudo sim/veth_setup.sh [up|down] [master_if] [slave_if]
+#   ecat_vslave ecat1 -n 2 &
+# Offloads are disabled so frames arrive as sent; IPv6 is disabled so no stray traffic hits the segment.
+
+set -e
+ACTION=${1:-up}
+MASTER_IF=${2:-ecat0}
+SLAVE_IF=${3:-ecat1}
+
+case "$ACTION" in
+up)
+    ip link add "$MASTER_IF" type veth peer name "$SLAVE_IF"
+    for IF in "$MASTER_IF" "$SLAVE_IF"; do
+        sysctl -q -w "net.ipv6.conf.$IF.disable_ipv6=1" 2>/dev/null || true
+        ethtool -K "$IF" tx off rx off tso off gso off gro off 2>/dev/null || true
+        ip link set "$IF" mtu 1500 promisc on up
+    done
+    echo "veth pair $MASTER_IF <-> $SLAVE_IF up"
+    ;;
+down)
+    ip link del "$MASTER_IF" 2>/dev/null || true
+    echo "veth pair $MASTER_IF removed"
+    ;;
+*)
+    echo "usage: $0 [up|down] [master_if] [slave_if]" >&2
+    exit 2
+    ;;
+esac
@@ -8,10 +8,28 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include "ethercat.h"   // from SOEM: make sure include path is set
+#include "src/ec_cycle.h" // compile together with src/ec_cycle.c
+#include "src/ec_sdoasync.h" // compile together with src/ec_sdoasync.c
+#include "src/ec_pdomap.h" // compile together with src/ec_pdomap.c
+#include "src/cia402.h" // compile together with src/cia402.c
+#include "src/ec_traj.h" // compile together with src/ec_traj.c
+#include "src/ec_wkc.h" // compile together with src/ec_wkc.c
+#include "src/telemetry.h" // compile together with src/telemetry.c
 
 #define EC_TIMEOUTMON 500
 #define DRIVE_SLAVE 1   // using first discovered slave (adjust if you have multiple)
+#define SDO_DECIMATION 100 // SDO setpoint/readback posted every 100 cycles (100 ms at 1 ms cycle)
+#define STOP_TIMEOUT_NS 2000000000LL // keep cycling this long after Stop for the ramp and quick stop to complete
+#define TORQUE_RAMP_NS 200000000LL // Start: S-curve from zero to torque_set
+#define STOP_RAMP_NS 300000000LL // Stop: S-curve to zero torque before the quick stop
+#define GUI_REFRESH_MS 50 // GUI timer draining the telemetry ring
+#define IDT_TELEMETRY 1
+#define WM_APP_STATUS (WM_APP + 1) // lParam: status text, malloc'd by the poster, freed by WndProc
+#define WM_APP_THREAD_DONE (WM_APP + 2) // posted by the EtherCAT thread as its last action
+#define MODE_CST 10 // CiA402 mode of operation: cyclic synchronous torque
 
 // CiA402 object indexes
 #define IDX_CONTROLWORD 0x6040
@@ -31,15 +49,48 @@
 #define CW_FAULT_RESET 0x0080
 
 static HWND hWndMain = NULL, hBtnStart = NULL, hBtnStop = NULL, hStaticRPM = NULL;
-static HANDLE hThread = NULL;
+static HANDLE hThread = NULL;   // the EtherCAT thread until its WM_APP_THREAD_DONE has been handled
 static volatile bool run_flag = false;
-static char ifname[128] = ""; // network interface name (set by command line or edit here)
+static bool closing;            // WM_CLOSE came while the thread was running: destroy once it is done
+static char ifname[128] = ""; // network interface name (set by command line or edit here), "eth1/eth2" = ring
+static uint8 IOmap[4096];     // process image for the cyclic exchange
+static ec_sdoasync_t sdo_engine; // SDOs issued while the cycle runs (advanced one step per cycle)
+static ec_pdomap_t drive_pdo;    // controlword / statusword location in IOmap
+static cia402_t drive_sm;        // CiA402 power state machine, driven from loop_cycle
+static int expected_wkc;         // outputsWKC * 2 + inputsWKC of the group
+static ec_wkc_t frames;          // missing / partial / late frames; a run of them drops the torque
+static telemetry_ring_t telemetry; // loop_cycle -> GUI timer, never waits for the GUI
+static volatile bool cycling;    // loop_cycle runs: the GUI timer shows its telemetry
+static bool dragging;            // the window is in its modal move / size loop
+static int32_t drag_late_ns, idle_late_ns; // worst wakeup lateness shown while dragging / otherwise
 
 // Forward
 DWORD WINAPI EtherCATThread(LPVOID lpParam);
 
-// Helper: set static text
+// Helper: set the static text from the EtherCAT thread. Posted, never sent: the thread must not wait
+// for the GUI thread, which may be in a modal drag loop or waiting for the thread itself.
 void SetRPMText(const char *txt) {
+    char *copy = _strdup(txt);
+    if (copy && !PostMessageA(hWndMain, WM_APP_STATUS, 0, (LPARAM)copy)) free(copy);
+}
+
+// GUI timer: the newest record of the cycle and the worst wakeup lateness since the last refresh, kept
+// apart for the time the window was being dragged or resized (the timer fires inside that modal loop too).
+static void ShowTelemetry(void) {
+    telemetry_summary_t sum;
+    char txt[256];
+    if (telemetry_drain(&telemetry, &sum) == 0 || !cycling) return;
+    int32_t *worst = dragging ? &drag_late_ns : &idle_late_ns;
+    if (sum.max_late_ns > *worst) *worst = sum.max_late_ns;
+    if (sum.flags & TELEMETRY_F_NO_VELOCITY) {
+        sprintf_s(txt, sizeof(txt), "Could not read actual velocity (0x606C) - jitter %d us", (int)(sum.max_late_ns / 1000));
+    } else if (sum.flags & TELEMETRY_F_TRIPPED) {
+        sprintf_s(txt, sizeof(txt), "RPM: %d (raw) - torque dropped after %s frames", (int)sum.last.velocity,
+            ec_wkc_class_name((ec_wkc_class_t)frames.tripped));
+    } else {
+        sprintf_s(txt, sizeof(txt), "RPM: %d (raw) - jitter %d us (worst %d dragging, %d otherwise)",
+            (int)sum.last.velocity, (int)(sum.max_late_ns / 1000), (int)(drag_late_ns / 1000), (int)(idle_late_ns / 1000));
+    }
     SetWindowTextA(hStaticRPM, txt);
 }
 
@@ -53,27 +104,55 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             140, 20, 100, 30, hwnd, (HMENU)2, NULL, NULL);
         hStaticRPM = CreateWindowA("STATIC", "RPM: -", WS_CHILD | WS_VISIBLE | SS_SIMPLE,
             20, 70, 360, 24, hwnd, NULL, NULL, NULL);
+        telemetry_init(&telemetry);
+        SetTimer(hwnd, IDT_TELEMETRY, GUI_REFRESH_MS, NULL);
+        break;
+    case WM_TIMER:
+        if (wParam == IDT_TELEMETRY) ShowTelemetry();
+        break;
+    case WM_ENTERSIZEMOVE:
+        dragging = true;
+        break;
+    case WM_EXITSIZEMOVE:
+        dragging = false;
+        break;
+    case WM_APP_STATUS:
+        SetWindowTextA(hStaticRPM, (const char *)lParam);
+        free((void *)lParam);
+        break;
+    case WM_APP_THREAD_DONE:
+        // the thread has disconnected: only now may a new one drive the ec_* context
+        WaitForSingleObject(hThread, INFINITE);
+        CloseHandle(hThread);
+        hThread = NULL;
+        run_flag = false;
+        if (closing) DestroyWindow(hwnd);
+        else EnableWindow(hBtnStart, TRUE);
         break;
     case WM_COMMAND:
-        if (LOWORD(wParam) == 1) { // Start
-            if (!run_flag) {
+        if (LOWORD(wParam) == 1) { // Start: disabled until the previous thread has posted WM_APP_THREAD_DONE
+            if (!hThread) {
                 run_flag = true;
                 hThread = CreateThread(NULL, 0, EtherCATThread, NULL, 0, NULL);
+                if (hThread) EnableWindow(hBtnStart, FALSE);
+                else run_flag = false;
             }
-        } else if (LOWORD(wParam) == 2) { // Stop
-            if (run_flag) {
-                run_flag = false;
-                // wait for thread to exit
-                if (hThread) {
-                    WaitForSingleObject(hThread, 2000);
-                    CloseHandle(hThread);
-                    hThread = NULL;
-                }
-            }
+        } else if (LOWORD(wParam) == 2) { // Stop: the thread ramps down, quick stops and disconnects on its own
+            run_flag = false;
+        }
+        break;
+    case WM_CLOSE:
+        // stop the drive and close EtherCAT first; WM_APP_THREAD_DONE destroys the window
+        if (hThread) {
+            closing = true;
+            run_flag = false;
+            SetWindowTextA(hStaticRPM, "Stopping...");
+        } else {
+            DestroyWindow(hwnd);
         }
         break;
     case WM_DESTROY:
-        run_flag = false;
+        KillTimer(hwnd, IDT_TELEMETRY);
         PostQuitMessage(0);
         break;
     default:
@@ -98,8 +177,104 @@ int read_sdo_s32(uint16 slave, uint16 idx, uint8 sub, int32_t *out) {
     return ret;
 }
 
-// Thread: initialize SOEM and run simple control loop
-DWORD WINAPI EtherCATThread(LPVOID lpParam) {
+// Per-cycle hook of the main loop
+typedef struct {
+    int16_t torque_set;
+    ec_traj_t traj;             // setpoint generator, one axis
+    int16_t torque;             // this cycle's setpoint
+    int64_t stop_deadline_ns;   // set when Stop was requested
+    int quick_stop;             // the stop ramp is done, quick stop commanded
+    ec_sdo_req_t torque_req;    // 0x6071 write
+    ec_sdo_req_t vel_req;       // 0x606C read
+    int32_t velocity;           // its last value
+    uint32_t flags;             // TELEMETRY_F_*
+} loop_ctx_t;
+
+static int sdo_pending(const ec_sdo_req_t *req) {
+    return req->status == EC_SDO_QUEUED || req->status == EC_SDO_BUSY;
+}
+
+static void loop_cycle(ec_cycle_t *cyc, void *user) {
+    loop_ctx_t *ctx = (loop_ctx_t *)user;
+
+    int64_t t0 = ec_cycle_now_ns();
+    ec_send_processdata();
+    int wkc = ec_receive_processdata(EC_TIMEOUTRET);
+    ec_wkc_cycle(&frames, wkc, expected_wkc, ec_cycle_now_ns() - t0);
+
+    // Stop: ramp the torque to zero, then quick stop through the PDO and keep cycling until the drive has
+    // confirmed it
+    if (!run_flag && ctx->stop_deadline_ns == 0) {
+        ctx->stop_deadline_ns = cyc->wake_ns + STOP_TIMEOUT_NS;
+        ec_traj_stop(&ctx->traj, STOP_RAMP_NS);
+    }
+    int moving = ec_traj_step(&ctx->traj, &ctx->torque);
+    if (frames.tripped) ctx->torque = 0;    // acting on stale inputs: no torque for the rest of the run
+    if (ctx->stop_deadline_ns) {
+        int timeout = cyc->wake_ns > ctx->stop_deadline_ns;
+        if (!ctx->quick_stop && (moving == 0 || timeout)) {
+            cia402_command(&drive_sm, CIA402_TARGET_QUICK_STOP, cyc->wake_ns);
+            ctx->quick_stop = 1;
+        }
+        int32_t velocity = ec_pdomap_has(&drive_pdo, PDO_ACTUAL_VELOCITY)
+            ? pdo_get_s32(drive_pdo.obj[PDO_ACTUAL_VELOCITY]) : CIA402_VELOCITY_UNKNOWN;
+        if (ctx->quick_stop && (cia402_reached(&drive_sm, velocity) || timeout)) ec_cycle_stop(cyc);
+    }
+
+    // CiA402 state machine over the PDO: statusword of this frame in, controlword for the next frame out
+    pdo_set_u16(drive_pdo.obj[PDO_CONTROLWORD],
+        cia402_update(&drive_sm, pdo_get_u16(drive_pdo.obj[PDO_STATUSWORD]), cyc->wake_ns));
+    // with 0x6060 in the PDO the mode goes out every cycle (a zero byte there would override the SDO write)
+    if (ec_pdomap_has(&drive_pdo, PDO_MODE_OF_OPERATION)) {
+        pdo_set_s8(drive_pdo.obj[PDO_MODE_OF_OPERATION], MODE_CST);
+    }
+    // with 0x6071 in the PDO the setpoint goes out every cycle, otherwise over SDO below
+    if (ec_pdomap_has(&drive_pdo, PDO_TARGET_TORQUE)) {
+        pdo_set_s16(drive_pdo.obj[PDO_TARGET_TORQUE], cia402_enabled(&drive_sm) ? ctx->torque : 0);
+    }
+
+    // one mailbox step per cycle; the SDOs posted below complete over the following cycles
+    ec_sdoasync_poll(&sdo_engine, 1);
+
+    // every cycle to the GUI through the telemetry ring (dropped, not waited for, if the GUI falls behind)
+    telemetry_rec_t rec;
+    rec.timestamp_ns = cyc->wake_ns;
+    rec.velocity = ctx->velocity;
+    rec.wkc = wkc;
+    rec.late_ns = (int32_t)cyc->last_late_ns;
+    rec.dc_offset_ns = 0;
+    rec.statusword = pdo_get_u16(drive_pdo.obj[PDO_STATUSWORD]);
+    rec.torque = ctx->torque;
+    rec.flags = ctx->flags | (frames.tripped ? TELEMETRY_F_TRIPPED : 0);
+    telemetry_push(&telemetry, &rec);
+
+    if (cyc->cycles % SDO_DECIMATION != 0) return;
+
+    // take the velocity read posted SDO_DECIMATION cycles ago. Many drives return velocity in [rpm] or [units].
+    // Check your ESI/manual; here the raw value is assumed to be RPM.
+    if (ec_sdo_req_finished(&ctx->vel_req)) {
+        if (ctx->vel_req.status == EC_SDO_DONE) {
+            memcpy(&ctx->velocity, ctx->vel_req.data, sizeof(ctx->velocity));
+            ctx->flags &= ~TELEMETRY_F_NO_VELOCITY;
+        } else {
+            ctx->flags |= TELEMETRY_F_NO_VELOCITY;
+        }
+    }
+
+    // queue target torque (0x6071, when not in the PDO) and actual velocity (0x606C) unless the previous ones
+    // are still in flight; torque only once the drive is enabled
+    if (cia402_enabled(&drive_sm) && !ec_pdomap_has(&drive_pdo, PDO_TARGET_TORQUE) && !sdo_pending(&ctx->torque_req)) {
+        ec_sdo_req_write(&ctx->torque_req, DRIVE_SLAVE, IDX_TARGET_TORQUE, 0x00, &ctx->torque, sizeof(int16_t));
+        ec_sdoasync_post(&sdo_engine, &ctx->torque_req);
+    }
+    if (!sdo_pending(&ctx->vel_req)) {
+        ec_sdo_req_read(&ctx->vel_req, DRIVE_SLAVE, IDX_ACTUAL_VELOCITY, 0x00, sizeof(int32_t));
+        ec_sdoasync_post(&sdo_engine, &ctx->vel_req);
+    }
+}
+
+// Thread body: initialize SOEM and run simple control loop
+static DWORD EtherCATRun(void) {
     int i, j;
     int slavecount;
     char txt[256];
@@ -111,7 +286,12 @@ DWORD WINAPI EtherCATThread(LPVOID lpParam) {
         strcpy_s(ifname, sizeof(ifname), "eth0");
     }
 
-    if (!ec_init(ifname)) {
+    // "eth1/eth2": redundant ring, out of eth1 and back into eth2
+    char primary[sizeof(ifname)];
+    strcpy_s(primary, sizeof(primary), ifname);
+    char *secondary = strchr(primary, '/');
+    if (secondary) *secondary++ = '\0';
+    if (secondary ? !ec_init_redundant(primary, secondary) : !ec_init(primary)) {
         sprintf_s(txt, sizeof(txt), "ec_init on interface '%s' failed. Is interface name correct and EtherCAT cable connected?", ifname);
         SetRPMText(txt);
         run_flag = false;
@@ -130,9 +310,18 @@ DWORD WINAPI EtherCATThread(LPVOID lpParam) {
     sprintf_s(txt, sizeof(txt), "Found %d slaves", slavecount);
     SetRPMText(txt);
 
-    // Map process data (basic)
-    ec_config_map(NULL);
+    // Map process data (basic) and locate controlword / statusword in it
+    ec_config_map(IOmap);
     ec_configdc();
+    expected_wkc = ec_group[0].outputsWKC * 2 + ec_group[0].inputsWKC;
+    ec_wkc_init(&frames, EC_CYCLE_1MS);
+    ec_pdomap_discover(&drive_pdo, DRIVE_SLAVE);
+    if (!ec_pdomap_has(&drive_pdo, PDO_CONTROLWORD) || !ec_pdomap_has(&drive_pdo, PDO_STATUSWORD)) {
+        SetRPMText("0x6040/0x6041 not in the PDO mapping - cannot enable the drive");
+        ec_close();
+        run_flag = false;
+        return 1;
+    }
 
     // change to operational
     ec_statecheck(0, EC_STATE_SAFE_OP,  EC_TIMEOUTSTATE);
@@ -147,65 +336,49 @@ DWORD WINAPI EtherCATThread(LPVOID lpParam) {
         return 1;
     }
 
-    SetRPMText("Operational - configuring drive via SDOs...");
+    SetRPMText("Operational - enabling drive...");
 
-    // 1) set Mode of Operation to Cyclic Synchronous Torque (CST). CiA402 value 10.
-    uint8 mode = 10; // CST
-    if (write_sdo_u8(DRIVE_SLAVE, IDX_MODE_OF_OPERATION, 0x00, mode) <= 0) {
+    // set Mode of Operation to Cyclic Synchronous Torque (CST): by SDO only when 0x6060 is not in the PDO,
+    // otherwise loop_cycle sends it every cycle
+    if (!ec_pdomap_has(&drive_pdo, PDO_MODE_OF_OPERATION)
+        && write_sdo_u8(DRIVE_SLAVE, IDX_MODE_OF_OPERATION, 0x00, MODE_CST) <= 0) {
         SetRPMText("Failed to write Mode of Operation (0x6060)");
         // continue anyway
     }
 
-    Sleep(50);
-
-    // 2) State machine via controlword (0x6040) -- using SDO writes for demo (many drives accept controlword via PDO; using SDO may work for commissioning)
-    // Shutdown
-    if (write_sdo_u16(DRIVE_SLAVE, IDX_CONTROLWORD, 0x00, (uint16)CW_SHUTDOWN) <= 0) {
-        // ignore
-    }
-    Sleep(100);
-    // Switch on
-    write_sdo_u16(DRIVE_SLAVE, IDX_CONTROLWORD, 0x00, (uint16)CW_SWITCH_ON);
-    Sleep(100);
-    // Enable operation
-    write_sdo_u16(DRIVE_SLAVE, IDX_CONTROLWORD, 0x00, (uint16)CW_ENABLE_OPERATION);
-    Sleep(200);
-
-    SetRPMText("Drive enabled - applying torque setpoint...");
-
-    // Main loop: while run_flag, set a small torque command and read actual velocity
-    int32_t torque_set = 1000; // unit: drive dependent (tune carefully!). Use safe small value.
-
-    while (run_flag) {
-        // write target torque (0x6071)
-        write_sdo_s32(DRIVE_SLAVE, IDX_TARGET_TORQUE, 0x00, torque_set);
-
-        // read actual velocity (0x606C). Many drives return velocity in [rpm] or [units]. Check your ESI/manual.
-        int32_t vel_raw = 0;
-        if (read_sdo_s32(DRIVE_SLAVE, IDX_ACTUAL_VELOCITY, 0x00, &vel_raw) > 0) {
-            // convert if needed; here assume raw value equals RPM. If not, user must apply proper scale from manual.
-            sprintf_s(txt, sizeof(txt), "RPM: %d (raw)", vel_raw);
-            SetRPMText(txt);
-        } else {
-            SetRPMText("Could not read actual velocity (0x606C)");
-        }
-
-        // simple 100 ms loop
-        Sleep(100);
-    }
-
-    // On stop: set torque zero and request disable
+    // Main loop: cyclic engine on absolute deadlines. Process data is exchanged every cycle and the setpoint
+    // generator (src/ec_traj.c) S-curves the torque up; without 0x6071 in the PDO the torque write, like
+    // the velocity read, is an SDO posted every SDO_DECIMATION cycles and never waited for.
+    loop_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.torque_set = 1000; // unit: drive dependent (tune carefully!). Use safe small value.
+    ec_traj_init(&ctx.traj, 1, EC_CYCLE_1MS, ctx.torque_set);
+    ec_traj_scurve(&ctx.traj, 0, ctx.torque_set, TORQUE_RAMP_NS);
+    ec_sdoasync_init(&sdo_engine);
+    // the state machine enables the drive from inside the cycle (shutdown -> switch on -> enable),
+    // each step confirmed by the statusword of the previous frame
+    cia402_init(&drive_sm);
+    cia402_command(&drive_sm, CIA402_TARGET_ENABLED, ec_cycle_now_ns());
+
+    ec_cycle_t cyc;
+    ec_cycle_init(&cyc, EC_CYCLE_1MS, loop_cycle, &ctx);
+    ec_cycle_set_realtime(0, -1);
+    cycling = true;
+    ec_cycle_run(&cyc);
+    cycling = false;
+    ec_cycle_destroy(&cyc);
+    ec_sdoasync_flush(&sdo_engine); // the blocking helpers below own the mailbox again
+
+    // On stop: the cycle already quick-stopped the drive through the PDO; set torque zero
     write_sdo_s32(DRIVE_SLAVE, IDX_TARGET_TORQUE, 0x00, 0);
-    // quick stop
-    write_sdo_u16(DRIVE_SLAVE, IDX_CONTROLWORD, 0x00, (uint16)CW_QUICK_STOP);
-    Sleep(100);
-    // shutdown
-    write_sdo_u16(DRIVE_SLAVE, IDX_CONTROLWORD, 0x00, (uint16)CW_SHUTDOWN);
 
-    // read last velocity to show final RPM
+    // read last velocity to show final RPM, together with how long enabling took
     int32_t last_vel = 0;
     if (read_sdo_s32(DRIVE_SLAVE, IDX_ACTUAL_VELOCITY, 0x00, &last_vel) > 0) {
-        sprintf_s(txt, sizeof(txt), "Final RPM: %d (raw)", last_vel);
+        sprintf_s(txt, sizeof(txt), "Final RPM: %d (raw), enabled in %lld us / %lld cycles, frames %llu missing %llu partial %llu late",
+            last_vel, (long long)(drive_sm.enable_ns / 1000), (long long)drive_sm.enable_cycles,
+            (unsigned long long)frames.count[EC_WKC_MISSING], (unsigned long long)frames.count[EC_WKC_PARTIAL],
+            (unsigned long long)frames.count[EC_WKC_LATE]);
         SetRPMText(txt);
     } else {
         SetRPMText("Stopped - final RPM unknown");
@@ -216,6 +389,14 @@ DWORD WINAPI EtherCATThread(LPVOID lpParam) {
     return 0;
 }
 
+// Thread: every exit path ends with WM_APP_THREAD_DONE, which closes the handle and re-enables Start
+DWORD WINAPI EtherCATThread(LPVOID lpParam) {
+    (void)lpParam;
+    DWORD ret = EtherCATRun();
+    PostMessageA(hWndMain, WM_APP_THREAD_DONE, 0, 0);
+    return ret;
+}
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
     MSG Msg;
     WNDCLASSEXA wc;
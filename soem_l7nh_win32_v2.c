@@ -1,237 +1,108 @@
 // soem_l7nh_win32.c
-// Windows GUI program (Option C) using SOEM PDOs where possible and SDO fallback for velocity.
-// - Adds a CONNECT button that initializes SOEM and maps PDOs (press Connect to discover the drive).
-// - Start / Stop buttons: Start sends torque via PDO outputs; Stop zeros torque and issues quick-stop.
-// - Displays realtime RPM on the GUI while running and final RPM after stop (reads velocity via SDO if not present in PDO).
-// Build: use existing CMake for SOEM and link to soem.lib. Adjust interface name (command-line arg) and DRIVE_SLAVE index as needed.
+// Windows GUI program (Option C) using SOEM PDOs; the PDO layout is read from the drives at connect time.
+// The GUI is a thin client of the headless control core (src/l7nh_core.c), which the Linux daemon
+// (src/l7nhd.c) drives the same way; everything below the buttons lives there.
+// - Adds a CONNECT button that initializes SOEM and maps PDOs (press Connect to discover the drives).
+//   Every L7NH on the segment becomes an axis of one struct-of-arrays process image (src/ec_axes.c).
+//   Several NICs may be given ("eth1,eth2"): each one is a segment with its own SOEM context, IOmap and
+//   cyclic thread on its own core, all running on common deadlines (src/ec_segment.c).
+//   "eth1/eth2" opens a segment as a redundant ring (out of eth1, back into eth2): a cable break costs a
+//   few cycles, is located from the port status and reported with the cycles lost (src/ec_redundancy.c).
+// - Latency shows p50/p99/p99.9/max of wakeup lateness, exchange, application and total cycle time from
+//   histograms the cyclic threads keep (src/ec_hist.c); Reset stats clears them without stopping.
+// - Every cycle of every axis is recorded into a ring in memory per segment, which the core's service
+//   thread writes to a ring file (src/ec_recorder.c); tools/rec_export.c turns a time range of it into CSV.
+// - A triggered scope per segment (src/ec_scope.c) keeps the last cycles in memory and freezes around a drive
+//   fault, overspeed, WKC mismatch or cycle overrun; the capture is saved as l7nh_scope_seg<N>_<K>.rec.
+// - Start / Stop buttons: Start enables all axes through their cyclic CiA402 state machines (src/cia402.c) and
+//   sends torque via PDO outputs, from a per-axis setpoint generator fed through a lookahead queue
+//   (src/ec_traj.c: ramps, S-curves, sine / chirp); Start S-curves up to the set torque. Stop ramps every
+//   axis to zero torque, then issues quick-stop through the same PDO path.
+// - speed_control: the generator streams velocity targets instead and a PI per axis in the cycle turns
+//   0x606C into 0x6071 (src/ec_velpi.c, float; -DEC_VELPI_FIXED for Q16.16). Stop then decelerates the
+//   motors along the ramp before the quick stop.
+// - Displays realtime RPM on the GUI while running (drained from a lock-free telemetry ring on a GUI timer) and final RPM after stop (final value read via SDO).
+// - SDO traffic after connect goes through the asynchronous mailbox engine (src/ec_sdoasync.c), which the cyclic
+//   thread advances one step per cycle, so a slow mailbox reply never delays the process data.
+// Build: CMake target ethercat_servo_control with -DL7NH_WITH_SOEM=ON (links the l7nh_core library and
+//        soem.lib). Adjust interface name (command-line arg) and cfg.cycle_ns as needed.
 
 #include <windows.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
-#include "ethercat.h"   // SOEM header (make sure include path is set and soem.lib linked)
+#include "src/l7nh_core.h"
 
-#define EC_TIMEOUTMON 500
-#define DRIVE_SLAVE 1   // index of the drive in ec_slave[] (1 = first slave). Adjust if needed.
+#define GUI_REFRESH_MS 50 // GUI timer draining the telemetry ring (the bus itself runs at cfg.cycle_ns)
+#define IDT_TELEMETRY 1
+#define ID_STATIC_RPM 20
+#define ID_STATIC_STATE 21
+#define WM_APP_TEXT (WM_APP + 1) // wParam: control id, lParam: text, malloc'd by the poster, freed by WndProc
+#define CLOSE_WAIT_MS 5000 // closing: longest wait for the service thread to stop the drives and disconnect
 
-// CiA402 object indexes (used for SDO fallback and safety checks)
-#define IDX_CONTROLWORD 0x6040
-#define IDX_STATUSWORD  0x6041
-#define IDX_MODE_OF_OPERATION 0x6060
-#define IDX_TARGET_TORQUE 0x6071
-#define IDX_ACTUAL_VELOCITY 0x606C
-
-// Controlword commands (simple masks used here)
-#define CW_SHUTDOWN 0x0006
-#define CW_SWITCH_ON 0x0007
-#define CW_ENABLE_OPERATION 0x000F
-#define CW_QUICK_STOP 0x0002
-#define CW_DISABLE_VOLTAGE 0x0000
-#define CW_FAULT_RESET 0x0080
-
-// GUI handles
+// Global GUI handles and flags
 static HWND hWndMain = NULL, hBtnConnect = NULL, hBtnStart = NULL, hBtnStop = NULL, hStaticRPM = NULL, hStaticState = NULL;
+static HWND hBtnLatency = NULL, hBtnResetStats = NULL;
 static HANDLE hThread = NULL;
-static volatile bool run_flag = false;
-static volatile bool connected_flag = false;
-static char ifname[128] = ""; // network interface name (set by command line or edit)
-
-// EtherCAT IOmap pointer (filled by ec_config_map)
-static uint8 ec_IOmap[4096]; // large enough IOmap buffer (make sure size covers your network)
+static char ifname[128] = ""; // network interface name(s), comma separated: one segment per NIC,
+                              // "eth1/eth2" for a redundant ring
+static l7nh_config_t cfg;     // l7nh_config_default(); speed_control off, torque_set 500
+static l7nh_core_t core;
+static bool dragging;                   // the window is in its modal move / size loop
+static ULONGLONG closing_since;         // close requested, waiting for the service thread (GetTickCount64)
+static int32_t drag_late_ns, idle_late_ns;  // worst wakeup lateness shown while dragging / otherwise
 
-// Forward
-DWORD WINAPI EtherCATThread(LPVOID lpParam);
 void UpdateStaticText(HWND hWnd, int id, const char *txt) {
     HWND h = GetDlgItem(hWnd, id);
     if (h) SetWindowTextA(h, txt);
 }
 
-// SDO helpers (wrap ec_SDOread / write)
-int write_sdo_u8(uint16 slave, uint16 idx, uint8 sub, uint8 val) {
-    return ec_SDOwrite(slave, idx, sub, FALSE, sizeof(uint8), &val, EC_TIMEOUTRXM);
-}
-int write_sdo_u16(uint16 slave, uint16 idx, uint8 sub, uint16 val) {
-    return ec_SDOwrite(slave, idx, sub, FALSE, sizeof(uint16), &val, EC_TIMEOUTRXM);
-}
-int write_sdo_s32(uint16 slave, uint16 idx, uint8 sub, int32_t val) {
-    return ec_SDOwrite(slave, idx, sub, FALSE, sizeof(int32_t), &val, EC_TIMEOUTRXM);
+// Core events arrive on EtherCATThread: the state line and the secondary (RPM) line. Posted, never sent:
+// SetWindowText from this thread would wait for the GUI thread, which may be waiting for this thread.
+static void OnCoreEvent(void *user, l7nh_event_kind_t kind, const char *msg) {
+    (void)user;
+    char *copy = _strdup(msg);
+    WPARAM id = kind == L7NH_EVENT_STATE ? ID_STATIC_STATE : ID_STATIC_RPM;
+    if (copy && !PostMessageA(hWndMain, WM_APP_TEXT, id, (LPARAM)copy)) free(copy);
 }
-int read_sdo_s32(uint16 slave, uint16 idx, uint8 sub, int32_t *out) {
-    int size = sizeof(int32_t);
-    int ret = ec_SDOread(slave, idx, sub, FALSE, &size, out, EC_TIMEOUTRXM);
-    return ret;
-}
-
-// Get pointer helpers to PDO areas. These assume the drive's Rx PDO maps Controlword first, then TargetTorque.
-// The ESI supplied with the drive shows Rx PDO mapping that includes 0x6040(Controlword) and 0x6071(Target Torque).
-// See the drive ESI for exact order — if different, adjust offsets here. (Reference: uploaded ESI file.)
 
-static inline uint16_t *pdo_controlword_ptr(int slave) {
-    // controlword assumed at outputs offset 0
-    if (!ec_slave[slave].outputs) return NULL;
-    return (uint16_t *)(ec_slave[slave].outputs + 0);
-}
-static inline int16_t *pdo_target_torque_ptr(int slave) {
-    // target torque assumed at outputs offset 2 (signed 16-bit)
-    if (!ec_slave[slave].outputs) return NULL;
-    return (int16_t *)(ec_slave[slave].outputs + 2);
-}
-static inline uint16_t *pdo_statusword_ptr(int slave) {
-    if (!ec_slave[slave].inputs) return NULL;
-    return (uint16_t *)(ec_slave[slave].inputs + 0);
-}
-static inline int32_t *pdo_actual_velocity_ptr(int slave) {
-    // many ESI variants map actual velocity in the first Transmit PDO entries after status.
-    // If mapped as 32-bit immediately after statusword, it would be at inputs+2 (byte offset 2) => align to int32
-    if (!ec_slave[slave].inputs) return NULL;
-    return (int32_t *)(ec_slave[slave].inputs + 2);
-}
-
-// Thread: main EtherCAT loop (called after Connect -> Start will create a separate short loop). 
-// This thread implements the cyclic PDO-based control while run_flag is true.
+// Thread: service thread of the control core. Connects, then carries out Start / Stop / Disconnect and
+// the non-cyclic work (SDO engines, cable breaks, scope captures) until disconnected.
 DWORD WINAPI EtherCATThread(LPVOID lpParam) {
-    char txt[256];
-    int slavecount;
-
-    if (!ec_init(ifname)) {
-        sprintf_s(txt, sizeof(txt), "ec_init('%s') failed. Check interface name and cable.", ifname);
-        UpdateStaticText(hWndMain, (int)hStaticState, txt);
-        connected_flag = false;
-        run_flag = false;
-        return 1;
-    }
-
-    if (ec_config_init(FALSE) <= 0) {
-        UpdateStaticText(hWndMain, (int)hStaticState, "No slaves found or ec_config_init failed");
-        ec_close();
-        connected_flag = false;
-        run_flag = false;
-        return 1;
-    }
-
-    slavecount = ec_slavecount;
-    sprintf_s(txt, sizeof(txt), "Found %d slaves", slavecount);
-    UpdateStaticText(hWndMain, (int)hStaticState, txt);
-
-    // Map process data into our IOmap buffer
-    ec_config_map(ec_IOmap);
-    ec_configdc();
-
-    // Set all slaves to OP state
-    ec_statecheck(0, EC_STATE_SAFE_OP, EC_TIMEOUTSTATE);
-    for (int s = 1; s <= ec_slavecount; s++) {
-        ec_slave[s].state = EC_STATE_OPERATIONAL;
-    }
-    ec_writestate(0);
-    ec_statecheck(0, EC_STATE_OPERATIONAL, EC_TIMEOUTSTATE);
-
-    if (ec_slave[DRIVE_SLAVE].state != EC_STATE_OPERATIONAL) {
-        UpdateStaticText(hWndMain, (int)hStaticState, "Drive failed to reach OPERATIONAL state");
-        ec_close();
-        connected_flag = false;
-        run_flag = false;
-        return 1;
-    }
-
-    connected_flag = true;
-    UpdateStaticText(hWndMain, (int)hStaticState, "Connected. Ready (press Start)");
-
-    // Keep thread alive while connected (but not running torque). Start/Stop will control run_flag separately.
-    while (connected_flag) {
-        // small sleep to keep responsive to GUI; Start button will spawn the run loop below.
-        Sleep(100);
-    }
-
-    // If disconnected requested, close ec
-    ec_close();
-    UpdateStaticText(hWndMain, (int)hStaticState, "Disconnected");
+    (void)lpParam;
+    if (l7nh_connect(&core, ifname, &cfg, OnCoreEvent, NULL) < 0) return 1;
+    while (l7nh_poll(&core)) Sleep(1);
     return 0;
 }
 
-// Start/Stop handlers implement torque control loop (uses PDO outputs). This uses the same IOmap and ec_send/receive.
-static HANDLE hRunThread = NULL;
-DWORD WINAPI RunLoop(LPVOID lpParam) {
-    char txt[256];
-
-    // basic state machine to enable drive via SDO for safety, then use PDO torque set
-    // Set Mode of Operation to CST (Cyclic Synchronous Torque) — CiA402 value 10
-    uint8 mode = 10; // CST
-    write_sdo_u8(DRIVE_SLAVE, IDX_MODE_OF_OPERATION, 0x00, mode);
-    Sleep(20);
-
-    // Use SDO to move CiA402 state machine to Operation Enabled: shutdown -> switch on -> enable
-    write_sdo_u16(DRIVE_SLAVE, IDX_CONTROLWORD, 0x00, (uint16)CW_SHUTDOWN);
-    Sleep(50);
-    write_sdo_u16(DRIVE_SLAVE, IDX_CONTROLWORD, 0x00, (uint16)CW_SWITCH_ON);
-    Sleep(50);
-    write_sdo_u16(DRIVE_SLAVE, IDX_CONTROLWORD, 0x00, (uint16)CW_ENABLE_OPERATION);
-    Sleep(100);
-
-    // Now run cyclic PDO loop. We'll send processdata and set torque via PDO outputs.
-    int16_t torque_set = 500; // small safe torque — tune for your motor (units per ESI). Use positive small value.
-
-    while (run_flag) {
-        // send processdata and receive to update inputs/outputs
-        ec_send_processdata();
-        ec_receive_processdata(EC_TIMEOUTRET);
-
-        // write PDO outputs directly
-        uint16_t *cw = pdo_controlword_ptr(DRIVE_SLAVE);
-        int16_t *tt = pdo_target_torque_ptr(DRIVE_SLAVE);
-        if (cw && tt) {
-            *cw = CW_ENABLE_OPERATION; // keep enabled
-            *tt = torque_set; // write torque
-        } else {
-            // if PDO not mapped as expected, fallback to SDO write
-            write_sdo_u16(DRIVE_SLAVE, IDX_CONTROLWORD, 0x00, (uint16)CW_ENABLE_OPERATION);
-            write_sdo_s32(DRIVE_SLAVE, IDX_TARGET_TORQUE, 0x00, torque_set);
-        }
-
-        // read velocity for display: try PDO first, then SDO fallback
-        int has_pdo_vel = 0;
-        int32_t vel_raw = 0;
-        int32_t *pdo_vel = pdo_actual_velocity_ptr(DRIVE_SLAVE);
-        if (pdo_vel) {
-            vel_raw = *pdo_vel;
-            has_pdo_vel = 1;
-        } else {
-            // SDO read fallback
-            if (read_sdo_s32(DRIVE_SLAVE, IDX_ACTUAL_VELOCITY, 0x00, &vel_raw) <= 0) {
-                // could not read velocity
-                UpdateStaticText(hWndMain, (int)hStaticRPM, "RPM: (no velocity)");
-            }
-        }
-        if (has_pdo_vel || vel_raw) {
-            sprintf_s(txt, sizeof(txt), "RPM: %d%s", (int)vel_raw, has_pdo_vel?" (pdo)":" (sdo)");
-            UpdateStaticText(hWndMain, (int)hStaticRPM, txt);
-        }
-
-        Sleep(50); // 50 ms cycle (adjust per your network / ESI timing)
-    }
-
-    // On stop: zero torque and quick stop
-    ec_send_processdata();
-    ec_receive_processdata(EC_TIMEOUTRET);
-    int16_t *tt = pdo_target_torque_ptr(DRIVE_SLAVE);
-    if (tt) {
-        *tt = 0;
-    } else {
-        write_sdo_s32(DRIVE_SLAVE, IDX_TARGET_TORQUE, 0x00, 0);
-    }
-    write_sdo_u16(DRIVE_SLAVE, IDX_CONTROLWORD, 0x00, (uint16)CW_QUICK_STOP);
-    Sleep(50);
+static bool ServiceThreadRunning(void) {
+    return hThread && WaitForSingleObject(hThread, 0) == WAIT_TIMEOUT;
+}
 
-    // Read final velocity (prefer SDO to get correct scaling)
-    int32_t last_vel = 0;
-    if (read_sdo_s32(DRIVE_SLAVE, IDX_ACTUAL_VELOCITY, 0x00, &last_vel) > 0) {
-        sprintf_s(txt, sizeof(txt), "Final RPM: %d", last_vel);
-        UpdateStaticText(hWndMain, (int)hStaticRPM, txt);
-    } else {
-        UpdateStaticText(hWndMain, (int)hStaticRPM, "Stopped - final RPM unknown");
-    }
+// GUI timer: drain the telemetry ring and show the newest values plus the worst wakeup lateness
+// seen by the cyclic thread since the last refresh. The timer keeps firing inside the modal loop of a
+// window drag, so the lateness is also kept apart for the time the window was being dragged or resized.
+static void ShowTelemetry(HWND hwnd) {
+    char line1[256], line2[256];
+    telemetry_summary_t sum;
+    if (l7nh_telemetry(&core, line1, sizeof(line1), line2, sizeof(line2), &sum) == 0) return;
+    int32_t *worst = dragging ? &drag_late_ns : &idle_late_ns;
+    if (sum.max_late_ns > *worst) *worst = sum.max_late_ns;
+    UpdateStaticText(hwnd, ID_STATIC_RPM, line1);
+    UpdateStaticText(hwnd, ID_STATIC_STATE, line2);
+}
 
-    return 0;
+// Latency button: p50/p99/p99.9/max of the cycle histograms of every segment (src/ec_hist.c), read while
+// the cycle keeps running. Cycles whose total time exceeded the period would have overrun.
+static void ShowLatency(HWND hwnd) {
+    char txt[2048];
+    int risk = l7nh_latency(&core, txt, sizeof(txt));
+    size_t used = strlen(txt);
+    snprintf(txt + used, sizeof(txt) - used, "Worst wakeup lateness: %.1f us while the window was dragged or resized, "
+        "%.1f us otherwise\n", drag_late_ns / 1e3, idle_late_ns / 1e3);
+    MessageBoxA(hwnd, txt, "Cycle latency", MB_OK | (risk ? MB_ICONWARNING : 0));
 }
 
 // Win32 callbacks and GUI creation
@@ -244,57 +115,75 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             140, 20, 100, 30, hwnd, (HMENU)11, NULL, NULL);
         hBtnStop = CreateWindowA("BUTTON", "Stop", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
             260, 20, 100, 30, hwnd, (HMENU)12, NULL, NULL);
+        hBtnLatency = CreateWindowA("BUTTON", "Latency", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+            20, 130, 100, 30, hwnd, (HMENU)13, NULL, NULL);
+        hBtnResetStats = CreateWindowA("BUTTON", "Reset stats", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+            140, 130, 100, 30, hwnd, (HMENU)14, NULL, NULL);
         hStaticRPM = CreateWindowA("STATIC", "RPM: -", WS_CHILD | WS_VISIBLE | SS_SIMPLE,
-            20, 70, 360, 24, hwnd, (HMENU)20, NULL, NULL);
+            20, 70, 360, 24, hwnd, (HMENU)ID_STATIC_RPM, NULL, NULL);
         hStaticState = CreateWindowA("STATIC", "State: Idle", WS_CHILD | WS_VISIBLE | SS_SIMPLE,
-            20, 100, 360, 24, hwnd, (HMENU)21, NULL, NULL);
+            20, 100, 360, 24, hwnd, (HMENU)ID_STATIC_STATE, NULL, NULL);
+        SetTimer(hwnd, IDT_TELEMETRY, GUI_REFRESH_MS, NULL);
+        break;
+    case WM_TIMER:
+        if (wParam != IDT_TELEMETRY) break;
+        if (l7nh_state(&core) == L7NH_RUNNING) ShowTelemetry(hwnd);
+        // closing: the window goes once the service thread has stopped the drives and disconnected
+        if (closing_since && (!ServiceThreadRunning() || GetTickCount64() - closing_since > CLOSE_WAIT_MS)) {
+            DestroyWindow(hwnd);
+        }
+        break;
+    case WM_APP_TEXT:
+        UpdateStaticText(hwnd, (int)wParam, (const char *)lParam);
+        free((void *)lParam);
+        break;
+    case WM_ENTERSIZEMOVE:
+        dragging = true;
+        break;
+    case WM_EXITSIZEMOVE:
+        dragging = false;
         break;
     case WM_COMMAND:
         if (LOWORD(wParam) == 10) { // Connect
-            if (!connected_flag) {
-                // spawn EtherCAT connect thread
-                connected_flag = false; // ensure
-                // copy interface name if provided via cmdline (already in ifname)
+            if (!ServiceThreadRunning()) {
+                // spawn EtherCAT connect thread (interface name from the cmdline is already in ifname)
+                if (hThread) CloseHandle(hThread);
                 hThread = CreateThread(NULL, 0, EtherCATThread, NULL, 0, NULL);
                 if (hThread) {
-                    UpdateStaticText(hwnd, 21, "Connecting...");
+                    UpdateStaticText(hwnd, ID_STATIC_STATE, "Connecting...");
                 }
             } else {
-                // disconnect request: tell thread to cleanup
-                connected_flag = false;
-                UpdateStaticText(hwnd, 21, "Disconnecting...");
+                // disconnect request: the service thread stops a run first, then closes the segments
+                l7nh_disconnect(&core);
+                UpdateStaticText(hwnd, ID_STATIC_STATE, "Disconnecting...");
             }
         } else if (LOWORD(wParam) == 11) { // Start
-            if (connected_flag && !run_flag) {
-                run_flag = true;
-                hRunThread = CreateThread(NULL, 0, RunLoop, NULL, 0, NULL);
-                UpdateStaticText(hwnd, 21, "Running...");
-            }
-        } else if (LOWORD(wParam) == 12) { // Stop
-            if (run_flag) {
-                run_flag = false;
-                // wait for run thread to finish
-                if (hRunThread) {
-                    WaitForSingleObject(hRunThread, 2000);
-                    CloseHandle(hRunThread);
-                    hRunThread = NULL;
-                }
-                UpdateStaticText(hwnd, 21, "Stopped (connected)");
+            if (l7nh_state(&core) == L7NH_CONNECTED) l7nh_start(&core);
+        } else if (LOWORD(wParam) == 12) { // Stop (ramp down and quick stop, reported when done)
+            if (l7nh_state(&core) == L7NH_RUNNING) l7nh_stop(&core);
+        } else if (LOWORD(wParam) == 13) { // Latency
+            ShowLatency(hwnd);
+        } else if (LOWORD(wParam) == 14) { // Reset stats (carried out by each cyclic thread)
+            l7nh_reset_stats(&core);
+            drag_late_ns = idle_late_ns = 0;
+        }
+        break;
+    case WM_CLOSE:
+        // stop the drives and close EtherCAT first; the GUI keeps pumping messages (the service thread
+        // posts its state lines) and the timer destroys the window when the thread is done
+        if (ServiceThreadRunning()) {
+            if (!closing_since) {
+                l7nh_disconnect(&core);
+                closing_since = GetTickCount64();
+                UpdateStaticText(hwnd, ID_STATIC_STATE, "Disconnecting...");
             }
+        } else {
+            DestroyWindow(hwnd);
         }
         break;
     case WM_DESTROY:
-        // ensure threads and EtherCAT closed
-        run_flag = false;
-        connected_flag = false;
-        if (hRunThread) {
-            WaitForSingleObject(hRunThread, 1000);
-            CloseHandle(hRunThread);
-        }
-        if (hThread) {
-            WaitForSingleObject(hThread, 1000);
-            CloseHandle(hThread);
-        }
+        KillTimer(hwnd, IDT_TELEMETRY);
+        if (hThread) CloseHandle(hThread);
         PostQuitMessage(0);
         break;
     default:
@@ -306,6 +195,46 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
     MSG Msg;
     WNDCLASSEXA wc;
+    (void)hPrevInstance;
 
     // If user passed interface name as command line, copy it
-    if (lpCmdLine && lpCmdLine[0] != '
\ No newline at end of file
+    if (lpCmdLine && lpCmdLine[0] != '\0') {
+        strncpy_s(ifname, sizeof(ifname), lpCmdLine, _TRUNCATE);
+    }
+    l7nh_config_default(&cfg);
+
+    wc.cbSize = sizeof(WNDCLASSEXA);
+    wc.style = 0;
+    wc.lpfnWndProc = WndProc;
+    wc.cbClsExtra = 0;
+    wc.cbWndExtra = 0;
+    wc.hInstance = hInstance;
+    wc.hIcon = LoadIcon(NULL, IDI_APPLICATION);
+    wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+    wc.hbrBackground = (HBRUSH)(COLOR_WINDOW+1);
+    wc.lpszMenuName = NULL;
+    wc.lpszClassName = "SOEM_L7NH_Class";
+    wc.hIconSm = LoadIcon(NULL, IDI_APPLICATION);
+
+    if (!RegisterClassExA(&wc)) {
+        MessageBoxA(NULL, "Window Registration Failed!", "Error", MB_ICONEXCLAMATION | MB_OK);
+        return 0;
+    }
+
+    hWndMain = CreateWindowA("SOEM_L7NH_Class", "SOEM L7NH Demo", WS_OVERLAPPEDWINDOW,
+        CW_USEDEFAULT, CW_USEDEFAULT, 420, 220, NULL, NULL, hInstance, NULL);
+
+    if (hWndMain == NULL) {
+        MessageBoxA(NULL, "Window Creation Failed!", "Error", MB_ICONEXCLAMATION | MB_OK);
+        return 0;
+    }
+
+    ShowWindow(hWndMain, nCmdShow);
+    UpdateWindow(hWndMain);
+
+    while (GetMessage(&Msg, NULL, 0, 0) > 0) {
+        TranslateMessage(&Msg);
+        DispatchMessage(&Msg);
+    }
+    return (int)Msg.wParam;
+}
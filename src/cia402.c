@@ -0,0 +1,141 @@
+// cia402.c
+// CiA402 power state machine driven from the cyclic task (see cia402.h).
+
+#include "cia402.h"
+
+#include <string.h>
+
+static const char *const state_names[CIA402_STATE_COUNT] = {
+    "Not ready to switch on",
+    "Switch on disabled",
+    "Ready to switch on",
+    "Switched on",
+    "Operation enabled",
+    "Quick stop active",
+    "Fault reaction active",
+    "Fault",
+};
+
+void cia402_init(cia402_t *sm) {
+    memset(sm, 0, sizeof(*sm));
+    sm->target = CIA402_TARGET_DISABLED;
+    sm->state = CIA402_NOT_READY;
+    sm->timeout_ns = CIA402_TIMEOUT_NS;
+    sm->max_fault_resets = CIA402_MAX_FAULT_RESETS;
+    sm->enable_ns = -1;
+    sm->enable_cycles = -1;
+}
+
+void cia402_command(cia402_t *sm, cia402_target_t target, int64_t now_ns) {
+    sm->target = target;
+    sm->request_ns = now_ns;
+    sm->request_cycles = 0;
+    sm->state_since_ns = now_ns;
+    memset(sm->state_ns, 0, sizeof(sm->state_ns));
+    sm->enable_ns = -1;
+    sm->enable_cycles = -1;
+    sm->fault_resets = 0;
+    sm->error = 0;
+}
+
+cia402_state_t cia402_decode(uint16_t sw) {
+    if ((sw & 0x4F) == 0x08) return CIA402_FAULT;
+    if ((sw & 0x4F) == 0x0F) return CIA402_FAULT_REACTION;
+    if ((sw & 0x4F) == 0x40) return CIA402_SWITCH_ON_DISABLED;
+    if ((sw & 0x6F) == 0x21) return CIA402_READY_TO_SWITCH_ON;
+    if ((sw & 0x6F) == 0x23) return CIA402_SWITCHED_ON;
+    if ((sw & 0x6F) == 0x27) return CIA402_OPERATION_ENABLED;
+    if ((sw & 0x6F) == 0x07) return CIA402_QUICK_STOP_ACTIVE;
+    return CIA402_NOT_READY;
+}
+
+// The drive is in a state the target asks for; it may stay there without a timeout.
+static int at_target(const cia402_t *sm) {
+    switch (sm->target) {
+    case CIA402_TARGET_ENABLED:
+        return sm->state == CIA402_OPERATION_ENABLED;
+    case CIA402_TARGET_QUICK_STOP:
+        return sm->state == CIA402_QUICK_STOP_ACTIVE || sm->state == CIA402_SWITCH_ON_DISABLED;
+    default:
+        return sm->state == CIA402_SWITCH_ON_DISABLED;
+    }
+}
+
+int cia402_reached(const cia402_t *sm, int32_t actual_velocity) {
+    if (sm->target == CIA402_TARGET_QUICK_STOP && sm->state == CIA402_QUICK_STOP_ACTIVE) {
+        return actual_velocity >= -CIA402_STANDSTILL && actual_velocity <= CIA402_STANDSTILL;
+    }
+    return at_target(sm);
+}
+
+const char *cia402_state_name(cia402_state_t state) {
+    return (unsigned)state < CIA402_STATE_COUNT ? state_names[state] : "?";
+}
+
+static void enter(cia402_t *sm, cia402_state_t next, uint16_t sw, int64_t now_ns) {
+    cia402_transition_t *t = &sm->log[sm->log_count & (CIA402_LOG_SIZE - 1)];
+    t->at_ns = now_ns;
+    t->statusword = sw;
+    t->from = (uint8_t)sm->state;
+    t->to = (uint8_t)next;
+    sm->log_count++;
+    sm->state_ns[sm->state] += now_ns - sm->state_since_ns;
+    sm->state = next;
+    sm->state_since_ns = now_ns;
+}
+
+// Controlword that moves the drive from 'state' one step towards the target.
+static uint16_t next_controlword(cia402_t *sm, int64_t now_ns) {
+    int enable = sm->target == CIA402_TARGET_ENABLED;
+
+    switch (sm->state) {
+    case CIA402_FAULT:
+        // fault reset acts on the rising edge of bit 7: hold 0x80 for CIA402_RESET_HOLD_NS, then drop it
+        // for one cycle before the next attempt
+        if (!enable) return CIA402_CW_DISABLE_VOLTAGE;
+        if (sm->controlword & CIA402_CW_FAULT_RESET) {
+            if (now_ns - sm->reset_ns < CIA402_RESET_HOLD_NS) return CIA402_CW_FAULT_RESET;
+            return CIA402_CW_DISABLE_VOLTAGE;
+        }
+        if (sm->fault_resets >= sm->max_fault_resets) {
+            sm->error |= CIA402_ERR_FAULT;
+            return CIA402_CW_DISABLE_VOLTAGE;
+        }
+        sm->fault_resets++;
+        sm->reset_ns = now_ns;
+        return CIA402_CW_FAULT_RESET;
+    case CIA402_SWITCH_ON_DISABLED:
+        return enable ? CIA402_CW_SHUTDOWN : CIA402_CW_DISABLE_VOLTAGE;
+    case CIA402_READY_TO_SWITCH_ON:
+        return enable ? CIA402_CW_SWITCH_ON : CIA402_CW_DISABLE_VOLTAGE;
+    case CIA402_SWITCHED_ON:
+        return enable ? CIA402_CW_ENABLE_OPERATION : CIA402_CW_DISABLE_VOLTAGE;
+    case CIA402_OPERATION_ENABLED:
+        if (enable) return CIA402_CW_ENABLE_OPERATION;
+        // controlled ramp down: quick stop, or disable operation before removing voltage
+        return sm->target == CIA402_TARGET_QUICK_STOP ? CIA402_CW_QUICK_STOP : CIA402_CW_DISABLE_OPERATION;
+    case CIA402_QUICK_STOP_ACTIVE:
+        // hold quick stop; leaving it goes through switch on disabled
+        return sm->target == CIA402_TARGET_QUICK_STOP ? CIA402_CW_QUICK_STOP : CIA402_CW_DISABLE_VOLTAGE;
+    default:    // not ready / fault reaction: the drive moves on by itself
+        return CIA402_CW_DISABLE_VOLTAGE;
+    }
+}
+
+uint16_t cia402_update(cia402_t *sm, uint16_t statusword, int64_t now_ns) {
+    cia402_state_t st = cia402_decode(statusword);
+
+    sm->statusword = statusword;
+    sm->request_cycles++;
+    if (st != sm->state) {
+        enter(sm, st, statusword, now_ns);
+        if (st == CIA402_OPERATION_ENABLED && sm->target == CIA402_TARGET_ENABLED && sm->enable_ns < 0) {
+            sm->enable_ns = now_ns - sm->request_ns;
+            sm->enable_cycles = (int64_t)sm->request_cycles;
+        }
+    } else if (!at_target(sm) && st != CIA402_FAULT && now_ns - sm->state_since_ns > sm->timeout_ns) {
+        sm->error |= CIA402_ERR_TIMEOUT;
+    }
+    sm->controlword = next_controlword(sm, now_ns);
+    return sm->controlword;
+}
@@ -0,0 +1,106 @@
+// cia402.h
+// CiA402 power state machine driven from the cyclic task.
+// - Every cycle the drive state is decoded from the 0x6041 statusword of the last received frame
+//   and the 0x6040 controlword for the next frame is chosen from it, so each transition is
+//   confirmed by the drive before the next command goes out (no fixed Sleep() between steps).
+// - Targets: disabled (switch on disabled), enabled (operation enabled) or quick stop.
+// - Faults are acknowledged with a 0 -> 1 edge on the fault-reset bit, up to max_fault_resets times.
+// - Reports the time spent in every state on the way up, the request-to-enabled latency in ns
+//   and bus cycles, and keeps a short log of the last transitions.
+// Pure computation: no SOEM calls, the caller moves the words through the PDO.
+
+#ifndef CIA402_H
+#define CIA402_H
+
+#include <stdint.h>
+
+// Controlword commands
+#define CIA402_CW_DISABLE_VOLTAGE   0x0000
+#define CIA402_CW_QUICK_STOP        0x0002
+#define CIA402_CW_SHUTDOWN          0x0006
+#define CIA402_CW_SWITCH_ON         0x0007
+#define CIA402_CW_DISABLE_OPERATION 0x0007
+#define CIA402_CW_ENABLE_OPERATION  0x000F
+#define CIA402_CW_FAULT_RESET       0x0080
+
+// Defaults
+#define CIA402_TIMEOUT_NS       500000000LL // a state not left within this time raises CIA402_ERR_TIMEOUT
+#define CIA402_MAX_FAULT_RESETS 3
+#define CIA402_RESET_HOLD_NS    20000000LL  // fault-reset bit held this long per attempt
+#define CIA402_LOG_SIZE         16          // transitions kept in the log, power of two
+#define CIA402_STANDSTILL       5           // |0x606C| at or below this is standstill (rpm on the L7NH)
+#define CIA402_VELOCITY_UNKNOWN INT32_MAX   // actual velocity not available (0x606C not in the PDO)
+
+typedef enum {
+    CIA402_NOT_READY = 0,
+    CIA402_SWITCH_ON_DISABLED,
+    CIA402_READY_TO_SWITCH_ON,
+    CIA402_SWITCHED_ON,
+    CIA402_OPERATION_ENABLED,
+    CIA402_QUICK_STOP_ACTIVE,
+    CIA402_FAULT_REACTION,
+    CIA402_FAULT,
+    CIA402_STATE_COUNT
+} cia402_state_t;
+
+typedef enum {
+    CIA402_TARGET_DISABLED = 0,
+    CIA402_TARGET_ENABLED,
+    CIA402_TARGET_QUICK_STOP
+} cia402_target_t;
+
+// Error flags
+#define CIA402_ERR_TIMEOUT      0x01    // a state was not left within timeout_ns
+#define CIA402_ERR_FAULT        0x02    // fault persisted after max_fault_resets attempts
+
+typedef struct {
+    int64_t at_ns;
+    uint16_t statusword;
+    uint8_t from;
+    uint8_t to;
+} cia402_transition_t;
+
+typedef struct {
+    cia402_target_t target;
+    cia402_state_t state;
+    uint16_t statusword;
+    uint16_t controlword;
+    int64_t timeout_ns;
+    int max_fault_resets;
+
+    int64_t state_since_ns;             // entry time of the current state
+    int64_t request_ns;                 // time of the last cia402_command()
+    uint64_t request_cycles;            // cycles since the last cia402_command()
+    int64_t state_ns[CIA402_STATE_COUNT];   // time spent in each state since the last command
+    int64_t enable_ns;                  // request -> operation enabled (-1 while not reached)
+    int64_t enable_cycles;              // same, in cycles (-1 while not reached)
+    int fault_resets;                   // reset attempts since the last command
+    int64_t reset_ns;                   // start of the current fault-reset pulse
+    uint32_t error;                     // CIA402_ERR_*
+
+    cia402_transition_t log[CIA402_LOG_SIZE];
+    uint32_t log_count;                 // total transitions (log holds the last CIA402_LOG_SIZE)
+} cia402_t;
+
+void cia402_init(cia402_t *sm);
+
+// Set the target state. Resets the per-request statistics.
+void cia402_command(cia402_t *sm, cia402_target_t target, int64_t now_ns);
+
+// Decode a statusword.
+cia402_state_t cia402_decode(uint16_t statusword);
+
+// One cycle: feed the received statusword, get the controlword to send.
+uint16_t cia402_update(cia402_t *sm, uint16_t statusword, int64_t now_ns);
+
+// Target reached (and, for the enabled target, torque may be applied).
+static inline int cia402_enabled(const cia402_t *sm) {
+    return sm->state == CIA402_OPERATION_ENABLED && sm->target == CIA402_TARGET_ENABLED;
+}
+// Target reached. A quick stop is only reached at standstill: in switch on disabled, or in quick stop
+// active with |actual_velocity| <= CIA402_STANDSTILL; the drive is still braking before that.
+int cia402_reached(const cia402_t *sm, int32_t actual_velocity);
+
+const char *cia402_state_name(cia402_state_t state);
+
+#endif // CIA402_H
@@ -0,0 +1,80 @@
+// ec_atomic.h
+// Minimal acquire/release atomics for the lock-free channels between the cyclic thread and the
+// rest of the program. C99 has no <stdatomic.h>, so map onto compiler intrinsics:
+// - GCC/Clang: __atomic builtins.
+// - MSVC: plain volatile access plus compiler barrier (x86/x64 are TSO), DMB on ARM64,
+//   Interlocked* for read-modify-write.
+
+#ifndef EC_ATOMIC_H
+#define EC_ATOMIC_H
+
+#include <stdint.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#if defined(_M_ARM64)
+#define EC_ATOMIC_FENCE() __dmb(_ARM64_BARRIER_ISH)
+#else
+#define EC_ATOMIC_FENCE() _ReadWriteBarrier()
+#endif
+
+static __inline uint32_t ec_atomic_load_u32(const volatile uint32_t *p) {
+    uint32_t v = *p;
+    EC_ATOMIC_FENCE();
+    return v;
+}
+static __inline void ec_atomic_store_u32(volatile uint32_t *p, uint32_t v) {
+    EC_ATOMIC_FENCE();
+    *p = v;
+}
+static __inline uint64_t ec_atomic_load_u64(const volatile uint64_t *p) {
+    return (uint64_t)_InterlockedCompareExchange64((volatile __int64 *)p, 0, 0);
+}
+static __inline void ec_atomic_store_u64(volatile uint64_t *p, uint64_t v) {
+    _InterlockedExchange64((volatile __int64 *)p, (__int64)v);
+}
+static __inline uint64_t ec_atomic_add_u64(volatile uint64_t *p, uint64_t v) {
+    return (uint64_t)_InterlockedExchangeAdd64((volatile __int64 *)p, (__int64)v);
+}
+static __inline uint32_t ec_atomic_add_u32(volatile uint32_t *p, uint32_t v) {
+    return (uint32_t)_InterlockedExchangeAdd((volatile long *)p, (long)v);
+}
+// Returns 1 if *p was 'expected' and is now 'desired'.
+static __inline int ec_atomic_cas_u32(volatile uint32_t *p, uint32_t expected, uint32_t desired) {
+    return (uint32_t)_InterlockedCompareExchange((volatile long *)p, (long)desired, (long)expected) == expected;
+}
+static __inline void ec_atomic_thread_fence(void) {
+    MemoryBarrier();
+}
+
+#else
+
+static inline uint32_t ec_atomic_load_u32(const volatile uint32_t *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+static inline void ec_atomic_store_u32(volatile uint32_t *p, uint32_t v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+static inline uint64_t ec_atomic_load_u64(const volatile uint64_t *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+static inline void ec_atomic_store_u64(volatile uint64_t *p, uint64_t v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+static inline uint64_t ec_atomic_add_u64(volatile uint64_t *p, uint64_t v) {
+    return __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+}
+static inline uint32_t ec_atomic_add_u32(volatile uint32_t *p, uint32_t v) {
+    return __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+}
+// Returns 1 if *p was 'expected' and is now 'desired'.
+static inline int ec_atomic_cas_u32(volatile uint32_t *p, uint32_t expected, uint32_t desired) {
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+static inline void ec_atomic_thread_fence(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif
+
+#endif // EC_ATOMIC_H
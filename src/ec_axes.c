@@ -0,0 +1,138 @@
+// ec_axes.c
+// Multi-axis struct-of-arrays process image (see ec_axes.h).
+
+#include "ec_axes.h"
+
+#include <string.h>
+
+#include "ethercat.h"
+
+static const ec_pdo_obj_t out_objs[] = { PDO_CONTROLWORD, PDO_TARGET_TORQUE, PDO_MODE_OF_OPERATION };
+static const ec_pdo_obj_t in_objs[] = { PDO_STATUSWORD, PDO_ACTUAL_VELOCITY, PDO_ACTUAL_TORQUE,
+                                        PDO_ACTUAL_POSITION, PDO_ERROR_CODE };
+#define N_OBJS(t) ((int)(sizeof(t) / sizeof((t)[0])))
+
+// Uniform layout: every object of every axis is mapped and sits at a constant distance from the
+// same object of the previous axis (one stride for outputs, one for inputs).
+static int check_uniform(ec_axes_t *ax, const ec_pdo_obj_t *objs, int n, ptrdiff_t *stride) {
+    *stride = ax->count > 1 ? ax->ptr[objs[0]][1] - ax->ptr[objs[0]][0] : 0;
+    for (int k = 0; k < n; k++) {
+        ec_pdo_obj_t o = objs[k];
+        if (!ec_axes_has(ax, o)) return 0;
+        for (int i = 1; i < ax->count; i++) {
+            if (ax->ptr[o][i] - ax->ptr[o][i - 1] != *stride) return 0;
+        }
+        ax->base[o] = ax->ptr[o][0];
+    }
+    return 1;
+}
+
+// Per-object pointer tables and the strided fast path of the axes bound so far.
+static int finish_binding(ec_axes_t *ax) {
+    ax->mapped_all = ax->count ? ~0u : 0;
+    for (int i = 0; i < ax->count; i++) {
+        ax->mapped_all &= ax->map[i].mapped;
+        for (int o = 0; o < PDO_OBJ_COUNT; o++) ax->ptr[o][i] = ax->map[i].obj[o];
+    }
+    ax->uniform = ax->count > 0 &&
+                  check_uniform(ax, out_objs, N_OBJS(out_objs), &ax->stride_out) &&
+                  check_uniform(ax, in_objs, N_OBJS(in_objs), &ax->stride_in);
+    return ax->count;
+}
+
+int ec_axes_discover(ec_axes_t *ax, uint32_t vendor) {
+    return ec_axes_discover_ctx(&ecx_context, ax, vendor);
+}
+
+int ec_axes_discover_ctx(ecx_contextt *context, ec_axes_t *ax, uint32_t vendor) {
+    memset(ax, 0, sizeof(*ax));
+    for (int s = 1; s <= *context->slavecount && ax->count < EC_AXES_MAX; s++) {
+        ec_pdomap_t *map = &ax->map[ax->count];
+        if (vendor != EC_AXES_ANY_VENDOR && context->slavelist[s].eep_man != vendor) continue;
+        if (ec_pdomap_discover_ctx(context, map, (uint16_t)s) != 0) continue;
+        if (!ec_pdomap_has(map, PDO_CONTROLWORD) || !ec_pdomap_has(map, PDO_STATUSWORD)) continue;
+        ax->slave[ax->count] = (uint16_t)s;
+        cia402_init(&ax->sm[ax->count]);
+        ax->count++;
+    }
+    return finish_binding(ax);
+}
+
+int ec_axes_bind_ctx(ecx_contextt *context, ec_axes_t *ax, const ec_pdomap_t *maps, int count) {
+    memset(ax, 0, sizeof(*ax));
+    if (count < 0 || count > EC_AXES_MAX) return -1;
+    for (int i = 0; i < count; i++) {
+        ec_pdomap_t *map = &ax->map[i];
+        *map = maps[i];
+        map->context = context;
+        if (ec_pdomap_bind(map) != 0 || !ec_pdomap_has(map, PDO_CONTROLWORD) || !ec_pdomap_has(map, PDO_STATUSWORD)) {
+            memset(ax, 0, sizeof(*ax));
+            return -1;
+        }
+        ax->slave[i] = map->slave;
+        cia402_init(&ax->sm[i]);
+    }
+    ax->count = count;
+    return finish_binding(ax);
+}
+
+void ec_axes_unpack(ec_axes_t *ax) {
+    const int n = ax->count;
+
+    if (ax->uniform) {
+        const ptrdiff_t st = ax->stride_in;
+        const uint8_t *sw = ax->base[PDO_STATUSWORD], *vel = ax->base[PDO_ACTUAL_VELOCITY];
+        const uint8_t *tq = ax->base[PDO_ACTUAL_TORQUE], *pos = ax->base[PDO_ACTUAL_POSITION];
+        const uint8_t *err = ax->base[PDO_ERROR_CODE];
+        for (int i = 0; i < n; i++) {
+            ax->statusword[i] = pdo_get_u16(sw + i * st);
+            ax->actual_velocity[i] = pdo_get_s32(vel + i * st);
+            ax->actual_torque[i] = pdo_get_s16(tq + i * st);
+            ax->actual_position[i] = pdo_get_s32(pos + i * st);
+            ax->error_code[i] = pdo_get_u16(err + i * st);
+        }
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        ax->statusword[i] = pdo_get_u16(ax->ptr[PDO_STATUSWORD][i]);
+        ax->actual_velocity[i] = pdo_get_s32(ax->ptr[PDO_ACTUAL_VELOCITY][i]);
+        ax->actual_torque[i] = pdo_get_s16(ax->ptr[PDO_ACTUAL_TORQUE][i]);
+        ax->actual_position[i] = pdo_get_s32(ax->ptr[PDO_ACTUAL_POSITION][i]);
+        ax->error_code[i] = pdo_get_u16(ax->ptr[PDO_ERROR_CODE][i]);
+    }
+}
+
+void ec_axes_pack(ec_axes_t *ax) {
+    const int n = ax->count;
+
+    if (ax->uniform) {
+        const ptrdiff_t st = ax->stride_out;
+        uint8_t *cw = ax->base[PDO_CONTROLWORD], *tq = ax->base[PDO_TARGET_TORQUE];
+        uint8_t *mode = ax->base[PDO_MODE_OF_OPERATION];
+        for (int i = 0; i < n; i++) {
+            pdo_set_u16(cw + i * st, ax->controlword[i]);
+            pdo_set_s16(tq + i * st, (int16_t)(ax->target_torque[i] * ax->enabled[i]));
+            pdo_set_s8(mode + i * st, ax->mode[i]);
+        }
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        pdo_set_u16(ax->ptr[PDO_CONTROLWORD][i], ax->controlword[i]);
+        pdo_set_s16(ax->ptr[PDO_TARGET_TORQUE][i], (int16_t)(ax->target_torque[i] * ax->enabled[i]));
+        pdo_set_s8(ax->ptr[PDO_MODE_OF_OPERATION][i], ax->mode[i]);
+    }
+}
+
+void ec_axes_command(ec_axes_t *ax, cia402_target_t target, int64_t now_ns) {
+    for (int i = 0; i < ax->count; i++) cia402_command(&ax->sm[i], target, now_ns);
+}
+
+int ec_axes_update(ec_axes_t *ax, int64_t now_ns) {
+    int reached = 0;
+    for (int i = 0; i < ax->count; i++) {
+        ax->controlword[i] = cia402_update(&ax->sm[i], ax->statusword[i], now_ns);
+        ax->enabled[i] = (uint8_t)cia402_enabled(&ax->sm[i]);
+        reached += cia402_reached(&ax->sm[i], ec_axes_velocity(ax, i));
+    }
+    return reached;
+}
@@ -0,0 +1,92 @@
+// ec_axes.h
+// N CiA402 axes discovered at connect time, with a struct-of-arrays process image.
+// - Every axis' controlword, statusword, setpoints and feedback live in one contiguous,
+//   cache-line aligned array per object, indexed by axis. The application works on these arrays;
+//   ec_axes_unpack() / ec_axes_pack() move them from/to the IOmap once per cycle.
+// - When all axes have the same PDO layout and SOEM placed them at a constant distance in the
+//   IOmap (the usual case: identical drives with the same mapping), pack/unpack are strided loops
+//   over base + axis * stride. Otherwise they go through a per-axis pointer table.
+// - Each axis carries its own CiA402 state machine; torque is only packed for enabled axes.
+
+#ifndef EC_AXES_H
+#define EC_AXES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ec_pdomap.h"
+#include "cia402.h"
+
+struct ecx_context;
+
+#define EC_AXES_MAX         64
+#define EC_AXES_CACHELINE   64
+#define EC_AXES_ANY_VENDOR  0
+
+#if defined(_MSC_VER)
+#define EC_AXES_ALIGN __declspec(align(EC_AXES_CACHELINE))
+#else
+#define EC_AXES_ALIGN __attribute__((aligned(EC_AXES_CACHELINE)))
+#endif
+
+typedef struct {
+    int count;
+    uint16_t slave[EC_AXES_MAX];            // ec_slave[] index of each axis
+
+    // process image: outputs (written by the application, packed into the IOmap)
+    EC_AXES_ALIGN uint16_t controlword[EC_AXES_MAX];
+    EC_AXES_ALIGN int16_t target_torque[EC_AXES_MAX];
+    EC_AXES_ALIGN int8_t mode[EC_AXES_MAX];
+    // process image: inputs (unpacked from the IOmap)
+    EC_AXES_ALIGN uint16_t statusword[EC_AXES_MAX];
+    EC_AXES_ALIGN int32_t actual_velocity[EC_AXES_MAX];
+    EC_AXES_ALIGN int16_t actual_torque[EC_AXES_MAX];
+    EC_AXES_ALIGN int32_t actual_position[EC_AXES_MAX];
+    EC_AXES_ALIGN uint16_t error_code[EC_AXES_MAX];
+    // 1 while the axis' state machine reports Operation enabled (gates target_torque)
+    EC_AXES_ALIGN uint8_t enabled[EC_AXES_MAX];
+
+    // IOmap binding
+    int uniform;                            // object o of axis i is at base[o] + i * stride
+    uint8_t *base[PDO_OBJ_COUNT];
+    ptrdiff_t stride_out;
+    ptrdiff_t stride_in;
+    uint8_t *ptr[PDO_OBJ_COUNT][EC_AXES_MAX];
+    uint32_t mapped_all;                    // PDO_OBJ bit set = mapped on every axis
+
+    cia402_t sm[EC_AXES_MAX];
+    ec_pdomap_t map[EC_AXES_MAX];
+} ec_axes_t;
+
+// Discover the PDO layout of every slave from the given vendor (EC_AXES_ANY_VENDOR = all) that maps
+// a controlword and a statusword, and bind them as axes. Call after ec_config_map (the _ctx variant
+// after ecx_config_map_group on that context). Returns the number of axes.
+int ec_axes_discover(ec_axes_t *ax, uint32_t vendor);
+int ec_axes_discover_ctx(struct ecx_context *context, ec_axes_t *ax, uint32_t vendor);
+
+// Same from PDO layouts known without asking the drives (ec_topo.c): maps[i] names the slave of axis i
+// and carries its entries; each is bound against the IOmap of context. Returns the number of axes, or
+// -1 (no axes) if a layout no longer fits the process data sizes SOEM configured.
+int ec_axes_bind_ctx(struct ecx_context *context, ec_axes_t *ax, const ec_pdomap_t *maps, int count);
+
+// Move inputs IOmap -> arrays / outputs arrays -> IOmap.
+void ec_axes_unpack(ec_axes_t *ax);
+void ec_axes_pack(ec_axes_t *ax);
+
+// Set the CiA402 target of every axis.
+void ec_axes_command(ec_axes_t *ax, cia402_target_t target, int64_t now_ns);
+
+// Run the state machines on statusword[] and fill controlword[] / enabled[]. Returns the number of
+// axes that have reached their target.
+int ec_axes_update(ec_axes_t *ax, int64_t now_ns);
+
+static inline int ec_axes_has(const ec_axes_t *ax, ec_pdo_obj_t obj) {
+    return (ax->mapped_all >> obj) & 1u;
+}
+
+// Actual velocity of axis i for cia402_reached(): CIA402_VELOCITY_UNKNOWN without 0x606C in the PDO.
+static inline int32_t ec_axes_velocity(const ec_axes_t *ax, int i) {
+    return ec_axes_has(ax, PDO_ACTUAL_VELOCITY) ? ax->actual_velocity[i] : CIA402_VELOCITY_UNKNOWN;
+}
+
+#endif // EC_AXES_H
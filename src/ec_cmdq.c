@@ -0,0 +1,83 @@
+// ec_cmdq.c
+// Command and status rings of the cyclic thread (see ec_cmdq.h).
+
+#include "ec_cmdq.h"
+
+#include <stddef.h>
+#include <string.h>
+#include "ec_atomic.h"
+
+#define CMD_MASK    (EC_CMDQ_SLOTS - 1)
+#define STATUS_MASK (EC_CMDQ_STATUS_SLOTS - 1)
+
+void ec_cmdq_reset(ec_cmdq_t *q) {
+    ec_atomic_store_u32(&q->tail, ec_atomic_load_u32(&q->head));
+    ec_atomic_store_u32(&q->st_tail, ec_atomic_load_u32(&q->st_head));
+}
+
+uint32_t ec_cmdq_space(const ec_cmdq_t *q) {
+    return EC_CMDQ_SLOTS - (q->head - ec_atomic_load_u32(&q->tail));
+}
+
+int ec_cmdq_push(ec_cmdq_t *q, const ec_cmd_t *cmd, uint32_t n) {
+    uint32_t head = q->head;        // only we write head
+    if (n > ec_cmdq_space(q)) return -1;
+    for (uint32_t k = 0; k < n; k++) q->cmd[(head + k) & CMD_MASK] = cmd[k];
+    ec_atomic_store_u32(&q->head, head + n);    // the whole batch at once
+    return 0;
+}
+
+uint32_t ec_cmdq_pending(const ec_cmdq_t *q) {
+    return ec_atomic_load_u32(&q->head) - q->tail;
+}
+
+void ec_cmdq_release(ec_cmdq_t *q, uint32_t n) {
+    if (n == 0) return;
+    ec_atomic_store_u32(&q->applied, ec_cmdq_at(q, n - 1)->id);
+    ec_atomic_store_u32(&q->tail, q->tail + n);
+}
+
+void ec_cmdq_publish(ec_cmdq_t *q, const ec_axes_t *ax, uint32_t tick, int64_t time_ns, int wkc, uint16_t flags) {
+    uint32_t dec = ec_atomic_load_u32(&q->decimation);
+    if (dec == 0 || tick % dec != 0) return;
+
+    uint32_t head = q->st_head;     // only we write st_head
+    if (head - ec_atomic_load_u32(&q->st_tail) >= EC_CMDQ_STATUS_SLOTS) {
+        ec_atomic_store_u32(&q->dropped, q->dropped + 1);
+        return;
+    }
+    ec_cmdq_status_t *st = &q->status[head & STATUS_MASK];
+    st->tick = tick;
+    st->applied = q->applied;
+    st->time_ns = time_ns;
+    st->wkc = wkc;
+    st->flags = flags;
+    st->axes = (uint16_t)ax->count;
+    for (int i = 0; i < ax->count; i++) {
+        st->statusword[i] = ax->statusword[i];
+        st->target_torque[i] = ax->target_torque[i];
+        st->actual_torque[i] = ax->actual_torque[i];
+        st->velocity[i] = ax->actual_velocity[i];
+        st->position[i] = ax->actual_position[i];
+    }
+    ec_atomic_store_u32(&q->st_head, head + 1);   // publish after the record is written
+}
+
+void ec_cmdq_subscribe(ec_cmdq_t *q, uint32_t decimation) {
+    ec_atomic_store_u32(&q->decimation, decimation);
+}
+
+int ec_cmdq_status(ec_cmdq_t *q, ec_cmdq_status_t *out) {
+    uint32_t tail = q->st_tail;     // only we write st_tail
+    if (tail == ec_atomic_load_u32(&q->st_head)) return 0;
+    const ec_cmdq_status_t *st = &q->status[tail & STATUS_MASK];
+    size_t n = (size_t)st->axes;
+    memcpy(out, st, offsetof(ec_cmdq_status_t, statusword));
+    memcpy(out->statusword, st->statusword, n * sizeof(out->statusword[0]));
+    memcpy(out->target_torque, st->target_torque, n * sizeof(out->target_torque[0]));
+    memcpy(out->actual_torque, st->actual_torque, n * sizeof(out->actual_torque[0]));
+    memcpy(out->velocity, st->velocity, n * sizeof(out->velocity[0]));
+    memcpy(out->position, st->position, n * sizeof(out->position[0]));
+    ec_atomic_store_u32(&q->st_tail, tail + 1);   // release the slot after the copy
+    return 1;
+}
@@ -0,0 +1,94 @@
+// ec_cmdq.h
+// Setpoint commands into a cyclic thread and status records out of it, for a control API served on
+// another thread (l7nh_ctl.c). Both are wait-free single-producer / single-consumer rings as in
+// telemetry.c: fixed slots, free-running head / tail, no allocation, no lock, no syscall.
+// - Commands: the producer writes the entries of a batch and publishes them with one store of head, so
+//   the cyclic thread takes a batch whole, in the cycle that first sees it. A batch that does not fit
+//   is refused whole. The cycle reports the id of the last entry it took as 'applied'.
+// - Status: every 'decimation' cycles (0 = never) the cyclic thread copies the process image of its
+//   axes into the next slot; when the reader fell behind the record is dropped and counted, the cycle
+//   never waits for it.
+
+#ifndef EC_CMDQ_H
+#define EC_CMDQ_H
+
+#include <stdint.h>
+
+#include "ec_axes.h"
+
+#define EC_CMDQ_SLOTS           256     // command entries, power of two
+#define EC_CMDQ_STATUS_SLOTS    64      // status records, power of two
+#define EC_CMDQ_CACHELINE       64
+
+// ec_cmdq_status_t.flags
+#define EC_CMDQ_WKC_OK          0x01    // working counter of the cycle as expected
+#define EC_CMDQ_DROPPED         0x02    // torque dropped after bad frames (ec_wkc.h)
+#define EC_CMDQ_STOPPING        0x04    // the stop ramp has the axes; commands are no longer applied
+
+typedef struct {
+    uint16_t axis;                      // of the segment
+    uint16_t reserved;
+    int32_t value;                      // 0x6071 torque, or rpm for the velocity PI
+    uint32_t id;                        // of the batch
+} ec_cmd_t;
+
+typedef struct {
+    uint32_t tick;                      // deadline index of the cycle
+    uint32_t applied;                   // id of the last command taken up to this cycle
+    int64_t time_ns;                    // cycle wakeup
+    int32_t wkc;
+    uint16_t flags;                     // EC_CMDQ_*
+    uint16_t axes;
+    uint16_t statusword[EC_AXES_MAX];
+    int16_t target_torque[EC_AXES_MAX];
+    int16_t actual_torque[EC_AXES_MAX];
+    int32_t velocity[EC_AXES_MAX];
+    int32_t position[EC_AXES_MAX];
+} ec_cmdq_status_t;
+
+typedef struct {
+    volatile uint32_t head;             // commands: producer
+    uint8_t pad0[EC_CMDQ_CACHELINE - sizeof(uint32_t)];
+    volatile uint32_t tail;             // commands: cyclic thread
+    volatile uint32_t applied;
+    uint8_t pad1[EC_CMDQ_CACHELINE - 2 * sizeof(uint32_t)];
+    ec_cmd_t cmd[EC_CMDQ_SLOTS];
+
+    volatile uint32_t decimation;       // set by the status reader
+    volatile uint32_t st_head;          // status: cyclic thread
+    volatile uint32_t dropped;
+    uint8_t pad2[EC_CMDQ_CACHELINE - 3 * sizeof(uint32_t)];
+    volatile uint32_t st_tail;          // status: reader
+    uint8_t pad3[EC_CMDQ_CACHELINE - sizeof(uint32_t)];
+    ec_cmdq_status_t status[EC_CMDQ_STATUS_SLOTS];
+} ec_cmdq_t;
+
+// While no cycle runs: empty both rings (keeps the decimation).
+void ec_cmdq_reset(ec_cmdq_t *q);
+
+// Producer: free command slots.
+uint32_t ec_cmdq_space(const ec_cmdq_t *q);
+
+// Producer: append n entries as one batch. Returns 0, or -1 if they do not fit (nothing is queued).
+int ec_cmdq_push(ec_cmdq_t *q, const ec_cmd_t *cmd, uint32_t n);
+
+// Cyclic thread: entries published and not taken yet; read them with ec_cmdq_at(q, 0..n-1), then
+// hand them back with ec_cmdq_release(q, n).
+uint32_t ec_cmdq_pending(const ec_cmdq_t *q);
+
+static inline const ec_cmd_t *ec_cmdq_at(const ec_cmdq_t *q, uint32_t k) {
+    return &q->cmd[(q->tail + k) & (EC_CMDQ_SLOTS - 1)];
+}
+
+void ec_cmdq_release(ec_cmdq_t *q, uint32_t n);
+
+// Cyclic thread, once per cycle: a status record when tick is a multiple of the decimation.
+void ec_cmdq_publish(ec_cmdq_t *q, const ec_axes_t *ax, uint32_t tick, int64_t time_ns, int wkc, uint16_t flags);
+
+// Reader: status every 'decimation' cycles from now on (0 = none).
+void ec_cmdq_subscribe(ec_cmdq_t *q, uint32_t decimation);
+
+// Reader: returns 1 and fills out if a status record was waiting.
+int ec_cmdq_status(ec_cmdq_t *q, ec_cmdq_status_t *out);
+
+#endif // EC_CMDQ_H
@@ -0,0 +1,170 @@
+// ec_cycle.c
+// Deadline-driven cyclic engine (see ec_cycle.h).
+
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include "ec_cycle.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <mmsystem.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+// Remaining wait below which we stop trusting the timer and spin on QPC.
+#define EC_CYCLE_SPIN_NS 200000
+#else
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#define NSEC_PER_SEC 1000000000LL
+
+int ec_cycle_valid_period(int64_t period_ns) {
+    return period_ns == EC_CYCLE_1MS || period_ns == EC_CYCLE_500US ||
+           period_ns == EC_CYCLE_250US || period_ns == EC_CYCLE_125US;
+}
+
+#ifdef _WIN32
+
+int64_t ec_cycle_now_ns(void) {
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    // split to avoid overflow of now * 1e9
+    return (now.QuadPart / freq.QuadPart) * NSEC_PER_SEC +
+           (now.QuadPart % freq.QuadPart) * NSEC_PER_SEC / freq.QuadPart;
+}
+
+static void sleep_until(ec_cycle_t *cyc, int64_t deadline_ns) {
+    int64_t remain = deadline_ns - ec_cycle_now_ns();
+    if (remain > EC_CYCLE_SPIN_NS && cyc->timer) {
+        LARGE_INTEGER due;
+        due.QuadPart = -((remain - EC_CYCLE_SPIN_NS) / 100); // relative, 100 ns units
+        if (SetWaitableTimer((HANDLE)cyc->timer, &due, 0, NULL, NULL, FALSE)) {
+            WaitForSingleObject((HANDLE)cyc->timer, INFINITE);
+        }
+    }
+    while (ec_cycle_now_ns() < deadline_ns) {
+        YieldProcessor();
+    }
+}
+
+int ec_cycle_set_realtime(int priority, int cpu) {
+    int ret = 0;
+    (void)priority;
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) ret = -1;
+    if (cpu >= 0 && !SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu)) ret = -1;
+    return ret;
+}
+
+#else
+
+int64_t ec_cycle_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void sleep_until(ec_cycle_t *cyc, int64_t deadline_ns) {
+    struct timespec ts;
+    (void)cyc;
+    ts.tv_sec = (time_t)(deadline_ns / NSEC_PER_SEC);
+    ts.tv_nsec = (long)(deadline_ns % NSEC_PER_SEC);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        // interrupted by a signal: sleep again towards the same absolute deadline
+    }
+}
+
+int ec_cycle_set_realtime(int priority, int cpu) {
+    struct sched_param sp;
+    int ret = 0;
+    memset(&sp, 0, sizeof(sp));
+    sp.sched_priority = priority;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) != 0) ret = -1;
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) ret = -1;
+    }
+    return ret;
+}
+
+#endif
+
+int ec_cycle_init(ec_cycle_t *cyc, int64_t period_ns, ec_cycle_hook_t hook, void *user) {
+    memset(cyc, 0, sizeof(*cyc));
+    if (!ec_cycle_valid_period(period_ns)) return -1;
+    cyc->period_ns = period_ns;
+    cyc->hook = hook;
+    cyc->user = user;
+#ifdef _WIN32
+    cyc->timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!cyc->timer) {
+        // pre-1803 Windows: plain timer, the QPC spin covers the resolution gap
+        cyc->timer = CreateWaitableTimerW(NULL, FALSE, NULL);
+    }
+#endif
+    return 0;
+}
+
+int ec_cycle_run(ec_cycle_t *cyc) {
+    return ec_cycle_run_at(cyc, ec_cycle_now_ns() + cyc->period_ns);
+}
+
+int ec_cycle_run_at(ec_cycle_t *cyc, int64_t start_ns) {
+#ifdef _WIN32
+    timeBeginPeriod(1);
+#endif
+    cyc->running = 1;
+    cyc->start_ns = start_ns;
+    cyc->next_ns = cyc->start_ns;
+
+    while (cyc->running) {
+        sleep_until(cyc, cyc->next_ns);
+        cyc->wake_ns = ec_cycle_now_ns();
+        cyc->last_late_ns = cyc->wake_ns - cyc->next_ns;
+        if (cyc->last_late_ns > cyc->max_late_ns) cyc->max_late_ns = cyc->last_late_ns;
+
+        if (cyc->hook) cyc->hook(cyc, cyc->user);
+        cyc->cycles++;
+
+        cyc->next_ns += cyc->period_ns + cyc->adjust_ns;
+        cyc->adjust_ns = 0;
+        int64_t now = ec_cycle_now_ns();
+        if (now > cyc->next_ns) {
+            // skip the deadlines we already missed instead of bursting to catch up
+            int64_t missed = (now - cyc->next_ns) / cyc->period_ns + 1;
+            cyc->overruns += (uint64_t)missed;
+            cyc->next_ns += missed * cyc->period_ns;
+        }
+    }
+
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif
+    return 0;
+}
+
+void ec_cycle_stop(ec_cycle_t *cyc) {
+    cyc->running = 0;
+}
+
+void ec_cycle_adjust(ec_cycle_t *cyc, int64_t adjust_ns) {
+    cyc->adjust_ns = adjust_ns;
+}
+
+void ec_cycle_destroy(ec_cycle_t *cyc) {
+#ifdef _WIN32
+    if (cyc->timer) CloseHandle((HANDLE)cyc->timer);
+#endif
+    cyc->timer = NULL;
+}
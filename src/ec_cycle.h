@@ -0,0 +1,78 @@
+// ec_cycle.h
+// Deadline-driven cyclic engine for the EtherCAT process-data loop.
+// - Every cycle wakes on an absolute deadline and the deadline is advanced by exactly one period,
+//   so the time spent inside the hook never accumulates into drift (unlike Sleep(n) after the work).
+// - Linux: clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME).
+// - Windows: high-resolution waitable timer for the coarse part of the wait, then a short
+//   QueryPerformanceCounter spin up to the deadline.
+// - Overruns (hook still busy when the next deadline has passed) are counted and the missed
+//   deadlines are skipped so the cycle stays phase-aligned.
+
+#ifndef EC_CYCLE_H
+#define EC_CYCLE_H
+
+#include <stdint.h>
+
+// Supported cycle times (ns)
+#define EC_CYCLE_1MS    1000000
+#define EC_CYCLE_500US  500000
+#define EC_CYCLE_250US  250000
+#define EC_CYCLE_125US  125000
+
+typedef struct ec_cycle ec_cycle_t;
+
+// Application hook, called once per cycle right after the wakeup.
+typedef void (*ec_cycle_hook_t)(ec_cycle_t *cyc, void *user);
+
+struct ec_cycle {
+    int64_t period_ns;
+    ec_cycle_hook_t hook;
+    void *user;
+    volatile int running;
+
+    int64_t start_ns;       // deadline of cycle 0
+    int64_t next_ns;        // absolute deadline of the next wakeup
+    int64_t wake_ns;        // time the current cycle actually woke up
+    int64_t adjust_ns;      // one-shot correction added to the next deadline (DC drift control)
+
+    // statistics (written by the cyclic thread only)
+    uint64_t cycles;
+    uint64_t overruns;      // deadlines missed because the previous cycle ran too long
+    int64_t last_late_ns;   // wakeup lateness of the current cycle
+    int64_t max_late_ns;    // worst wakeup lateness since start
+
+    void *timer;            // Windows waitable timer handle (unused on Linux)
+};
+
+// Returns nonzero if period_ns is one of the supported EC_CYCLE_* values.
+int ec_cycle_valid_period(int64_t period_ns);
+
+// Initialise an engine. Returns 0 on success, -1 for an unsupported period.
+int ec_cycle_init(ec_cycle_t *cyc, int64_t period_ns, ec_cycle_hook_t hook, void *user);
+
+// Run cycles on the calling thread until ec_cycle_stop() is called (from the hook or another thread).
+int ec_cycle_run(ec_cycle_t *cyc);
+
+// Same, with the first deadline at an absolute time (ec_cycle_now_ns base). Engines started with the
+// same start_ns and period wake on the same deadlines, e.g. one per segment.
+int ec_cycle_run_at(ec_cycle_t *cyc, int64_t start_ns);
+
+// Request the engine to return after the current cycle.
+void ec_cycle_stop(ec_cycle_t *cyc);
+
+// Shift the next deadline by adjust_ns (consumed once). Used to slew the master cycle towards the
+// distributed-clock reference; call from the hook.
+void ec_cycle_adjust(ec_cycle_t *cyc, int64_t adjust_ns);
+
+// Release platform resources.
+void ec_cycle_destroy(ec_cycle_t *cyc);
+
+// Monotonic clock in ns (same time base the engine schedules on).
+int64_t ec_cycle_now_ns(void);
+
+// Best-effort real-time setup of the calling thread: priority (1..99 on Linux, ignored scale on
+// Windows -> TIME_CRITICAL) and CPU affinity (cpu < 0 leaves affinity unchanged). Both are attempted;
+// returns 0 if both succeeded, -1 otherwise.
+int ec_cycle_set_realtime(int priority, int cpu);
+
+#endif // EC_CYCLE_H
@@ -0,0 +1,72 @@
+// ec_dcsync.c
+// Distributed-clock SYNC0 activation and master drift control (see ec_dcsync.h).
+// The controller follows the scheme of SOEM's red_test ec_sync(): measure where the frame
+// passed the reference clock inside the DC cycle and nudge the next master deadline so that
+// the phase converges on the configured lead.
+
+#include "ec_dcsync.h"
+
+#include <string.h>
+#include "ethercat.h"
+
+void ec_dcsync_init(ec_dcsync_t *dc, int64_t cycle_ns, int64_t shift_ns) {
+    memset(dc, 0, sizeof(*dc));
+    dc->cycle_ns = cycle_ns;
+    dc->shift_ns = shift_ns;
+    dc->lead_ns = cycle_ns / 2;
+    dc->kp_div = 100;
+    dc->ki_div = 20;
+    dc->max_adjust_ns = cycle_ns / 10;
+    dc->converge_ns = -1;
+    dc->window_ns = EC_DCSYNC_WINDOW_NS;
+    dc->lock_cycles = EC_DCSYNC_LOCK_CYCLES;
+}
+
+int ec_dcsync_enable(ec_dcsync_t *dc, uint16_t slave) {
+    return ec_dcsync_enable_ctx(&ecx_context, dc, slave);
+}
+
+int ec_dcsync_enable_ctx(ecx_contextt *context, ec_dcsync_t *dc, uint16_t slave) {
+    if (!context->slavelist[slave].hasdc) return -1;
+    ecx_dcsync0(context, slave, TRUE, (uint32)dc->cycle_ns, (int32)dc->shift_ns);
+    return 0;
+}
+
+void ec_dcsync_disable(uint16_t slave) {
+    ec_dcsync_disable_ctx(&ecx_context, slave);
+}
+
+void ec_dcsync_disable_ctx(ecx_contextt *context, uint16_t slave) {
+    ecx_dcsync0(context, slave, FALSE, 0, 0);
+}
+
+int64_t ec_dcsync_update(ec_dcsync_t *dc, int64_t dctime, int64_t now_ns) {
+    int64_t delta, adj;
+
+    if (dc->start_ns == 0) dc->start_ns = now_ns;
+
+    // phase of the frame relative to the point lead_ns before SYNC0, wrapped to +-cycle/2
+    delta = (dctime - dc->shift_ns + dc->lead_ns) % dc->cycle_ns;
+    if (delta < 0) delta += dc->cycle_ns;
+    if (delta > dc->cycle_ns / 2) delta -= dc->cycle_ns;
+    dc->offset_ns = delta;
+
+    if (delta > 0) dc->integral++;
+    if (delta < 0) dc->integral--;
+
+    adj = -(delta / dc->kp_div) - (dc->integral / dc->ki_div);
+    if (adj > dc->max_adjust_ns) adj = dc->max_adjust_ns;
+    if (adj < -dc->max_adjust_ns) adj = -dc->max_adjust_ns;
+    dc->adjust_ns = adj;
+
+    if (delta < dc->window_ns && delta > -dc->window_ns) {
+        if (dc->locked_count < dc->lock_cycles) dc->locked_count++;
+        if (!dc->converged && dc->locked_count >= dc->lock_cycles) {
+            dc->converged = 1;
+            dc->converge_ns = now_ns - dc->start_ns;
+        }
+    } else {
+        dc->locked_count = 0;
+    }
+    return adj;
+}
@@ -0,0 +1,59 @@
+// ec_dcsync.h
+// Distributed-clock synchronous operation.
+// - Activates SYNC0 on a DC-capable slave with a configurable shift (ec_dcsync0).
+// - Runs a PI loop that slews the master cycle so frames leave at a fixed phase of the
+//   reference clock (ec_DCtime, updated by every ec_receive_processdata).
+// - Reports the current phase offset and the time it took to converge into the lock window.
+
+#ifndef EC_DCSYNC_H
+#define EC_DCSYNC_H
+
+#include <stdint.h>
+
+struct ecx_context;
+
+// Defaults
+#define EC_DCSYNC_SHIFT_NS      0       // extra SYNC0 shift relative to the DC cycle start
+#define EC_DCSYNC_WINDOW_NS     5000    // |offset| inside this window counts as locked
+#define EC_DCSYNC_LOCK_CYCLES   100     // consecutive locked cycles before we report convergence
+
+typedef struct {
+    int64_t cycle_ns;       // bus cycle (SYNC0 period)
+    int64_t shift_ns;       // SYNC0 shift programmed into the slave
+    int64_t lead_ns;        // frame passes the reference clock this long before SYNC0 (default cycle/2)
+
+    // PI controller (integer gains: correction = -offset/kp_div - integral/ki_div)
+    int64_t kp_div;
+    int64_t ki_div;
+    int64_t integral;
+    int64_t max_adjust_ns;  // clamp on the per-cycle slew
+
+    // reported values
+    int64_t offset_ns;      // last measured phase offset, wrapped to +-cycle/2
+    int64_t adjust_ns;      // last correction handed to the cyclic engine
+    int64_t start_ns;       // time of the first update
+    int64_t converge_ns;    // time from first update to lock, -1 while not converged
+    int locked_count;
+    int converged;
+
+    int64_t window_ns;
+    int lock_cycles;
+} ec_dcsync_t;
+
+// Initialise controller state for the given cycle and SYNC0 shift.
+void ec_dcsync_init(ec_dcsync_t *dc, int64_t cycle_ns, int64_t shift_ns);
+
+// Activate SYNC0 on slave (call after ec_configdc(), before requesting OP).
+// Returns 0 on success, -1 if the slave has no distributed clock.
+int ec_dcsync_enable(ec_dcsync_t *dc, uint16_t slave);
+int ec_dcsync_enable_ctx(struct ecx_context *context, ec_dcsync_t *dc, uint16_t slave);
+
+// Deactivate SYNC0 on slave.
+void ec_dcsync_disable(uint16_t slave);
+void ec_dcsync_disable_ctx(struct ecx_context *context, uint16_t slave);
+
+// Feed the reference time of the last received frame (ec_DCtime) and the local monotonic time.
+// Returns the correction (ns) to apply to the next master deadline (ec_cycle_adjust).
+int64_t ec_dcsync_update(ec_dcsync_t *dc, int64_t dctime, int64_t now_ns);
+
+#endif // EC_DCSYNC_H
@@ -0,0 +1,96 @@
+// ec_health.c
+// Slave supervision of a running segment (see ec_health.h).
+
+#include "ec_health.h"
+#include "ec_atomic.h"
+#include "ec_cycle.h"
+
+#include <string.h>
+
+void ec_health_init(ec_health_t *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+void ec_health_cycle(ec_health_t *h, int wkc, int expected_wkc) {
+    if (wkc < expected_wkc && !h->check) ec_atomic_store_u32(&h->check, 1);
+}
+
+static void went_down(ec_health_t *h, ec_health_slave_t *hs, int64_t now) {
+    hs->down_ns = now;
+    ec_atomic_store_u32(&hs->lost, hs->lost + 1);
+    ec_atomic_store_u32(&hs->down, 1);
+    ec_atomic_store_u32(&h->down, h->down + 1);
+    ec_atomic_store_u32(&h->changes, h->changes + 1);
+}
+
+static void came_back(ec_health_t *h, ec_health_slave_t *hs, int64_t now) {
+    uint64_t took = (uint64_t)(now - hs->down_ns);
+    ec_atomic_store_u64(&hs->last_recovery_ns, took);
+    if (took > hs->max_recovery_ns) ec_atomic_store_u64(&hs->max_recovery_ns, took);
+    ec_atomic_store_u32(&hs->recovered, hs->recovered + 1);
+    ec_atomic_store_u32(&hs->down, 0);
+    ec_atomic_store_u32(&h->down, h->down - 1);
+    ec_atomic_store_u32(&h->changes, h->changes + 1);
+}
+
+// ecatcheck for one slave, on the state of the last ecx_readstate.
+static void check_slave(ec_health_t *h, ecx_contextt *context, uint16 s) {
+    ec_slavet *sl = &context->slavelist[s];
+    ec_health_slave_t *hs = &h->slave[s];
+    int64_t now = ec_cycle_now_ns();
+
+    hs->state = sl->state;
+    hs->al_status = sl->ALstatuscode;
+    if (sl->state == EC_STATE_OPERATIONAL && !sl->islost) {
+        if (hs->down) came_back(h, hs, now);
+        return;
+    }
+    context->grouplist[sl->group].docheckstate = TRUE;
+    if (!hs->down) went_down(h, hs, now);
+
+    if (sl->state == EC_STATE_SAFE_OP + EC_STATE_ERROR) {
+        sl->state = EC_STATE_SAFE_OP + EC_STATE_ACK;
+        ecx_writestate(context, s);
+    } else if (sl->state == EC_STATE_SAFE_OP) {
+        sl->state = EC_STATE_OPERATIONAL;
+        ecx_writestate(context, s);
+    } else if (sl->state > EC_STATE_NONE) {
+        if (ecx_reconfig_slave(context, s, EC_TIMEOUTMON) == EC_STATE_SAFE_OP) {
+            sl->islost = FALSE;
+            ec_atomic_store_u32(&hs->reconfigured, hs->reconfigured + 1);
+        }
+    } else if (!sl->islost) {
+        ecx_statecheck(context, s, EC_STATE_OPERATIONAL, EC_TIMEOUTRET);
+        if (sl->state == EC_STATE_NONE) sl->islost = TRUE;
+    }
+    if (sl->islost && (sl->state != EC_STATE_NONE || ecx_recover_slave(context, s, EC_TIMEOUTMON))) {
+        sl->islost = FALSE;     // answering again; the next step configures it
+    }
+}
+
+int ec_health_step(ec_health_t *h, ecx_contextt *context, int64_t slice_ns) {
+    ec_groupt *grp = &context->grouplist[0];
+    int n = *context->slavecount;
+    int64_t t0 = ec_cycle_now_ns(), took;
+
+    if (h->next == 0) {
+        if (!ec_atomic_load_u32(&h->check) && !grp->docheckstate && !h->down) return 0;
+        ec_atomic_store_u32(&h->check, 0);
+        grp->docheckstate = FALSE;
+        ecx_readstate(context);
+        h->next = 1;
+    }
+    h->steps++;
+    while (h->next <= n && ec_cycle_now_ns() - t0 < slice_ns) {
+        check_slave(h, context, (uint16)h->next);
+        h->next++;
+    }
+    took = ec_cycle_now_ns() - t0;
+    if (took > h->max_step_ns) h->max_step_ns = took;
+    if (h->next <= n) {
+        h->carried++;
+        return 1;
+    }
+    h->next = 0;
+    return 0;
+}
@@ -0,0 +1,65 @@
+// ec_health.h
+// Slave supervision of a running segment, after the ecatcheck thread of SOEM's examples.
+// - The cyclic thread only raises flags: ec_health_cycle() asks for a check when the working counter
+//   comes back short. It reads back which slaves are out (down) and takes their axes off torque while
+//   every other axis keeps running (ec_segment.c).
+// - ec_health_step() runs on the supervisor thread of the group: ecx_readstate, then for every slave
+//   out of OP the ecatcheck ladder: acknowledge SAFE-OP + ERROR, request OP from SAFE-OP,
+//   ecx_reconfig_slave from INIT / PRE-OP (the PO2SOconfigx hook programs the mapping a power cycle
+//   lost), ecx_recover_slave for a slave that stopped answering. A slave stays down until it is back
+//   in OP.
+// - The acyclic frames of a step go out between the cyclic ones. A step ends once it has spent
+//   slice_ns and carries the remaining slaves over to the next interval, so it takes a slice plus the
+//   check of one slave. That check is short (EC_TIMEOUTRET / EC_TIMEOUTMON per call) except for a
+//   reconfiguration: ecx_reconfig_slave waits for INIT, PRE-OP and SAFE-OP with EC_TIMEOUTSAFE each,
+//   and its PO2SOconfigx hook writes the mapping by blocking SDOs (EC_TIMEOUTRXM each). A drive that
+//   comes back slowly can hold the supervisor thread for seconds, and the checks of the other segments
+//   of its group wait that long; their cyclic threads are not affected.
+// - Per slave: outages, recoveries, reconfigurations and the time from detecting an outage to OP.
+
+#ifndef EC_HEALTH_H
+#define EC_HEALTH_H
+
+#include <stdint.h>
+
+#include "ethercat.h"
+
+#define EC_HEALTH_INTERVAL_NS   10000000LL  // supervisor period (ecatcheck sleeps 10 ms)
+#define EC_HEALTH_SLICE_NS      1000000LL   // default acyclic work per segment and interval
+
+typedef struct {
+    // written by the supervisor
+    volatile uint32_t down;             // out of OP: from detection until back in OP
+    volatile uint32_t lost;             // outages (left OP or stopped answering)
+    volatile uint32_t recovered;        // outages that ended in OP
+    volatile uint32_t reconfigured;     // came back in INIT / PRE-OP and were configured again
+    volatile uint64_t last_recovery_ns; // detection -> OP of the last outage
+    volatile uint64_t max_recovery_ns;
+    int64_t down_ns;                    // detection of the current outage
+    uint16_t state;                     // AL state at the last check
+    uint16_t al_status;                 // AL status code at the last check
+} ec_health_slave_t;
+
+typedef struct {
+    volatile uint32_t check;            // set by the cyclic thread: working counter short
+    volatile uint32_t changes;          // bumped whenever a slave goes down or comes back
+    volatile uint32_t down;             // slaves down
+
+    // supervisor only
+    int next;                           // slave the next step resumes with, 0 = start a new check
+    uint64_t steps;                     // steps that checked anything
+    uint64_t carried;                   // steps that ran out of their slice
+    int64_t max_step_ns;                // longest step
+    ec_health_slave_t slave[EC_MAXSLAVE];   // [0] unused, like ec_slave[]
+} ec_health_t;
+
+void ec_health_init(ec_health_t *h);
+
+// Account one cycle (cyclic thread). wkc may be EC_NOFRAME.
+void ec_health_cycle(ec_health_t *h, int wkc, int expected_wkc);
+
+// One supervisor step on the context of the segment (supervisor thread). Does nothing while every
+// slave is in OP and no check was asked for. Returns 1 if slaves are left for the next step.
+int ec_health_step(ec_health_t *h, struct ecx_context *context, int64_t slice_ns);
+
+#endif // EC_HEALTH_H
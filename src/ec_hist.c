@@ -0,0 +1,112 @@
+// ec_hist.c
+// Lock-free log-bucketed latency histograms (see ec_hist.h).
+
+#include "ec_hist.h"
+#include "ec_atomic.h"
+
+#include <string.h>
+
+#define SUB         (1 << EC_HIST_SUB_BITS)
+
+static const char *const metric_names[EC_HIST_COUNT] = { "wake", "exchange", "app", "total" };
+
+const char *ec_hist_metric_name(ec_hist_metric_t m) {
+    return (unsigned)m < EC_HIST_COUNT ? metric_names[m] : "?";
+}
+
+static int msb64(uint64_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long i;
+    _BitScanReverse64(&i, v);
+    return (int)i;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+static int bucket_of(uint64_t v) {
+    if (v < SUB) return (int)v;
+    int shift = msb64(v) - EC_HIST_SUB_BITS;
+    int b = (shift + 1) * SUB + (int)((v >> shift) & (SUB - 1));
+    return b < EC_HIST_BUCKETS ? b : EC_HIST_BUCKETS - 1;
+}
+
+static uint64_t bucket_low(int b) {
+    if (b < SUB) return (uint64_t)b;
+    int shift = b / SUB - 1;
+    return (uint64_t)(SUB + b % SUB) << shift;
+}
+
+static uint64_t bucket_high(int b) {
+    return b < SUB ? (uint64_t)b : bucket_low(b) + ((uint64_t)1 << (b / SUB - 1)) - 1;
+}
+
+void ec_hist_init(ec_hist_t *h) {
+    memset((void *)h, 0, sizeof(*h));
+}
+
+void ec_hist_record(ec_hist_t *h, int64_t value_ns) {
+    uint32_t req = ec_atomic_load_u32(&h->reset_req);
+    uint64_t v = value_ns > 0 ? (uint64_t)value_ns : 0;
+    int b = bucket_of(v);
+
+    if (req != h->reset_done) {
+        for (int i = 0; i < EC_HIST_BUCKETS; i++) ec_atomic_store_u32(&h->bucket[i], 0);
+        ec_atomic_store_u64(&h->sum, 0);
+        ec_atomic_store_u64(&h->max, 0);
+        ec_atomic_store_u64(&h->count, 0);
+        h->reset_done = req;
+    }
+    ec_atomic_store_u32(&h->bucket[b], h->bucket[b] + 1);
+    ec_atomic_store_u64(&h->sum, h->sum + v);
+    if (v > h->max) ec_atomic_store_u64(&h->max, v);
+    ec_atomic_store_u64(&h->count, h->count + 1);
+}
+
+void ec_hist_reset(ec_hist_t *h) {
+    ec_atomic_add_u32(&h->reset_req, 1);
+}
+
+void ec_hist_snapshot(const ec_hist_t *h, ec_hist_snap_t *snap) {
+    snap->count = 0;
+    for (int i = 0; i < EC_HIST_BUCKETS; i++) {
+        snap->bucket[i] = ec_atomic_load_u32(&h->bucket[i]);
+        snap->count += snap->bucket[i];
+    }
+    snap->sum = (int64_t)ec_atomic_load_u64(&h->sum);
+    snap->max = (int64_t)ec_atomic_load_u64(&h->max);
+}
+
+int64_t ec_hist_percentile(const ec_hist_snap_t *snap, int per_mille) {
+    uint64_t rank = (snap->count * (uint64_t)per_mille + 999) / 1000, seen = 0;
+
+    if (snap->count == 0) return 0;
+    if (rank == 0) rank = 1;
+    for (int b = 0; b < EC_HIST_BUCKETS; b++) {
+        seen += snap->bucket[b];
+        if (seen >= rank) {
+            int64_t high = (int64_t)bucket_high(b);
+            return high < snap->max ? high : snap->max;
+        }
+    }
+    return snap->max;
+}
+
+uint64_t ec_hist_above(const ec_hist_snap_t *snap, int64_t threshold_ns) {
+    uint64_t n = 0;
+    for (int b = EC_HIST_BUCKETS - 1; b >= 0 && (int64_t)bucket_low(b) > threshold_ns; b--) n += snap->bucket[b];
+    return n;
+}
+
+void ec_hist_summarize(const ec_hist_t *h, int64_t threshold_ns, ec_hist_summary_t *sum) {
+    ec_hist_snap_t snap;
+
+    ec_hist_snapshot(h, &snap);
+    sum->count = snap.count;
+    sum->mean = snap.count ? snap.sum / (int64_t)snap.count : 0;
+    sum->p50 = ec_hist_percentile(&snap, 500);
+    sum->p99 = ec_hist_percentile(&snap, 990);
+    sum->p999 = ec_hist_percentile(&snap, 999);
+    sum->max = snap.max;
+    sum->over = ec_hist_above(&snap, threshold_ns);
+}
@@ -0,0 +1,74 @@
+// ec_hist.h
+// Log-bucketed latency histograms recorded inside the cyclic task.
+// - Buckets: exact below 8 ns, then 8 buckets per power of two (<= 12.5 % relative width); the 256
+//   buckets reach 2^34 ns (~17.2 s), and values from 15 * 2^30 ns (~16.1 s) up, larger ones included,
+//   land in the last bucket. One record is a bucket index, three stores and no divisions.
+// - Single writer (the cyclic thread), any number of readers: every field is written with a release
+//   store and read with acquire loads, so a snapshot never blocks the cycle. Buckets read a few
+//   records apart are fine for percentiles; the snapshot counts what it actually copied.
+// - Reset from any thread only raises a request; the writer clears the histogram on its next record,
+//   so there is never a second writer.
+
+#ifndef EC_HIST_H
+#define EC_HIST_H
+
+#include <stdint.h>
+
+#define EC_HIST_SUB_BITS    3
+#define EC_HIST_BUCKETS     256
+
+typedef struct {
+    volatile uint32_t bucket[EC_HIST_BUCKETS];
+    volatile uint64_t count;
+    volatile uint64_t sum;
+    volatile uint64_t max;
+    volatile uint32_t reset_req;    // bumped by ec_hist_reset()
+    uint32_t reset_done;            // writer's copy of reset_req
+} ec_hist_t;
+
+typedef struct {
+    uint64_t count;
+    int64_t sum;
+    int64_t max;
+    uint32_t bucket[EC_HIST_BUCKETS];
+} ec_hist_snap_t;
+
+typedef struct {
+    uint64_t count;
+    int64_t mean, p50, p99, p999, max;
+    uint64_t over;                  // samples certainly above the threshold given to ec_hist_summarize
+} ec_hist_summary_t;
+
+// The per-cycle quantities the cyclic task records.
+typedef enum {
+    EC_HIST_WAKE,                   // wakeup lateness against the deadline
+    EC_HIST_EXCHANGE,               // ec_send_processdata -> ec_receive_processdata
+    EC_HIST_APP,                    // application compute (unpack .. pack, without barrier waits)
+    EC_HIST_TOTAL,                  // deadline -> end of the cycle's work
+    EC_HIST_COUNT
+} ec_hist_metric_t;
+
+const char *ec_hist_metric_name(ec_hist_metric_t m);
+
+void ec_hist_init(ec_hist_t *h);
+
+// Writer side (cyclic thread). Negative values count as 0.
+void ec_hist_record(ec_hist_t *h, int64_t value_ns);
+
+// Any thread: request a reset, carried out by the writer on its next record.
+void ec_hist_reset(ec_hist_t *h);
+
+// Any thread.
+void ec_hist_snapshot(const ec_hist_t *h, ec_hist_snap_t *snap);
+
+// Nearest-rank percentile (per_mille 500 = median, 999 = p99.9) of a snapshot: upper edge of the
+// bucket that holds the rank, at most the recorded maximum. 0 for an empty snapshot.
+int64_t ec_hist_percentile(const ec_hist_snap_t *snap, int per_mille);
+
+// Samples in buckets that lie entirely above threshold_ns.
+uint64_t ec_hist_above(const ec_hist_snap_t *snap, int64_t threshold_ns);
+
+// Snapshot + p50/p99/p99.9/max + samples over threshold_ns (e.g. the cycle period for EC_HIST_TOTAL).
+void ec_hist_summarize(const ec_hist_t *h, int64_t threshold_ns, ec_hist_summary_t *sum);
+
+#endif // EC_HIST_H
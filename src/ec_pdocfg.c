@@ -0,0 +1,98 @@
+// ec_pdocfg.c
+// Compact PDO mapping for the L7NH (see ec_pdocfg.h).
+
+#include "ec_pdocfg.h"
+
+#include "ethercat.h"
+
+// ---------------------------------------------------------------------------------------------
+// Edit these tables to change what goes on the wire. Entries are mapped in order; keep 16/32-bit
+// objects on even byte offsets where possible. Max 8 entries per PDO on the L7NH.
+// ---------------------------------------------------------------------------------------------
+#define PDOCFG_RXPDO 0x1600     // 1st receive PDO mapping object
+#define PDOCFG_TXPDO 0x1A00     // 1st transmit PDO mapping object
+
+static const ec_pdocfg_entry_t pdocfg_rx[] = {
+    { 0x6040, 0x00, 16 },   // Controlword
+    { 0x6071, 0x00, 16 },   // Target torque
+    { 0x6060, 0x00,  8 },   // Modes of operation
+};
+
+static const ec_pdocfg_entry_t pdocfg_tx[] = {
+    { 0x6041, 0x00, 16 },   // Statusword
+    { 0x606C, 0x00, 32 },   // Velocity actual value
+    { 0x6077, 0x00, 16 },   // Torque actual value
+    { 0x6064, 0x00, 32 },   // Position actual value
+    { 0x603F, 0x00, 16 },   // Error code
+};
+// ---------------------------------------------------------------------------------------------
+
+#define IDX_RXPDO_ASSIGN 0x1C12
+#define IDX_TXPDO_ASSIGN 0x1C13
+#define N_ENTRIES(t) ((int)(sizeof(t) / sizeof((t)[0])))
+
+static signed char pdocfg_result[EC_MAXSLAVE];
+static int pdocfg_result_init = 0;
+
+static int wr_u8(ecx_contextt *ctx, uint16 slave, uint16 idx, uint8 sub, uint8 val) {
+    return ecx_SDOwrite(ctx, slave, idx, sub, FALSE, sizeof(val), &val, EC_TIMEOUTRXM) > 0;
+}
+static int wr_u16(ecx_contextt *ctx, uint16 slave, uint16 idx, uint8 sub, uint16 val) {
+    return ecx_SDOwrite(ctx, slave, idx, sub, FALSE, sizeof(val), &val, EC_TIMEOUTRXM) > 0;
+}
+static int wr_u32(ecx_contextt *ctx, uint16 slave, uint16 idx, uint8 sub, uint32 val) {
+    return ecx_SDOwrite(ctx, slave, idx, sub, FALSE, sizeof(val), &val, EC_TIMEOUTRXM) > 0;
+}
+
+// Standard CoE sequence: clear assignment, clear mapping, write entries, set count, re-assign.
+static int program_pdo(ecx_contextt *ctx, uint16 slave, uint16 assign_idx, uint16 pdo_idx,
+                       const ec_pdocfg_entry_t *tab, int n) {
+    int ok = wr_u8(ctx, slave, assign_idx, 0, 0);
+    ok = ok && wr_u8(ctx, slave, pdo_idx, 0, 0);
+    for (int i = 0; ok && i < n; i++) {
+        uint32 raw = ((uint32)tab[i].index << 16) | ((uint32)tab[i].sub << 8) | tab[i].bits;
+        ok = wr_u32(ctx, slave, pdo_idx, (uint8)(i + 1), raw);
+    }
+    ok = ok && wr_u8(ctx, slave, pdo_idx, 0, (uint8)n);
+    ok = ok && wr_u16(ctx, slave, assign_idx, 1, pdo_idx);
+    ok = ok && wr_u8(ctx, slave, assign_idx, 0, 1);
+    return ok;
+}
+
+int ec_pdocfg_program_ctx(struct ecx_context *context, uint16_t slave) {
+    return program_pdo(context, slave, IDX_RXPDO_ASSIGN, PDOCFG_RXPDO, pdocfg_rx, N_ENTRIES(pdocfg_rx)) &&
+           program_pdo(context, slave, IDX_TXPDO_ASSIGN, PDOCFG_TXPDO, pdocfg_tx, N_ENTRIES(pdocfg_tx));
+}
+
+static void init_results(void) {
+    if (pdocfg_result_init) return;
+    for (int i = 0; i < EC_MAXSLAVE; i++) pdocfg_result[i] = -1;
+    pdocfg_result_init = 1;
+}
+
+int ec_pdocfg_po2so(uint16_t slave) {
+    int ok;
+    init_results();
+    ok = ec_pdocfg_program_ctx(&ecx_context, slave);
+    if (slave < EC_MAXSLAVE) pdocfg_result[slave] = (signed char)ok;
+    return ok;
+}
+
+void ec_pdocfg_install(uint16_t slave) {
+    init_results();
+    ec_slave[slave].PO2SOconfig = ec_pdocfg_po2so;
+}
+
+int ec_pdocfg_status(uint16_t slave) {
+    init_results();
+    return slave < EC_MAXSLAVE ? pdocfg_result[slave] : -1;
+}
+
+static int table_bytes(const ec_pdocfg_entry_t *tab, int n) {
+    int bits = 0;
+    for (int i = 0; i < n; i++) bits += tab[i].bits;
+    return (bits + 7) / 8;
+}
+
+int ec_pdocfg_rx_bytes(void) { return table_bytes(pdocfg_rx, N_ENTRIES(pdocfg_rx)); }
+int ec_pdocfg_tx_bytes(void) { return table_bytes(pdocfg_tx, N_ENTRIES(pdocfg_tx)); }
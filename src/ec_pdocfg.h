@@ -0,0 +1,39 @@
+// ec_pdocfg.h
+// Compact PDO mapping for the L7NH, programmed from a PRE-OP -> SAFE-OP hook.
+// - The hook is wired through ec_slave[].PO2SOconfig, so SOEM calls it inside ec_config_map()
+//   right before it reads the PDO assignment to size the SyncManagers.
+// - The RxPDO/TxPDO content comes from the tables at the top of ec_pdocfg.c (edit them there).
+// - ec_pdomap_discover() afterwards picks up the new layout automatically.
+
+#ifndef EC_PDOCFG_H
+#define EC_PDOCFG_H
+
+#include <stdint.h>
+
+struct ecx_context;
+
+typedef struct {
+    uint16_t index;
+    uint8_t sub;
+    uint8_t bits;
+} ec_pdocfg_entry_t;
+
+// Install the compact-mapping hook on slave (call after ec_config_init, before ec_config_map).
+void ec_pdocfg_install(uint16_t slave);
+
+// The hook itself (SOEM PO2SOconfig signature). Returns 1 on success, 0 if an SDO write failed.
+int ec_pdocfg_po2so(uint16_t slave);
+
+// Program the compact mapping on a slave of any context right away. The slave must be in PRE-OP,
+// i.e. call between ecx_config_init and ecx_config_map_group; the PO2SO hook above only exists for
+// the global context. Returns 1 on success, 0 if an SDO write failed.
+int ec_pdocfg_program_ctx(struct ecx_context *context, uint16_t slave);
+
+// Result of the last hook run on slave: 1 = compact mapping programmed, 0 = failed, -1 = not run.
+int ec_pdocfg_status(uint16_t slave);
+
+// RxPDO / TxPDO size in bytes of the configured tables (useful for frame budgeting).
+int ec_pdocfg_rx_bytes(void);
+int ec_pdocfg_tx_bytes(void);
+
+#endif // EC_PDOCFG_H
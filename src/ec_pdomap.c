@@ -0,0 +1,140 @@
+// ec_pdomap.c
+// PDO layout discovery (see ec_pdomap.h).
+
+#include "ec_pdomap.h"
+
+#include "ethercat.h"
+
+#define IDX_RXPDO_ASSIGN 0x1C12
+#define IDX_TXPDO_ASSIGN 0x1C13
+
+// Where unmapped objects point. Inputs scratch is never written, so unmapped feedback reads 0.
+static uint8_t pdo_scratch_out[8];
+static uint8_t pdo_scratch_in[8];
+
+static const struct {
+    uint16_t index;
+    uint8_t sub;
+    uint8_t bits;
+    uint8_t output;
+} pdo_objs[PDO_OBJ_COUNT] = {
+    [PDO_CONTROLWORD]       = { 0x6040, 0, 16, 1 },
+    [PDO_TARGET_TORQUE]     = { 0x6071, 0, 16, 1 },
+    [PDO_MODE_OF_OPERATION] = { 0x6060, 0,  8, 1 },
+    [PDO_TARGET_VELOCITY]   = { 0x60FF, 0, 32, 1 },
+    [PDO_TARGET_POSITION]   = { 0x607A, 0, 32, 1 },
+    [PDO_STATUSWORD]        = { 0x6041, 0, 16, 0 },
+    [PDO_ACTUAL_VELOCITY]   = { 0x606C, 0, 32, 0 },
+    [PDO_ACTUAL_TORQUE]     = { 0x6077, 0, 16, 0 },
+    [PDO_ACTUAL_POSITION]   = { 0x6064, 0, 32, 0 },
+    [PDO_ERROR_CODE]        = { 0x603F, 0, 16, 0 },
+    [PDO_MODE_DISPLAY]      = { 0x6061, 0,  8, 0 },
+};
+
+static int sdo_read(ec_pdomap_t *map, uint16 idx, uint8 sub, void *out, int size) {
+    int sz = size;
+    memset(out, 0, (size_t)size);
+    return ecx_SDOread(map->context, map->slave, idx, sub, FALSE, &sz, out, EC_TIMEOUTRXM);
+}
+
+// Read one SM assignment object (0x1C12/0x1C13) and append its entries.
+static int read_assign(ec_pdomap_t *map, uint16 assign_idx, uint8_t output, uint32_t *bits) {
+    uint8 npdo = 0;
+    *bits = 0;
+    if (sdo_read(map, assign_idx, 0, &npdo, sizeof(npdo)) <= 0) return -1;
+
+    for (uint8 i = 1; i <= npdo; i++) {
+        uint16 pdo_idx = 0;
+        uint8 nent = 0;
+        if (sdo_read(map, assign_idx, i, &pdo_idx, sizeof(pdo_idx)) <= 0) return -1;
+        if (sdo_read(map, pdo_idx, 0, &nent, sizeof(nent)) <= 0) return -1;
+
+        for (uint8 e = 1; e <= nent; e++) {
+            uint32 raw = 0;
+            if (sdo_read(map, pdo_idx, e, &raw, sizeof(raw)) <= 0) return -1;
+            // mapping entry: index(16) | subindex(8) | bit length(8); index 0 = padding
+            uint16_t obj_idx = (uint16_t)(raw >> 16);
+            uint8_t obj_bits = (uint8_t)(raw & 0xFF);
+            if (obj_idx != 0 && map->n_entries < EC_PDOMAP_MAX_ENTRIES) {
+                ec_pdo_entry_t *ent = &map->entries[map->n_entries++];
+                ent->index = obj_idx;
+                ent->sub = (uint8_t)((raw >> 8) & 0xFF);
+                ent->bits = obj_bits;
+                ent->bitoff = (uint16_t)*bits;
+                ent->output = output;
+            }
+            *bits += obj_bits;
+        }
+    }
+    return 0;
+}
+
+static void unbind(ec_pdomap_t *map) {
+    for (int o = 0; o < PDO_OBJ_COUNT; o++) {
+        map->obj[o] = pdo_objs[o].output ? pdo_scratch_out : pdo_scratch_in;
+    }
+    map->mapped = 0;
+}
+
+int ec_pdomap_read(ec_pdomap_t *map, uint16_t slave) {
+    return ec_pdomap_read_ctx(&ecx_context, map, slave);
+}
+
+int ec_pdomap_read_ctx(ecx_contextt *context, ec_pdomap_t *map, uint16_t slave) {
+    memset(map, 0, sizeof(*map));
+    map->context = context;
+    map->slave = slave;
+    unbind(map);
+
+    if (read_assign(map, IDX_RXPDO_ASSIGN, 1, &map->out_bits) != 0 ||
+        read_assign(map, IDX_TXPDO_ASSIGN, 0, &map->in_bits) != 0) {
+        map->n_entries = 0;
+        map->out_bits = map->in_bits = 0;
+        return -1;
+    }
+    return map->n_entries;
+}
+
+static const ec_pdo_entry_t *find_entry(const ec_pdomap_t *map, uint16_t index, uint8_t sub, int output) {
+    for (int i = 0; i < map->n_entries; i++) {
+        const ec_pdo_entry_t *e = &map->entries[i];
+        if (e->index == index && e->sub == sub && e->output == (output ? 1 : 0)) return e;
+    }
+    return NULL;
+}
+
+uint8_t *ec_pdomap_find(ec_pdomap_t *map, uint16_t index, uint8_t sub, int output) {
+    const ec_pdo_entry_t *e = find_entry(map, index, sub, output);
+    const ec_slavet *sl = &map->context->slavelist[map->slave];
+    uint8 *base = output ? sl->outputs : sl->inputs;
+    if (!e || !base || (e->bitoff & 7)) return output ? pdo_scratch_out : pdo_scratch_in;
+    return base + e->bitoff / 8;
+}
+
+int ec_pdomap_bind(ec_pdomap_t *map) {
+    ec_slavet *sl = &map->context->slavelist[map->slave];
+
+    unbind(map);
+    // SOEM sized the SyncManagers from the same assignment; if they disagree the table is stale
+    if ((map->out_bits + 7) / 8 != sl->Obytes || (map->in_bits + 7) / 8 != sl->Ibytes) return -1;
+
+    for (int o = 0; o < PDO_OBJ_COUNT; o++) {
+        const ec_pdo_entry_t *e = find_entry(map, pdo_objs[o].index, pdo_objs[o].sub, pdo_objs[o].output);
+        // only byte aligned entries of the expected width are bound; anything else stays on scratch
+        if (!e || e->bits != pdo_objs[o].bits || (e->bitoff & 7)) continue;
+        uint8 *base = pdo_objs[o].output ? sl->outputs : sl->inputs;
+        if (!base) continue;
+        map->obj[o] = base + e->bitoff / 8;
+        map->mapped |= 1u << o;
+    }
+    return 0;
+}
+
+int ec_pdomap_discover(ec_pdomap_t *map, uint16_t slave) {
+    return ec_pdomap_discover_ctx(&ecx_context, map, slave);
+}
+
+int ec_pdomap_discover_ctx(ecx_contextt *context, ec_pdomap_t *map, uint16_t slave) {
+    if (ec_pdomap_read_ctx(context, map, slave) < 0) return -1;
+    return ec_pdomap_bind(map);
+}
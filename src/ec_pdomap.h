@@ -0,0 +1,92 @@
+// ec_pdomap.h
+// PDO layout discovery for CiA402 drives.
+// - At connect time the actual mapping is read over CoE from the SM assignment objects
+//   (0x1C12 RxPDO / 0x1C13 TxPDO) and the 0x16xx / 0x1Axx mapping entries.
+// - The result is a per-slave offset table plus resolved pointers into the IOmap for the
+//   CiA402 objects the control loop uses.
+// - Objects that are not mapped resolve to a scratch area instead of NULL, so the cyclic
+//   path reads/writes through the table without branches and never falls back to SDO.
+//   ec_pdomap_has() tells at connect time which objects are really present.
+// Values are accessed with memcpy-based helpers (PDO entries are not naturally aligned);
+// EtherCAT data is little endian, like the x86/x64 hosts this program targets.
+// The plain calls work on SOEM's global context; the _ctx variants on any ecx_contextt (one per NIC).
+
+#ifndef EC_PDOMAP_H
+#define EC_PDOMAP_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define EC_PDOMAP_MAX_ENTRIES 64
+
+struct ecx_context;
+
+// CiA402 objects resolved at bind time
+typedef enum {
+    // RxPDO (master -> drive)
+    PDO_CONTROLWORD = 0,        // 0x6040 UINT16
+    PDO_TARGET_TORQUE,          // 0x6071 INT16
+    PDO_MODE_OF_OPERATION,      // 0x6060 INT8
+    PDO_TARGET_VELOCITY,        // 0x60FF INT32
+    PDO_TARGET_POSITION,        // 0x607A INT32
+    // TxPDO (drive -> master)
+    PDO_STATUSWORD,             // 0x6041 UINT16
+    PDO_ACTUAL_VELOCITY,        // 0x606C INT32
+    PDO_ACTUAL_TORQUE,          // 0x6077 INT16
+    PDO_ACTUAL_POSITION,        // 0x6064 INT32
+    PDO_ERROR_CODE,             // 0x603F UINT16
+    PDO_MODE_DISPLAY,           // 0x6061 INT8
+    PDO_OBJ_COUNT
+} ec_pdo_obj_t;
+
+typedef struct {
+    uint16_t index;
+    uint8_t sub;
+    uint8_t bits;
+    uint16_t bitoff;            // bit offset inside the slave's outputs/inputs
+    uint8_t output;             // 1 = RxPDO (outputs), 0 = TxPDO (inputs)
+} ec_pdo_entry_t;
+
+typedef struct {
+    struct ecx_context *context;
+    uint16_t slave;
+    int n_entries;
+    ec_pdo_entry_t entries[EC_PDOMAP_MAX_ENTRIES];
+    uint32_t out_bits;          // total mapped RxPDO bits
+    uint32_t in_bits;           // total mapped TxPDO bits
+
+    uint8_t *obj[PDO_OBJ_COUNT];    // resolved IOmap pointers (scratch area when not mapped)
+    uint32_t mapped;                // bit n set = PDO_OBJ n is really mapped
+} ec_pdomap_t;
+
+// Read the PDO assignment/mapping of slave over CoE. Returns number of entries, or -1 if the
+// assignment could not be read (the map is then left empty and every object unmapped).
+int ec_pdomap_read(ec_pdomap_t *map, uint16_t slave);
+int ec_pdomap_read_ctx(struct ecx_context *context, ec_pdomap_t *map, uint16_t slave);
+
+// Resolve object pointers against the slave's outputs/inputs in map->context (call after ec_config_map).
+// Returns 0, or -1 if the mapped sizes disagree with what SOEM configured (map is then unbound).
+int ec_pdomap_bind(ec_pdomap_t *map);
+
+// ec_pdomap_read + ec_pdomap_bind.
+int ec_pdomap_discover(ec_pdomap_t *map, uint16_t slave);
+int ec_pdomap_discover_ctx(struct ecx_context *context, ec_pdomap_t *map, uint16_t slave);
+
+// Pointer to any mapped object (index:sub), or the scratch area if it is not mapped.
+uint8_t *ec_pdomap_find(ec_pdomap_t *map, uint16_t index, uint8_t sub, int output);
+
+static inline int ec_pdomap_has(const ec_pdomap_t *map, ec_pdo_obj_t obj) {
+    return (map->mapped >> obj) & 1u;
+}
+
+// Typed accessors (branch-free; use with map->obj[PDO_...])
+static inline uint16_t pdo_get_u16(const uint8_t *p) { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline int16_t  pdo_get_s16(const uint8_t *p) { int16_t v;  memcpy(&v, p, sizeof(v)); return v; }
+static inline int32_t  pdo_get_s32(const uint8_t *p) { int32_t v;  memcpy(&v, p, sizeof(v)); return v; }
+static inline int8_t   pdo_get_s8(const uint8_t *p)  { return (int8_t)p[0]; }
+static inline void pdo_set_u16(uint8_t *p, uint16_t v) { memcpy(p, &v, sizeof(v)); }
+static inline void pdo_set_s16(uint8_t *p, int16_t v)  { memcpy(p, &v, sizeof(v)); }
+static inline void pdo_set_s32(uint8_t *p, int32_t v)  { memcpy(p, &v, sizeof(v)); }
+static inline void pdo_set_s8(uint8_t *p, int8_t v)    { p[0] = (uint8_t)v; }
+
+#endif // EC_PDOMAP_H
@@ -0,0 +1,171 @@
+// ec_recorder.c
+// Process-data ring in locked memory, flushed to a ring file (see ec_recorder.h).
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "ec_recorder.h"
+#include "ec_atomic.h"
+#include "ec_cycle.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#define PAGE 4096
+
+typedef char ec_rec_size_check[sizeof(ec_rec_t) == 32 ? 1 : -1];
+typedef char ec_rec_header_check[sizeof(ec_rec_header_t) <= EC_REC_HEADER_SIZE ? 1 : -1];
+
+static uint64_t pow2_at_least(uint64_t n) {
+    uint64_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+// Create the file at its full size and allocate the ring, locked where the OS allows.
+static int open_file(ec_recorder_t *rec, const char *path) {
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    rec->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+    if (rec->file == INVALID_HANDLE_VALUE) return -1;
+    size.QuadPart = (LONGLONG)rec->mem_size;
+    rec->mem = VirtualAlloc(NULL, (SIZE_T)rec->mem_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!SetFilePointerEx((HANDLE)rec->file, size, NULL, FILE_BEGIN) || !SetEndOfFile((HANDLE)rec->file) || !rec->mem) {
+        if (rec->mem) VirtualFree(rec->mem, 0, MEM_RELEASE);
+        CloseHandle((HANDLE)rec->file);
+        return -1;
+    }
+    rec->locked = VirtualLock(rec->mem, (SIZE_T)rec->mem_size) != 0;
+#else
+    rec->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (rec->fd < 0) return -1;
+    if (ftruncate(rec->fd, (off_t)rec->mem_size) != 0 || posix_memalign(&rec->mem, PAGE, (size_t)rec->mem_size) != 0) {
+        rec->mem = NULL;
+        close(rec->fd);
+        return -1;
+    }
+    rec->locked = mlock(rec->mem, (size_t)rec->mem_size) == 0;
+#endif
+    return 0;
+}
+
+// Write len bytes at offset off of the file. Returns 0, or -1.
+static int write_at(ec_recorder_t *rec, uint64_t off, const void *buf, uint64_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+    while (len > 0) {
+        uint32_t chunk = len > (1u << 30) ? (1u << 30) : (uint32_t)len;
+#ifdef _WIN32
+        OVERLAPPED ov;
+        DWORD done = 0;
+        memset(&ov, 0, sizeof(ov));
+        ov.Offset = (DWORD)off;
+        ov.OffsetHigh = (DWORD)(off >> 32);
+        if (!WriteFile((HANDLE)rec->file, p, chunk, &done, &ov) || done == 0) return -1;
+#else
+        ssize_t done = pwrite(rec->fd, p, chunk, (off_t)off);
+        if (done <= 0) return -1;
+#endif
+        p += done;
+        off += (uint64_t)done;
+        len -= (uint64_t)done;
+    }
+    return 0;
+}
+
+int ec_recorder_open(ec_recorder_t *rec, const char *path, uint64_t records, int axes, int64_t period_ns) {
+    memset(rec, 0, sizeof(*rec));
+    records = pow2_at_least(records ? records : EC_REC_DEFAULT_RECORDS);
+    rec->mem_size = EC_REC_HEADER_SIZE + records * sizeof(ec_rec_t);
+    if (open_file(rec, path) != 0) return -1;
+
+    // commit every page now, so the cyclic thread never takes a page fault
+    memset(rec->mem, 0, (size_t)rec->mem_size);
+
+    rec->hdr = (ec_rec_header_t *)rec->mem;
+    rec->ring = (ec_rec_t *)((uint8_t *)rec->mem + EC_REC_HEADER_SIZE);
+    rec->mask = records - 1;
+    memcpy(rec->hdr->magic, EC_REC_MAGIC, sizeof(rec->hdr->magic));
+    rec->hdr->version = EC_REC_VERSION;
+    rec->hdr->header_size = EC_REC_HEADER_SIZE;
+    rec->hdr->record_size = sizeof(ec_rec_t);
+    rec->hdr->axes = (uint32_t)axes;
+    rec->hdr->capacity = records;
+    rec->hdr->period_ns = period_ns;
+    rec->hdr->start_ns = ec_cycle_now_ns();
+    rec->hdr->start_unix_s = (int64_t)time(NULL);
+    ec_atomic_store_u64(&rec->hdr->head, 0);
+    if (write_at(rec, 0, rec->mem, EC_REC_HEADER_SIZE) != 0) {
+        ec_recorder_close(rec);
+        return -1;
+    }
+    return 0;
+}
+
+void ec_recorder_write(ec_recorder_t *rec, const ec_axes_t *ax, int64_t time_ns, uint32_t cycle, int wkc_ok) {
+    uint64_t head = rec->head;
+    uint16_t flags = wkc_ok ? EC_REC_WKC_OK : 0;
+
+    for (int i = 0; i < ax->count; i++) {
+        ec_rec_t *r = &rec->ring[(head + (uint64_t)i) & rec->mask];
+        r->time_ns = time_ns;
+        r->cycle = cycle;
+        r->axis = (uint16_t)i;
+        r->statusword = ax->statusword[i];
+        r->controlword = ax->controlword[i];
+        r->target_torque = ax->target_torque[i];
+        r->actual_torque = ax->actual_torque[i];
+        r->flags = (uint16_t)(flags | (ax->enabled[i] ? EC_REC_ENABLED : 0));
+        r->velocity = ax->actual_velocity[i];
+        r->position = ax->actual_position[i];
+    }
+    rec->head = head + (uint64_t)ax->count;
+    ec_atomic_store_u64(&rec->hdr->head, rec->head);
+}
+
+int ec_recorder_flush(ec_recorder_t *rec) {
+    ec_rec_header_t hdr;
+    uint64_t head = ec_atomic_load_u64(&rec->hdr->head), from = rec->flushed, capacity = rec->mask + 1;
+
+    if (head - from > capacity) from = head - capacity;
+    // at most two runs of slots: up to the end of the ring, then from its start
+    while (from < head) {
+        uint64_t slot = from & rec->mask, n = head - from;
+        if (n > capacity - slot) n = capacity - slot;
+        if (write_at(rec, EC_REC_HEADER_SIZE + slot * sizeof(ec_rec_t), &rec->ring[slot], n * sizeof(ec_rec_t)) != 0) {
+            return -1;
+        }
+        from += n;
+    }
+    // the header last: a reader of the file never sees a head beyond the records it holds
+    memcpy(&hdr, (const void *)rec->hdr, sizeof(hdr));
+    hdr.head = head;
+    if (write_at(rec, 0, &hdr, sizeof(hdr)) != 0) return -1;
+    rec->flushed = head;
+    return 0;
+}
+
+void ec_recorder_close(ec_recorder_t *rec) {
+    if (!rec->mem) return;
+    ec_recorder_flush(rec);
+#ifdef _WIN32
+    if (rec->locked) VirtualUnlock(rec->mem, (SIZE_T)rec->mem_size);
+    VirtualFree(rec->mem, 0, MEM_RELEASE);
+    CloseHandle((HANDLE)rec->file);
+#else
+    if (rec->locked) munlock(rec->mem, (size_t)rec->mem_size);
+    free(rec->mem);
+    close(rec->fd);
+#endif
+    rec->mem = NULL;
+}
@@ -0,0 +1,98 @@
+// ec_recorder.h
+// Process-data recorder: every cycle, one fixed-size record per axis into a ring in locked memory,
+// written out to a ring file of the same layout by a thread that is not real-time.
+// - The ring (with a copy of the file header) is allocated, touched page by page and locked where the
+//   OS allows when the recorder is opened; the file is created and sized then too. Recording is plain
+//   stores into that memory plus one release store of the head counter: no syscalls, no locks, and
+//   with the memory locked no page faults on the cyclic thread. (A shared mapping of the file would
+//   not do: the first store to a page that was written back faults again, for the page cache to track
+//   it as dirty.)
+// - ec_recorder_flush, from another thread (the control core's service thread, in l7nh_poll), writes
+//   the records added since its last call to their slots in the file and then the header with the
+//   head it wrote up to; ec_recorder_close flushes the rest. The file trails the recording by one
+//   flush interval, also after a crash.
+// - Layout (little endian, native on every target we build for): a 4 KiB header (ec_rec_header_t),
+//   then 'capacity' records of 32 bytes (ec_rec_t). Record n of the recording lives in slot
+//   n & (capacity - 1); header.head counts the records written, so the valid range is
+//   [max(0, head - capacity), head), also after a crash.
+// - tools/rec_export.c turns a time range of a recording into CSV. Triggered captures (ec_scope.c) are
+//   saved in the same layout, ending after slot head - 1; readers need no more of a ring that has not
+//   wrapped, so both replay with l7nhd -R.
+
+#ifndef EC_RECORDER_H
+#define EC_RECORDER_H
+
+#include <stdint.h>
+
+#include "ec_axes.h"
+
+#define EC_REC_MAGIC            "L7NHREC1"
+#define EC_REC_VERSION          1
+#define EC_REC_HEADER_SIZE      4096
+#define EC_REC_DEFAULT_RECORDS  (1u << 20)      // 32 MiB: ~4 s of 64 axes at 4 kHz
+
+// ec_rec_t.flags
+#define EC_REC_WKC_OK           0x0001          // working counter of the cycle as expected
+#define EC_REC_ENABLED          0x0002          // axis in Operation enabled (torque packed)
+
+typedef struct {
+    char magic[8];                  // EC_REC_MAGIC
+    uint32_t version;
+    uint32_t header_size;           // file offset of slot 0
+    uint32_t record_size;           // sizeof(ec_rec_t)
+    uint32_t axes;
+    uint64_t capacity;              // slots, power of two
+    int64_t period_ns;
+    int64_t start_ns;               // monotonic time (ec_cycle_now_ns) of ec_recorder_open
+    int64_t start_unix_s;           // wall clock at ec_recorder_open
+    volatile uint64_t head;         // records written so far
+    uint32_t trigger;               // captures (ec_scope.c): EC_SCOPE_TRIG_* that fired, 0 for recordings
+    int32_t trigger_axis;           // captures: lowest axis that fired, -1 if not axis specific
+} ec_rec_header_t;
+
+typedef struct {
+    int64_t time_ns;                // cycle wakeup (monotonic, same base as start_ns)
+    uint32_t cycle;                 // deadline index
+    uint16_t axis;
+    uint16_t statusword;            // 0x6041
+    uint16_t controlword;           // 0x6040 sent this cycle
+    int16_t target_torque;          // 0x6071 requested this cycle
+    int16_t actual_torque;          // 0x6077
+    uint16_t flags;                 // EC_REC_*
+    int32_t velocity;               // 0x606C
+    int32_t position;               // 0x6064
+} ec_rec_t;
+
+typedef struct {
+    ec_rec_header_t *hdr;           // in mem, head advanced by the writer
+    ec_rec_t *ring;                 // in mem, after the header page
+    uint64_t mask;
+    uint64_t head;                  // writer's copy of hdr->head
+    uint64_t flushed;               // records in the file (flushing thread)
+    uint64_t mem_size;
+    int locked;                     // pages locked in memory
+    void *mem;
+#ifdef _WIN32
+    void *file;                     // HANDLE
+#else
+    int fd;
+#endif
+} ec_recorder_t;
+
+// Create (or overwrite) path with room for 'records' records (rounded up to a power of two, 0 =
+// EC_REC_DEFAULT_RECORDS) and allocate the ring. Returns 0, or -1 if the file cannot be created or the
+// memory allocated.
+int ec_recorder_open(ec_recorder_t *rec, const char *path, uint64_t records, int axes, int64_t period_ns);
+
+// Cyclic thread: one record per axis of the current process image (call after ec_axes_pack).
+void ec_recorder_write(ec_recorder_t *rec, const ec_axes_t *ax, int64_t time_ns, uint32_t cycle, int wkc_ok);
+
+// One thread other than the cyclic one: write the records recorded since the last flush to the file.
+// Records the writer overwrote before they were flushed (more than a ring behind) are skipped.
+// Returns 0, or -1 on a file error.
+int ec_recorder_flush(ec_recorder_t *rec);
+
+// Flush, close the file and free the ring; the file keeps the recording.
+void ec_recorder_close(ec_recorder_t *rec);
+
+#endif // EC_RECORDER_H
@@ -0,0 +1,56 @@
+// ec_redundancy.c
+// Failover accounting and line-break location for redundant segments (see ec_redundancy.h).
+
+#include "ec_redundancy.h"
+#include "ec_atomic.h"
+
+#include <string.h>
+#include "ethercat.h"
+
+void ec_redundancy_init(ec_redundancy_t *r, int ring) {
+    memset(r, 0, sizeof(*r));
+    r->ring = ring;
+    r->line_break = EC_REDUNDANCY_NO_BREAK;
+}
+
+void ec_redundancy_cycle(ec_redundancy_t *r, int wkc, int expected_wkc) {
+    if (wkc != expected_wkc) {
+        if (r->open_cycles++ == 0) ec_atomic_store_u32(&r->degraded, 1);
+        ec_atomic_store_u64(&r->cycles_lost, r->cycles_lost + 1);
+        return;
+    }
+    if (r->open_cycles == 0) return;
+    ec_atomic_store_u32(&r->last_lost, r->open_cycles);
+    if (r->open_cycles > r->max_lost) ec_atomic_store_u32(&r->max_lost, r->open_cycles);
+    ec_atomic_store_u32(&r->failovers, r->failovers + 1);
+    ec_atomic_store_u32(&r->degraded, 0);
+    r->open_cycles = 0;
+}
+
+// Port p counts as connected like in SOEM's topology scan: loop open and communication established.
+static int port_connected(uint16 dlstat, int p) {
+    return ((dlstat >> (8 + 2 * p)) & 0x03) == 0x02;
+}
+
+int ec_redundancy_check(ec_redundancy_t *r, ecx_contextt *context) {
+    int n = *context->slavecount;
+    int brk = EC_REDUNDANCY_NO_BREAK, silent = 0;
+
+    for (int s = 1; s <= n; s++) {
+        const ec_slavet *sl = &context->slavelist[s];
+        uint8 buf[2];
+        if (ecx_FPRD(context->port, sl->configadr, ECT_REG_DLSTAT, sizeof(buf), buf, EC_TIMEOUTRET) <= 0) {
+            silent++;
+            continue;
+        }
+        uint16 dlstat = (uint16)(buf[0] | (buf[1] << 8));
+        for (int p = 0; p < 4 && brk == EC_REDUNDANCY_NO_BREAK; p++) {
+            if (!(sl->activeports & (1 << p)) || port_connected(dlstat, p)) continue;
+            brk = p == 0 ? s - 1 : s;   // port 0 leads towards the master
+        }
+    }
+    if (brk == EC_REDUNDANCY_NO_BREAK && n > 0 && silent == n) brk = 0;
+    r->line_break = brk;
+    r->silent = silent;
+    return brk;
+}
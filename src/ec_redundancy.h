@@ -0,0 +1,46 @@
+// ec_redundancy.h
+// Cable redundancy of a segment opened on two NICs (ecx_init_redundant).
+// - The slaves form a ring from the primary NIC back to the secondary one. SOEM sends every frame out
+//   of both ports; after a cable break each half of the line is served from its own end and the
+//   process data is complete again once the ESCs next to the break have closed their ports.
+// - ec_redundancy_cycle() runs in the cyclic thread: the first cycle whose working counter is not the
+//   expected one opens a failover event, the next complete cycle closes it. The cycles in between are
+//   the cycles lost to the failover. Without a ring a break leaves the event open.
+// - ec_redundancy_check() runs outside the cycle (one FPRD per slave): it reads the ESC DL status
+//   (0x0110) and locates the open cable from the ports that lost the link they had at config time.
+
+#ifndef EC_REDUNDANCY_H
+#define EC_REDUNDANCY_H
+
+#include <stdint.h>
+
+struct ecx_context;
+
+#define EC_REDUNDANCY_NO_BREAK  -1      // line_break: every cable of the segment is closed
+
+typedef struct {
+    int ring;                           // opened with a secondary NIC
+
+    // written by the cyclic thread
+    uint32_t open_cycles;               // wrong-WKC cycles of the open event, 0 = none open
+    volatile uint32_t degraded;         // an event is open
+    volatile uint32_t failovers;        // events closed by a complete cycle
+    volatile uint32_t last_lost;        // cycles lost by the last closed event
+    volatile uint32_t max_lost;
+    volatile uint64_t cycles_lost;      // all cycles with a wrong working counter
+
+    // written by ec_redundancy_check()
+    int line_break;                     // the cable behind this slave is open (0 = at the master)
+    int silent;                         // slaves that did not answer the DL status read
+} ec_redundancy_t;
+
+void ec_redundancy_init(ec_redundancy_t *r, int ring);
+
+// Account one cycle (cyclic thread). wkc may be EC_NOFRAME.
+void ec_redundancy_cycle(ec_redundancy_t *r, int wkc, int expected_wkc);
+
+// Read the port status of every slave and update line_break / silent. A line whose master-side cable
+// is open does not answer at all; that is reported as a break at 0 as well. Returns line_break.
+int ec_redundancy_check(ec_redundancy_t *r, struct ecx_context *context);
+
+#endif // EC_REDUNDANCY_H
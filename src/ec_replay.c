@@ -0,0 +1,345 @@
+// ec_replay.c
+// Deterministic replay of a recording with divergence report (see ec_replay.h).
+
+#ifndef _WIN32
+#define _DEFAULT_SOURCE     // madvise
+#endif
+
+#include "ec_replay.h"
+#include "ec_atomic.h"
+
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define PAGE            4096
+#define PER_PAGE        (PAGE / sizeof(ec_rec_t))   // records per page; slots are page aligned in the file
+#define RELEASE_RECORDS ((256u << 10) / sizeof(ec_rec_t))  // handed back in chunks: fewer syscalls and TLB shootdowns
+#define EVENT_MASK      (EC_REPLAY_EVENTS - 1)
+
+enum { WILLNEED, DONTNEED };
+
+static int map_file(ec_replay_t *rp, const char *path) {
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    rp->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (rp->file == INVALID_HANDLE_VALUE) return -1;
+    if (!GetFileSizeEx((HANDLE)rp->file, &size) || size.QuadPart < EC_REC_HEADER_SIZE) {
+        CloseHandle((HANDLE)rp->file);
+        return -1;
+    }
+    rp->map_size = (uint64_t)size.QuadPart;
+    rp->mapping = CreateFileMappingA((HANDLE)rp->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!rp->mapping) {
+        CloseHandle((HANDLE)rp->file);
+        return -1;
+    }
+    rp->map = MapViewOfFile((HANDLE)rp->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!rp->map) {
+        CloseHandle((HANDLE)rp->mapping);
+        CloseHandle((HANDLE)rp->file);
+        return -1;
+    }
+#else
+    struct stat st;
+    rp->fd = open(path, O_RDONLY);
+    if (rp->fd < 0) return -1;
+    if (fstat(rp->fd, &st) != 0 || st.st_size < EC_REC_HEADER_SIZE) {
+        close(rp->fd);
+        return -1;
+    }
+    rp->map_size = (uint64_t)st.st_size;
+    rp->map = mmap(NULL, (size_t)rp->map_size, PROT_READ, MAP_SHARED, rp->fd, 0);
+    if (rp->map == MAP_FAILED) {
+        rp->map = NULL;
+        close(rp->fd);
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+static void unmap_file(ec_replay_t *rp) {
+    if (!rp->map) return;
+#ifdef _WIN32
+    UnmapViewOfFile(rp->map);
+    CloseHandle((HANDLE)rp->mapping);
+    CloseHandle((HANDLE)rp->file);
+#else
+    munmap(rp->map, (size_t)rp->map_size);
+    close(rp->fd);
+#endif
+    rp->map = NULL;
+}
+
+static const ec_rec_t *slot(const ec_replay_t *rp, uint64_t r) {
+    return &rp->ring[r & rp->mask];
+}
+
+// Page advice for the records [from, to) of the trace, which may wrap around the end of the ring.
+// WILLNEED covers every page they touch, DONTNEED only the pages they fill.
+static void advise(ec_replay_t *rp, uint64_t from, uint64_t to, int advice) {
+    while (from < to) {
+        uint64_t s = from & rp->mask, n = to - from;
+        if (n > rp->mask + 1 - s) n = rp->mask + 1 - s;
+        uintptr_t a = (uintptr_t)&rp->ring[s], b = a + (uintptr_t)(n * sizeof(ec_rec_t));
+        if (advice == WILLNEED) {
+            a &= ~(uintptr_t)(PAGE - 1);
+            b = (b + PAGE - 1) & ~(uintptr_t)(PAGE - 1);
+        } else {
+            a = (a + PAGE - 1) & ~(uintptr_t)(PAGE - 1);
+            b &= ~(uintptr_t)(PAGE - 1);
+        }
+        if (b > a) {
+#ifdef _WIN32
+            if (advice == DONTNEED) VirtualUnlock((void *)a, (SIZE_T)(b - a));  // not locked: leaves the working set
+#else
+            if (advice == DONTNEED) munlock((void *)a, (size_t)(b - a));  // locked on fault under mlockall
+            madvise((void *)a, (size_t)(b - a), advice == WILLNEED ? MADV_WILLNEED : MADV_DONTNEED);
+#endif
+        }
+        from += n;
+    }
+}
+
+int ec_replay_open(ec_replay_t *rp, const char *path, const char *report_path) {
+    memset(rp, 0, sizeof(*rp));
+    rp->band[EC_REPLAY_TORQUE] = EC_REPLAY_BAND_TORQUE;
+    rp->band[EC_REPLAY_VELOCITY] = EC_REPLAY_BAND_VELOCITY;
+    rp->band[EC_REPLAY_POSITION] = EC_REPLAY_BAND_POSITION;
+    if (map_file(rp, path) != 0) {
+        rp->error = "cannot open the recording";
+        return -1;
+    }
+
+    // a ring that has not wrapped only needs its slots up to head: triggered captures (ec_scope_save)
+    // end there, with capacity rounded up to a power of two
+    const ec_rec_header_t *h = (const ec_rec_header_t *)rp->map;
+    rp->hdr = h;
+    uint64_t head = ec_atomic_load_u64(&((ec_rec_header_t *)rp->map)->head);
+    if (memcmp(h->magic, EC_REC_MAGIC, sizeof(h->magic)) != 0 || h->version != EC_REC_VERSION ||
+        h->record_size != sizeof(ec_rec_t) || h->header_size % PAGE != 0 || h->capacity == 0 ||
+        (h->capacity & (h->capacity - 1)) != 0 || h->axes == 0 || h->axes > EC_AXES_MAX ||
+        h->header_size + (head < h->capacity ? head : h->capacity) * sizeof(ec_rec_t) > rp->map_size) {
+        rp->error = "not a recording of this version";
+        unmap_file(rp);
+        return -1;
+    }
+    rp->ring = (const ec_rec_t *)((const uint8_t *)rp->map + h->header_size);
+    rp->mask = h->capacity - 1;
+    rp->axes = (int)h->axes;
+
+    // whole cycles only; a ring that wrapped keeps its newest capacity / axes cycles
+    head -= head % h->axes;
+    rp->end = head;
+    rp->first = head > h->capacity ? head - (h->capacity / h->axes) * h->axes : 0;
+    rp->cycles = (rp->end - rp->first) / h->axes;
+    if (rp->cycles == 0) {
+        rp->error = "the recording is empty";
+        unmap_file(rp);
+        return -1;
+    }
+
+    rp->report = fopen(report_path, "w");
+    if (!rp->report) {
+        rp->error = "cannot write the report";
+        unmap_file(rp);
+        return -1;
+    }
+    time_t start = (time_t)h->start_unix_s;
+    char when[32];
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&start));
+    fprintf(rp->report, "# replay of %s (recorded %s): %llu cycles of %u axes at %lld us%s\n", path, when,
+            (unsigned long long)rp->cycles, (unsigned)h->axes, (long long)(h->period_ns / 1000),
+            rp->first ? ", the oldest cycles were overwritten" : "");
+    fprintf(rp->report, "# cycle\ttime_s\taxis\tchannel\tcycles\tpeak\trecorded\tlive\n");
+
+    rp->next = rp->ready = rp->first;
+    rp->released = rp->first - rp->first % PER_PAGE;
+    rp->last_tick = slot(rp, rp->first)->cycle;
+    ec_replay_prefetch(rp);
+    return 0;
+}
+
+void ec_replay_prefetch(ec_replay_t *rp) {
+    uint64_t next = ec_atomic_load_u64(&rp->next);
+    uint64_t target = next + EC_REPLAY_AHEAD_BYTES / sizeof(ec_rec_t);
+    if (target > rp->end) target = rp->end;
+
+    if (target > rp->ready) {
+        advise(rp, rp->ready, target, WILLNEED);
+        for (uint64_t r = rp->ready - rp->ready % PER_PAGE; r < target; r += PER_PAGE) {
+            (void)*(const volatile uint8_t *)slot(rp, r);
+        }
+        (void)*(const volatile uint8_t *)slot(rp, target - 1);
+        ec_atomic_store_u64(&rp->ready, target);
+    }
+
+    // hand back what was played, a page short of the cycle
+    uint64_t played = next - next % PER_PAGE;
+    if (played >= rp->released + RELEASE_RECORDS + PER_PAGE) {
+        advise(rp, rp->released, played - PER_PAGE, DONTNEED);
+        rp->released = played - PER_PAGE;
+    }
+}
+
+static void push_event(ec_replay_t *rp, const ec_replay_event_t *e) {
+    uint32_t head = rp->ev_head;    // only we write ev_head
+    if (head - ec_atomic_load_u32(&rp->ev_tail) >= EC_REPLAY_EVENTS) {
+        ec_atomic_store_u32(&rp->ev_dropped, rp->ev_dropped + 1);
+        return;
+    }
+    rp->ev[head & EVENT_MASK] = *e;
+    ec_atomic_store_u32(&rp->ev_head, head + 1);
+}
+
+static void compare(ec_replay_t *rp, int axis, ec_replay_channel_t c, int64_t recorded, int64_t live,
+                    int64_t time_ns) {
+    ec_replay_track_t *t = &rp->track[axis][c];
+    int64_t d = c == EC_REPLAY_STATE ? ((recorded ^ live) & EC_REPLAY_STATE_MASK) != 0 : live - recorded;
+    int32_t dev = (int32_t)(d < 0 ? (-d > INT32_MAX ? INT32_MAX : -d) : (d > INT32_MAX ? INT32_MAX : d));
+
+    if (dev > (c == EC_REPLAY_STATE ? 0 : rp->band[c])) {
+        ec_replay_event_t *e = &t->open;
+        if (t->out++ == 0) t->first = rp->played;
+        if (dev > t->peak) {
+            t->peak = dev;
+            t->peak_cycle = rp->played;
+        }
+        if (e->cycles++ == 0) {
+            e->cycle = rp->played;
+            e->time_ns = time_ns;
+            e->axis = (uint16_t)axis;
+            e->channel = (uint16_t)c;
+            e->peak = -1;
+        }
+        if (dev > e->peak) {
+            e->peak = dev;
+            e->recorded = (int32_t)recorded;
+            e->live = (int32_t)live;
+        }
+    } else if (t->open.cycles) {
+        push_event(rp, &t->open);
+        t->episodes++;
+        t->open.cycles = 0;
+    }
+}
+
+static void hold(const ec_replay_t *rp, ec_axes_t *ax) {
+    for (int i = 0; i < ax->count && i < rp->axes; i++) {
+        ax->controlword[i] = rp->controlword[i];
+        ax->target_torque[i] = rp->torque[i];
+        ax->enabled[i] = rp->enabled[i];
+    }
+}
+
+int ec_replay_cycle(ec_replay_t *rp, ec_axes_t *ax) {
+    uint64_t r = rp->next;          // only we write next
+    int n = ax->count < rp->axes ? ax->count : rp->axes;
+
+    if (rp->done) {
+        hold(rp, ax);
+        return 0;
+    }
+    if (r + (uint64_t)rp->axes > ec_atomic_load_u64(&rp->ready)) {
+        rp->starved++;
+        hold(rp, ax);
+        return 1;
+    }
+
+    const ec_rec_t *rec = slot(rp, r);
+    if (rp->played && rec->cycle - rp->last_tick > 1) rp->gaps += rec->cycle - rp->last_tick - 1;
+    rp->last_tick = rec->cycle;
+    int64_t time_ns = rec->time_ns - rp->hdr->start_ns;
+    for (int i = 0; i < n; i++) {
+        rec = slot(rp, r + (uint64_t)i);
+        if (rec->axis != i) rp->bad++;
+        compare(rp, i, EC_REPLAY_STATE, rec->statusword, ax->statusword[i], time_ns);
+        compare(rp, i, EC_REPLAY_TORQUE, rec->actual_torque, ax->actual_torque[i], time_ns);
+        compare(rp, i, EC_REPLAY_VELOCITY, rec->velocity, ax->actual_velocity[i], time_ns);
+        compare(rp, i, EC_REPLAY_POSITION, rec->position, ax->actual_position[i], time_ns);
+        rp->controlword[i] = rec->controlword;
+        rp->torque[i] = rec->target_torque;
+        rp->enabled[i] = (rec->flags & EC_REC_ENABLED) != 0;
+    }
+    hold(rp, ax);
+
+    ec_atomic_store_u64(&rp->played, rp->played + 1);
+    ec_atomic_store_u64(&rp->next, r + (uint64_t)rp->axes);
+    if (rp->next >= rp->end) ec_atomic_store_u32(&rp->done, 1);
+    return 1;
+}
+
+static void write_event(ec_replay_t *rp, const ec_replay_event_t *e) {
+    if (e->channel == EC_REPLAY_STATE) {
+        fprintf(rp->report, "%llu\t%.6f\t%u\t%s\t%u\t%d\t0x%04X\t0x%04X\n", (unsigned long long)e->cycle,
+                e->time_ns / 1e9, (unsigned)e->axis, ec_replay_channel_name(EC_REPLAY_STATE), (unsigned)e->cycles,
+                (int)e->peak, (unsigned)(uint16_t)e->recorded, (unsigned)(uint16_t)e->live);
+    } else {
+        fprintf(rp->report, "%llu\t%.6f\t%u\t%s\t%u\t%d\t%d\t%d\n", (unsigned long long)e->cycle, e->time_ns / 1e9,
+                (unsigned)e->axis, ec_replay_channel_name((ec_replay_channel_t)e->channel), (unsigned)e->cycles,
+                (int)e->peak, (int)e->recorded, (int)e->live);
+    }
+}
+
+void ec_replay_drain(ec_replay_t *rp) {
+    uint32_t tail = rp->ev_tail;    // only we write ev_tail
+    while (tail != ec_atomic_load_u32(&rp->ev_head)) {
+        write_event(rp, &rp->ev[tail & EVENT_MASK]);
+        ec_atomic_store_u32(&rp->ev_tail, ++tail);
+    }
+}
+
+uint64_t ec_replay_out(const ec_replay_t *rp, ec_replay_channel_t c) {
+    uint64_t out = 0;
+    for (int i = 0; i < rp->axes; i++) out += rp->track[i][c].out;
+    return out;
+}
+
+void ec_replay_close(ec_replay_t *rp) {
+    if (!rp->report) return;
+    ec_replay_drain(rp);
+    for (int i = 0; i < rp->axes; i++) {
+        for (int c = 0; c < EC_REPLAY_CHANNELS; c++) {
+            ec_replay_track_t *t = &rp->track[i][c];
+            if (!t->open.cycles) continue;
+            write_event(rp, &t->open);      // still out of band when the replay ended
+            t->episodes++;
+            t->open.cycles = 0;
+        }
+    }
+
+    fprintf(rp->report, "# played %llu of %llu cycles, %u starved, %u recorded deadlines skipped, %u damaged records,"
+            " %u episodes not listed\n", (unsigned long long)rp->played, (unsigned long long)rp->cycles,
+            (unsigned)rp->starved, (unsigned)rp->gaps, (unsigned)rp->bad, (unsigned)rp->ev_dropped);
+    int diverged = 0;
+    for (int i = 0; i < rp->axes; i++) {
+        for (int c = 0; c < EC_REPLAY_CHANNELS; c++) {
+            const ec_replay_track_t *t = &rp->track[i][c];
+            if (!t->out) continue;
+            diverged = 1;
+            fprintf(rp->report, "# axis %d %s: %llu cycles out of band (%d) in %u episodes, first at cycle %llu,"
+                    " peak %d at cycle %llu\n", i, ec_replay_channel_name((ec_replay_channel_t)c),
+                    (unsigned long long)t->out, c == EC_REPLAY_STATE ? 0 : (int)rp->band[c], (unsigned)t->episodes,
+                    (unsigned long long)t->first, (int)t->peak, (unsigned long long)t->peak_cycle);
+        }
+    }
+    if (!diverged) fprintf(rp->report, "# no divergence\n");
+    fclose(rp->report);
+    rp->report = NULL;
+    unmap_file(rp);
+}
+
+const char *ec_replay_channel_name(ec_replay_channel_t c) {
+    static const char *const names[EC_REPLAY_CHANNELS] = { "state", "torque", "velocity", "position" };
+    return c >= 0 && c < EC_REPLAY_CHANNELS ? names[c] : "?";
+}
@@ -0,0 +1,124 @@
+// ec_replay.h
+// Deterministic replay of a process-data recording (ec_recorder.h) against live drives.
+// - Every cycle plays the next recorded cycle: the 0x6040 controlword and 0x6071 torque of every axis go
+//   out exactly as recorded (torque gated by the recorded Operation-enabled flag, as ec_axes_pack did
+//   then), and the live inputs of the cycle are compared with the recorded ones: the CiA402 state bits
+//   of 0x6041 must match, 0x6077 / 0x606C / 0x6064 must stay within a band around the recording.
+//   Once the trace is over the last recorded outputs are held until the owner stops.
+// - The trace is streamed from a read-only mapping of the file, never loaded: the service thread keeps
+//   a window of EC_REPLAY_AHEAD_BYTES ahead of the cycle touched (so the cycle takes no page fault) and
+//   hands the pages behind it back to the OS, so a multi-hour trace costs a few MiB of memory. Should
+//   the cycle still catch up with the window, it holds the outputs and the trace waits (counted as
+//   starved).
+// - Divergence: per axis and channel, a run of cycles out of band is an episode. Episodes go from the
+//   cyclic thread through a wait-free SPSC ring (as telemetry.c) to the service thread, which writes
+//   them into the report as they close; ec_replay_close() appends the totals.
+
+#ifndef EC_REPLAY_H
+#define EC_REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ec_axes.h"
+#include "ec_recorder.h"
+
+#define EC_REPLAY_AHEAD_BYTES   (8u << 20)      // trace kept resident ahead of the cycle
+#define EC_REPLAY_EVENTS        1024            // episodes in flight to the report, power of two
+#define EC_REPLAY_STATE_MASK    0x006F          // statusword bits of the CiA402 state (fault included)
+#define EC_REPLAY_BAND_TORQUE   30              // default bands: 0x6077 (per mille of rated torque)
+#define EC_REPLAY_BAND_VELOCITY 20              // 0x606C (drive units, rpm on the L7NH)
+#define EC_REPLAY_BAND_POSITION 10000           // 0x6064 (encoder counts)
+
+typedef enum {
+    EC_REPLAY_STATE = 0,
+    EC_REPLAY_TORQUE,
+    EC_REPLAY_VELOCITY,
+    EC_REPLAY_POSITION,
+    EC_REPLAY_CHANNELS
+} ec_replay_channel_t;
+
+typedef struct {
+    uint64_t cycle;                 // replay cycle the episode started in
+    int64_t time_ns;                // its time in the recording (since its start, as rec_export shows it)
+    uint32_t cycles;                // its length
+    uint16_t axis;
+    uint16_t channel;               // ec_replay_channel_t
+    int32_t peak;                   // largest |live - recorded|; state: 1
+    int32_t recorded, live;         // at the peak (state: the statuswords)
+} ec_replay_event_t;
+
+typedef struct {
+    uint64_t out;                   // cycles out of band
+    uint64_t first;                 // cycle of the first one (valid if out)
+    uint64_t peak_cycle;
+    int32_t peak;                   // largest |live - recorded|
+    uint32_t episodes;
+    ec_replay_event_t open;         // episode in progress (open.cycles > 0)
+} ec_replay_track_t;
+
+typedef struct {
+    const ec_rec_header_t *hdr;
+    const ec_rec_t *ring;
+    uint64_t mask;
+    uint64_t first, end;            // records of the trace: [first, end)
+    uint64_t cycles;                // cycles of the trace
+    int axes;
+    int32_t band[EC_REPLAY_CHANNELS];   // [EC_REPLAY_STATE] unused
+    FILE *report;
+    const char *error;              // why ec_replay_open failed
+
+    // streaming: next is written by the cyclic thread, ready / released by the service thread
+    volatile uint64_t next;         // next record to play
+    volatile uint64_t ready;        // records up to here are resident
+    uint64_t released;              // pages of records before this were handed back
+
+    // cyclic thread
+    volatile uint64_t played;       // cycles played
+    volatile uint32_t done;         // the trace is over, the last outputs are held
+    uint32_t starved;               // cycles the window was behind: outputs held, trace paused
+    uint32_t gaps;                  // recorded deadlines that were skipped (overruns of the recording)
+    uint32_t bad;                   // records of another axis than expected (damaged trace)
+    uint32_t last_tick;
+    uint16_t controlword[EC_AXES_MAX];  // outputs last played
+    int16_t torque[EC_AXES_MAX];
+    uint8_t enabled[EC_AXES_MAX];
+    ec_replay_track_t track[EC_AXES_MAX][EC_REPLAY_CHANNELS];
+
+    // episodes: cyclic thread -> service thread
+    volatile uint32_t ev_head, ev_tail, ev_dropped;
+    ec_replay_event_t ev[EC_REPLAY_EVENTS];
+
+    uint64_t map_size;
+    void *map;
+#ifdef _WIN32
+    void *file;                     // HANDLEs
+    void *mapping;
+#else
+    int fd;
+#endif
+} ec_replay_t;
+
+// Map the recording at path (read only) and write the report to report_path. Bands start at the
+// defaults. Returns 0, or -1 with rp->error set.
+int ec_replay_open(ec_replay_t *rp, const char *path, const char *report_path);
+
+// Service thread, every millisecond or so while the trace plays: move the resident window along and
+// write the episodes that closed into the report.
+void ec_replay_prefetch(ec_replay_t *rp);
+void ec_replay_drain(ec_replay_t *rp);
+
+// Cyclic thread, after ec_axes_update: compare the inputs with the next recorded cycle and set its
+// outputs (controlword, target_torque, enabled). Returns 1 while the trace plays, 0 once it is over.
+int ec_replay_cycle(ec_replay_t *rp, ec_axes_t *ax);
+
+// Out-of-band cycles of all axes of one channel.
+uint64_t ec_replay_out(const ec_replay_t *rp, ec_replay_channel_t c);
+
+// Once no cycle plays it any more: close the open episodes, complete the report with the totals per
+// axis and channel, unmap. The counters stay readable.
+void ec_replay_close(ec_replay_t *rp);
+
+const char *ec_replay_channel_name(ec_replay_channel_t c);
+
+#endif // EC_REPLAY_H
@@ -0,0 +1,183 @@
+// ec_scope.c
+// Triggered capture of the process image (see ec_scope.h).
+
+#include "ec_scope.h"
+#include "ec_atomic.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SW_FAULT_BIT 3      // 0x6041 bit 3: fault
+
+int ec_scope_init(ec_scope_t *sc, int axes, int64_t period_ns, uint32_t pre, uint32_t post, uint32_t conditions,
+                  int32_t velocity_limit) {
+    memset(sc, 0, sizeof(*sc));
+    if (axes < 1) axes = 1;
+    if (axes > EC_AXES_MAX) axes = EC_AXES_MAX;
+    sc->axes = axes;
+    sc->period_ns = period_ns;
+    sc->pre = pre;
+    sc->post = post;
+    sc->conditions = conditions;
+    sc->velocity_limit = velocity_limit < 0 ? -velocity_limit : velocity_limit;
+    sc->trigger_axis = -1;
+    sc->depth = 1;
+    while (sc->depth <= pre + post) sc->depth <<= 1;
+
+    size_t bytes = (size_t)sc->depth * (size_t)axes * sizeof(ec_rec_t);
+    sc->ring = (ec_rec_t *)malloc(bytes);
+    if (!sc->ring) return -1;
+    memset(sc->ring, 0, bytes);     // commit the pages now, not in the cycle
+    return 0;
+}
+
+void ec_scope_free(ec_scope_t *sc) {
+    free(sc->ring);
+    sc->ring = NULL;
+    sc->state = EC_SCOPE_IDLE;
+}
+
+void ec_scope_arm(ec_scope_t *sc) {
+    sc->stored = 0;
+    sc->remaining = 0;
+    sc->cause = 0;
+    sc->trigger_axis = -1;
+    ec_atomic_store_u32(&sc->state, EC_SCOPE_ARMED);
+}
+
+int ec_scope_frozen(const ec_scope_t *sc) {
+    return ec_atomic_load_u32(&sc->state) == EC_SCOPE_FROZEN;
+}
+
+static void freeze(ec_scope_t *sc) {
+    sc->captures++;
+    ec_atomic_store_u32(&sc->state, EC_SCOPE_FROZEN);
+}
+
+static int lowest_axis(uint64_t bits) {
+    int i = 0;
+    while (!(bits & 1u)) {
+        bits >>= 1;
+        i++;
+    }
+    return i;
+}
+
+uint32_t ec_scope_trigger(ec_scope_t *sc, const ec_axes_t *ax, int wkc_ok, int overrun, uint64_t *hit) {
+    const int n = ax->count < sc->axes ? ax->count : sc->axes;
+    const uint32_t lim = (uint32_t)sc->velocity_limit;
+    const uint64_t fault_on = (sc->conditions & EC_SCOPE_TRIG_FAULT) ? ~0ull : 0;
+    const uint64_t fast_on = (sc->conditions & EC_SCOPE_TRIG_OVERSPEED) ? ~0ull : 0;
+    uint64_t fault = 0, fast = 0;
+
+    // one bit per axis; |v| > lim as a single unsigned compare
+    for (int i = 0; i < n; i++) {
+        fault |= (uint64_t)((ax->statusword[i] >> SW_FAULT_BIT) & 1u) << i;
+        fast |= (uint64_t)((uint32_t)ax->actual_velocity[i] + lim > 2u * lim) << i;
+    }
+    uint64_t new_fault = fault & ~sc->prev_fault & fault_on, new_fast = fast & ~sc->prev_overspeed & fast_on;
+    sc->prev_fault = fault;
+    sc->prev_overspeed = fast;
+
+    uint32_t cause = (new_fault ? EC_SCOPE_TRIG_FAULT : 0) | (new_fast ? EC_SCOPE_TRIG_OVERSPEED : 0) |
+                     (!wkc_ok ? EC_SCOPE_TRIG_WKC : 0) | (overrun ? EC_SCOPE_TRIG_OVERRUN : 0);
+    *hit = new_fault | new_fast;
+    return cause & sc->conditions;
+}
+
+void ec_scope_cycle(ec_scope_t *sc, const ec_axes_t *ax, int64_t time_ns, uint32_t cycle, int wkc_ok, int overrun) {
+    uint32_t state = ec_atomic_load_u32(&sc->state);
+    const int n = ax->count < sc->axes ? ax->count : sc->axes;
+    uint64_t hit;
+
+    if (state == EC_SCOPE_IDLE) return;
+    // the edges are tracked while frozen too: a fault that stays set does not fire after re-arming
+    uint32_t cause = ec_scope_trigger(sc, ax, wkc_ok, overrun, &hit);
+    if (state == EC_SCOPE_FROZEN) return;
+
+    ec_rec_t *r = &sc->ring[(size_t)(sc->stored & (sc->depth - 1)) * (size_t)sc->axes];
+    for (int i = 0; i < n; i++, r++) {
+        r->time_ns = time_ns;
+        r->cycle = cycle;
+        r->axis = (uint16_t)i;
+        r->statusword = ax->statusword[i];
+        r->controlword = ax->controlword[i];
+        r->target_torque = ax->target_torque[i];
+        r->actual_torque = ax->actual_torque[i];
+        r->flags = (uint16_t)((wkc_ok ? EC_REC_WKC_OK : 0) | (ax->enabled[i] ? EC_REC_ENABLED : 0));
+        r->velocity = ax->actual_velocity[i];
+        r->position = ax->actual_position[i];
+    }
+
+    if (state == EC_SCOPE_ARMED) {
+        if (cause) {
+            sc->cause = cause;
+            sc->trigger_axis = hit ? lowest_axis(hit) : -1;
+            sc->trigger_cycle = cycle;
+            sc->trigger_ns = time_ns;
+            sc->trigger_index = sc->stored;
+            sc->remaining = sc->post;
+            sc->stored++;
+            if (sc->post == 0) freeze(sc);
+            else ec_atomic_store_u32(&sc->state, EC_SCOPE_TRIGGERED);
+            return;
+        }
+    } else if (--sc->remaining == 0) {
+        sc->stored++;
+        freeze(sc);
+        return;
+    }
+    sc->stored++;
+}
+
+int ec_scope_save(const ec_scope_t *sc, const char *path) {
+    static const uint8_t zero[EC_REC_HEADER_SIZE];
+    ec_rec_header_t hdr;
+    FILE *f;
+
+    // the acquire of the frozen state first: only then are stored and trigger_index the capture's
+    if (!ec_scope_frozen(sc)) return -1;
+    uint64_t first = sc->trigger_index >= sc->pre ? sc->trigger_index - sc->pre : 0;
+    uint64_t cycles = sc->stored - first;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, EC_REC_MAGIC, sizeof(hdr.magic));
+    hdr.version = EC_REC_VERSION;
+    hdr.header_size = EC_REC_HEADER_SIZE;
+    hdr.record_size = sizeof(ec_rec_t);
+    hdr.axes = (uint32_t)sc->axes;
+    hdr.capacity = 1;
+    while (hdr.capacity < cycles * (uint64_t)sc->axes) hdr.capacity <<= 1;
+    hdr.period_ns = sc->period_ns;
+    hdr.start_ns = sc->trigger_ns;
+    hdr.start_unix_s = (int64_t)time(NULL);
+    hdr.head = cycles * (uint64_t)sc->axes;
+    hdr.trigger = sc->cause;
+    hdr.trigger_axis = sc->trigger_axis;
+
+    f = fopen(path, "wb");
+    if (!f) return -1;
+    int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+             fwrite(zero, EC_REC_HEADER_SIZE - sizeof(hdr), 1, f) == 1;
+    for (uint64_t c = first; ok && c < sc->stored; c++) {
+        const ec_rec_t *r = &sc->ring[(size_t)(c & (sc->depth - 1)) * (size_t)sc->axes];
+        ok = fwrite(r, sizeof(ec_rec_t), (size_t)sc->axes, f) == (size_t)sc->axes;
+    }
+    if (fclose(f) != 0) ok = 0;
+    return ok ? (int)cycles : -1;
+}
+
+const char *ec_scope_cause_name(uint32_t cause, char *buf, int len) {
+    static const char *const names[] = { "fault", "overspeed", "wkc", "overrun" };
+    int used = 0;
+
+    if (len < 1) return buf;
+    buf[0] = '\0';
+    for (int b = 0; b < 4; b++) {
+        if (!(cause & (1u << b))) continue;
+        used += snprintf(buf + used, (size_t)(len - used), "%s%s", used ? "+" : "", names[b]);
+        if (used >= len) break;
+    }
+    return buf;
+}
@@ -0,0 +1,93 @@
+// ec_scope.h
+// Triggered capture ("scope") of the process image around faults and other events.
+// - Armed, the cyclic thread keeps the last cycles of every axis in a pre-allocated in-memory ring
+//   (records as in ec_recorder.h) and evaluates the trigger conditions. On a trigger it records
+//   'post' more cycles and freezes; the ring then holds up to 'pre' cycles before the trigger, the
+//   trigger cycle and 'post' cycles after it.
+// - The trigger is evaluated as bit masks over the axis arrays (one bit per axis, no branches per
+//   axis) and fires on the rising edge of a fault / overspeed bit, so a drive that stays in fault
+//   does not retrigger after re-arming. WKC mismatch and cycle overrun fire on every such cycle.
+// - Cost while armed (bench_axes, trig_ns_per_axis / scope_ns_per_axis): the trigger evaluation is about
+//   2 ns per axis from 8 axes up, on top of a fixed ~15 ns; the armed scope as a whole is 5-30 ns per
+//   axis, most of it the copy of one 32-byte record per axis into the pre-trigger ring.
+// - Saving (a file write) never happens in the cycle: another thread polls ec_scope_frozen(), writes
+//   the capture with ec_scope_save() as a recording file (tools/rec_export reads it, times relative to
+//   the trigger) and re-arms with ec_scope_arm().
+
+#ifndef EC_SCOPE_H
+#define EC_SCOPE_H
+
+#include <stdint.h>
+
+#include "ec_axes.h"
+#include "ec_recorder.h"
+
+// Trigger conditions
+#define EC_SCOPE_TRIG_FAULT     0x01    // fault bit (0x6041 bit 3) set on any axis
+#define EC_SCOPE_TRIG_OVERSPEED 0x02    // |0x606C| above velocity_limit on any axis
+#define EC_SCOPE_TRIG_WKC       0x04    // working counter not as expected
+#define EC_SCOPE_TRIG_OVERRUN   0x08    // the cyclic engine skipped a deadline
+#define EC_SCOPE_TRIG_ALL       0x0F
+
+typedef enum {
+    EC_SCOPE_IDLE = 0,                  // not armed
+    EC_SCOPE_ARMED,                     // filling the pre-trigger ring, evaluating the trigger
+    EC_SCOPE_TRIGGERED,                 // recording the post-trigger cycles
+    EC_SCOPE_FROZEN                     // capture complete, waiting for ec_scope_save / ec_scope_arm
+} ec_scope_state_t;
+
+typedef struct {
+    // configuration
+    uint32_t conditions;                // EC_SCOPE_TRIG_*
+    int32_t velocity_limit;             // rpm, for EC_SCOPE_TRIG_OVERSPEED
+    uint32_t pre, post;                 // cycles kept before / recorded after the trigger
+    int axes;
+    int64_t period_ns;
+
+    volatile uint32_t state;            // ec_scope_state_t
+
+    // cyclic thread
+    ec_rec_t *ring;                     // depth cycles x axes records
+    uint32_t depth;                     // cycles, power of two > pre + post
+    uint64_t stored;                    // cycles stored since armed
+    uint32_t remaining;                 // post-trigger cycles still to record
+    uint64_t prev_fault, prev_overspeed;    // per-axis bits of the previous cycle
+
+    // trigger, valid when frozen
+    uint32_t cause;                     // EC_SCOPE_TRIG_* that fired
+    int trigger_axis;                   // lowest axis that fired (-1 for WKC / overrun)
+    uint32_t trigger_cycle;
+    int64_t trigger_ns;
+    uint64_t trigger_index;             // value of 'stored' at the trigger cycle
+    uint32_t captures;                  // completed captures since init
+} ec_scope_t;
+
+// Allocate the ring for 'axes' axes and pre + post cycles. The scope starts idle.
+// Returns 0, or -1 if the memory cannot be allocated.
+int ec_scope_init(ec_scope_t *sc, int axes, int64_t period_ns, uint32_t pre, uint32_t post, uint32_t conditions,
+                  int32_t velocity_limit);
+void ec_scope_free(ec_scope_t *sc);
+
+// Any thread, while the scope is idle or frozen: start a new capture.
+void ec_scope_arm(ec_scope_t *sc);
+
+// Cyclic thread: evaluate the enabled trigger conditions of this cycle and track the edges. Returns the
+// EC_SCOPE_TRIG_* that fire; hit gets the axes whose fault / overspeed bit rose. Part of ec_scope_cycle,
+// public for bench_axes.
+uint32_t ec_scope_trigger(ec_scope_t *sc, const ec_axes_t *ax, int wkc_ok, int overrun, uint64_t *hit);
+
+// Cyclic thread, once per cycle after ec_axes_pack. overrun: the engine skipped a deadline before
+// this cycle.
+void ec_scope_cycle(ec_scope_t *sc, const ec_axes_t *ax, int64_t time_ns, uint32_t cycle, int wkc_ok, int overrun);
+
+// Any thread: the capture is complete.
+int ec_scope_frozen(const ec_scope_t *sc);
+
+// Any thread, once frozen: write the capture to path as a recording file (ec_recorder.h layout,
+// start_ns = trigger time). Returns the number of cycles written, or -1 on a file error.
+int ec_scope_save(const ec_scope_t *sc, const char *path);
+
+// Names of the bits of a cause mask, e.g. "fault+wkc".
+const char *ec_scope_cause_name(uint32_t cause, char *buf, int len);
+
+#endif // EC_SCOPE_H
@@ -0,0 +1,288 @@
+// ec_sdoasync.c
+// Non-blocking CoE SDO engine (see ec_sdoasync.h).
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "ec_sdoasync.h"
+#include "ec_cycle.h"
+
+#include <string.h>
+
+#include "ethercat.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define MBX_HDR         6       // length, address, channel/priority, type/counter
+#define MBXT_COE        0x03
+#define COES_SDOREQ     0x02
+#define COES_SDORES     0x03
+#define SDO_DOWN_EXP    0x23    // expedited download, size indicated (n in bits 2..3)
+#define SDO_DOWN_NORM   0x21    // normal download, size in the data field
+#define SDO_DOWN_RES    0x60
+#define SDO_UP_REQ      0x40
+#define SDO_ABORT       0x80
+#define SDO_FIXED       10      // CoE header + command + index + sub + 4-byte data/size field
+
+typedef char ec_sdoasync_mbx_fits[(sizeof(ec_mbxbuft) <= EC_SDOASYNC_MBX_SIZE) ? 1 : -1];
+
+static uint16_t rd16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t rd32(const uint8_t *p) { return (uint32_t)rd16(p) | ((uint32_t)rd16(p + 2) << 16); }
+static void wr16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void wr32(uint8_t *p, uint32_t v) { wr16(p, (uint16_t)v); wr16(p + 2, (uint16_t)(v >> 16)); }
+
+void ec_sdoasync_init(ec_sdoasync_t *eng) {
+    ec_sdoasync_init_ctx(eng, &ecx_context);
+}
+
+void ec_sdoasync_init_ctx(ec_sdoasync_t *eng, ecx_contextt *context) {
+    memset(eng, 0, sizeof(*eng));
+    eng->context = context;
+    eng->timeout_ns = EC_SDOASYNC_TIMEOUT_NS;
+}
+
+int ec_sdo_req_write(ec_sdo_req_t *req, uint16_t slave, uint16_t index, uint8_t sub, const void *data, int size) {
+    if (size <= 0 || size > EC_SDOASYNC_MAX_DATA) return -1;
+    memset(req, 0, sizeof(*req));
+    req->slave = slave;
+    req->index = index;
+    req->sub = sub;
+    req->write = 1;
+    req->size = size;
+    memcpy(req->data, data, (size_t)size);
+    return 0;
+}
+
+int ec_sdo_req_read(ec_sdo_req_t *req, uint16_t slave, uint16_t index, uint8_t sub, int size) {
+    if (size <= 0 || size > EC_SDOASYNC_MAX_DATA) return -1;
+    memset(req, 0, sizeof(*req));
+    req->slave = slave;
+    req->index = index;
+    req->sub = sub;
+    req->size = size;
+    return 0;
+}
+
+int ec_sdoasync_post(ec_sdoasync_t *eng, ec_sdo_req_t *req) {
+    uint32_t st = ec_atomic_load_u32(&req->status);
+    if (st == EC_SDO_QUEUED || st == EC_SDO_BUSY) return -1;
+
+    while (!ec_atomic_cas_u32(&eng->post_lock, 0, 1)) {
+        // posters only contend with each other, never with the cyclic poller
+    }
+    uint32_t head = eng->head;
+    if (head - ec_atomic_load_u32(&eng->tail) >= EC_SDOASYNC_QUEUE) {
+        ec_atomic_store_u32(&eng->post_lock, 0);
+        return -1;
+    }
+    req->abort_code = 0;
+    req->post_ns = ec_cycle_now_ns();
+    req->done_ns = 0;
+    ec_atomic_store_u32(&req->status, EC_SDO_QUEUED);
+    eng->queue[head & (EC_SDOASYNC_QUEUE - 1)] = req;
+    ec_atomic_store_u32(&eng->head, head + 1);
+    ec_atomic_store_u32(&eng->post_lock, 0);
+    return 0;
+}
+
+int ec_sdoasync_busy(const ec_sdoasync_t *eng) {
+    return eng->active != NULL || ec_atomic_load_u32(&eng->head) != ec_atomic_load_u32(&eng->tail);
+}
+
+static void finish(ec_sdoasync_t *eng, ec_sdo_req_t *req, uint32_t status) {
+    req->done_ns = ec_cycle_now_ns();
+    if (status == EC_SDO_DONE) eng->completed++;
+    else eng->failed++;
+    if (req->done_ns - req->post_ns > eng->max_latency_ns) eng->max_latency_ns = req->done_ns - req->post_ns;
+    if (eng->active == req) eng->active = NULL;
+    ec_atomic_store_u32(&req->status, status);
+    if (req->done) req->done(req);
+}
+
+// Finish a request without its reply. If it was on the wire, the reply may still come and must not
+// complete the next request to the slave: mark the slave for one more timeout.
+static void abandon(ec_sdoasync_t *eng, ec_sdo_req_t *req, uint32_t status) {
+    if (req->status == EC_SDO_BUSY && req->slave < EC_SDOASYNC_SLAVES) {
+        eng->stale_ns[req->slave] = ec_cycle_now_ns() + eng->timeout_ns;
+    }
+    finish(eng, req, status);
+}
+
+// Build the CoE request for req into eng->mbx. Returns 0, or -1 if it does not fit the mailbox.
+static int build_request(ec_sdoasync_t *eng, ec_sdo_req_t *req) {
+    uint8_t *m = eng->mbx;
+    uint16_t len = SDO_FIXED;
+    ec_slavet *sl = &eng->context->slavelist[req->slave];
+    uint16_t mbx_l = sl->mbx_l;
+
+    memset(m, 0, MBX_HDR + SDO_FIXED + EC_SDOASYNC_MAX_DATA);
+    sl->mbx_cnt = ec_nextmbxcnt(sl->mbx_cnt);
+    m[5] = (uint8_t)(MBXT_COE | (sl->mbx_cnt << 4));
+    wr16(m + 6, (uint16_t)(COES_SDOREQ << 12));
+    wr16(m + 9, req->index);
+    m[11] = req->sub;
+    if (!req->write) {
+        m[8] = SDO_UP_REQ;
+    } else if (req->size <= 4) {
+        m[8] = (uint8_t)(SDO_DOWN_EXP | ((4 - req->size) << 2));
+        memcpy(m + 12, req->data, (size_t)req->size);
+    } else {
+        m[8] = SDO_DOWN_NORM;
+        wr32(m + 12, (uint32_t)req->size);
+        memcpy(m + 16, req->data, (size_t)req->size);
+        len = (uint16_t)(len + req->size);
+    }
+    wr16(m, len);
+    return (mbx_l == 0 || MBX_HDR + len > mbx_l) ? -1 : 0;
+}
+
+// Match a received mailbox against the active request.
+// Returns the final status, or -1 if the mail belongs to something else.
+static int parse_reply(ec_sdoasync_t *eng, ec_sdo_req_t *req) {
+    const uint8_t *m = eng->mbx;
+    uint16_t len = rd16(m);
+    uint8_t cmd = m[8];
+
+    if ((m[5] & 0x0F) != MBXT_COE || len < SDO_FIXED) return -1;
+    if (rd16(m + 9) != req->index || m[11] != req->sub) return -1;
+    if (cmd == SDO_ABORT) {
+        req->abort_code = rd32(m + 12);
+        return EC_SDO_ABORTED;
+    }
+    if ((rd16(m + 6) >> 12) != COES_SDORES) return -1;
+    if (req->write) return cmd == SDO_DOWN_RES ? EC_SDO_DONE : EC_SDO_FAILED;
+
+    if ((cmd >> 5) != 2) return EC_SDO_FAILED;     // not an upload response
+    if (cmd & 0x02) {                               // expedited
+        int n = (cmd & 0x01) ? 4 - ((cmd >> 2) & 0x03) : 4;
+        if (n > req->size) return EC_SDO_FAILED;
+        memcpy(req->data, m + 12, (size_t)n);
+        req->size = n;
+        return EC_SDO_DONE;
+    }
+    uint32_t n = rd32(m + 12);                      // normal: complete size, data follows
+    if (n > (uint32_t)req->size || n + SDO_FIXED > len) return EC_SDO_FAILED;    // segmented: unsupported
+    memcpy(req->data, m + 16, n);
+    req->size = (int)n;
+    return EC_SDO_DONE;
+}
+
+int ec_sdoasync_poll(ec_sdoasync_t *eng, int max_steps) {
+    int steps = 0;
+
+    if (!ec_atomic_cas_u32(&eng->poll_lock, 0, 1)) return 0;
+    while (steps < max_steps) {
+        ec_sdo_req_t *req = eng->active;
+        int64_t now;
+
+        if (!req) {
+            uint32_t tail = eng->tail;
+            if (tail == ec_atomic_load_u32(&eng->head)) break;
+            req = eng->queue[tail & (EC_SDOASYNC_QUEUE - 1)];
+            ec_atomic_store_u32(&eng->tail, tail + 1);
+            if (!req) continue;     // cancelled while queued
+            eng->active = req;
+            if (req->slave < 1 || req->slave > *eng->context->slavecount || build_request(eng, req) != 0) {
+                finish(eng, req, EC_SDO_FAILED);
+                continue;
+            }
+        }
+
+        steps++;
+        now = ec_cycle_now_ns();
+        if (req->status == EC_SDO_QUEUED && req->slave < EC_SDOASYNC_SLAVES && eng->stale_ns[req->slave]) {
+            // one mailbox-full poll for the late reply of an abandoned request; sent once it is out
+            ec_clearmbx((ec_mbxbuft *)eng->mbx);
+            if (ecx_mbxreceive(eng->context, req->slave, (ec_mbxbuft *)eng->mbx, 0) > 0) {
+                eng->discarded++;
+                eng->stale_ns[req->slave] = 0;
+            } else if (now > eng->stale_ns[req->slave]) {
+                eng->stale_ns[req->slave] = 0;  // lost
+            } else if (now - req->post_ns > eng->timeout_ns) {
+                finish(eng, req, EC_SDO_TIMEOUT);
+                continue;
+            } else {
+                break;
+            }
+            if (build_request(eng, req) != 0) {     // the mailbox buffer held the discarded reply
+                finish(eng, req, EC_SDO_FAILED);
+            }
+            continue;
+        }
+        if (req->status == EC_SDO_QUEUED) {
+            // one mailbox write; 0 means the slave's receive mailbox is still full
+            if (ecx_mbxsend(eng->context, req->slave, (ec_mbxbuft *)eng->mbx, 0) > 0) {
+                eng->deadline_ns = now + eng->timeout_ns;
+                ec_atomic_store_u32(&req->status, EC_SDO_BUSY);
+            } else if (now - req->post_ns > eng->timeout_ns) {
+                finish(eng, req, EC_SDO_TIMEOUT);
+                continue;
+            }
+            break;  // the reply cannot be there yet
+        }
+
+        // one mailbox-full poll (+ read when there is mail)
+        ec_clearmbx((ec_mbxbuft *)eng->mbx);
+        if (ecx_mbxreceive(eng->context, req->slave, (ec_mbxbuft *)eng->mbx, 0) > 0) {
+            int st = parse_reply(eng, req);
+            if (st >= 0) {
+                finish(eng, req, (uint32_t)st);
+                continue;
+            }
+        }
+        if (now > eng->deadline_ns) {
+            abandon(eng, req, EC_SDO_TIMEOUT);
+            continue;
+        }
+        break;
+    }
+    eng->steps += (uint64_t)steps;
+    ec_atomic_store_u32(&eng->poll_lock, 0);
+    return steps;
+}
+
+void ec_sdoasync_flush(ec_sdoasync_t *eng) {
+    if (eng->active) abandon(eng, eng->active, EC_SDO_FAILED);
+    while (eng->tail != ec_atomic_load_u32(&eng->head)) {
+        ec_sdo_req_t *req = eng->queue[eng->tail & (EC_SDOASYNC_QUEUE - 1)];
+        ec_atomic_store_u32(&eng->tail, eng->tail + 1);
+        if (req) finish(eng, req, EC_SDO_FAILED);
+    }
+}
+
+uint32_t ec_sdoasync_cancel(ec_sdoasync_t *eng, ec_sdo_req_t *req) {
+    while (!ec_atomic_cas_u32(&eng->poll_lock, 0, 1)) {
+        // the poller holds the lock for at most its max_steps
+    }
+    if (!ec_sdo_req_finished(req)) {
+        if (eng->active == req) {
+            // its late reply is taken out of the mailbox before the next request to the slave
+            abandon(eng, req, EC_SDO_FAILED);
+        } else {
+            uint32_t head = ec_atomic_load_u32(&eng->head);
+            for (uint32_t i = eng->tail; i != head; i++) {
+                if (eng->queue[i & (EC_SDOASYNC_QUEUE - 1)] == req) eng->queue[i & (EC_SDOASYNC_QUEUE - 1)] = NULL;
+            }
+            finish(eng, req, EC_SDO_FAILED);
+        }
+    }
+    ec_atomic_store_u32(&eng->poll_lock, 0);
+    return ec_atomic_load_u32(&req->status);
+}
+
+uint32_t ec_sdoasync_wait(ec_sdo_req_t *req, int timeout_ms) {
+    for (int waited = 0; !ec_sdo_req_finished(req) && waited < timeout_ms; waited++) {
+#ifdef _WIN32
+        Sleep(1);
+#else
+        struct timespec ts = { 0, 1000000 };
+        nanosleep(&ts, NULL);
+#endif
+    }
+    return ec_atomic_load_u32(&req->status);
+}
@@ -0,0 +1,121 @@
+// ec_sdoasync.h
+// Non-blocking CoE SDO engine, so commissioning/readback traffic never stalls the process-data cycle.
+// - Any thread posts requests (ec_sdo_req_t owned by the caller) into a bounded queue.
+// - The thread that owns the bus advances the mailbox state machine a bounded number of steps per
+//   call (ec_sdoasync_poll), e.g. once per cycle right after the process-data exchange. One step is
+//   a single mailbox write or a single mailbox-full poll (+ read), i.e. one or two datagrams, and
+//   never a wait on the slave.
+// - A request completes through its 'done' callback (called on the polling thread - keep it short)
+//   and/or as a future: poll ec_sdo_req_finished() or block in ec_sdoasync_wait() from a non-cyclic thread.
+// Transfers are expedited (<= 4 bytes) or normal single-mailbox (<= EC_SDOASYNC_MAX_DATA bytes);
+// segmented transfers are not used. Uses SOEM's ecx_mbxsend / ecx_mbxreceive with zero timeouts, on the
+// global context or, with ec_sdoasync_init_ctx, on the context of one segment.
+// A reply carries only index / sub, so the reply to a request given up on the wire (timed out, cancelled
+// or flushed while busy) would complete the next request to the same object. The slave stays marked
+// until that reply has been taken out of its mailbox, or for one more timeout; its next request is sent
+// only then.
+
+#ifndef EC_SDOASYNC_H
+#define EC_SDOASYNC_H
+
+#include <stdint.h>
+
+#include "ec_atomic.h"
+
+#define EC_SDOASYNC_QUEUE       32          // pending requests, power of two
+#define EC_SDOASYNC_MAX_DATA    64          // bytes per transfer
+#define EC_SDOASYNC_MBX_SIZE    1488        // >= sizeof(ec_mbxbuft)
+#define EC_SDOASYNC_TIMEOUT_NS  100000000LL // default reply timeout per request (100 ms)
+#define EC_SDOASYNC_SLAVES      256         // slave positions tracked for late replies (> EC_MAXSLAVE)
+
+struct ecx_context;
+
+// Request status
+enum {
+    EC_SDO_IDLE = 0,
+    EC_SDO_QUEUED,      // posted, not on the wire yet
+    EC_SDO_BUSY,        // request sent, waiting for the reply
+    EC_SDO_DONE,        // finished statuses from here on
+    EC_SDO_ABORTED,     // slave answered with an SDO abort (abort_code)
+    EC_SDO_TIMEOUT,     // no reply within the timeout
+    EC_SDO_FAILED       // mailbox error, bad reply or engine flushed
+};
+
+typedef struct ec_sdo_req ec_sdo_req_t;
+typedef void (*ec_sdo_done_t)(ec_sdo_req_t *req);
+
+struct ec_sdo_req {
+    uint16_t slave;
+    uint16_t index;
+    uint8_t sub;
+    uint8_t write;                      // 1 = download (write), 0 = upload (read)
+    int size;                           // write: bytes to send; read: capacity in, bytes received out
+    uint8_t data[EC_SDOASYNC_MAX_DATA];
+    uint32_t abort_code;
+    int64_t post_ns;                    // ec_cycle_now_ns() at post
+    int64_t done_ns;                    // ec_cycle_now_ns() at completion
+    ec_sdo_done_t done;                 // optional completion callback (polling thread); a request
+                                        // with a callback stays owned by the engine until it returns
+    void *user;
+    volatile uint32_t status;           // EC_SDO_*
+};
+
+typedef struct {
+    struct ecx_context *context;        // segment the engine talks to
+    ec_sdo_req_t *queue[EC_SDOASYNC_QUEUE];
+    volatile uint32_t head;             // next slot to post (posters, under post_lock)
+    volatile uint32_t tail;             // next slot to start (poller only)
+    volatile uint32_t post_lock;
+    volatile uint32_t poll_lock;        // only one thread advances the state machine at a time
+
+    ec_sdo_req_t *active;               // request on the wire
+    int64_t deadline_ns;
+    int64_t timeout_ns;
+    uint8_t mbx[EC_SDOASYNC_MBX_SIZE];
+    int64_t stale_ns[EC_SDOASYNC_SLAVES];   // per slave: a late reply may still come until then, 0 = none
+
+    // statistics
+    uint64_t steps;
+    uint32_t completed;
+    uint32_t failed;                    // aborted + timed out + failed
+    uint32_t discarded;                 // late replies taken out of a mailbox
+    int64_t max_latency_ns;             // worst post -> completion time
+} ec_sdoasync_t;
+
+void ec_sdoasync_init(ec_sdoasync_t *eng);
+void ec_sdoasync_init_ctx(ec_sdoasync_t *eng, struct ecx_context *context);
+
+// Fill a request. Returns 0, or -1 if size exceeds EC_SDOASYNC_MAX_DATA.
+int ec_sdo_req_write(ec_sdo_req_t *req, uint16_t slave, uint16_t index, uint8_t sub, const void *data, int size);
+int ec_sdo_req_read(ec_sdo_req_t *req, uint16_t slave, uint16_t index, uint8_t sub, int size);
+
+// Queue a request (any thread). The request must stay alive until it has finished.
+// Returns 0, or -1 if the queue is full or the request is already pending.
+int ec_sdoasync_post(ec_sdoasync_t *eng, ec_sdo_req_t *req);
+
+// Advance the engine by at most max_steps bus transactions. Returns the number of steps taken
+// (0 when idle or when another thread is polling).
+int ec_sdoasync_poll(ec_sdoasync_t *eng, int max_steps);
+
+// Nonzero when there is queued or active work.
+int ec_sdoasync_busy(const ec_sdoasync_t *eng);
+
+// Fail the active and all queued requests with EC_SDO_FAILED (e.g. on disconnect). Call from the
+// polling thread or when no thread polls any more.
+void ec_sdoasync_flush(ec_sdoasync_t *eng);
+
+static inline int ec_sdo_req_finished(const ec_sdo_req_t *req) {
+    return ec_atomic_load_u32(&req->status) >= EC_SDO_DONE;
+}
+
+// Block the calling (non-cyclic) thread until req has finished or timeout_ms elapsed; someone else
+// must be polling the engine. Returns the request status; if it has not finished, the engine still
+// holds req: cancel it before req goes out of scope.
+uint32_t ec_sdoasync_wait(ec_sdo_req_t *req, int timeout_ms);
+
+// Take req out of the engine (any thread): a queued request is removed, the active one is abandoned,
+// either fails with EC_SDO_FAILED. Afterwards the engine holds no reference to req. Waits for a
+// concurrent ec_sdoasync_poll to return. Returns the final status (unchanged if it had finished).
+uint32_t ec_sdoasync_cancel(ec_sdoasync_t *eng, ec_sdo_req_t *req);
+
+#endif // EC_SDOASYNC_H
@@ -0,0 +1,443 @@
+// ec_segment.c
+// One EtherCAT segment per NIC on its own context and cyclic thread (see ec_segment.h).
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "ec_segment.h"
+#include "ec_pdocfg.h"
+#include "ec_atomic.h"
+
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#define cpu_relax() YieldProcessor()
+#define thread_yield() SwitchToThread()
+#else
+#include <sched.h>
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() ((void)0)
+#endif
+#define thread_yield() sched_yield()
+#endif
+
+#define START_CYCLES 10     // first common deadline this many periods after start (thread spin-up)
+#define SPIN_NS      20000  // busy-wait at the barrier this long, then also yield the core (fewer cores
+                            // than segments: the peer we wait for may need this one)
+
+static void bind_context(ec_segment_t *seg) {
+    ecx_contextt *ctx = &seg->context;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->port = &seg->port;
+    ctx->slavelist = &seg->slavelist[0];
+    ctx->slavecount = &seg->slavecount;
+    ctx->maxslave = EC_MAXSLAVE;
+    ctx->grouplist = &seg->grouplist[0];
+    ctx->maxgroup = EC_MAXGROUP;
+    ctx->esibuf = &seg->esibuf[0];
+    ctx->esimap = &seg->esimap[0];
+    ctx->elist = &seg->elist;
+    ctx->idxstack = &seg->idxstack;
+    ctx->ecaterror = &seg->ecaterror;
+    ctx->DCtime = &seg->DCtime;
+    ctx->SMcommtype = &seg->SMcommtype[0];
+    ctx->PDOassign = &seg->PDOassign[0];
+    ctx->PDOdesc = &seg->PDOdesc[0];
+    ctx->eepSM = &seg->eepSM;
+    ctx->eepFMMU = &seg->eepFMMU;
+    ctx->userdata = seg;
+}
+
+// PO2SOconfigx hook of every axis once connected: what a power cycle takes from a drive and
+// ecx_reconfig_slave does not restore, the compact mapping and SYNC0.
+static int reconfigure(ecx_contextt *context, uint16 slave) {
+    ec_segment_t *seg = (ec_segment_t *)context->userdata;
+
+    if ((seg->flags & EC_SEGMENT_COMPACT_PDO) && !ec_pdocfg_program_ctx(context, slave)) return 0;
+    if (seg->dc_sync) ec_dcsync_enable_ctx(context, &seg->dcsync, slave);
+    return 1;
+}
+
+static int fail(ec_segment_t *seg, const char *why) {
+    seg->error = why;
+    ecx_close(&seg->context);
+    return -1;
+}
+
+int ec_segment_connect(ec_segment_t *seg, const char *ifname, int64_t period_ns, uint32_t vendor, int flags) {
+    return ec_segment_connect_cached(seg, ifname, NULL, period_ns, vendor, flags, NULL);
+}
+
+int ec_segment_connect_redundant(ec_segment_t *seg, const char *ifname, const char *ifname2, int64_t period_ns,
+                                 uint32_t vendor, int flags) {
+    return ec_segment_connect_cached(seg, ifname, ifname2, period_ns, vendor, flags, NULL);
+}
+
+const char *ec_segment_phase_name(ec_connect_phase_t phase) {
+    static const char *const names[EC_CONNECT_PHASES] = {
+        "init", "scan", "pdo", "map", "dc", "axes", "sync0", "safe-op", "op"
+    };
+    return phase >= 0 && phase < EC_CONNECT_PHASES ? names[phase] : "?";
+}
+
+// Close the phase that started at *t0 and start the next one.
+static void phase_done(ec_segment_t *seg, ec_connect_phase_t phase, int64_t *t0) {
+    int64_t now = ec_cycle_now_ns();
+    seg->connect.phase_ns[phase] = now - *t0;
+    *t0 = now;
+}
+
+// One connect attempt; cached = the identity in topo was checked against the SII and matched.
+// Returns 0, -1 with seg->error set, or 1 if a drive refused the cached layout (context closed).
+static int connect_once(ec_segment_t *seg, const char *ifname, const char *ifname2, int64_t period_ns,
+                        uint32_t vendor, int flags, const ec_topo_t *topo) {
+    ecx_contextt *ctx = &seg->context;
+    int ring = ifname2 && ifname2[0];
+    int64_t t0 = ec_cycle_now_ns();
+
+    memset(seg, 0, sizeof(*seg));
+    bind_context(seg);
+    strncpy(seg->ifname, ifname, sizeof(seg->ifname) - 1);
+    if (ring) strncpy(seg->ifname2, ifname2, sizeof(seg->ifname2) - 1);
+    seg->cpu = -1;
+    seg->vendor = vendor;
+    seg->flags = flags;
+    seg->period_ns = period_ns;
+    ec_redundancy_init(&seg->red, ring);
+    ec_health_init(&seg->health);
+    ec_wkc_init(&seg->frames, period_ns);
+
+    if (ring ? !ecx_init_redundant(ctx, &seg->redport, ifname, seg->ifname2) : !ecx_init(ctx, ifname)) {
+        seg->error = ring ? "ecx_init_redundant failed (interface names, permissions)"
+                          : "ecx_init failed (interface name, permissions)";
+        return -1;
+    }
+    phase_done(seg, EC_CONNECT_INIT, &t0);
+    if (ecx_config_init(ctx, FALSE) <= 0) return fail(seg, "no slaves found");
+    phase_done(seg, EC_CONNECT_SCAN, &t0);
+    int cached = topo && ec_topo_match_ctx(topo, ctx, ifname, vendor, flags);
+    // same drives; a remap that kept the sizes would still pass SAFE-OP, so compare the mapping too
+    int remapped = cached && !ec_topo_verify_ctx(topo, ctx);
+    if (remapped) cached = 0;
+
+    // slaves are in PRE-OP now: program the compact mapping before the SyncManagers get sized. With a
+    // fingerprint the drives still hold it from the last connect (verified above; SAFE-OP below confirms
+    // the sizes).
+    if ((flags & EC_SEGMENT_COMPACT_PDO) && !cached) {
+        for (int s = 1; s <= seg->slavecount; s++) {
+            if (vendor != EC_AXES_ANY_VENDOR && seg->slavelist[s].eep_man != vendor) continue;
+            if (!ec_pdocfg_program_ctx(ctx, (uint16_t)s)) return fail(seg, "compact PDO mapping rejected");
+        }
+    }
+    phase_done(seg, EC_CONNECT_PDO, &t0);
+    if (cached) ec_topo_apply_ctx(topo, ctx);
+    if (ecx_config_map_group(ctx, seg->iomap, 0) > EC_SEGMENT_IOMAP) return fail(seg, "IOmap too small");
+    phase_done(seg, EC_CONNECT_MAP, &t0);
+    ecx_configdc(ctx);
+    if (cached) seg->connect.dc_delta_ns = ec_topo_dc_delta_ctx(topo, ctx);
+    seg->expected_wkc = seg->grouplist[0].outputsWKC * 2 + seg->grouplist[0].inputsWKC;
+    phase_done(seg, EC_CONNECT_DC, &t0);
+
+    if (cached && ec_topo_bind_axes_ctx(topo, ctx, &seg->axes) <= 0) {
+        ecx_close(ctx);
+        return 1;
+    }
+    if (!cached && ec_axes_discover_ctx(ctx, &seg->axes, vendor) == 0) {
+        return fail(seg, "no drive with 0x6040/0x6041 mapped");
+    }
+    phase_done(seg, EC_CONNECT_AXES, &t0);
+
+    if (flags & EC_SEGMENT_DC_SYNC) {
+        ec_dcsync_init(&seg->dcsync, period_ns, EC_DCSYNC_SHIFT_NS);
+        seg->dc_sync = 1;
+        for (int i = 0; i < seg->axes.count; i++) {
+            if (ec_dcsync_enable_ctx(ctx, &seg->dcsync, seg->axes.slave[i]) != 0) {
+                for (int j = 0; j < i; j++) ec_dcsync_disable_ctx(ctx, seg->axes.slave[j]);
+                seg->dc_sync = 0;   // free-run
+                break;
+            }
+        }
+    }
+    phase_done(seg, EC_CONNECT_SYNC0, &t0);
+
+    if (ecx_statecheck(ctx, 0, EC_STATE_SAFE_OP, EC_TIMEOUTSTATE) != EC_STATE_SAFE_OP && cached) {
+        // the SyncManager lengths from the fingerprint do not fit what the drives map now
+        for (int i = 0; seg->dc_sync && i < seg->axes.count; i++) ec_dcsync_disable_ctx(ctx, seg->axes.slave[i]);
+        ecx_close(ctx);
+        return 1;
+    }
+    phase_done(seg, EC_CONNECT_SAFE_OP, &t0);
+    for (int s = 0; s <= seg->slavecount; s++) seg->slavelist[s].state = EC_STATE_OPERATIONAL;
+    ecx_writestate(ctx, 0);
+    if (ecx_statecheck(ctx, 0, EC_STATE_OPERATIONAL, EC_TIMEOUTSTATE) != EC_STATE_OPERATIONAL) {
+        return fail(seg, "slaves failed to reach OPERATIONAL");
+    }
+    phase_done(seg, EC_CONNECT_OP, &t0);
+    seg->connect.topo = cached ? EC_TOPO_HIT : remapped ? EC_TOPO_STALE : EC_TOPO_NONE;
+    // only now: the connect itself has programmed the drives already (or found them programmed)
+    for (int i = 0; i < seg->axes.count; i++) seg->slavelist[seg->axes.slave[i]].PO2SOconfigx = reconfigure;
+    return 0;
+}
+
+int ec_segment_connect_cached(ec_segment_t *seg, const char *ifname, const char *ifname2, int64_t period_ns,
+                              uint32_t vendor, int flags, ec_topo_t *topo) {
+    int64_t t0 = ec_cycle_now_ns();
+    int ret = connect_once(seg, ifname, ifname2, period_ns, vendor, flags, topo);
+    int stale = ret == 1;
+
+    if (stale) ret = connect_once(seg, ifname, ifname2, period_ns, vendor, flags, NULL);
+    seg->connect.total_ns = ec_cycle_now_ns() - t0;
+    if (ret != 0) {
+        if (topo) memset(topo, 0, sizeof(*topo));
+        return -1;
+    }
+    if (stale) seg->connect.topo = EC_TOPO_STALE;
+    if (topo) ec_topo_capture_ctx(topo, &seg->context, &seg->axes, ifname, vendor, flags);
+    return 0;
+}
+
+void ec_segment_close(ec_segment_t *seg) {
+    ecx_contextt *ctx = &seg->context;
+
+    for (int i = 0; seg->dc_sync && i < seg->axes.count; i++) ec_dcsync_disable_ctx(ctx, seg->axes.slave[i]);
+    seg->slavelist[0].state = EC_STATE_INIT;
+    ecx_writestate(ctx, 0);
+    ecx_close(ctx);
+}
+
+void ec_segment_group_init(ec_segment_group_t *g, int64_t period_ns, ec_segment_hook_t hook, void *user) {
+    memset(g, 0, sizeof(*g));
+    g->period_ns = period_ns;
+    g->barrier_timeout_ns = period_ns / EC_SEGMENT_BARRIER_DIV;
+    g->health_slice_ns = EC_HEALTH_SLICE_NS;
+    g->hook = hook;
+    g->user = user;
+}
+
+int ec_segment_group_add(ec_segment_group_t *g, ec_segment_t *seg, int cpu) {
+    if (g->count >= EC_SEGMENT_MAX || seg->period_ns != g->period_ns) return -1;
+    seg->index = g->count;
+    seg->cpu = cpu;
+    seg->group = g;
+    g->seg[g->count] = seg;
+    return g->count++;
+}
+
+// Publish our tick and wait until every segment has reached it (or the timeout expired).
+// Returns the time waited.
+static int64_t barrier_wait(ec_segment_group_t *g, ec_segment_t *seg, uint32_t tick) {
+    int64_t start = ec_cycle_now_ns(), waited;
+
+    ec_atomic_store_u32(&g->arrived[seg->index], tick);
+    for (;;) {
+        int all = 1;
+        for (int i = 0; i < g->count && all; i++) {
+            all = (int32_t)(ec_atomic_load_u32(&g->arrived[i]) - tick) >= 0;
+        }
+        waited = ec_cycle_now_ns() - start;
+        if (all) break;
+        if (waited > g->barrier_timeout_ns || !ec_atomic_load_u32(&g->running)) {
+            seg->stats.barrier_timeouts++;
+            break;
+        }
+        if (waited > SPIN_NS) thread_yield();
+        else cpu_relax();
+    }
+    if (waited > seg->stats.max_barrier_ns) seg->stats.max_barrier_ns = waited;
+    return waited;
+}
+
+// Follow the supervisor: axes of a slave that went out of OP are marked offline, axes of a slave that
+// is back start over towards their target from whatever state the drive came back in.
+static void track_health(ec_segment_t *seg, int64_t now_ns) {
+    ec_axes_t *ax = &seg->axes;
+
+    seg->health_seen = ec_atomic_load_u32(&seg->health.changes);
+    seg->offline_axes = 0;
+    for (int i = 0; i < ax->count; i++) {
+        uint8_t down = ec_atomic_load_u32(&seg->health.slave[ax->slave[i]].down) != 0;
+        if (seg->offline[i] && !down) cia402_command(&ax->sm[i], ax->sm[i].target, now_ns);
+        seg->offline[i] = down;
+        seg->offline_axes += down;
+    }
+}
+
+static void segment_cycle(ec_cycle_t *cyc, void *user) {
+    ec_segment_t *seg = (ec_segment_t *)user;
+    ec_segment_group_t *g = seg->group;
+    // deadline index: executed cycles + skipped deadlines, identical on every segment
+    uint32_t tick = (uint32_t)(cyc->cycles + cyc->overruns);
+    int64_t t0 = ec_cycle_now_ns(), t1, waited = 0;
+
+    ecx_send_processdata(&seg->context);
+    seg->wkc = ecx_receive_processdata(&seg->context, EC_TIMEOUTRET);
+    t1 = ec_cycle_now_ns();
+    seg->stats.exchange_ns = t1 - t0;
+    if (seg->stats.exchange_ns > seg->stats.max_exchange_ns) seg->stats.max_exchange_ns = seg->stats.exchange_ns;
+    ec_wkc_cycle(&seg->frames, seg->wkc, seg->expected_wkc, seg->stats.exchange_ns);
+    ec_redundancy_cycle(&seg->red, seg->wkc, seg->expected_wkc);
+    ec_health_cycle(&seg->health, seg->wkc, seg->expected_wkc);
+
+    if (seg->dc_sync) ec_cycle_adjust(cyc, ec_dcsync_update(&seg->dcsync, seg->DCtime, cyc->wake_ns));
+
+    ec_axes_unpack(&seg->axes);
+    if (ec_atomic_load_u32(&seg->health.changes) != seg->health_seen) track_health(seg, cyc->wake_ns);
+    for (int i = 0; seg->offline_axes && i < seg->axes.count; i++) {
+        if (seg->offline[i]) seg->axes.statusword[i] = 0;     // not ready to switch on: no torque
+    }
+    ec_axes_update(&seg->axes, cyc->wake_ns);
+    seg->tick = tick;
+    if (g->count > 1) waited = barrier_wait(g, seg, tick);
+    if (g->hook) g->hook(seg, tick, g->user);
+    if (seg->frames.tripped) {
+        for (int i = 0; i < seg->axes.count; i++) seg->axes.target_torque[i] = 0;   // stale inputs: no torque
+    }
+    ec_axes_pack(&seg->axes);
+    if (seg->recorder) ec_recorder_write(seg->recorder, &seg->axes, cyc->wake_ns, tick, seg->wkc == seg->expected_wkc);
+    if (seg->scope) {
+        ec_scope_cycle(seg->scope, &seg->axes, cyc->wake_ns, tick, seg->wkc == seg->expected_wkc,
+                       cyc->overruns != seg->seen_overruns);
+    }
+    if (seg->shm) {
+        ec_shm_publish(seg->shm, &seg->axes, cyc->wake_ns, tick, seg->wkc,
+                       (seg->wkc == seg->expected_wkc ? EC_SHM_WKC_OK : 0) | (seg->frames.tripped ? EC_SHM_DROPPED : 0));
+    }
+    seg->seen_overruns = cyc->overruns;
+
+    int64_t end = ec_cycle_now_ns();
+    ec_hist_record(&seg->hist[EC_HIST_WAKE], cyc->last_late_ns);
+    ec_hist_record(&seg->hist[EC_HIST_EXCHANGE], seg->stats.exchange_ns);
+    ec_hist_record(&seg->hist[EC_HIST_APP], end - t1 - waited);
+    ec_hist_record(&seg->hist[EC_HIST_TOTAL], end - (cyc->wake_ns - cyc->last_late_ns));
+
+    if (!ec_atomic_load_u32(&g->running)) ec_cycle_stop(cyc);
+}
+
+static void run_segment(ec_segment_t *seg) {
+    seg->rt_error = ec_cycle_set_realtime(seg->group->priority, seg->cpu);
+    ec_cycle_run_at(&seg->cycle, seg->group->start_ns);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI segment_thread(LPVOID arg) {
+    run_segment((ec_segment_t *)arg);
+    return 0;
+}
+#else
+static void *segment_thread(void *arg) {
+    run_segment((ec_segment_t *)arg);
+    return NULL;
+}
+#endif
+
+// ecatcheck for the whole group: one bounded step per segment every EC_HEALTH_INTERVAL_NS.
+static void run_supervisor(ec_segment_group_t *g) {
+    while (ec_atomic_load_u32(&g->running)) {
+        for (int i = 0; i < g->count; i++) ec_health_step(&g->seg[i]->health, &g->seg[i]->context, g->health_slice_ns);
+#ifdef _WIN32
+        Sleep((DWORD)(EC_HEALTH_INTERVAL_NS / 1000000));
+#else
+        struct timespec ts = { 0, EC_HEALTH_INTERVAL_NS };
+        nanosleep(&ts, NULL);
+#endif
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI supervisor_thread(LPVOID arg) {
+    run_supervisor((ec_segment_group_t *)arg);
+    return 0;
+}
+#else
+static void *supervisor_thread(void *arg) {
+    run_supervisor((ec_segment_group_t *)arg);
+    return NULL;
+}
+#endif
+
+static void join_threads(ec_segment_group_t *g, int n);
+
+int ec_segment_group_start(ec_segment_group_t *g, int priority) {
+    g->priority = priority;
+    g->start_ns = ec_cycle_now_ns() + START_CYCLES * g->period_ns;
+    for (int i = 0; i < EC_SEGMENT_MAX; i++) g->arrived[i] = 0xFFFFFFFFu;     // tick -1
+    ec_atomic_store_u32(&g->running, 1);
+
+    for (int i = 0; i < g->count; i++) {
+        ec_segment_t *seg = g->seg[i];
+        memset(&seg->stats, 0, sizeof(seg->stats));
+        seg->seen_overruns = 0;
+        ec_wkc_arm(&seg->frames);
+        ec_health_init(&seg->health);
+        seg->health_seen = 0;
+        seg->offline_axes = 0;
+        memset(seg->offline, 0, sizeof(seg->offline));
+        for (int m = 0; m < EC_HIST_COUNT; m++) ec_hist_init(&seg->hist[m]);
+        if (ec_cycle_init(&seg->cycle, g->period_ns, segment_cycle, seg) != 0) {
+            seg->error = "unsupported cycle time";
+        } else {
+#ifdef _WIN32
+            seg->thread = CreateThread(NULL, 0, segment_thread, seg, 0, NULL);
+            if (seg->thread) continue;
+#else
+            if (pthread_create(&seg->thread, NULL, segment_thread, seg) == 0) continue;
+#endif
+            seg->error = "cannot create the cyclic thread";
+            ec_cycle_destroy(&seg->cycle);
+        }
+        // roll back: stop and join the threads already started
+        ec_segment_group_stop(g);
+        join_threads(g, i);
+        return -1;
+    }
+    g->supervised = 0;
+    if (g->health_slice_ns <= 0) return 0;
+#ifdef _WIN32
+    g->supervisor = CreateThread(NULL, 0, supervisor_thread, g, 0, NULL);
+    g->supervised = g->supervisor != NULL;
+#else
+    g->supervised = pthread_create(&g->supervisor, NULL, supervisor_thread, g) == 0;
+#endif
+    if (g->supervised) return 0;
+    g->seg[0]->error = "cannot create the supervisor thread";
+    ec_segment_group_stop(g);
+    join_threads(g, g->count);
+    return -1;
+}
+
+void ec_segment_group_stop(ec_segment_group_t *g) {
+    ec_atomic_store_u32(&g->running, 0);
+}
+
+static void join_threads(ec_segment_group_t *g, int n) {
+    for (int i = 0; i < n; i++) {
+        ec_segment_t *seg = g->seg[i];
+#ifdef _WIN32
+        WaitForSingleObject((HANDLE)seg->thread, INFINITE);
+        CloseHandle((HANDLE)seg->thread);
+        seg->thread = NULL;
+#else
+        pthread_join(seg->thread, NULL);
+#endif
+        ec_cycle_destroy(&seg->cycle);
+    }
+}
+
+void ec_segment_group_join(ec_segment_group_t *g) {
+    join_threads(g, g->count);
+    if (!g->supervised) return;
+#ifdef _WIN32
+    WaitForSingleObject((HANDLE)g->supervisor, INFINITE);
+    CloseHandle((HANDLE)g->supervisor);
+    g->supervisor = NULL;
+#else
+    pthread_join(g->supervisor, NULL);
+#endif
+    g->supervised = 0;
+}
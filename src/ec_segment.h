@@ -0,0 +1,206 @@
+// ec_segment.h
+// One EtherCAT segment per NIC, each on its own SOEM context and its own cyclic thread.
+// - A segment owns everything SOEM keeps per instance (ecx_contextt with its slave list, groups,
+//   DC time, ...) plus its IOmap, the axes found on it, its DC-sync controller and its statistics.
+//   Nothing goes through the global ec_* API, so several segments run side by side in one process.
+// - ec_segment_group_start() runs every segment on its own thread pinned to its own core. All threads
+//   wake on the same absolute deadlines; a cycle is send + receive, unpack, CiA402 update, barrier,
+//   application hook, pack.
+// - The barrier lets the hook of cycle k run only once every segment has unpacked the inputs of
+//   cycle k, so setpoints of axes coordinated across segments are computed from one consistent
+//   snapshot and leave on every segment in the frames of cycle k + 1.
+// - A segment never waits at the barrier longer than barrier_timeout_ns: late peers are counted
+//   and the cycle goes ahead with their previous inputs.
+// - Each segment locks its cycle to its own DC reference clock; the barrier also absorbs the phase
+//   between the segments' reference clocks.
+// - A segment opened on two NICs (ec_segment_connect_redundant) is a ring: after a cable break it keeps
+//   cycling on both halves of the line and counts the cycles lost to the failover (ec_redundancy.c).
+// - While the group runs, a supervisor thread brings slaves that dropped out of OP back (ec_health.c).
+//   The axes of a slave that is out read as not ready to switch on, so they get no torque, while the
+//   other axes keep theirs; once the slave is back in OP, its axes start over towards their target.
+// - Every cycle is classified as good, missing, partial WKC or late (ec_wkc.c); a run of bad cycles past
+//   the limits of seg->frames drops the torque of every axis of the segment until the next start.
+
+#ifndef EC_SEGMENT_H
+#define EC_SEGMENT_H
+
+#include <stdint.h>
+
+#include "ethercat.h"
+#include "ec_cycle.h"
+#include "ec_dcsync.h"
+#include "ec_axes.h"
+#include "ec_redundancy.h"
+#include "ec_hist.h"
+#include "ec_recorder.h"
+#include "ec_scope.h"
+#include "ec_topo.h"
+#include "ec_health.h"
+#include "ec_wkc.h"
+#include "ec_shm.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#define EC_SEGMENT_MAX          4       // segments (NICs) per group
+#define EC_SEGMENT_IOMAP        4096    // IOmap bytes per segment
+#define EC_SEGMENT_BARRIER_DIV  2       // default barrier timeout = period / EC_SEGMENT_BARRIER_DIV
+
+// ec_segment_connect() flags
+#define EC_SEGMENT_COMPACT_PDO  0x01    // program the ec_pdocfg.c mapping on every axis in PRE-OP
+#define EC_SEGMENT_DC_SYNC      0x02    // SYNC0 on every axis, cycle locked to the reference clock
+
+typedef struct ec_segment ec_segment_t;
+typedef struct ec_segment_group ec_segment_group_t;
+
+// Application hook of a group, called on each segment's thread after the barrier of cycle 'tick'
+// (deadline index since start, equal on all segments). Writes the setpoint arrays of seg->axes;
+// may read the input arrays of the other segments of the group.
+typedef void (*ec_segment_hook_t)(ec_segment_t *seg, uint32_t tick, void *user);
+
+typedef struct {
+    int64_t exchange_ns;        // send + receive of the last cycle
+    int64_t max_exchange_ns;
+    int64_t max_barrier_ns;     // longest wait for the other segments
+    uint64_t barrier_timeouts;  // cycles that went ahead without every peer
+} ec_segment_stats_t;
+
+// Phases of ec_segment_connect(), in order
+typedef enum {
+    EC_CONNECT_INIT = 0,        // open the NIC(s)
+    EC_CONNECT_SCAN,            // ecx_config_init: count slaves, read their SII, PRE-OP
+    EC_CONNECT_PDO,             // program the compact PDO mapping over CoE
+    EC_CONNECT_MAP,             // ecx_config_map_group: PDO assignment over CoE, SM / FMMU, IOmap
+    EC_CONNECT_DC,              // ecx_configdc: propagation delays, reference clock
+    EC_CONNECT_AXES,            // PDO mapping of every axis over CoE (or from the fingerprint)
+    EC_CONNECT_SYNC0,           // SYNC0 on every axis
+    EC_CONNECT_SAFE_OP,
+    EC_CONNECT_OP,
+    EC_CONNECT_PHASES
+} ec_connect_phase_t;
+
+typedef struct {
+    int64_t phase_ns[EC_CONNECT_PHASES];    // of the attempt that connected
+    int64_t total_ns;                       // including a refused cached attempt
+    ec_topo_result_t topo;
+    int32_t dc_delta_ns;                    // largest propagation delay change against the fingerprint
+} ec_segment_connect_t;
+
+struct ec_segment {
+    int index;                  // position in the group
+    char ifname[128];
+    char ifname2[128];          // secondary NIC of a ring, "" if none
+    int cpu;                    // core of the cyclic thread (-1 = not pinned)
+    int rt_error;               // ec_cycle_set_realtime() result of the cyclic thread
+    const char *error;          // why ec_segment_connect() failed
+    ec_segment_connect_t connect;   // where the time of the connect went
+
+    // SOEM instance
+    ecx_contextt context;
+    ecx_portt port;
+    ecx_redportt redport;
+    ec_slavet slavelist[EC_MAXSLAVE];
+    int slavecount;
+    ec_groupt grouplist[EC_MAXGROUP];
+    uint8 esibuf[EC_MAXEEPBUF];
+    uint32 esimap[EC_MAXEEPBITMAP];
+    ec_eringt elist;
+    ec_idxstackT idxstack;
+    boolean ecaterror;
+    int64 DCtime;
+    ec_SMcommtypet SMcommtype[EC_MAX_MAPT];
+    ec_PDOassignt PDOassign[EC_MAX_MAPT];
+    ec_PDOdesct PDOdesc[EC_MAX_MAPT];
+    ec_eepromSMt eepSM;
+    ec_eepromFMMUt eepFMMU;
+    EC_AXES_ALIGN uint8 iomap[EC_SEGMENT_IOMAP];
+
+    ec_axes_t axes;
+    uint32_t vendor;            // vendor and flags of the connect
+    int flags;
+    int64_t period_ns;
+    int dc_sync;
+    ec_dcsync_t dcsync;
+    int expected_wkc;
+    int wkc;                    // working counter of the last cycle
+    ec_wkc_t frames;            // missing / partial / late frames since the connect; limits may be changed
+                                // between the connect and ec_segment_group_start
+    uint32_t tick;              // deadline index of the last cycle
+    ec_redundancy_t red;        // failover accounting (also kept without a ring)
+    ec_health_t health;         // slave supervision
+    uint32_t health_seen;       // health.changes the cyclic thread last acted on
+    int offline_axes;           // axes whose slave is out of OP (cyclic thread)
+    uint8_t offline[EC_AXES_MAX];
+
+    ec_cycle_t cycle;
+    ec_segment_stats_t stats;
+    ec_hist_t hist[EC_HIST_COUNT];  // per-cycle latencies, readable and resettable while running
+    ec_recorder_t *recorder;        // set before ec_segment_group_start to record every cycle, or NULL
+    ec_scope_t *scope;              // same for a triggered capture (armed and saved by the application)
+    ec_shm_t *shm;                  // same to publish every cycle in shared memory (inputs taken by the hook)
+    uint64_t seen_overruns;         // cycle.overruns at the previous cycle
+    ec_segment_group_t *group;
+#ifdef _WIN32
+    void *thread;               // HANDLE
+#else
+    pthread_t thread;
+#endif
+};
+
+struct ec_segment_group {
+    int count;
+    ec_segment_t *seg[EC_SEGMENT_MAX];
+    int64_t period_ns;
+    int64_t barrier_timeout_ns;
+    int priority;               // real-time priority of the cyclic threads
+    int64_t health_slice_ns;    // acyclic work of the supervisor per segment and interval, 0 = no supervisor
+    ec_segment_hook_t hook;
+    void *user;
+    int64_t start_ns;           // common deadline of cycle 0
+    volatile uint32_t running;
+    volatile uint32_t arrived[EC_SEGMENT_MAX];  // tick each segment last reached the barrier with
+    int supervised;             // the supervisor thread runs
+#ifdef _WIN32
+    void *supervisor;           // HANDLE
+#else
+    pthread_t supervisor;
+#endif
+};
+
+// Open ifname, bind the axes of 'vendor' (EC_AXES_ANY_VENDOR = all CiA402 slaves) and bring the
+// segment to OP. Returns 0, or -1 with seg->error set (the context is closed again).
+int ec_segment_connect(ec_segment_t *seg, const char *ifname, int64_t period_ns, uint32_t vendor, int flags);
+
+// Same on a ring from ifname back to ifname2 (ecx_init_redundant); ifname2 NULL or "" = no ring.
+int ec_segment_connect_redundant(ec_segment_t *seg, const char *ifname, const char *ifname2, int64_t period_ns,
+                                 uint32_t vendor, int flags);
+
+// Same, reusing the fingerprint of an earlier connect to this NIC (ec_topo.h) if topo holds one; on
+// success topo is replaced by the fingerprint of this connect for the caller to keep. topo NULL = cold.
+int ec_segment_connect_cached(ec_segment_t *seg, const char *ifname, const char *ifname2, int64_t period_ns,
+                              uint32_t vendor, int flags, ec_topo_t *topo);
+
+const char *ec_segment_phase_name(ec_connect_phase_t phase);
+
+// Leave OP, stop SYNC0 and close the context (the cyclic thread must have been joined).
+void ec_segment_close(ec_segment_t *seg);
+
+void ec_segment_group_init(ec_segment_group_t *g, int64_t period_ns, ec_segment_hook_t hook, void *user);
+
+// Add a connected segment whose cyclic thread will run on 'cpu' (-1 = no affinity).
+// Returns its index, or -1 if the group is full or the segment runs another period.
+int ec_segment_group_add(ec_segment_group_t *g, ec_segment_t *seg, int cpu);
+
+// Start one cyclic thread per segment, all on the same deadlines from a few cycles from now, and the
+// supervisor (normal priority, not pinned). Returns 0, or -1 if a thread could not be created (the ones
+// already running are stopped).
+int ec_segment_group_start(ec_segment_group_t *g, int priority);
+
+// Request every thread to return after its current cycle (any thread, also from the hook).
+void ec_segment_group_stop(ec_segment_group_t *g);
+
+// Wait for the cyclic threads and the supervisor to finish.
+void ec_segment_group_join(ec_segment_group_t *g);
+
+#endif // EC_SEGMENT_H
@@ -0,0 +1,253 @@
+// ec_shm.c
+// Process image in named shared memory (see ec_shm.h).
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "ec_shm.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#define PAGE 4096
+
+static void shm_name(ec_shm_t *m, int segment) {
+#ifdef _WIN32
+    snprintf(m->name, sizeof(m->name), "Local\\l7nh_seg%d", segment);
+#else
+    snprintf(m->name, sizeof(m->name), "/l7nh_seg%d", segment);
+#endif
+}
+
+static int map_area(ec_shm_t *m, int create) {
+    size_t size = sizeof(ec_shm_area_t);
+#ifdef _WIN32
+    m->mapping = create ? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size, m->name)
+                        : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, m->name);
+    if (!m->mapping) return -1;
+    m->area = (ec_shm_area_t *)MapViewOfFile((HANDLE)m->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!m->area) {
+        CloseHandle((HANDLE)m->mapping);
+        return -1;
+    }
+    if (create) VirtualLock(m->area, size);
+#else
+    m->fd = shm_open(m->name, create ? O_RDWR | O_CREAT : O_RDWR, 0660);
+    if (m->fd < 0) return -1;
+    if (create && ftruncate(m->fd, (off_t)size) != 0) {
+        close(m->fd);
+        shm_unlink(m->name);
+        return -1;
+    }
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0);
+    if (p == MAP_FAILED) {
+        close(m->fd);
+        if (create) shm_unlink(m->name);
+        return -1;
+    }
+    m->area = (ec_shm_area_t *)p;
+    if (create) mlock(p, size);
+#endif
+    return 0;
+}
+
+int ec_shm_create(ec_shm_t *m, int segment, const ec_axes_t *ax, int64_t period_ns, int setpoint_rpm) {
+    memset(m, 0, sizeof(*m));
+    shm_name(m, segment);
+    if (map_area(m, 1) != 0) {
+        m->area = NULL;
+        return -1;
+    }
+    m->owner = 1;
+
+    // a crashed owner may have left an area behind: start over, and touch every page now so the cyclic
+    // thread never takes a page fault
+    ec_shm_area_t *a = m->area;
+    for (size_t off = 0; off < sizeof(*a); off += PAGE) ((volatile uint8_t *)a)[off] = 0;
+    memset(a, 0, sizeof(*a));
+    a->version = EC_SHM_VERSION;
+    a->size = sizeof(*a);
+    a->segment = segment;
+    a->axes = (uint32_t)ax->count;
+    a->period_ns = period_ns;
+    a->hold_ns = EC_SHM_HOLD_NS;
+    a->setpoint_rpm = setpoint_rpm != 0;
+    for (int i = 0; i < ax->count; i++) a->slave[i] = ax->slave[i];
+    ec_atomic_thread_fence();
+    memcpy(a->magic, EC_SHM_MAGIC, sizeof(a->magic));   // last: an attaching reader sees a complete header
+    return 0;
+}
+
+int ec_shm_attach(ec_shm_t *m, int segment) {
+    memset(m, 0, sizeof(*m));
+    shm_name(m, segment);
+    if (map_area(m, 0) != 0) {
+        m->area = NULL;
+        return -1;
+    }
+    if (memcmp(m->area->magic, EC_SHM_MAGIC, sizeof(m->area->magic)) != 0 || m->area->version != EC_SHM_VERSION ||
+        m->area->size != sizeof(ec_shm_area_t)) {
+        ec_shm_close(m);
+        return -1;
+    }
+    return 0;
+}
+
+void ec_shm_close(ec_shm_t *m) {
+    if (!m->area) return;
+#ifdef _WIN32
+    if (m->owner) VirtualUnlock(m->area, sizeof(ec_shm_area_t));
+    UnmapViewOfFile(m->area);
+    CloseHandle((HANDLE)m->mapping);
+#else
+    munmap(m->area, sizeof(ec_shm_area_t));
+    close(m->fd);
+    if (m->owner) shm_unlink(m->name);
+#endif
+    m->area = NULL;
+}
+
+void ec_shm_set_running(ec_shm_t *m, int running) {
+    ec_shm_status_t *st = &m->area->status;
+
+    if (running) {
+        m->seen = ec_atomic_load_u32(&m->area->input.seq);   // a commit of an earlier run is not picked up
+        m->mask = 0;
+        m->lapsed = 0;
+    }
+    ec_atomic_store_u32(&st->flags, running ? st->flags | EC_SHM_RUNNING : st->flags & ~(uint32_t)EC_SHM_RUNNING);
+}
+
+uint64_t ec_shm_take(ec_shm_t *m, int64_t now_ns) {
+    ec_shm_input_t *in = &m->area->input;
+    uint32_t s1 = ec_atomic_load_u32(&in->seq);
+
+    if (s1 & 1u) {
+        ec_atomic_store_u32(&in->torn, in->torn + 1);
+    } else if (s1 != m->seen) {
+        uint64_t mask = in->mask;
+        int32_t value[EC_AXES_MAX];
+        for (int i = 0; i < EC_AXES_MAX; i++) value[i] = in->value[i];
+        ec_atomic_thread_fence();
+        if (ec_atomic_load_u32(&in->seq) != s1) {
+            ec_atomic_store_u32(&in->torn, in->torn + 1);   // overwritten meanwhile: the next cycle takes it
+        } else {
+            m->seen = s1;
+            m->taken_ns = now_ns;
+            m->lapsed = 0;
+            m->mask = mask;
+            memcpy(m->value, value, sizeof(value));
+            ec_atomic_store_u32(&in->taken, in->taken + 1);
+            return m->mask;
+        }
+    }
+    if (m->mask && !m->lapsed && now_ns - m->taken_ns > m->area->hold_ns) {
+        m->lapsed = 1;
+        memset(m->value, 0, sizeof(m->value));
+        ec_atomic_store_u32(&in->lapsed, in->lapsed + 1);
+    }
+    return m->mask;
+}
+
+void ec_shm_publish(ec_shm_t *m, const ec_axes_t *ax, int64_t time_ns, uint32_t tick, int wkc, uint32_t flags) {
+    ec_shm_status_t *st = &m->area->status;
+    uint32_t seq = st->seq;
+
+    ec_atomic_store_u32(&st->seq, seq + 1);
+    ec_atomic_thread_fence();       // the odd seq is visible before any of the data changes
+    st->tick = tick;
+    st->time_ns = time_ns;
+    st->wkc = wkc;
+    st->flags = (flags & ~(uint32_t)(EC_SHM_RUNNING | EC_SHM_LAPSED)) | (st->flags & EC_SHM_RUNNING) |
+                (m->lapsed ? EC_SHM_LAPSED : 0);
+    st->input_mask = m->mask;
+    for (int i = 0; i < ax->count; i++) {
+        st->statusword[i] = ax->statusword[i];
+        st->controlword[i] = ax->controlword[i];
+        st->target_torque[i] = ax->target_torque[i];
+        st->actual_torque[i] = ax->actual_torque[i];
+        st->velocity[i] = ax->actual_velocity[i];
+        st->position[i] = ax->actual_position[i];
+        st->error_code[i] = ax->error_code[i];
+        st->enabled[i] = ax->enabled[i];
+    }
+    ec_atomic_store_u32(&st->seq, seq + 2);
+}
+
+static uint32_t self_id(void) {
+#ifdef _WIN32
+    return (uint32_t)GetCurrentProcessId();
+#else
+    return (uint32_t)getpid();
+#endif
+}
+
+// The holder of the writer lock no longer exists (it died between lock and unlock).
+static int holder_gone(uint32_t pid) {
+#ifdef _WIN32
+    HANDLE h = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+    if (!h) return GetLastError() == ERROR_INVALID_PARAMETER;
+    int gone = WaitForSingleObject(h, 0) == WAIT_OBJECT_0;
+    CloseHandle(h);
+    return gone;
+#else
+    return kill((pid_t)pid, 0) != 0 && errno == ESRCH;
+#endif
+}
+
+int ec_shm_set(ec_shm_t *m, uint64_t mask, const int32_t *value) {
+    ec_shm_input_t *in = &m->area->input;
+    uint32_t me = self_id(), holder = 0;
+
+    for (int spins = 0; !ec_atomic_cas_u32(&in->lock, 0, me); spins++) {
+        holder = ec_atomic_load_u32(&in->lock);
+        if (spins < EC_SHM_LOCK_SPINS) continue;
+        if (holder == 0 || !holder_gone(holder) || !ec_atomic_cas_u32(&in->lock, holder, me)) return -1;
+        break;
+    }
+    uint32_t seq = in->seq & ~1u;   // a writer that died half way left it odd
+    ec_atomic_store_u32(&in->seq, seq + 1);
+    ec_atomic_thread_fence();
+    in->mask = mask;
+    for (int i = 0; i < EC_AXES_MAX; i++) in->value[i] = (mask >> i) & 1u ? value[i] : 0;
+    ec_atomic_store_u32(&in->seq, seq + 2);
+    ec_atomic_store_u32(&in->commits, in->commits + 1);
+    ec_atomic_store_u32(&in->lock, 0);
+    return 0;
+}
+
+void ec_shm_snapshot(const ec_shm_t *m, ec_shm_status_t *out) {
+    const ec_shm_status_t *st = &m->area->status;
+    uint32_t begin;
+
+    do {
+        begin = ec_shm_read_begin(m);
+        out->tick = st->tick;
+        out->time_ns = st->time_ns;
+        out->wkc = st->wkc;
+        out->flags = st->flags;
+        out->input_mask = st->input_mask;
+        for (int i = 0; i < EC_AXES_MAX; i++) {
+            out->statusword[i] = st->statusword[i];
+            out->controlword[i] = st->controlword[i];
+            out->target_torque[i] = st->target_torque[i];
+            out->actual_torque[i] = st->actual_torque[i];
+            out->velocity[i] = st->velocity[i];
+            out->position[i] = st->position[i];
+            out->error_code[i] = st->error_code[i];
+            out->enabled[i] = st->enabled[i];
+        }
+    } while (ec_shm_read_retry(m, begin));
+    out->seq = begin;
+}
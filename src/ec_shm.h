@@ -0,0 +1,141 @@
+// ec_shm.h
+// Process image of a segment in named shared memory, for other local processes (vision, PLC, ...).
+// - One area per segment: POSIX shm_open("/l7nh_seg<N>"), on Windows a pagefile-backed mapping
+//   "Local\l7nh_seg<N>". The owner (control core) creates, sizes, maps, touches and locks it once; the
+//   cyclic thread then only stores into it. Other processes map the same pages: no copy, no syscall.
+// - Status: after the pack of every cycle the cyclic thread writes the inputs and outputs of every
+//   axis under a seqlock (seq odd while writing). Readers never block the writer: they read in place
+//   between ec_shm_read_begin() and ec_shm_read_retry() and go again if a cycle overwrote them, or take
+//   a copy with ec_shm_snapshot(). The data is at most one cycle old.
+// - Setpoint input: a writer process takes the writer lock (a CAS among writers only, never held by the
+//   cyclic thread), writes an axis mask and one value per axis under a second seqlock and commits. At the
+//   start of its cycle the cyclic thread copies a complete commit with ec_shm_take(); one that is being
+//   written is left for the next cycle, so the cycle never waits and never sees half of one.
+// - A commit lasts until the next one. If none comes within hold_ns the input lapses: the masked axes
+//   get setpoint 0 until a writer commits again. Mask 0 hands every axis back to the owner. Once the
+//   owner stops, its stop ramp starts from the last input and later commits are ignored.
+// - Units of the values: 0x6071 torque, or rpm when the header says setpoint_rpm (velocity PI).
+// - Layout version EC_SHM_VERSION; everything is native endian and aligned, so C readers can map
+//   ec_shm_area_t directly.
+
+#ifndef EC_SHM_H
+#define EC_SHM_H
+
+#include <stdint.h>
+
+#include "ec_axes.h"
+#include "ec_atomic.h"
+
+#define EC_SHM_MAGIC        "L7NHSHM1"
+#define EC_SHM_VERSION      1
+#define EC_SHM_HOLD_NS      100000000LL     // default: an input lapses 100 ms after its last commit
+#define EC_SHM_LOCK_SPINS   100000          // ec_shm_set gives up on the writer lock after this many tries
+
+// ec_shm_status_t.flags
+#define EC_SHM_RUNNING      0x0001          // the cycle runs; otherwise the status is that of the last cycle
+#define EC_SHM_WKC_OK       0x0002          // working counter of the cycle as expected
+#define EC_SHM_DROPPED      0x0004          // torque dropped after bad frames (ec_wkc.h)
+#define EC_SHM_LAPSED       0x0008          // the input lapsed, its axes are at 0
+
+typedef struct {
+    volatile uint32_t seq;                  // odd while the cyclic thread writes
+    volatile uint32_t tick;                 // deadline index of the cycle
+    volatile int64_t time_ns;               // cycle wakeup (monotonic clock of the owner)
+    volatile int32_t wkc;
+    volatile uint32_t flags;                // EC_SHM_*
+    volatile uint64_t input_mask;           // axes driven by the input in this cycle
+    EC_AXES_ALIGN volatile uint16_t statusword[EC_AXES_MAX];
+    EC_AXES_ALIGN volatile uint16_t controlword[EC_AXES_MAX];
+    EC_AXES_ALIGN volatile int16_t target_torque[EC_AXES_MAX];
+    EC_AXES_ALIGN volatile int16_t actual_torque[EC_AXES_MAX];
+    EC_AXES_ALIGN volatile int32_t velocity[EC_AXES_MAX];
+    EC_AXES_ALIGN volatile int32_t position[EC_AXES_MAX];
+    EC_AXES_ALIGN volatile uint16_t error_code[EC_AXES_MAX];
+    EC_AXES_ALIGN volatile uint8_t enabled[EC_AXES_MAX];
+} ec_shm_status_t;
+
+typedef struct {
+    volatile uint32_t lock;                 // writer lock: 0 free, else pid of the holder
+    volatile uint32_t seq;                  // odd while a writer writes
+    volatile uint32_t commits;              // by writers
+    volatile uint64_t mask;                 // axes to drive
+    EC_AXES_ALIGN volatile int32_t value[EC_AXES_MAX];
+    // by the cyclic thread
+    volatile uint32_t taken;                // commits picked up
+    volatile uint32_t torn;                 // cycles that found a commit being written
+    volatile uint32_t lapsed;               // inputs that lapsed
+} ec_shm_input_t;
+
+typedef struct {
+    char magic[8];                          // EC_SHM_MAGIC
+    uint32_t version;
+    uint32_t size;                          // sizeof(ec_shm_area_t)
+    int32_t segment;
+    uint32_t axes;
+    int64_t period_ns;
+    int64_t hold_ns;
+    uint32_t setpoint_rpm;                  // input values are rpm (velocity PI), else 0x6071 torque
+    uint16_t slave[EC_AXES_MAX];            // slave of every axis
+    EC_AXES_ALIGN ec_shm_status_t status;
+    EC_AXES_ALIGN ec_shm_input_t input;
+} ec_shm_area_t;
+
+typedef struct {
+    ec_shm_area_t *area;
+    int owner;                              // created it (unlinked on close)
+    char name[32];
+    // owner's cyclic thread: the input as last taken
+    uint32_t seen;                          // input.seq of the last commit taken
+    int64_t taken_ns;                       // when it was taken
+    int lapsed;
+    uint64_t mask;
+    int32_t value[EC_AXES_MAX];
+#ifdef _WIN32
+    void *mapping;                          // HANDLE
+#else
+    int fd;
+#endif
+} ec_shm_t;
+
+// Owner: create (or take over) the area of segment 'segment' for 'axes' axes. Returns 0, or -1 if the
+// shared memory cannot be created or mapped.
+int ec_shm_create(ec_shm_t *m, int segment, const ec_axes_t *ax, int64_t period_ns, int setpoint_rpm);
+
+// Other processes: map the area of a segment. Returns 0, or -1 if there is none (or another version).
+int ec_shm_attach(ec_shm_t *m, int segment);
+
+// Unmap; the owner also removes the name.
+void ec_shm_close(ec_shm_t *m);
+
+// Owner, while no cycle runs: mark the cycle as about to run (EC_SHM_RUNNING; commits made before are
+// not picked up) or as stopped.
+void ec_shm_set_running(ec_shm_t *m, int running);
+
+// Owner's cyclic thread, at the start of the cycle: pick up the newest complete commit. Returns the mask
+// of axes driven by the input; their values are in m->value (0 once lapsed).
+uint64_t ec_shm_take(ec_shm_t *m, int64_t now_ns);
+
+// Owner's cyclic thread, after the pack: publish the process image of the cycle. flags: EC_SHM_* besides
+// RUNNING and LAPSED, which ec_shm_publish keeps itself.
+void ec_shm_publish(ec_shm_t *m, const ec_axes_t *ax, int64_t time_ns, uint32_t tick, int wkc, uint32_t flags);
+
+// Writer process: drive the axes in mask with value[axis] from the next cycle on (mask 0 releases them).
+// Returns 0, or -1 if another writer held the lock for EC_SHM_LOCK_SPINS tries.
+int ec_shm_set(ec_shm_t *m, uint64_t mask, const int32_t *value);
+
+// Reader: in-place read of area->status. Reads between begin and retry are consistent if retry returns 0.
+static inline uint32_t ec_shm_read_begin(const ec_shm_t *m) {
+    uint32_t s;
+    while ((s = ec_atomic_load_u32(&m->area->status.seq)) & 1u) { }
+    return s;
+}
+
+static inline int ec_shm_read_retry(const ec_shm_t *m, uint32_t begin) {
+    ec_atomic_thread_fence();
+    return ec_atomic_load_u32(&m->area->status.seq) != begin;
+}
+
+// Reader: consistent copy of the status of the last cycle.
+void ec_shm_snapshot(const ec_shm_t *m, ec_shm_status_t *out);
+
+#endif // EC_SHM_H
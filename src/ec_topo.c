@@ -0,0 +1,173 @@
+// ec_topo.c
+// Topology fingerprint of a segment (see ec_topo.h).
+
+#include "ec_topo.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FNV_OFFSET  2166136261u
+#define FNV_PRIME   16777619u
+#define PAYLOAD(t)  ((const uint8_t *)(t) + offsetof(ec_topo_t, ifname))
+
+static uint32_t checksum(const ec_topo_t *t) {
+    const uint8_t *p = PAYLOAD(t);
+    uint32_t h = FNV_OFFSET;
+    for (size_t i = 0; i < sizeof(*t) - offsetof(ec_topo_t, ifname); i++) h = (h ^ p[i]) * FNV_PRIME;
+    return h;
+}
+
+int ec_topo_valid(const ec_topo_t *t) {
+    return memcmp(t->magic, EC_TOPO_MAGIC, sizeof(t->magic)) == 0 && t->version == EC_TOPO_VERSION &&
+           t->size == sizeof(*t) && t->checksum == checksum(t);
+}
+
+int ec_topo_capture_ctx(ec_topo_t *t, ecx_contextt *context, const ec_axes_t *ax, const char *ifname,
+                        uint32_t vendor, int flags) {
+    int n = *context->slavecount;
+
+    memset(t, 0, sizeof(*t));
+    if (n > EC_TOPO_SLAVES) return -1;
+    strncpy(t->ifname, ifname, sizeof(t->ifname) - 1);
+    t->vendor = vendor;
+    t->flags = flags;
+    t->slaves = n;
+    for (int s = 1; s <= n; s++) {
+        const ec_slavet *sl = &context->slavelist[s];
+        ec_topo_slave_t *ts = &t->slave[s];
+        ts->vendor = sl->eep_man;
+        ts->product = sl->eep_id;
+        ts->revision = sl->eep_rev;
+        ts->configadr = sl->configadr;
+        ts->aliasadr = sl->aliasadr;
+        ts->topology = sl->topology;
+        ts->coe_details = sl->CoEdetails;
+        ts->mbx_proto = sl->mbx_proto;
+        ts->obits = sl->Obits;
+        ts->ibits = sl->Ibits;
+        ts->pdelay_ns = sl->pdelay;
+        for (int k = 0; k < EC_TOPO_SM; k++) {
+            ts->sm[k].start = sl->SM[k].StartAddr;
+            ts->sm[k].length = sl->SM[k].SMlength;
+            ts->sm[k].flags = sl->SM[k].SMflags;
+        }
+    }
+    t->axes = ax->count;
+    for (int i = 0; i < ax->count; i++) {
+        const ec_pdomap_t *map = &ax->map[i];
+        ec_topo_axis_t *ta = &t->axis[i];
+        ta->slave = ax->slave[i];
+        ta->entries = (uint16_t)map->n_entries;
+        ta->out_bits = map->out_bits;
+        ta->in_bits = map->in_bits;
+        memcpy(ta->entry, map->entries, sizeof(ta->entry));
+    }
+    memcpy(t->magic, EC_TOPO_MAGIC, sizeof(t->magic));
+    t->version = EC_TOPO_VERSION;
+    t->size = sizeof(*t);
+    t->checksum = checksum(t);
+    return 0;
+}
+
+int ec_topo_match_ctx(const ec_topo_t *t, ecx_contextt *context, const char *ifname, uint32_t vendor,
+                      int flags) {
+    if (!ec_topo_valid(t) || strncmp(t->ifname, ifname, sizeof(t->ifname) - 1) != 0 || t->vendor != vendor ||
+        t->flags != flags || t->slaves != *context->slavecount) {
+        return 0;
+    }
+    for (int s = 1; s <= t->slaves; s++) {
+        const ec_slavet *sl = &context->slavelist[s];
+        const ec_topo_slave_t *ts = &t->slave[s];
+        if (sl->eep_man != ts->vendor || sl->eep_id != ts->product || sl->eep_rev != ts->revision ||
+            sl->configadr != ts->configadr || sl->aliasadr != ts->aliasadr || sl->topology != ts->topology) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int ec_topo_verify_ctx(const ec_topo_t *t, ecx_contextt *context) {
+    static ec_pdomap_t map;     // service thread only
+
+    if (t->axes <= 0 || t->axes > EC_AXES_MAX) return 0;
+    for (int i = 0; i < t->axes; i++) {
+        const ec_topo_axis_t *ta = &t->axis[i];
+        if (ec_pdomap_read_ctx(context, &map, ta->slave) != ta->entries || map.out_bits != ta->out_bits ||
+            map.in_bits != ta->in_bits) {
+            return 0;
+        }
+        for (int e = 0; e < map.n_entries; e++) {
+            const ec_pdo_entry_t *a = &map.entries[e], *b = &ta->entry[e];
+            if (a->index != b->index || a->sub != b->sub || a->bits != b->bits || a->bitoff != b->bitoff ||
+                a->output != b->output) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+void ec_topo_apply_ctx(const ec_topo_t *t, ecx_contextt *context) {
+    for (int s = 1; s <= t->slaves; s++) {
+        ec_slavet *sl = &context->slavelist[s];
+        const ec_topo_slave_t *ts = &t->slave[s];
+        for (int k = 0; k < EC_TOPO_SM; k++) {
+            sl->SM[k].StartAddr = ts->sm[k].start;
+            sl->SM[k].SMlength = ts->sm[k].length;
+            sl->SM[k].SMflags = ts->sm[k].flags;
+        }
+        sl->Obits = ts->obits;
+        sl->Ibits = ts->ibits;
+        sl->configindex = 1;    // any non-zero index: layout given, nothing to read from the slave
+    }
+}
+
+int ec_topo_bind_axes_ctx(const ec_topo_t *t, ecx_contextt *context, ec_axes_t *ax) {
+    static ec_pdomap_t maps[EC_AXES_MAX];     // service thread only
+
+    if (t->axes <= 0 || t->axes > EC_AXES_MAX) return -1;
+    for (int i = 0; i < t->axes; i++) {
+        const ec_topo_axis_t *ta = &t->axis[i];
+        memset(&maps[i], 0, sizeof(maps[i]));
+        maps[i].slave = ta->slave;
+        maps[i].n_entries = ta->entries > EC_PDOMAP_MAX_ENTRIES ? EC_PDOMAP_MAX_ENTRIES : ta->entries;
+        maps[i].out_bits = ta->out_bits;
+        maps[i].in_bits = ta->in_bits;
+        memcpy(maps[i].entries, ta->entry, sizeof(maps[i].entries));
+    }
+    return ec_axes_bind_ctx(context, ax, maps, t->axes);
+}
+
+int32_t ec_topo_dc_delta_ctx(const ec_topo_t *t, ecx_contextt *context) {
+    int32_t worst = 0;
+    for (int s = 1; s <= t->slaves && s <= *context->slavecount; s++) {
+        int32_t d = context->slavelist[s].pdelay - t->slave[s].pdelay_ns;
+        if (d < 0) d = -d;
+        if (d > worst) worst = d;
+    }
+    return worst;
+}
+
+int ec_topo_save(const ec_topo_t *t, const char *path) {
+    FILE *f;
+
+    if (!ec_topo_valid(t)) return -1;
+    f = fopen(path, "wb");
+    if (!f) return -1;
+    int ok = fwrite(t, sizeof(*t), 1, f) == 1;
+    if (fclose(f) != 0) ok = 0;
+    return ok ? 0 : -1;
+}
+
+int ec_topo_load(ec_topo_t *t, const char *path) {
+    FILE *f = fopen(path, "rb");
+    int ok = 0;
+
+    if (f) {
+        ok = fread(t, sizeof(*t), 1, f) == 1 && ec_topo_valid(t);
+        fclose(f);
+    }
+    if (!ok) memset(t, 0, sizeof(*t));
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,116 @@
+// ec_topo.h
+// Topology fingerprint of a segment, kept in a file between connects so that reconnecting to the same
+// network skips the mailbox traffic of a cold connect.
+// - Captured after a successful connect: per slave vendor / product / revision, station address, port
+//   topology, SyncManager layout, process data sizes and DC propagation delay; per axis the PDO mapping
+//   ec_pdomap.c read.
+// - On reconnect the identity part is compared with what ecx_config_init found in the SII (SOEM reads
+//   that anyway and reuses it for identical drives). When it matches, ec_segment.c skips programming
+//   the compact mapping, presets the SyncManager layout so ec_config_map reads no PDO objects over CoE,
+//   and binds the axes from the stored mapping instead of reading it a second time.
+// - Before the stored layout is used, the PDO assignment (0x1C12 / 0x1C13) and the assigned 0x16xx /
+//   0x1Axx entries of every axis are read back in PRE-OP and compared with the stored mapping: a remap
+//   that keeps the sizes would pass SAFE-OP and bind every object at a wrong offset. On a mismatch the
+//   connect goes cold. This costs the mapping reads of one pass instead of two (compact mapping and
+//   SOEM's own read in ec_config_map are still skipped).
+// - The drives confirm the SyncManager layout themselves: a slave whose sizes changed since refuses
+//   SAFE-OP, and the connect starts over cold.
+// - DC delays are stored to show cable changes; they do not gate the fast path.
+// File: the struct as is behind a magic, version, size and checksum; anything else reads as no
+// fingerprint. Written and read by the service thread only.
+
+#ifndef EC_TOPO_H
+#define EC_TOPO_H
+
+#include <stdint.h>
+
+#include "ethercat.h"
+#include "ec_axes.h"
+
+#define EC_TOPO_MAGIC       "L7NHTOP1"
+#define EC_TOPO_VERSION     1
+#define EC_TOPO_SLAVES      EC_AXES_MAX     // larger segments are never fingerprinted
+#define EC_TOPO_SM          4               // mailbox out / in, process data out / in
+
+// ec_segment_connect_cached() outcome
+typedef enum {
+    EC_TOPO_NONE = 0,       // no fingerprint given, or it did not match: cold connect
+    EC_TOPO_HIT,            // fingerprint matched and the drives accepted the stored layout
+    EC_TOPO_STALE           // fingerprint matched, a drive refused the layout: connected cold after all
+} ec_topo_result_t;
+
+typedef struct {
+    uint16_t start;
+    uint16_t length;
+    uint32_t flags;
+} ec_topo_sm_t;
+
+typedef struct {
+    uint32_t vendor;
+    uint32_t product;
+    uint32_t revision;
+    uint16_t configadr;
+    uint16_t aliasadr;
+    uint8_t topology;       // ports in use
+    uint8_t coe_details;
+    uint16_t mbx_proto;
+    uint16_t obits;
+    uint16_t ibits;
+    int32_t pdelay_ns;      // DC propagation delay from the reference clock
+    ec_topo_sm_t sm[EC_TOPO_SM];
+} ec_topo_slave_t;
+
+typedef struct {
+    uint16_t slave;
+    uint16_t entries;
+    uint32_t out_bits;
+    uint32_t in_bits;
+    ec_pdo_entry_t entry[EC_PDOMAP_MAX_ENTRIES];
+} ec_topo_axis_t;
+
+typedef struct {
+    char magic[8];          // EC_TOPO_MAGIC, all zero = no fingerprint
+    uint32_t version;
+    uint32_t size;          // sizeof(ec_topo_t)
+    uint32_t checksum;      // FNV-1a over everything behind this field
+    char ifname[64];        // NIC it was captured on
+    uint32_t vendor;        // axis vendor filter of the connect
+    int32_t flags;          // ec_segment_connect() flags of the connect
+    int32_t slaves;
+    int32_t axes;
+    ec_topo_slave_t slave[EC_TOPO_SLAVES + 1];  // [0] unused, like ec_slave[]
+    ec_topo_axis_t axis[EC_AXES_MAX];
+} ec_topo_t;
+
+// Record a connected segment (after its axes are bound). Returns 0, or -1 (t cleared) for a segment
+// larger than EC_TOPO_SLAVES.
+int ec_topo_capture_ctx(ec_topo_t *t, struct ecx_context *context, const ec_axes_t *ax, const char *ifname,
+                        uint32_t vendor, int flags);
+
+// After ecx_config_init: 1 if the slaves found are the ones fingerprinted for this NIC and connect,
+// else 0.
+int ec_topo_match_ctx(const ec_topo_t *t, struct ecx_context *context, const char *ifname, uint32_t vendor,
+                      int flags);
+
+// In PRE-OP, after a match: 1 if the PDO mapping every axis holds now (read over CoE) is the stored one,
+// entry for entry, else 0.
+int ec_topo_verify_ctx(const ec_topo_t *t, struct ecx_context *context);
+
+// Before ecx_config_map_group: preset SyncManager layout and process data sizes of every slave, so
+// SOEM takes them instead of reading the PDO assignment over CoE.
+void ec_topo_apply_ctx(const ec_topo_t *t, struct ecx_context *context);
+
+// After ecx_config_map_group: bind the axes from the stored mappings. Returns the axis count or -1.
+int ec_topo_bind_axes_ctx(const ec_topo_t *t, struct ecx_context *context, ec_axes_t *ax);
+
+// After ecx_configdc: largest change of a propagation delay against the fingerprint, in ns.
+int32_t ec_topo_dc_delta_ctx(const ec_topo_t *t, struct ecx_context *context);
+
+// 1 if t holds a fingerprint.
+int ec_topo_valid(const ec_topo_t *t);
+
+// Returns 0, or -1 (load: t cleared) if the file cannot be written / read or is not a fingerprint.
+int ec_topo_save(const ec_topo_t *t, const char *path);
+int ec_topo_load(ec_topo_t *t, const char *path);
+
+#endif // EC_TOPO_H
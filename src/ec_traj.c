@@ -0,0 +1,164 @@
+// ec_traj.c
+// Streaming torque-setpoint generator (see ec_traj.h).
+
+#include "ec_traj.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "ec_atomic.h"
+
+#define QUEUE_MASK  (EC_TRAJ_DEPTH - 1)
+#define TWO_PI      6.28318530718f
+
+int ec_traj_init(ec_traj_t *tr, int axes, int64_t period_ns, int16_t limit) {
+    memset(tr, 0, sizeof(*tr));
+    if (axes < 0 || axes > EC_AXES_MAX || period_ns <= 0) return -1;
+    tr->axes = axes;
+    tr->period_ns = period_ns;
+    tr->limit = limit < 0 ? (int16_t)-limit : limit;
+    return 0;
+}
+
+static uint32_t to_cycles(const ec_traj_t *tr, int64_t duration_ns) {
+    if (duration_ns <= 0) return 0;
+    return (uint32_t)((duration_ns + tr->period_ns / 2) / tr->period_ns);
+}
+
+static int append(ec_traj_t *tr, int axis, const ec_traj_seg_t *seg) {
+    if (axis < 0 || axis >= tr->axes || ec_atomic_load_u32(&tr->stop_req) != 0) return -1;
+    ec_traj_axis_t *a = &tr->axis[axis];
+    uint32_t head = a->head;        // only we write head
+    if (head - ec_atomic_load_u32(&a->tail) >= EC_TRAJ_DEPTH) return -1;
+    a->queue[head & QUEUE_MASK] = *seg;
+    ec_atomic_store_u32(&a->head, head + 1);   // publish after the segment is written
+    return 0;
+}
+
+int ec_traj_ramp(ec_traj_t *tr, int axis, int16_t target, int64_t duration_ns) {
+    ec_traj_seg_t seg;
+    memset(&seg, 0, sizeof(seg));
+    seg.kind = EC_TRAJ_RAMP;
+    seg.cycles = to_cycles(tr, duration_ns);
+    seg.target = target;
+    return append(tr, axis, &seg);
+}
+
+int ec_traj_scurve(ec_traj_t *tr, int axis, int16_t target, int64_t duration_ns) {
+    ec_traj_seg_t seg;
+    memset(&seg, 0, sizeof(seg));
+    seg.kind = EC_TRAJ_SCURVE;
+    seg.cycles = to_cycles(tr, duration_ns);
+    seg.target = target;
+    return append(tr, axis, &seg);
+}
+
+int ec_traj_sine(ec_traj_t *tr, int axis, int16_t amplitude, double hz, int64_t duration_ns) {
+    return ec_traj_chirp(tr, axis, amplitude, hz, hz, duration_ns);
+}
+
+int ec_traj_chirp(ec_traj_t *tr, int axis, int16_t amplitude, double f0_hz, double f1_hz, int64_t duration_ns) {
+    ec_traj_seg_t seg;
+    double period_s = (double)tr->period_ns * 1e-9;
+    memset(&seg, 0, sizeof(seg));
+    seg.kind = f0_hz == f1_hz ? EC_TRAJ_SINE : EC_TRAJ_CHIRP;
+    seg.cycles = to_cycles(tr, duration_ns);
+    seg.amplitude = amplitude;
+    seg.freq = (float)(f0_hz * period_s);
+    if (seg.cycles) seg.dfreq = (float)((f1_hz - f0_hz) * period_s / seg.cycles);
+    return append(tr, axis, &seg);
+}
+
+int ec_traj_space(const ec_traj_t *tr, int axis) {
+    if (axis < 0 || axis >= tr->axes) return 0;
+    const ec_traj_axis_t *a = &tr->axis[axis];
+    return EC_TRAJ_DEPTH - (int)(a->head - ec_atomic_load_u32(&a->tail));
+}
+
+void ec_traj_stop(ec_traj_t *tr, int64_t duration_ns) {
+    ec_atomic_store_u32(&tr->stop_cycles, to_cycles(tr, duration_ns));
+    ec_atomic_add_u32(&tr->stop_req, 1);
+}
+
+// Make seg the segment being played, starting from the current value.
+static void start(ec_traj_axis_t *a, const ec_traj_seg_t *seg) {
+    a->seg = *seg;
+    a->t = 0;
+    a->from = a->value;
+    a->phase = 0.0f;
+    if (seg->cycles == 0 && seg->kind <= EC_TRAJ_SCURVE) a->value = seg->target;
+}
+
+// Setpoint of the next cycle of the segment being played.
+static float advance(ec_traj_axis_t *a) {
+    const ec_traj_seg_t *s = &a->seg;
+    uint32_t t = ++a->t;
+    float u;
+
+    if (t >= s->cycles) {
+        return s->kind <= EC_TRAJ_SCURVE ? s->target : a->from;     // land exactly
+    }
+    switch (s->kind) {
+    case EC_TRAJ_RAMP:
+        u = (float)t / (float)s->cycles;
+        return a->from + (s->target - a->from) * u;
+    case EC_TRAJ_SCURVE:
+        u = (float)t / (float)s->cycles;
+        return a->from + (s->target - a->from) * u * u * (3.0f - 2.0f * u);
+    default:
+        // instantaneous frequency of the previous cycle; phase kept in [0, 1) for float precision
+        a->phase += s->freq + s->dfreq * (float)(t - 1);
+        a->phase -= floorf(a->phase);
+        return a->from + s->amplitude * sinf(TWO_PI * a->phase);
+    }
+}
+
+void ec_traj_override(ec_traj_t *tr, int axis, int16_t value) {
+    ec_traj_axis_t *a = &tr->axis[axis];
+
+    if (tr->stop_done) return;      // stopping: the stop ramp has the axis
+    a->value = value;
+    a->seg.cycles = 0;
+    a->t = 0;
+    ec_atomic_store_u32(&a->tail, ec_atomic_load_u32(&a->head));
+}
+
+int ec_traj_step(ec_traj_t *tr, int16_t *out) {
+    const float lim = (float)tr->limit;
+    uint32_t req = ec_atomic_load_u32(&tr->stop_req);
+    int moving = 0;
+
+    if (req != tr->stop_done) {
+        ec_traj_seg_t stop;
+        memset(&stop, 0, sizeof(stop));
+        stop.kind = EC_TRAJ_SCURVE;
+        stop.cycles = ec_atomic_load_u32(&tr->stop_cycles);
+        tr->stop_done = req;
+        for (int i = 0; i < tr->axes; i++) start(&tr->axis[i], &stop);
+    }
+
+    for (int i = 0; i < tr->axes; i++) {
+        ec_traj_axis_t *a = &tr->axis[i];
+        uint32_t head = ec_atomic_load_u32(&a->head);
+        uint32_t tail = a->tail;        // only we write tail
+
+        if (tr->stop_done) {
+            tail = head;                // stopping: whatever was queued is dropped
+        } else {
+            while (a->t >= a->seg.cycles && tail != head) start(a, &a->queue[tail++ & QUEUE_MASK]);
+        }
+        ec_atomic_store_u32(&a->tail, tail);    // release the slots after the copy
+
+        if (a->t < a->seg.cycles) {
+            a->value = advance(a);
+            moving++;
+        } else if (tail != head) {
+            moving++;
+        }
+        // clamp the state too, so the next segment (or a stop) starts from what was sent
+        if (a->value > lim) a->value = lim;
+        else if (a->value < -lim) a->value = -lim;
+        out[i] = (int16_t)(a->value >= 0.0f ? a->value + 0.5f : a->value - 0.5f);
+    }
+    return moving;
+}
@@ -0,0 +1,94 @@
+// ec_traj.h
+// Streaming torque-setpoint generator for the cyclic task (CST, 0x6071).
+// - Every axis has a lookahead queue of profile segments: linear ramp, S-curve, sine and linear chirp.
+//   Any one non-RT thread appends segments; the cyclic thread consumes them in order and writes a fresh
+//   setpoint for every axis every cycle. The queue is a wait-free SPSC ring (as telemetry.c): no
+//   allocation and no locks on either side, a full queue rejects the append.
+// - Segments are relative to where the previous one ended, so a stream of them is continuous: a ramp or
+//   S-curve moves to its target, a sine or chirp oscillates around the current value and ends on it
+//   (smoothly when the duration holds whole periods).
+//   With the queue empty the axis holds its last value.
+// - Durations are converted to cycles when appended; frequencies to cycles^-1. The cycle itself only
+//   does float arithmetic and, for oscillations, one sinf() per axis.
+// - Stop: ec_traj_stop() drops every queued segment and ramps all axes to zero along an S-curve;
+//   ec_traj_step() returns 0 once every axis has arrived.
+
+#ifndef EC_TRAJ_H
+#define EC_TRAJ_H
+
+#include <stdint.h>
+
+#include "ec_axes.h"
+
+#define EC_TRAJ_DEPTH   16      // queued segments per axis, power of two
+
+typedef enum {
+    EC_TRAJ_RAMP = 0,           // linear to 'target'
+    EC_TRAJ_SCURVE,             // smoothstep to 'target': rate of change starts and ends at zero
+    EC_TRAJ_SINE,               // amplitude * sin(2 pi f t) around the start value
+    EC_TRAJ_CHIRP               // as sine, f sweeping linearly from f0 to f1
+} ec_traj_kind_t;
+
+typedef struct {
+    uint32_t kind;              // ec_traj_kind_t
+    uint32_t cycles;            // duration; 0 steps to target (ramps) or is skipped (oscillations)
+    float target;               // ramps
+    float amplitude;            // oscillations
+    float freq;                 // oscillations, cycles^-1 at the start
+    float dfreq;                // chirp, change of freq per cycle
+} ec_traj_seg_t;
+
+typedef struct {
+    // lookahead queue: head written by the producer, tail by the cyclic thread
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    ec_traj_seg_t queue[EC_TRAJ_DEPTH];
+
+    // cyclic thread
+    ec_traj_seg_t seg;          // segment being played
+    uint32_t t;                 // cycles of it played
+    float from;                 // value when it started
+    float phase;                // oscillations, in turns [0, 1)
+    float value;                // current setpoint before rounding
+} ec_traj_axis_t;
+
+typedef struct {
+    int axes;
+    int64_t period_ns;
+    int16_t limit;              // |setpoint| is clamped to this
+
+    volatile uint32_t stop_req; // bumped by ec_traj_stop(); appends are refused from then on
+    volatile uint32_t stop_cycles;
+    uint32_t stop_done;         // cyclic thread's copy of stop_req
+
+    ec_traj_axis_t axis[EC_AXES_MAX];
+} ec_traj_t;
+
+// Non-RT, while no cycle uses the generator: every axis at zero with an empty queue.
+// Returns -1 for more than EC_AXES_MAX axes or a period that is not positive.
+int ec_traj_init(ec_traj_t *tr, int axes, int64_t period_ns, int16_t limit);
+
+// Producer thread: append a segment to the queue of one axis. Returns 0, or -1 if the queue is full
+// or the generator is stopping.
+int ec_traj_ramp(ec_traj_t *tr, int axis, int16_t target, int64_t duration_ns);
+int ec_traj_scurve(ec_traj_t *tr, int axis, int16_t target, int64_t duration_ns);
+int ec_traj_sine(ec_traj_t *tr, int axis, int16_t amplitude, double hz, int64_t duration_ns);
+int ec_traj_chirp(ec_traj_t *tr, int axis, int16_t amplitude, double f0_hz, double f1_hz, int64_t duration_ns);
+
+// Producer thread: free slots in the queue of one axis.
+int ec_traj_space(const ec_traj_t *tr, int axis);
+
+// Any thread: drop the queued segments and ramp every axis to zero within duration_ns.
+void ec_traj_stop(ec_traj_t *tr, int64_t duration_ns);
+
+// Cyclic thread, before ec_traj_step: the setpoint of one axis comes from elsewhere this cycle (ec_shm.c,
+// ec_cmdq.c, ec_replay.c).
+// The segment being played and the queued ones are dropped; the axis holds value, and a stop ramps
+// from there. Ignored once the generator is stopping.
+void ec_traj_override(ec_traj_t *tr, int axis, int16_t value);
+
+// Cyclic thread, once per cycle: advance every axis and write its setpoint to out[0..axes-1].
+// Returns the number of axes whose setpoint is still moving or has segments queued.
+int ec_traj_step(ec_traj_t *tr, int16_t *out);
+
+#endif // EC_TRAJ_H
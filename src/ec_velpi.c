@@ -0,0 +1,109 @@
+// ec_velpi.c
+// Velocity PI controller on top of CST (see ec_velpi.h).
+
+#include "ec_velpi.h"
+
+#include <string.h>
+
+#ifdef EC_VELPI_FIXED
+#define Q16(x)  ((int64_t)((x) * 65536.0 + ((x) < 0 ? -0.5 : 0.5)))
+#endif
+
+int ec_velpi_init(ec_velpi_t *pi, int axes, int64_t period_ns, double kp, double ki, double ka, int16_t limit) {
+    memset(pi, 0, sizeof(*pi));
+    if (axes < 0 || axes > EC_AXES_MAX || period_ns <= 0) return -1;
+    double period_s = (double)period_ns * 1e-9;
+    pi->axes = axes;
+    pi->period_ns = period_ns;
+    pi->limit = limit < 0 ? (int16_t)-limit : limit;
+#ifdef EC_VELPI_FIXED
+    pi->kp = Q16(kp);
+    pi->ki_dt = Q16(ki * period_s);
+    pi->ka_dt = Q16(ka / period_s);
+#else
+    pi->kp = (float)kp;
+    pi->ki_dt = (float)(ki * period_s);
+    pi->ka_dt = (float)(ka / period_s);
+#endif
+    return 0;
+}
+
+void ec_velpi_reset(ec_velpi_t *pi) {
+    for (int i = 0; i < pi->axes; i++) {
+        pi->integ[i] = 0;
+        pi->prev_target[i] = pi->target[i];
+    }
+}
+
+// Axis not enabled: its torque goes nowhere, so nothing may accumulate for the moment it is.
+static void hold(ec_velpi_t *pi, int i, int16_t *torque) {
+    pi->integ[i] = 0;
+    pi->prev_target[i] = pi->target[i];
+    torque[i] = 0;
+}
+
+#ifdef EC_VELPI_FIXED
+
+void ec_velpi_update(ec_velpi_t *pi, const int32_t *actual_velocity, const uint8_t *enabled, int16_t *torque) {
+    const int64_t lim = (int64_t)pi->limit << 16;
+
+    for (int i = 0; i < pi->axes; i++) {
+        if (enabled && !enabled[i]) {
+            hold(pi, i, torque);
+            continue;
+        }
+        int64_t e = (int64_t)pi->target[i] - actual_velocity[i];
+        int64_t acc = (int64_t)pi->target[i] - pi->prev_target[i];
+        int64_t integ = pi->integ[i] + pi->ki_dt * e;
+        pi->prev_target[i] = pi->target[i];
+
+        if (integ > lim) integ = lim;
+        else if (integ < -lim) integ = -lim;
+        int64_t u = pi->kp * e + integ + pi->ka_dt * acc + ((int64_t)pi->feedforward[i] << 16);
+        if (u > lim) {
+            u = lim;
+            if (e > 0) integ = pi->integ[i];        // do not wind further into the limit
+            pi->saturated[i]++;
+        } else if (u < -lim) {
+            u = -lim;
+            if (e < 0) integ = pi->integ[i];
+            pi->saturated[i]++;
+        }
+        pi->integ[i] = integ;
+        torque[i] = (int16_t)((u + 0x8000) >> 16);  // arithmetic shift: round to nearest
+    }
+}
+
+#else
+
+void ec_velpi_update(ec_velpi_t *pi, const int32_t *actual_velocity, const uint8_t *enabled, int16_t *torque) {
+    const float lim = (float)pi->limit;
+
+    for (int i = 0; i < pi->axes; i++) {
+        if (enabled && !enabled[i]) {
+            hold(pi, i, torque);
+            continue;
+        }
+        float e = (float)(pi->target[i] - actual_velocity[i]);
+        float acc = (float)(pi->target[i] - pi->prev_target[i]);
+        float integ = pi->integ[i] + pi->ki_dt * e;
+        pi->prev_target[i] = pi->target[i];
+
+        if (integ > lim) integ = lim;
+        else if (integ < -lim) integ = -lim;
+        float u = pi->kp * e + integ + pi->ka_dt * acc + (float)pi->feedforward[i];
+        if (u > lim) {
+            u = lim;
+            if (e > 0.0f) integ = pi->integ[i];     // do not wind further into the limit
+            pi->saturated[i]++;
+        } else if (u < -lim) {
+            u = -lim;
+            if (e < 0.0f) integ = pi->integ[i];
+            pi->saturated[i]++;
+        }
+        pi->integ[i] = integ;
+        torque[i] = (int16_t)(u >= 0.0f ? u + 0.5f : u - 0.5f);
+    }
+}
+
+#endif
@@ -0,0 +1,61 @@
+// ec_velpi.h
+// Velocity PI controller computed in the cyclic task on top of CST: reads 0x606C, writes 0x6071.
+// - Per axis: torque = kp * e + integral(ki * e) + ka * d(target)/dt + feedforward[i], e = target - actual,
+//   clamped to +-limit. The acceleration feed-forward (ka, torque per rpm/s) lets the PI only correct
+//   what the model misses; feedforward[] is a per-axis torque offset (friction, gravity) set by the caller.
+// - Anti-windup by conditional integration: while the output is saturated, the integrator does not
+//   move further into the saturation, and it never exceeds +-limit on its own.
+// - Arithmetic per build option: float by default; with EC_VELPI_FIXED defined, gains are Q16.16 and
+//   the integrator a 64-bit Q16 accumulator, for targets without an FPU. Both give the same
+//   controller to within one torque unit.
+// - All axes in one call over the struct-of-arrays process image (ec_axes.h); no allocation, no
+//   divisions in the cycle.
+// Units: velocity in rpm, torque in 0.1 % of rated (0x6071), gains in torque units per rpm [per s].
+
+#ifndef EC_VELPI_H
+#define EC_VELPI_H
+
+#include <stdint.h>
+
+#include "ec_axes.h"
+
+typedef struct {
+    int axes;
+    int64_t period_ns;
+    int16_t limit;                      // |torque| output limit
+
+#ifdef EC_VELPI_FIXED
+    int64_t kp;                         // Q16.16
+    int64_t ki_dt;                      // Q16.16, ki * period
+    int64_t ka_dt;                      // Q16.16, ka / period
+    int64_t integ[EC_AXES_MAX];         // Q16 torque
+#else
+    float kp;
+    float ki_dt;                        // ki * period
+    float ka_dt;                        // ka / period
+    float integ[EC_AXES_MAX];           // torque
+#endif
+
+    // inputs, written by the cyclic hook before ec_velpi_update
+    int32_t target[EC_AXES_MAX];        // rpm
+    int16_t feedforward[EC_AXES_MAX];   // torque
+
+    int32_t prev_target[EC_AXES_MAX];   // for the acceleration feed-forward
+    uint32_t saturated[EC_AXES_MAX];    // cycles spent at the output limit (diagnostics)
+} ec_velpi_t;
+
+// Non-RT: zero state and targets, gains for the given cycle period. kp in torque per rpm, ki in torque
+// per rpm*s, ka in torque per rpm/s. Returns -1 for more than EC_AXES_MAX axes or a period that is not
+// positive.
+int ec_velpi_init(ec_velpi_t *pi, int axes, int64_t period_ns, double kp, double ki, double ka, int16_t limit);
+
+// Clear the integrators and take the current targets as the previous ones (no feed-forward kick), e.g.
+// when the axes are enabled.
+void ec_velpi_reset(ec_velpi_t *pi);
+
+// Cyclic thread, once per cycle after ec_axes_update: one controller step for every axis from
+// actual_velocity[] to torque[]. Axes whose enabled[] is 0 get zero torque and a cleared integrator,
+// so enabling never starts from a wound-up state; enabled NULL runs every axis.
+void ec_velpi_update(ec_velpi_t *pi, const int32_t *actual_velocity, const uint8_t *enabled, int16_t *torque);
+
+#endif // EC_VELPI_H
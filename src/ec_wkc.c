@@ -0,0 +1,61 @@
+// ec_wkc.c
+// Working-counter and frame-loss accounting (see ec_wkc.h).
+
+#include "ec_wkc.h"
+#include "ec_atomic.h"
+
+#include <string.h>
+#include "ethercat.h"
+
+void ec_wkc_init(ec_wkc_t *w, int64_t period_ns) {
+    memset(w, 0, sizeof(*w));
+    w->late_ns = period_ns / EC_WKC_LATE_DIV;
+    w->limit[EC_WKC_MISSING] = EC_WKC_MISSING_LIMIT;
+    w->limit[EC_WKC_PARTIAL] = EC_WKC_PARTIAL_LIMIT;
+    w->limit[EC_WKC_LATE] = EC_WKC_LATE_LIMIT;
+}
+
+void ec_wkc_arm(ec_wkc_t *w) {
+    w->run = 0;
+    memset(w->run_class, 0, sizeof(w->run_class));
+    ec_atomic_store_u32(&w->tripped, 0);
+}
+
+ec_wkc_class_t ec_wkc_cycle(ec_wkc_t *w, int wkc, int expected_wkc, int64_t exchange_ns) {
+    ec_wkc_class_t c = wkc == EC_NOFRAME ? EC_WKC_MISSING
+                     : wkc != expected_wkc ? EC_WKC_PARTIAL
+                     : exchange_ns > w->late_ns ? EC_WKC_LATE : EC_WKC_GOOD;
+
+    ec_atomic_store_u64(&w->count[c], w->count[c] + 1);
+    if (c == EC_WKC_GOOD) {
+        if (w->run) {
+            w->run = 0;
+            memset(w->run_class, 0, sizeof(w->run_class));
+        }
+        return c;
+    }
+    w->run++;
+    w->run_class[c]++;
+    if (w->run > w->max_run) ec_atomic_store_u32(&w->max_run, w->run);
+    if (!w->tripped && w->limit[c] && w->run_class[c] >= w->limit[c]) {
+        ec_atomic_store_u32(&w->trips, w->trips + 1);
+        ec_atomic_store_u32(&w->tripped, (uint32_t)c);
+    }
+    return c;
+}
+
+void ec_wkc_read(const ec_wkc_t *w, ec_wkc_counts_t *out) {
+    out->cycles = 0;
+    for (int c = 0; c < EC_WKC_CLASSES; c++) {
+        out->count[c] = ec_atomic_load_u64(&w->count[c]);
+        out->cycles += out->count[c];
+    }
+    out->max_run = ec_atomic_load_u32(&w->max_run);
+    out->trips = ec_atomic_load_u32(&w->trips);
+    out->tripped = (ec_wkc_class_t)ec_atomic_load_u32(&w->tripped);
+}
+
+const char *ec_wkc_class_name(ec_wkc_class_t c) {
+    static const char *const names[EC_WKC_CLASSES] = { "good", "missing", "partial WKC", "late" };
+    return c >= 0 && c < EC_WKC_CLASSES ? names[c] : "?";
+}
@@ -0,0 +1,72 @@
+// ec_wkc.h
+// Working-counter and frame-loss accounting of the cyclic exchange.
+// - ec_wkc_cycle() classifies every cycle from what ec_receive_processdata returned and how long the
+//   exchange took, against expected_wkc = outputsWKC * 2 + inputsWKC of the group:
+//   missing: no frame came back within EC_TIMEOUTRET (EC_NOFRAME), the inputs are those of an earlier
+//            cycle;
+//   partial: a frame came back with another working counter, some slaves did not read or write
+//            their process data;
+//   late:    a complete frame, but send -> receive took longer than late_ns, so the inputs are older
+//            than the cycle assumes.
+//   A cycle has one class, in that order.
+// - A run of cycles that are not good trips the accounting once it holds limit[class] cycles of one
+//   class (0 = that class never trips). A tripped segment sends zero torque on every axis until the
+//   next start; the cycle keeps running, so the CiA402 state machines and a stop still work.
+// - The counters only grow, from the connect on (across runs), for trending. Single writer (the cyclic
+//   thread), any number of readers through release stores / acquire loads (ec_wkc_read()).
+
+#ifndef EC_WKC_H
+#define EC_WKC_H
+
+#include <stdint.h>
+
+#define EC_WKC_LATE_DIV         2       // default late_ns = period / EC_WKC_LATE_DIV
+#define EC_WKC_MISSING_LIMIT    5       // default consecutive missing frames that drop the torque
+#define EC_WKC_LATE_LIMIT       20
+#define EC_WKC_PARTIAL_LIMIT    0       // off: a slave out of OP shortens the WKC until the supervisor has it
+                                        // back, and its own axes are off torque meanwhile (ec_health.h)
+
+typedef enum {
+    EC_WKC_GOOD = 0,
+    EC_WKC_MISSING,
+    EC_WKC_PARTIAL,
+    EC_WKC_LATE,
+    EC_WKC_CLASSES
+} ec_wkc_class_t;
+
+typedef struct {
+    int64_t late_ns;
+    uint32_t limit[EC_WKC_CLASSES];     // [EC_WKC_GOOD] unused
+
+    // written by the cyclic thread
+    volatile uint64_t count[EC_WKC_CLASSES];    // cycles per class since the connect
+    volatile uint32_t max_run;                  // longest run of cycles that were not good
+    volatile uint32_t trips;                    // runs that dropped the torque
+    volatile uint32_t tripped;                  // the torque is dropped; class that tripped it, 0 = none
+    uint32_t run;                               // cycles of the current run
+    uint32_t run_class[EC_WKC_CLASSES];         // of those, per class
+} ec_wkc_t;
+
+typedef struct {
+    uint64_t count[EC_WKC_CLASSES];
+    uint64_t cycles;
+    uint32_t max_run;
+    uint32_t trips;
+    ec_wkc_class_t tripped;
+} ec_wkc_counts_t;
+
+// Clear the counters (on connect) and set the default limits for period_ns.
+void ec_wkc_init(ec_wkc_t *w, int64_t period_ns);
+
+// Start of a run: clear the trip and the current run, keep the counters.
+void ec_wkc_arm(ec_wkc_t *w);
+
+// Account one cycle (cyclic thread). wkc may be EC_NOFRAME. Returns its class.
+ec_wkc_class_t ec_wkc_cycle(ec_wkc_t *w, int wkc, int expected_wkc, int64_t exchange_ns);
+
+// Any thread: a consistent enough copy of the counters (each one read atomically).
+void ec_wkc_read(const ec_wkc_t *w, ec_wkc_counts_t *out);
+
+const char *ec_wkc_class_name(ec_wkc_class_t c);
+
+#endif // EC_WKC_H
@@ -0,0 +1,791 @@
+// l7nh_core.c
+// Headless control core (see l7nh_core.h).
+
+#include "l7nh_core.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ec_atomic.h"
+#include "ec_pdomap.h"
+#include "cia402.h"
+
+#define MODE_CST            10              // CiA402 mode of operation: cyclic synchronous torque
+#define IDX_MODE_OF_OPERATION 0x6060
+#define IDX_ACTUAL_VELOCITY 0x606C
+#define SDO_WAIT_NS         700000000LL     // how long the service thread waits for one SDO (EC_TIMEOUTRXM)
+#define STOP_TIMEOUT_NS     2000000000LL    // keep cycling this long after a stop for the ramp and quick stop
+#define START_RAMP_NS       200000000LL     // Start: S-curve from zero to torque_set / speed_set_rpm
+#define STOP_RAMP_NS        300000000LL     // Stop: S-curve from the current setpoint to zero
+#define TORQUE_LIMIT        1000            // no torque setpoint exceeds this (units per ESI)
+#define SPEED_LIMIT_RPM     3000            // speed_control: no velocity target exceeds this
+#define VELPI_KP            8.0             // torque per rpm (bench_velpi: ~6 ms 10-90 % rise, 400 W motor)
+#define VELPI_KI            800.0           // torque per rpm*s
+#define VELPI_KA            0.02            // torque per rpm/s, acceleration feed-forward
+#define SCOPE_PRE_CYCLES    2000
+#define SCOPE_POST_CYCLES   500
+#define SCOPE_OVERSPEED_RPM 3000
+
+void l7nh_config_default(l7nh_config_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->cycle_ns = EC_CYCLE_1MS;
+    cfg->compact_pdo = 1;
+    cfg->dc_sync = 1;
+    cfg->record = 1;
+    cfg->scope = 1;
+    cfg->shm = 1;
+    cfg->topo_cache = 1;
+    cfg->torque_set = 500;      // small safe torque - tune for your motor
+    cfg->speed_set_rpm = 500;
+    cfg->missing_limit = EC_WKC_MISSING_LIMIT;
+    cfg->partial_limit = EC_WKC_PARTIAL_LIMIT;
+    cfg->late_limit = EC_WKC_LATE_LIMIT;
+    cfg->replay_torque_band = EC_REPLAY_BAND_TORQUE;
+    cfg->replay_velocity_band = EC_REPLAY_BAND_VELOCITY;
+    cfg->replay_position_band = EC_REPLAY_BAND_POSITION;
+    cfg->priority = 80;
+    cfg->cpu0 = 1;              // core 0 keeps the service thread and everything else
+}
+
+static void report(l7nh_core_t *core, l7nh_event_kind_t kind, const char *msg) {
+    if (core->event) core->event(core->user, kind, msg);
+}
+
+// Queue an SDO on the engine of segment s and advance the engine ourselves until it has finished: no
+// cycle runs, and nobody else polls on the service thread. The poll lock keeps this exclusive with a
+// cyclic thread that may be polling too. On the deadline the request is cancelled: req lives on the
+// caller's stack and the engine must not keep it.
+static int sdo_transfer(l7nh_core_t *core, int s, ec_sdo_req_t *req) {
+    int64_t deadline = ec_cycle_now_ns() + SDO_WAIT_NS;
+    if (ec_sdoasync_post(&core->sdo[s], req) != 0) return 0;
+    while (!ec_sdo_req_finished(req) && ec_cycle_now_ns() < deadline) ec_sdoasync_poll(&core->sdo[s], 1);
+    return ec_sdoasync_cancel(&core->sdo[s], req) == EC_SDO_DONE;
+}
+
+static void close_segments(l7nh_core_t *core) {
+    for (int i = 0; i < core->segment_count; i++) {
+        ec_sdoasync_flush(&core->sdo[i]);
+        ec_segment_close(&core->segments[i]);
+        ec_scope_free(&core->scopes[i]);
+        ec_shm_close(&core->shm[i]);
+    }
+    core->segment_count = 0;
+    ec_atomic_store_u32(&core->state, L7NH_IDLE);
+}
+
+// Connect time of a segment, phase by phase (ec_segment.h), and whether the fingerprint was used.
+static void report_connect(l7nh_core_t *core, const ec_segment_t *seg) {
+    static const char *const topo[] = { "cold", "topology cached", "topology changed, cold" };
+    char txt[320];
+    int len = snprintf(txt, sizeof(txt), "%s: connected in %.1f ms (%s):", seg->ifname,
+        seg->connect.total_ns / 1e6, topo[seg->connect.topo]);
+    for (int p = 0; p < EC_CONNECT_PHASES && len > 0 && len < (int)sizeof(txt); p++) {
+        len += snprintf(txt + len, sizeof(txt) - (size_t)len, " %s %.1f", ec_segment_phase_name((ec_connect_phase_t)p),
+            seg->connect.phase_ns[p] / 1e6);
+    }
+    report(core, L7NH_EVENT_INFO, txt);
+}
+
+int l7nh_connect(l7nh_core_t *core, const char *ifnames, const l7nh_config_t *cfg, l7nh_event_t event,
+                 void *user) {
+    char names[128], txt[256], path[32];
+    l7nh_config_t c = *cfg;             // cfg may be core->cfg of an earlier connect
+    int axis_count = 0;
+
+    memset(core, 0, sizeof(*core));
+    core->cfg = c;
+    cfg = &core->cfg;
+    core->event = event;
+    core->user = user;
+    telemetry_init(&core->telemetry);
+
+    snprintf(names, sizeof(names), "%s", ifnames ? ifnames : "");
+    for (char *name = names; *name && core->segment_count < EC_SEGMENT_MAX;) {
+        ec_segment_t *seg = &core->segments[core->segment_count];
+        char *next = strchr(name, ',');
+        if (next) *next++ = '\0';
+        char *name2 = strchr(name, '/');
+        if (name2) *name2++ = '\0';
+        int flags = (cfg->compact_pdo ? EC_SEGMENT_COMPACT_PDO : 0) | (cfg->dc_sync ? EC_SEGMENT_DC_SYNC : 0);
+        ec_topo_t *topo = NULL;
+        if (cfg->topo_cache) {
+            topo = &core->topo[core->segment_count];
+            snprintf(path, sizeof(path), "l7nh_topo_seg%d.bin", core->segment_count);
+            ec_topo_load(topo, path);
+        }
+        if (ec_segment_connect_cached(seg, name, name2, cfg->cycle_ns, L7NH_VENDOR, flags, topo) != 0) {
+            snprintf(txt, sizeof(txt), "%s: %s", name, seg->error);
+            report(core, L7NH_EVENT_STATE, txt);
+            close_segments(core);
+            return -1;
+        }
+        if (!ec_axes_has(&seg->axes, PDO_TARGET_TORQUE)) {
+            report(core, L7NH_EVENT_STATE, "PDO mapping lacks 0x6071 - torque cannot be commanded");
+        }
+        if (cfg->dc_sync && !seg->dc_sync) {
+            report(core, L7NH_EVENT_STATE, "Drive has no DC - running free-run mode");
+        }
+        if (topo && ec_topo_save(topo, path) != 0) report(core, L7NH_EVENT_STATE, "Cannot write the topology fingerprint");
+        report_connect(core, seg);
+        seg->frames.limit[EC_WKC_MISSING] = cfg->missing_limit;
+        seg->frames.limit[EC_WKC_PARTIAL] = cfg->partial_limit;
+        seg->frames.limit[EC_WKC_LATE] = cfg->late_limit;
+        ec_sdoasync_init_ctx(&core->sdo[core->segment_count], &seg->context);
+        if (cfg->scope && ec_scope_init(&core->scopes[core->segment_count], seg->axes.count, cfg->cycle_ns,
+                                        SCOPE_PRE_CYCLES, SCOPE_POST_CYCLES, EC_SCOPE_TRIG_ALL,
+                                        SCOPE_OVERSPEED_RPM) != 0) {
+            report(core, L7NH_EVENT_STATE, "Not enough memory for the scope - running without it");
+        }
+        if (cfg->shm && ec_shm_create(&core->shm[core->segment_count], core->segment_count, &seg->axes, cfg->cycle_ns,
+                                      cfg->speed_control) != 0) {
+            report(core, L7NH_EVENT_STATE, "Cannot create the shared process image - running without it");
+        }
+        axis_count += seg->axes.count;
+        core->segment_count++;
+        if (!next) break;
+        name = next;
+    }
+    if (core->segment_count == 0) {
+        report(core, L7NH_EVENT_STATE, "No interface name given");
+        return -1;
+    }
+
+    ec_atomic_store_u32(&core->state, L7NH_CONNECTED);
+    snprintf(txt, sizeof(txt), "Connected, %d axes on %d segment(s). Ready", axis_count, core->segment_count);
+    report(core, L7NH_EVENT_STATE, txt);
+    return axis_count;
+}
+
+void l7nh_start(l7nh_core_t *core) {
+    ec_atomic_store_u32(&core->start_req, 1);
+}
+
+void l7nh_stop(l7nh_core_t *core) {
+    ec_atomic_store_u32(&core->stop_req, 1);
+}
+
+void l7nh_disconnect(l7nh_core_t *core) {
+    ec_atomic_store_u32(&core->disconnect_req, 1);
+}
+
+l7nh_state_t l7nh_state(const l7nh_core_t *core) {
+    return (l7nh_state_t)ec_atomic_load_u32(&core->state);
+}
+
+static int16_t clamp16(int32_t v) {
+    return (int16_t)(v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v);
+}
+
+// Per-cycle application hook of every segment, after the cross-segment barrier (see ec_segment.c): the
+// exchange, unpack and CiA402 update of this cycle are done on all segments, so every axis gets its
+// setpoint in the same cycle. Segment 0 also pushes a telemetry record of its axis 0.
+static void run_cycle(ec_segment_t *seg, uint32_t tick, void *user) {
+    l7nh_core_t *core = (l7nh_core_t *)user;
+    l7nh_run_t *run = &core->run;
+    ec_axes_t *ax = &seg->axes;
+    ec_cycle_t *cyc = &seg->cycle;
+    int s = seg->index;
+    int moving;
+
+    // Stop: ramp the setpoints to zero, then quick stop through the PDO and keep cycling until every drive
+    // has confirmed it
+    if (run->stop_deadline_ns[s] == 0 && ec_atomic_load_u32(&run->stop)) {
+        run->stop_deadline_ns[s] = cyc->wake_ns + STOP_TIMEOUT_NS;
+        ec_traj_stop(&run->traj[s], STOP_RAMP_NS);
+    }
+
+    // Setpoints of other processes (ec_shm.c), taken at the cycle boundary; they replace the generator's
+    // until the stop ramp takes over from them (not in a replay)
+    if (seg->shm && !run->replay && !run->stop_deadline_ns[s]) {
+        uint64_t mask = ec_shm_take(seg->shm, cyc->wake_ns);
+        for (int i = 0; mask && i < ax->count; i++) {
+            if ((mask >> i) & 1u) ec_traj_override(&run->traj[s], i, clamp16(seg->shm->value[i]));
+        }
+    }
+
+    // Setpoints of the control API (l7nh_set), whole batches at the cycle boundary; taken but not applied
+    // once stopping
+    ec_cmdq_t *q = &core->cmdq[s];
+    uint32_t n = ec_cmdq_pending(q);
+    for (uint32_t k = 0; k < n && !run->replay && !run->stop_deadline_ns[s]; k++) {
+        const ec_cmd_t *c = ec_cmdq_at(q, k);
+        if (c->axis < ax->count) ec_traj_override(&run->traj[s], c->axis, clamp16(c->value));
+    }
+    ec_cmdq_release(q, n);
+
+    // A fresh setpoint for every axis every cycle; torque is only packed for axes that report Operation enabled.
+    // A replay sends the recorded controlword, torque and enable of this cycle instead; the generator holds
+    // that torque, so a stop ramps down from it.
+    if (run->replay && !run->stop_deadline_ns[s]) {
+        moving = ec_replay_cycle(&core->replays[s], ax);
+        for (int i = 0; i < ax->count; i++) ec_traj_override(&run->traj[s], i, ax->target_torque[i]);
+    } else if (run->speed_control) {
+        int16_t speed[EC_AXES_MAX];
+        moving = ec_traj_step(&run->traj[s], speed);
+        for (int i = 0; i < ax->count; i++) run->velpi[s].target[i] = speed[i];
+        ec_velpi_update(&run->velpi[s], ax->actual_velocity, ax->enabled, ax->target_torque);
+    } else {
+        moving = ec_traj_step(&run->traj[s], ax->target_torque);
+    }
+    for (int i = 0; i < ax->count; i++) ax->mode[i] = MODE_CST;
+
+    if (run->stop_deadline_ns[s]) {
+        int timeout = cyc->wake_ns > run->stop_deadline_ns[s];
+        if (!run->quick_stop[s] && (moving == 0 || timeout)) {
+            ec_axes_command(ax, CIA402_TARGET_QUICK_STOP, cyc->wake_ns);
+            run->quick_stop[s] = 1;
+        }
+        int reached = 0;
+        for (int i = 0; i < ax->count; i++) reached += cia402_reached(&ax->sm[i], ec_axes_velocity(ax, i));
+        if (run->quick_stop[s] && !run->done[s] && (reached == ax->count || timeout)) {
+            run->done[s] = 1;
+            if (ec_atomic_add_u32(&run->stopped, 1) + 1 == (uint32_t)core->segment_count) {
+                ec_segment_group_stop(seg->group);
+            }
+        }
+    }
+
+    if (s == 0) {
+        telemetry_rec_t rec;
+        rec.timestamp_ns = cyc->wake_ns;
+        rec.velocity = ax->actual_velocity[0];
+        rec.wkc = seg->wkc;
+        rec.late_ns = (int32_t)cyc->last_late_ns;
+        rec.dc_offset_ns = seg->dc_sync ? (int32_t)seg->dcsync.offset_ns : 0;
+        rec.statusword = ax->statusword[0];
+        rec.torque = ec_axes_has(ax, PDO_ACTUAL_TORQUE) ? ax->actual_torque[0] : ax->target_torque[0];
+        rec.flags = seg->frames.tripped ? TELEMETRY_F_TRIPPED : 0;
+        telemetry_push(&core->telemetry, &rec);
+    }
+
+    ec_cmdq_publish(q, ax, tick, cyc->wake_ns, seg->wkc,
+                    (uint16_t)((seg->wkc == seg->expected_wkc ? EC_CMDQ_WKC_OK : 0) |
+                               (seg->frames.tripped ? EC_CMDQ_DROPPED : 0) |
+                               (run->stop_deadline_ns[s] ? EC_CMDQ_STOPPING : 0)));
+
+    // one mailbox step, only while the first half of the cycle is still ahead of us
+    if (ec_cycle_now_ns() - cyc->wake_ns < cyc->period_ns / 2) ec_sdoasync_poll(&core->sdo[s], 1);
+}
+
+// The cyclic threads record into memory (ec_recorder.h); the service thread writes it to the files.
+static void flush_recorders(l7nh_core_t *core) {
+    for (int s = 0; s < core->segment_count; s++) {
+        if (core->segments[s].recorder) ec_recorder_flush(core->segments[s].recorder);
+    }
+}
+
+static void close_recorders(l7nh_core_t *core) {
+    for (int s = 0; s < core->segment_count; s++) {
+        if (core->segments[s].recorder) ec_recorder_close(core->segments[s].recorder);
+        core->segments[s].recorder = NULL;
+    }
+}
+
+// The shared process images stay mapped for readers, showing the last cycle, until the disconnect.
+static void release_shm(l7nh_core_t *core) {
+    for (int s = 0; s < core->segment_count; s++) {
+        if (core->segments[s].shm) ec_shm_set_running(core->segments[s].shm, 0);
+        core->segments[s].shm = NULL;
+    }
+}
+
+// cfg.replay: map one recording per segment, which must have the axes and the period of the segment.
+// Returns 0, or -1 after reporting why (nothing stays open).
+static int open_replays(l7nh_core_t *core) {
+    const l7nh_config_t *cfg = &core->cfg;
+    char names[sizeof(cfg->replay)], txt[384], path[32];
+    char *name = names;
+
+    snprintf(names, sizeof(names), "%s", cfg->replay);
+    for (int s = 0; s < core->segment_count; s++) {
+        ec_replay_t *rp = &core->replays[s];
+        const ec_axes_t *ax = &core->segments[s].axes;
+        char *next = name ? strchr(name, ',') : NULL;
+        if (next) *next++ = '\0';
+        snprintf(path, sizeof(path), "l7nh_replay_seg%d.txt", s);
+        if (!name || !*name) {
+            snprintf(txt, sizeof(txt), "Replay: no recording for segment %d", s);
+        } else if (ec_replay_open(rp, name, path) != 0) {
+            snprintf(txt, sizeof(txt), "Replay %s: %s", name, rp->error);
+        } else if (rp->axes != ax->count || rp->hdr->period_ns != cfg->cycle_ns) {
+            snprintf(txt, sizeof(txt), "Replay %s: recorded %d axes at %lld us, segment %d has %d at %lld us", name,
+                rp->axes, (long long)(rp->hdr->period_ns / 1000), s, ax->count, (long long)(cfg->cycle_ns / 1000));
+            ec_replay_close(rp);
+        } else {
+            rp->band[EC_REPLAY_TORQUE] = cfg->replay_torque_band;
+            rp->band[EC_REPLAY_VELOCITY] = cfg->replay_velocity_band;
+            rp->band[EC_REPLAY_POSITION] = cfg->replay_position_band;
+            name = next;
+            continue;
+        }
+        report(core, L7NH_EVENT_STATE, txt);
+        while (--s >= 0) ec_replay_close(&core->replays[s]);
+        return -1;
+    }
+    return 0;
+}
+
+// End of a replay run: complete the reports and tell how closely the drives followed the recordings.
+static void close_replays(l7nh_core_t *core) {
+    char txt[384];
+
+    if (!core->run.replay) return;
+    for (int s = 0; s < core->segment_count; s++) {
+        ec_replay_t *rp = &core->replays[s];
+        ec_replay_close(rp);
+        snprintf(txt, sizeof(txt), "Segment %d: replayed %llu of %llu cycles; out of band: state %llu, torque %llu,"
+            " velocity %llu, position %llu cycles (l7nh_replay_seg%d.txt)", s, (unsigned long long)rp->played,
+            (unsigned long long)rp->cycles, (unsigned long long)ec_replay_out(rp, EC_REPLAY_STATE),
+            (unsigned long long)ec_replay_out(rp, EC_REPLAY_TORQUE),
+            (unsigned long long)ec_replay_out(rp, EC_REPLAY_VELOCITY),
+            (unsigned long long)ec_replay_out(rp, EC_REPLAY_POSITION), s);
+        report(core, L7NH_EVENT_STATE, txt);
+    }
+}
+
+static void start_run(l7nh_core_t *core) {
+    const l7nh_config_t *cfg = &core->cfg;
+    l7nh_run_t *run = &core->run;
+    int replay = cfg->replay[0] != '\0';
+
+    if (replay && open_replays(core) != 0) return;
+
+    // Mode of Operation = CST. Sent every cycle when 0x6060 is in the PDO, otherwise set once over SDO.
+    for (int s = 0; s < core->segment_count; s++) {
+        ec_axes_t *ax = &core->segments[s].axes;
+        for (int i = 0; i < ax->count; i++) {
+            if (!ec_pdomap_has(&ax->map[i], PDO_MODE_OF_OPERATION)) {
+                uint8 mode = MODE_CST;
+                ec_sdo_req_t req;
+                ec_sdo_req_write(&req, ax->slave[i], IDX_MODE_OF_OPERATION, 0x00, &mode, sizeof(mode));
+                sdo_transfer(core, s, &req);
+            }
+        }
+    }
+
+    // Run the cyclic PDO loops on common absolute deadlines (see ec_segment.c). The CiA402 state
+    // machines enable the drives from inside the cycle: shutdown -> switch on -> enable, each step
+    // confirmed by the statusword of the previous frame.
+    // A replay sends recorded torque, whatever computed it then.
+    memset(run, 0, sizeof(*run));
+    run->replay = replay;
+    run->speed_control = replay ? 0 : cfg->speed_control;
+    for (int s = 0; s < core->segment_count; s++) {
+        if (run->speed_control && !ec_axes_has(&core->segments[s].axes, PDO_ACTUAL_VELOCITY)) {
+            report(core, L7NH_EVENT_STATE, "0x606C not in the PDO - running without speed control");
+            run->speed_control = 0;
+        }
+    }
+    ec_segment_group_init(&core->group, cfg->cycle_ns, run_cycle, core);
+    for (int s = 0; s < core->segment_count; s++) {
+        ec_segment_t *seg = &core->segments[s];
+        if (run->speed_control) {
+            ec_traj_init(&run->traj[s], seg->axes.count, cfg->cycle_ns, SPEED_LIMIT_RPM);
+            ec_velpi_init(&run->velpi[s], seg->axes.count, cfg->cycle_ns, VELPI_KP, VELPI_KI, VELPI_KA, TORQUE_LIMIT);
+        } else {
+            ec_traj_init(&run->traj[s], seg->axes.count, cfg->cycle_ns, TORQUE_LIMIT);
+        }
+        for (int i = 0; i < seg->axes.count; i++) {
+            cia402_init(&seg->axes.sm[i]);
+            if (!run->replay) ec_traj_scurve(&run->traj[s], i, run->speed_control ? (int16_t)cfg->speed_set_rpm : cfg->torque_set,
+                START_RAMP_NS);
+        }
+        ec_axes_command(&seg->axes, CIA402_TARGET_ENABLED, ec_cycle_now_ns());
+        if (seg->dc_sync) ec_dcsync_init(&seg->dcsync, cfg->cycle_ns, EC_DCSYNC_SHIFT_NS); // fresh PI state per run
+        ec_segment_group_add(&core->group, seg, cfg->cpu0 < 0 ? -1 : cfg->cpu0 + s);
+        seg->recorder = NULL;
+        if (cfg->record) {
+            char path[32];
+            snprintf(path, sizeof(path), "l7nh_%sseg%d.rec", run->replay ? "replay_" : "", s);    // not over the source
+            if (ec_recorder_open(&core->recorders[s], path, 0, seg->axes.count, cfg->cycle_ns) == 0) {
+                seg->recorder = &core->recorders[s];
+            }
+        }
+        seg->scope = NULL;
+        if (core->scopes[s].ring) {
+            ec_scope_arm(&core->scopes[s]);
+            seg->scope = &core->scopes[s];
+        }
+        seg->shm = NULL;
+        if (core->shm[s].area) {
+            core->shm[s].area->setpoint_rpm = (uint32_t)run->speed_control;
+            ec_shm_set_running(&core->shm[s], 1);
+            seg->shm = &core->shm[s];
+        }
+        ec_cmdq_reset(&core->cmdq[s]);
+    }
+
+    memset(core->health_reported, 0, sizeof(core->health_reported));
+    memset(core->slave_reported, 0, sizeof(core->slave_reported));
+    for (int s = 0; s < core->segment_count; s++) core->trips_reported[s] = core->segments[s].frames.trips;
+    if (ec_segment_group_start(&core->group, cfg->priority) != 0) {
+        report(core, L7NH_EVENT_STATE, core->segments[0].error ? core->segments[0].error : "Cannot start cycle");
+        close_recorders(core);
+        release_shm(core);
+        close_replays(core);
+        return;
+    }
+    ec_atomic_store_u32(&core->state, L7NH_RUNNING);
+    report(core, L7NH_EVENT_STATE, run->replay ? "Replaying..." : "Running...");
+}
+
+// Enable report of the last run for the slowest axis of all segments: request -> Operation enabled and the
+// time spent in each state on the way, or the state an axis that never enabled got stuck in.
+static void format_enable(const l7nh_core_t *core, char *txt, size_t len) {
+    const cia402_t *sm = NULL;
+    int worst_seg = 0, worst = 0;
+    for (int s = 0; s < core->segment_count; s++) {
+        for (int i = 0; i < core->segments[s].axes.count; i++) {
+            const cia402_t *a = &core->segments[s].axes.sm[i];
+            if (!sm || (sm->enable_ns >= 0 && (a->enable_ns < 0 || a->enable_ns > sm->enable_ns))) {
+                sm = a;
+                worst_seg = s;
+                worst = i;
+            }
+        }
+    }
+    if (!sm) {
+        snprintf(txt, len, "no axes");
+    } else if (sm->enable_ns < 0) {
+        snprintf(txt, len, "axis %d.%d never enabled (stuck in %s%s)", worst_seg, worst,
+            cia402_state_name(sm->state), (sm->error & CIA402_ERR_FAULT) ? ", fault reset failed" : "");
+    } else {
+        snprintf(txt, len, "slowest axis %d.%d enabled in %lld us / %lld cycles (SOD %lld, RTSO %lld, SO %lld us)",
+            worst_seg, worst, (long long)(sm->enable_ns / 1000), (long long)sm->enable_cycles,
+            (long long)(sm->state_ns[CIA402_SWITCH_ON_DISABLED] / 1000),
+            (long long)(sm->state_ns[CIA402_READY_TO_SWITCH_ON] / 1000),
+            (long long)(sm->state_ns[CIA402_SWITCHED_ON] / 1000));
+    }
+}
+
+// The cyclic threads have returned (or are about to): join them and report the run.
+static void finish_run(l7nh_core_t *core) {
+    char txt[384], enable_txt[160];
+
+    ec_segment_group_join(&core->group);
+    close_recorders(core);
+    release_shm(core);
+    close_replays(core);
+    for (int s = 0; s < core->segment_count; s++) core->segments[s].scope = NULL; // a capture in progress stays unsaved
+
+    uint64_t cycles = core->segments[0].cycle.cycles, overruns = 0, barrier_timeouts = 0;
+    int64_t max_late = 0;
+    for (int s = 0; s < core->segment_count; s++) {
+        overruns += core->segments[s].cycle.overruns;
+        barrier_timeouts += core->segments[s].stats.barrier_timeouts;
+        if (core->segments[s].cycle.max_late_ns > max_late) max_late = core->segments[s].cycle.max_late_ns;
+    }
+    format_enable(core, enable_txt, sizeof(enable_txt));
+    snprintf(txt, sizeof(txt), "Stopped after %llu cycles, %llu overruns, %llu barrier timeouts, max late %lld us; %s",
+        (unsigned long long)cycles, (unsigned long long)overruns, (unsigned long long)barrier_timeouts,
+        (long long)(max_late / 1000), enable_txt);
+    report(core, L7NH_EVENT_STATE, txt);
+    const ec_dcsync_t *dc = &core->segments[0].dcsync;
+    if (core->segments[0].dc_sync) {
+        if (dc->converged) {
+            snprintf(txt, sizeof(txt), "DC offset %lld ns, converged in %lld ms", (long long)dc->offset_ns,
+                (long long)(dc->converge_ns / 1000000));
+        } else {
+            snprintf(txt, sizeof(txt), "DC offset %lld ns, not converged", (long long)dc->offset_ns);
+        }
+        report(core, L7NH_EVENT_INFO, txt);
+    }
+
+    // The cycles already ramped the drives down through quick stop; leave zero torque in the outputs
+    for (int s = 0; s < core->segment_count; s++) {
+        ec_axes_t *ax = &core->segments[s].axes;
+        for (int i = 0; i < ax->count; i++) ax->target_torque[i] = 0;
+        ec_axes_pack(ax);
+    }
+    ec_atomic_store_u32(&core->state, L7NH_CONNECTED);
+
+    // Final velocity over SDO (the drive's own scaling)
+    ec_sdo_req_t req;
+    int32_t vel;
+    ec_sdo_req_read(&req, core->segments[0].axes.slave[0], IDX_ACTUAL_VELOCITY, 0x00, sizeof(vel));
+    if (sdo_transfer(core, 0, &req)) {
+        memcpy(&vel, req.data, sizeof(vel));
+        snprintf(txt, sizeof(txt), "Final RPM: %d", (int)vel);
+        report(core, L7NH_EVENT_INFO, txt);
+    } else {
+        report(core, L7NH_EVENT_INFO, "Stopped - final RPM unknown");
+    }
+}
+
+// Cable break on a redundant segment: locate it from the port status (a few FPRDs, so not from the cycle)
+// and report where it is and what the failover cost.
+static void check_redundancy(l7nh_core_t *core) {
+    char txt[256];
+
+    for (int i = 0; i < core->segment_count; i++) {
+        ec_redundancy_t *red = &core->segments[i].red;
+        uint32_t events = red->failovers * 2 + red->degraded;     // changes when an event opens or closes
+        if (events == core->red_reported[i]) continue;
+        core->red_reported[i] = events;
+        int brk = ec_redundancy_check(red, &core->segments[i].context);
+        if (brk == EC_REDUNDANCY_NO_BREAK) {
+            snprintf(txt, sizeof(txt), "Segment %d: %u cycles without full WKC, all cables closed", i,
+                (unsigned)red->last_lost);
+        } else if (red->degraded) {
+            snprintf(txt, sizeof(txt), "Segment %d: cable open behind slave %d, %d drives unreachable", i, brk,
+                red->silent);
+        } else {
+            snprintf(txt, sizeof(txt), "Segment %d: cable open behind slave %d, running on both ends (failover lost %u cycles)",
+                i, brk, (unsigned)red->last_lost);
+        }
+        report(core, L7NH_EVENT_STATE, txt);
+    }
+}
+
+// Slaves the supervisor saw drop out of OP or bring back (ec_health.c).
+static void check_health(l7nh_core_t *core) {
+    char txt[256];
+
+    for (int i = 0; i < core->segment_count; i++) {
+        ec_segment_t *seg = &core->segments[i];
+        uint32_t changes = ec_atomic_load_u32(&seg->health.changes);
+        if (changes == core->health_reported[i]) continue;
+        core->health_reported[i] = changes;
+        for (int s = 1; s <= seg->slavecount; s++) {
+            const ec_health_slave_t *hs = &seg->health.slave[s];
+            uint32_t events = ec_atomic_load_u32(&hs->lost) + ec_atomic_load_u32(&hs->recovered);
+            if (events == core->slave_reported[i][s]) continue;
+            core->slave_reported[i][s] = events;
+            if (ec_atomic_load_u32(&hs->down)) {
+                snprintf(txt, sizeof(txt), "Segment %d: slave %d out of OP (AL state 0x%02x, status 0x%04x), its axes without torque",
+                    i, s, hs->state, hs->al_status);
+            } else {
+                snprintf(txt, sizeof(txt), "Segment %d: slave %d back in OP after %.1f ms (%u outages, %u reconfigured)", i, s,
+                    ec_atomic_load_u64(&hs->last_recovery_ns) / 1e6, (unsigned)hs->lost, (unsigned)hs->reconfigured);
+            }
+            report(core, L7NH_EVENT_STATE, txt);
+        }
+    }
+}
+
+// Segments whose cycle dropped the torque after a run of bad frames (ec_wkc.c).
+static void check_frames(l7nh_core_t *core) {
+    char txt[256];
+
+    for (int i = 0; i < core->segment_count; i++) {
+        ec_wkc_counts_t n;
+        ec_wkc_read(&core->segments[i].frames, &n);
+        if (n.trips == core->trips_reported[i] || n.tripped == EC_WKC_GOOD) continue;
+        core->trips_reported[i] = n.trips;
+        snprintf(txt, sizeof(txt), "Segment %d: torque dropped after %u %s frames in a row (%llu missing, %llu partial, %llu late so far)",
+            i, (unsigned)core->segments[i].frames.limit[n.tripped], ec_wkc_class_name(n.tripped),
+            (unsigned long long)n.count[EC_WKC_MISSING], (unsigned long long)n.count[EC_WKC_PARTIAL],
+            (unsigned long long)n.count[EC_WKC_LATE]);
+        report(core, L7NH_EVENT_STATE, txt);
+    }
+}
+
+// Replay: keep the recordings streaming towards the cycles and the reports written; stop once every
+// segment has played its recording to the end.
+static void check_replays(l7nh_core_t *core) {
+    int done = 0;
+
+    for (int s = 0; s < core->segment_count; s++) {
+        ec_replay_prefetch(&core->replays[s]);
+        ec_replay_drain(&core->replays[s]);
+        done += ec_atomic_load_u32(&core->replays[s].done) != 0;
+    }
+    if (done == core->segment_count && l7nh_state(core) == L7NH_RUNNING && !ec_atomic_load_u32(&core->stop_req)) {
+        report(core, L7NH_EVENT_STATE, "Replay finished");
+        l7nh_stop(core);
+    }
+}
+
+// Frozen scope captures: save to the next l7nh_scope_seg<N>_<K>.rec, report the cause and re-arm.
+static void check_scopes(l7nh_core_t *core) {
+    char txt[256], cause[64], path[48];
+
+    for (int i = 0; i < core->segment_count; i++) {
+        ec_scope_t *sc = &core->scopes[i];
+        if (!ec_scope_frozen(sc)) continue;
+        snprintf(path, sizeof(path), "l7nh_scope_seg%d_%03u.rec", i, (unsigned)sc->captures);
+        int n = ec_scope_save(sc, path);
+        ec_scope_cause_name(sc->cause, cause, sizeof(cause));
+        if (n < 0) {
+            snprintf(txt, sizeof(txt), "Segment %d: scope triggered (%s), cannot write %s", i, cause, path);
+        } else if (sc->trigger_axis >= 0) {
+            snprintf(txt, sizeof(txt), "Segment %d: scope triggered (%s) on axis %d, %d cycles in %s", i, cause,
+                sc->trigger_axis, n, path);
+        } else {
+            snprintf(txt, sizeof(txt), "Segment %d: scope triggered (%s), %d cycles in %s", i, cause, n, path);
+        }
+        report(core, L7NH_EVENT_STATE, txt);
+        ec_scope_arm(sc); // without a running cycle it just waits for the next start
+    }
+}
+
+int l7nh_poll(l7nh_core_t *core) {
+    l7nh_state_t state = l7nh_state(core);
+
+    if (state == L7NH_IDLE) return 0;
+    if (ec_atomic_load_u32(&core->disconnect_req) && state == L7NH_RUNNING) ec_atomic_store_u32(&core->stop_req, 1);
+
+    // a request that does not fit the state it finds is dropped, not kept for later
+    int start = ec_atomic_load_u32(&core->start_req) != 0, stop = ec_atomic_load_u32(&core->stop_req) != 0;
+    if (start) ec_atomic_store_u32(&core->start_req, 0);
+    if (stop) ec_atomic_store_u32(&core->stop_req, 0);
+    if (state == L7NH_CONNECTED && start && !stop && !ec_atomic_load_u32(&core->disconnect_req)) {
+        start_run(core);
+    } else if (state == L7NH_RUNNING && stop) {
+        ec_atomic_store_u32(&core->run.stop, 1);
+        ec_atomic_store_u32(&core->state, L7NH_STOPPING);
+        report(core, L7NH_EVENT_STATE, "Stopping...");
+    }
+    state = l7nh_state(core);
+
+    if (state == L7NH_RUNNING || state == L7NH_STOPPING) {
+        check_redundancy(core);
+        check_health(core);
+        check_frames(core);
+        if (core->run.replay) check_replays(core);
+        flush_recorders(core);
+        // a group stops itself once every segment has confirmed the quick stop
+        if (!ec_atomic_load_u32(&core->group.running)) finish_run(core);
+    } else {
+        // no cycle runs: the SDO engines are ours (the poll lock keeps them exclusive)
+        for (int i = 0; i < core->segment_count; i++) ec_sdoasync_poll(&core->sdo[i], 4);
+    }
+    check_scopes(core);
+
+    if (l7nh_state(core) == L7NH_CONNECTED && ec_atomic_load_u32(&core->disconnect_req)) {
+        close_segments(core);
+        report(core, L7NH_EVENT_STATE, "Disconnected");
+        return 0;
+    }
+    return 1;
+}
+
+uint32_t l7nh_telemetry(l7nh_core_t *core, char *line1, size_t len1, char *line2, size_t len2,
+                        telemetry_summary_t *out) {
+    telemetry_summary_t sum;
+    const ec_segment_t *seg = &core->segments[0];
+
+    if (telemetry_drain(&core->telemetry, &sum) == 0) return 0;
+    if (out) *out = sum;
+    const char *state = cia402_state_name(cia402_decode(sum.last.statusword));
+    if (seg->axes.count && ec_atomic_load_u32(&seg->health.slave[seg->axes.slave[0]].down)) {
+        snprintf(line1, len1, "RPM: --- (axis 0 of %d offline, recovering)  WKC: %d", seg->axes.count,
+            (int)sum.min_wkc);
+    } else if (ec_axes_has(&seg->axes, PDO_ACTUAL_VELOCITY)) {
+        snprintf(line1, len1, "RPM: %d (axis 0 of %d)  %s  WKC: %d", (int)sum.last.velocity, seg->axes.count,
+            state, (int)sum.min_wkc);
+    } else {
+        snprintf(line1, len1, "RPM: (0x606C not in PDO)  %s  WKC: %d", state, (int)sum.min_wkc);
+    }
+    if (seg->dc_sync) {
+        snprintf(line2, len2, "Running - jitter %d us, DC offset %d ns%s, dropped %u",
+            (int)(sum.max_late_ns / 1000), (int)sum.last.dc_offset_ns,
+            seg->dcsync.converged ? " (locked)" : " (converging)", (unsigned)core->telemetry.dropped);
+    } else {
+        snprintf(line2, len2, "Running - jitter %d us, dropped %u",
+            (int)(sum.max_late_ns / 1000), (unsigned)core->telemetry.dropped);
+    }
+    return sum.count;
+}
+
+int l7nh_latency(const l7nh_core_t *core, char *txt, size_t len) {
+    size_t used = 0;
+    int risk = 0;
+
+    txt[0] = '\0';
+    if (core->segment_count == 0) {
+        snprintf(txt, len, "Not connected");
+        return 0;
+    }
+    for (int s = 0; s < core->segment_count && used < len; s++) {
+        const ec_segment_t *seg = &core->segments[s];
+        ec_hist_summary_t sum[EC_HIST_COUNT];
+        for (int m = 0; m < EC_HIST_COUNT; m++) ec_hist_summarize(&seg->hist[m], core->cfg.cycle_ns, &sum[m]);
+        used += snprintf(txt + used, len - used, "Segment %d (%s), %llu cycles, period %lld us\n", s,
+            seg->ifname, (unsigned long long)sum[EC_HIST_TOTAL].count, (long long)(core->cfg.cycle_ns / 1000));
+        for (int m = 0; m < EC_HIST_COUNT && used < len; m++) {
+            used += snprintf(txt + used, len - used, "  %-8s p50 %7.1f  p99 %7.1f  p99.9 %7.1f  max %7.1f us\n",
+                ec_hist_metric_name((ec_hist_metric_t)m), sum[m].p50 / 1e3, sum[m].p99 / 1e3, sum[m].p999 / 1e3,
+                sum[m].max / 1e3);
+        }
+        risk |= sum[EC_HIST_TOTAL].over != 0;
+        if (used < len) {
+            used += snprintf(txt + used, len - used, "  %llu cycles over the period%s\n",
+                (unsigned long long)sum[EC_HIST_TOTAL].over, sum[EC_HIST_TOTAL].over ? " - OVERRUN RISK" : "");
+        }
+        uint32_t lost = 0, recovered = 0;
+        uint64_t worst = 0;
+        for (int k = 1; k <= seg->slavecount; k++) {
+            const ec_health_slave_t *hs = &seg->health.slave[k];
+            lost += hs->lost;
+            recovered += hs->recovered;
+            if (hs->max_recovery_ns > worst) worst = hs->max_recovery_ns;
+        }
+        if (used < len) {
+            used += snprintf(txt + used, len - used,
+                "  supervisor: %u outages, %u recovered (worst %.1f ms), longest check %.2f ms\n",
+                (unsigned)lost, (unsigned)recovered, worst / 1e6, seg->health.max_step_ns / 1e6);
+        }
+        ec_wkc_counts_t n;
+        ec_wkc_read(&seg->frames, &n);
+        if (used < len) {
+            used += snprintf(txt + used, len - used,
+                "  frames: %llu missing, %llu partial WKC, %llu late of %llu, longest run %u, torque dropped %u times\n\n",
+                (unsigned long long)n.count[EC_WKC_MISSING], (unsigned long long)n.count[EC_WKC_PARTIAL],
+                (unsigned long long)n.count[EC_WKC_LATE], (unsigned long long)n.cycles, (unsigned)n.max_run,
+                (unsigned)n.trips);
+        }
+    }
+    return risk;
+}
+
+int l7nh_frames(const l7nh_core_t *core, int s, ec_wkc_counts_t *out) {
+    if (s < 0 || s >= core->segment_count) return -1;
+    ec_wkc_read(&core->segments[s].frames, out);
+    return 0;
+}
+
+int l7nh_set(l7nh_core_t *core, const l7nh_setpoint_t *sp, int n, int velocity, uint32_t id) {
+    static ec_cmd_t batch[EC_SEGMENT_MAX][EC_SEGMENT_MAX * EC_AXES_MAX];     // service thread only
+    uint32_t count[EC_SEGMENT_MAX] = { 0 };
+
+    if (l7nh_state(core) != L7NH_RUNNING || core->run.replay) return L7NH_SET_STATE;
+    if ((velocity != 0) != (core->run.speed_control != 0)) return L7NH_SET_KIND;
+    for (int k = 0; k < n; k++) {
+        int s = 0, axis = sp[k].axis;
+        while (s < core->segment_count && axis >= core->segments[s].axes.count) {
+            axis -= core->segments[s].axes.count;
+            s++;
+        }
+        if (s == core->segment_count) return L7NH_SET_AXIS;
+        if (count[s] == EC_CMDQ_SLOTS) return L7NH_SET_FULL;
+        ec_cmd_t *c = &batch[s][count[s]++];
+        c->axis = (uint16_t)axis;
+        c->reserved = 0;
+        c->value = sp[k].value;
+        c->id = id;
+    }
+    // all or nothing: only this thread fills the queues, so the room seen here is there for the pushes
+    for (int s = 0; s < core->segment_count; s++) {
+        if (count[s] > ec_cmdq_space(&core->cmdq[s])) return L7NH_SET_FULL;
+    }
+    for (int s = 0; s < core->segment_count; s++) {
+        if (count[s]) ec_cmdq_push(&core->cmdq[s], batch[s], count[s]);
+    }
+    return L7NH_SET_OK;
+}
+
+void l7nh_subscribe(l7nh_core_t *core, uint32_t decimation) {
+    for (int s = 0; s < EC_SEGMENT_MAX; s++) ec_cmdq_subscribe(&core->cmdq[s], decimation);
+}
+
+int l7nh_status(l7nh_core_t *core, int s, ec_cmdq_status_t *out) {
+    if (s < 0 || s >= core->segment_count) return 0;
+    return ec_cmdq_status(&core->cmdq[s], out);
+}
+
+void l7nh_reset_stats(l7nh_core_t *core) {
+    for (int s = 0; s < core->segment_count; s++) {
+        for (int m = 0; m < EC_HIST_COUNT; m++) ec_hist_reset(&core->segments[s].hist[m]);
+    }
+}
@@ -0,0 +1,180 @@
+// l7nh_core.h
+// Headless control core: everything between "connect these NICs" and "the drives turn", without any
+// GUI or OS dependency beyond what ec_segment / ec_cycle already abstract.
+// - One segment per NIC (ec_segment.c), every L7NH on it an axis; a cyclic thread per segment runs the
+//   CiA402 state machines, the setpoint generator (ec_traj.c) and optionally the velocity PI
+//   (ec_velpi.c), records every cycle (ec_recorder.c) and keeps a triggered scope (ec_scope.c).
+// - One service thread owns the core: it connects, then calls l7nh_poll() every millisecond or so. Poll
+//   advances the SDO engines while no cycle runs, starts and stops the cycle, locates cable breaks,
+//   saves scope captures and finally closes the segments. Start / stop / disconnect are requests any
+//   thread may raise; poll carries them out, so slow SDO traffic never blocks the caller.
+// - With cfg.shm the process image of every segment is published in shared memory each cycle, and
+//   other processes may drive axes from there (ec_shm.c); the run cycle takes their setpoints instead
+//   of the generator's, until the stop ramp takes over.
+// - A control API on the service thread (l7nh_ctl.c) queues setpoints for the cycle with l7nh_set()
+//   and reads decimated status back with l7nh_status(), through the lock-free rings of ec_cmdq.c.
+// - With cfg.replay a run plays recordings instead (ec_replay.c): every cycle sends the recorded
+//   controlword and torque of its axes and compares the drives' feedback with the recorded one; the run
+//   stops by itself at the end of the recordings and leaves a divergence report per segment.
+// - Any thread may also drain the telemetry ring (one consumer) and read or reset the latency
+//   histograms while the cycle runs.
+// - Messages for the operator are handed to the event callback on the service thread: a state line
+//   ("Connected ...", "Stopped after ...") and an info line (DC offset, final velocity, ...).
+// - A segment whose frames go missing, come back short or late for longer than the limits of the config
+//   drops the torque of its axes for the rest of the run (ec_wkc.c); that is reported as a state line.
+// Hosts: soem_l7nh_win32_v2.c (Win32 GUI) and l7nhd.c (Linux daemon).
+
+#ifndef L7NH_CORE_H
+#define L7NH_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ec_segment.h"
+#include "ec_cmdq.h"
+#include "ec_replay.h"
+#include "ec_sdoasync.h"
+#include "ec_traj.h"
+#include "ec_velpi.h"
+#include "telemetry.h"
+
+#define L7NH_VENDOR     0x00007595      // every slave with this vendor id (LS Mecapion) is driven as an axis
+
+typedef struct {
+    int64_t cycle_ns;                   // EC_CYCLE_1MS / _500US / _250US / _125US
+    int compact_pdo;                    // program the minimal PDO mapping from ec_pdocfg.c in PRE-OP
+    int dc_sync;                        // SYNC0 on the drive + cycle locked to the DC reference clock
+    int record;                         // every cycle of every axis into l7nh_seg<N>.rec
+    int scope;                          // triggered capture into l7nh_scope_seg<N>_<K>.rec
+    int shm;                            // process image in shared memory l7nh_seg<N>, setpoints from there (ec_shm.h)
+    int topo_cache;                     // reconnect from the fingerprint in l7nh_topo_seg<N>.bin (ec_topo.h)
+    int speed_control;                  // velocity PI in the cycle (needs 0x606C in the PDO)
+    int16_t torque_set;                 // Start: torque the generator ramps to (units per ESI)
+    int32_t speed_set_rpm;              // same with speed_control
+    uint32_t missing_limit;             // consecutive missing frames that drop the torque of a segment (ec_wkc.h),
+    uint32_t partial_limit;             // same with a partial working counter and with late frames; 0 = never
+    uint32_t late_limit;
+    char replay[256];                   // Start replays these recordings, one per segment ("a.rec,b.rec"), instead
+                                        // of ramping to torque_set; "" = normal run. Recorded into l7nh_replay_seg<N>.rec
+    int32_t replay_torque_band;         // replay: largest deviation from the recorded 0x6077 / 0x606C / 0x6064
+    int32_t replay_velocity_band;       // that is not a divergence
+    int32_t replay_position_band;
+    int priority;                       // real-time priority of the cyclic threads
+    int cpu0;                           // the thread of segment i runs on core cpu0 + i (-1 = not pinned)
+} l7nh_config_t;
+
+// l7nh_set() results
+#define L7NH_SET_OK     0
+#define L7NH_SET_STATE  -1              // no run, the run is stopping or replays a recording
+#define L7NH_SET_KIND   -2              // torque given to a velocity-PI run or the other way round
+#define L7NH_SET_AXIS   -3              // no such axis
+#define L7NH_SET_FULL   -4              // a queue of the batch has no room; nothing was queued
+
+typedef struct {
+    uint16_t axis;                      // over all segments: segment 0 first
+    int32_t value;                      // 0x6071 torque, or rpm with speed_control
+} l7nh_setpoint_t;
+
+typedef enum {
+    L7NH_IDLE = 0,                      // not connected
+    L7NH_CONNECTED,                     // segments in OP, no cycle running
+    L7NH_RUNNING,                       // cyclic threads running
+    L7NH_STOPPING                       // stop ramp and quick stop in progress
+} l7nh_state_t;
+
+typedef enum {
+    L7NH_EVENT_STATE = 0,               // what the core is doing / did last
+    L7NH_EVENT_INFO                     // secondary figures (DC offset, final velocity, ...)
+} l7nh_event_kind_t;
+
+typedef void (*l7nh_event_t)(void *user, l7nh_event_kind_t kind, const char *msg);
+
+// State shared with the cyclic hook of a run
+typedef struct {
+    int speed_control;                          // traj streams rpm for velpi instead of torque
+    int replay;                                 // the cycles play core->replays until the stop
+    ec_traj_t traj[EC_SEGMENT_MAX];
+    ec_velpi_t velpi[EC_SEGMENT_MAX];
+    volatile uint32_t stop;                     // set by the service thread: ramp down and quick stop
+    int64_t stop_deadline_ns[EC_SEGMENT_MAX];   // 0 while running; set when the stop was seen
+    int quick_stop[EC_SEGMENT_MAX];             // the stop ramp is done, quick stop commanded
+    int done[EC_SEGMENT_MAX];                   // counted in 'stopped'
+    volatile uint32_t stopped;                  // segments whose axes confirmed the quick stop
+} l7nh_run_t;
+
+typedef struct {
+    l7nh_config_t cfg;
+    l7nh_event_t event;
+    void *user;
+    volatile uint32_t state;                    // l7nh_state_t
+    volatile uint32_t start_req, stop_req, disconnect_req;
+
+    ec_segment_t segments[EC_SEGMENT_MAX];
+    int segment_count;
+    ec_segment_group_t group;
+    ec_sdoasync_t sdo[EC_SEGMENT_MAX];          // per segment; polled by its cyclic thread while running,
+                                                // by the service thread otherwise
+    ec_recorder_t recorders[EC_SEGMENT_MAX];
+    ec_scope_t scopes[EC_SEGMENT_MAX];
+    ec_topo_t topo[EC_SEGMENT_MAX];
+    ec_shm_t shm[EC_SEGMENT_MAX];
+    ec_cmdq_t cmdq[EC_SEGMENT_MAX];             // control API <-> cyclic thread
+    ec_replay_t replays[EC_SEGMENT_MAX];        // cfg.replay: per segment, open while its run lasts
+    uint32_t red_reported[EC_SEGMENT_MAX];      // redundancy events already reported
+    uint32_t health_reported[EC_SEGMENT_MAX];   // health.changes already reported
+    uint32_t slave_reported[EC_SEGMENT_MAX][EC_MAXSLAVE];   // outages + recoveries already reported
+    uint32_t trips_reported[EC_SEGMENT_MAX];    // frames.trips already reported
+    telemetry_ring_t telemetry;                 // axis 0 of segment 0, cyclic thread -> any one reader
+    l7nh_run_t run;
+} l7nh_core_t;
+
+void l7nh_config_default(l7nh_config_t *cfg);
+
+// Service thread: connect one segment per interface in ifnames ("eth1" or "eth1,eth2,..."; "eth1/eth2"
+// makes that segment a ring with eth2 as the secondary NIC). Returns the number of axes, or -1 after
+// reporting why (nothing stays open). The connect time of every segment, per phase, is reported as
+// an info event.
+int l7nh_connect(l7nh_core_t *core, const char *ifnames, const l7nh_config_t *cfg, l7nh_event_t event,
+                 void *user);
+
+// Any thread: requests carried out by the next l7nh_poll(). Stop ramps every axis to zero (or to
+// standstill with speed_control) before the quick stop; disconnect stops first if needed.
+void l7nh_start(l7nh_core_t *core);
+void l7nh_stop(l7nh_core_t *core);
+void l7nh_disconnect(l7nh_core_t *core);
+
+// Service thread, every millisecond or so while connected. Returns 1, or 0 once disconnected.
+int l7nh_poll(l7nh_core_t *core);
+
+l7nh_state_t l7nh_state(const l7nh_core_t *core);
+
+// Any one thread: drain the telemetry ring and format it as two lines (velocity / state, timing); sum
+// (may be NULL) gets the figures themselves. Returns the number of records drained; the lines are left
+// alone when it is 0.
+uint32_t l7nh_telemetry(l7nh_core_t *core, char *line1, size_t len1, char *line2, size_t len2,
+                        telemetry_summary_t *sum);
+
+// Any thread: p50/p99/p99.9/max of the cycle histograms of every segment. Returns 1 if some cycle took
+// longer than the period (overrun risk), else 0.
+int l7nh_latency(const l7nh_core_t *core, char *txt, size_t len);
+
+// Any thread: frame counters of segment s since its connect (ec_wkc.h), for trending. Returns -1 if there
+// is no such segment.
+int l7nh_frames(const l7nh_core_t *core, int s, ec_wkc_counts_t *out);
+
+// Service thread (the one producer of the command queues): apply n setpoints from the next cycle on,
+// all of a segment in the same cycle (a batch over several segments may straddle one cycle boundary).
+// velocity says what the values are and must match the run. The cycle reports id as applied in its
+// status once it took them; they hold until the next setpoint for the axis or the stop ramp.
+// Returns L7NH_SET_*.
+int l7nh_set(l7nh_core_t *core, const l7nh_setpoint_t *sp, int n, int velocity, uint32_t id);
+
+// Service thread: status records every 'decimation' cycles while the cycle runs (0 = none). Take them
+// with l7nh_status(), which returns 1 and fills out if segment s had one waiting.
+void l7nh_subscribe(l7nh_core_t *core, uint32_t decimation);
+int l7nh_status(l7nh_core_t *core, int s, ec_cmdq_status_t *out);
+
+// Any thread: clear the histograms (carried out by each cyclic thread).
+void l7nh_reset_stats(l7nh_core_t *core);
+
+#endif // L7NH_CORE_H
@@ -0,0 +1,369 @@
+// l7nh_ctl.c
+// Local control API over a Unix domain socket (see l7nh_ctl.h).
+
+#define _GNU_SOURCE     // ppoll: the service loop waits with the resolution of the cycle
+
+#include "l7nh_ctl.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define STATUS_LAG_DIV  4       // the status of a cycle is fetched period / STATUS_LAG_DIV after its wakeup
+
+static int set_nonblock(int fd) {
+    int fl = fcntl(fd, F_GETFL, 0);
+    return fl < 0 ? -1 : fcntl(fd, F_SETFL, fl | O_NONBLOCK);
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// One status stream for the core, at the gcd of what the clients asked for; each client gets its own
+// every decimation cycles out of it.
+static void update_decimation(l7nh_ctl_t *ctl) {
+    uint32_t g = 0;
+    for (int k = 0; k < L7NH_CTL_CLIENTS; k++) {
+        if (ctl->client[k].fd >= 0 && ctl->client[k].decimation) g = gcd(g, ctl->client[k].decimation);
+    }
+    ctl->decimation = g;
+    l7nh_subscribe(ctl->core, g);
+}
+
+static void drop_client(l7nh_ctl_t *ctl, l7nh_ctl_client_t *c) {
+    close(c->fd);
+    c->fd = -1;
+    if (c->decimation) {
+        c->decimation = 0;
+        update_decimation(ctl);
+    }
+}
+
+// Append a frame to the send buffer of a client. Returns -1 if it does not fit.
+static int queue_frame(l7nh_ctl_client_t *c, uint8_t type, uint32_t id, const void *payload, uint32_t len) {
+    l7nh_ctl_hdr_t hdr;
+    if (c->tx_len + sizeof(hdr) + len > sizeof(c->tx)) return -1;
+    hdr.len = (uint16_t)(sizeof(hdr) + len);
+    hdr.type = type;
+    hdr.flags = 0;
+    hdr.id = id;
+    memcpy(c->tx + c->tx_len, &hdr, sizeof(hdr));
+    memcpy(c->tx + c->tx_len + sizeof(hdr), payload, len);
+    c->tx_len += (uint32_t)(sizeof(hdr) + len);
+    return 0;
+}
+
+static void flush_client(l7nh_ctl_t *ctl, l7nh_ctl_client_t *c) {
+    ssize_t n = send(c->fd, c->tx, c->tx_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) drop_client(ctl, c);
+        return;
+    }
+    c->tx_len -= (uint32_t)n;
+    memmove(c->tx, c->tx + n, c->tx_len);
+}
+
+static int do_connect(l7nh_ctl_t *ctl, uint8_t flags, const uint8_t *payload, uint32_t plen) {
+    l7nh_ctl_connect_t req;
+    l7nh_config_t cfg = ctl->cfg;
+
+    if (plen <= offsetof(l7nh_ctl_connect_t, ifnames) || plen > sizeof(req)) return L7NH_CTL_EFRAME;
+    memset(&req, 0, sizeof(req));
+    memcpy(&req, payload, plen);
+    req.ifnames[sizeof(req.ifnames) - 1] = '\0';
+    if (req.cycle_us) cfg.cycle_ns = (int64_t)req.cycle_us * 1000;
+    if (!ec_cycle_valid_period(cfg.cycle_ns)) return L7NH_CTL_EFRAME;
+    cfg.speed_control = (flags & L7NH_CTL_VELOCITY) != 0;
+    if (l7nh_state(ctl->core) != L7NH_IDLE) return L7NH_CTL_ESTATE;
+
+    int axes = l7nh_connect(ctl->core, req.ifnames, &cfg, ctl->event, ctl->user);
+    l7nh_subscribe(ctl->core, ctl->decimation);     // the connect starts the core over
+    return axes < 0 ? L7NH_CTL_ECONNECT : axes;
+}
+
+static int do_set(l7nh_ctl_t *ctl, uint8_t flags, uint32_t id, const uint8_t *payload, uint32_t plen) {
+    static l7nh_setpoint_t sp[L7NH_CTL_SET_MAX];
+    uint32_t n = plen / sizeof(l7nh_ctl_set_t);
+
+    if (n == 0 || n > L7NH_CTL_SET_MAX || plen % sizeof(l7nh_ctl_set_t)) return L7NH_CTL_EFRAME;
+    for (uint32_t k = 0; k < n; k++) {
+        l7nh_ctl_set_t e;
+        memcpy(&e, payload + k * sizeof(e), sizeof(e));
+        sp[k].axis = e.axis;
+        sp[k].value = e.value;
+    }
+    return l7nh_set(ctl->core, sp, (int)n, flags & L7NH_CTL_VELOCITY, id);
+}
+
+// One request: carry it out and queue the ACK. Returns -1 if the client has to go.
+static int serve(l7nh_ctl_t *ctl, l7nh_ctl_client_t *c, const l7nh_ctl_hdr_t *hdr, const uint8_t *payload) {
+    l7nh_core_t *core = ctl->core;
+    uint32_t plen = hdr->len - (uint32_t)sizeof(*hdr);
+    l7nh_state_t state = l7nh_state(core);
+    l7nh_ctl_ack_t ack;
+
+    switch (hdr->type) {
+    case L7NH_CTL_CONNECT:
+        ack.result = do_connect(ctl, hdr->flags, payload, plen);
+        break;
+    case L7NH_CTL_ENABLE:
+        ack.result = state == L7NH_CONNECTED ? L7NH_CTL_OK : L7NH_CTL_ESTATE;
+        if (ack.result == L7NH_CTL_OK) l7nh_start(core);
+        break;
+    case L7NH_CTL_SET:
+        ack.result = do_set(ctl, hdr->flags, hdr->id, payload, plen);
+        break;
+    case L7NH_CTL_STOP:
+        ack.result = state == L7NH_RUNNING ? L7NH_CTL_OK : L7NH_CTL_ESTATE;
+        if (ack.result == L7NH_CTL_OK) l7nh_stop(core);
+        break;
+    case L7NH_CTL_DISCONNECT:
+        ack.result = state != L7NH_IDLE ? L7NH_CTL_OK : L7NH_CTL_ESTATE;
+        if (ack.result == L7NH_CTL_OK) l7nh_disconnect(core);
+        break;
+    case L7NH_CTL_SUBSCRIBE:
+        if (plen != sizeof(uint32_t)) {
+            ack.result = L7NH_CTL_EFRAME;
+            break;
+        }
+        memcpy(&c->decimation, payload, sizeof(uint32_t));
+        update_decimation(ctl);
+        ack.result = L7NH_CTL_OK;
+        break;
+    default:
+        ack.result = L7NH_CTL_EFRAME;
+        break;
+    }
+    ack.state = (uint32_t)l7nh_state(core);
+    return queue_frame(c, L7NH_CTL_ACK, hdr->id, &ack, sizeof(ack));
+}
+
+static void read_client(l7nh_ctl_t *ctl, l7nh_ctl_client_t *c) {
+    ssize_t n = recv(c->fd, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len, MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        drop_client(ctl, c);
+        return;
+    }
+    if (n < 0) return;
+    c->rx_len += (uint32_t)n;
+
+    uint32_t off = 0;
+    while (c->rx_len - off >= sizeof(l7nh_ctl_hdr_t)) {
+        l7nh_ctl_hdr_t hdr;
+        memcpy(&hdr, c->rx + off, sizeof(hdr));
+        if (hdr.len < sizeof(hdr) || hdr.len > L7NH_CTL_FRAME_MAX) {
+            drop_client(ctl, c);   // out of step with the framing: nothing after this can be trusted
+            return;
+        }
+        if (c->rx_len - off < hdr.len) break;
+        if (serve(ctl, c, &hdr, c->rx + off + sizeof(hdr)) != 0) {
+            drop_client(ctl, c);   // not reading its ACKs
+            return;
+        }
+        off += hdr.len;
+    }
+    c->rx_len -= off;
+    memmove(c->rx, c->rx + off, c->rx_len);
+}
+
+static void accept_clients(l7nh_ctl_t *ctl) {
+    int fd;
+    while ((fd = accept(ctl->fd, NULL, NULL)) >= 0) {
+        l7nh_ctl_client_t *c = NULL;
+        for (int k = 0; k < L7NH_CTL_CLIENTS && !c; k++) {
+            if (ctl->client[k].fd < 0) c = &ctl->client[k];
+        }
+        if (!c || set_nonblock(fd) != 0) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->decimation = 0;
+        c->dropped = 0;
+        c->rx_len = 0;
+        c->tx_len = 0;
+    }
+}
+
+// Status records of the cycle to the subscribers whose decimation they fall on.
+static void forward_status(l7nh_ctl_t *ctl) {
+    static ec_cmdq_status_t st;
+    static uint8_t frame[sizeof(l7nh_ctl_status_t) + EC_AXES_MAX * sizeof(l7nh_ctl_axis_t)];
+
+    for (int s = 0; s < ctl->core->segment_count; s++) {
+        while (l7nh_status(ctl->core, s, &st)) {
+            l7nh_ctl_status_t hdr;
+            hdr.segment = (uint8_t)s;
+            hdr.flags = (uint8_t)st.flags;
+            hdr.axes = st.axes;
+            hdr.tick = st.tick;
+            hdr.time_ns = st.time_ns;
+            hdr.wkc = st.wkc;
+            hdr.applied = st.applied;
+            hdr.reserved = 0;
+            for (int i = 0; i < st.axes; i++) {
+                l7nh_ctl_axis_t a;
+                a.statusword = st.statusword[i];
+                a.target_torque = st.target_torque[i];
+                a.actual_torque = st.actual_torque[i];
+                a.reserved = 0;
+                a.velocity = st.velocity[i];
+                a.position = st.position[i];
+                memcpy(frame + sizeof(hdr) + (size_t)i * sizeof(a), &a, sizeof(a));
+            }
+            ctl->next_status_ns = st.time_ns + ctl->core->cfg.cycle_ns * (int64_t)ctl->decimation +
+                                  ctl->core->cfg.cycle_ns / STATUS_LAG_DIV;
+            uint32_t len = (uint32_t)(sizeof(hdr) + st.axes * sizeof(l7nh_ctl_axis_t));
+            for (int k = 0; k < L7NH_CTL_CLIENTS; k++) {
+                l7nh_ctl_client_t *c = &ctl->client[k];
+                if (c->fd < 0 || c->decimation == 0 || st.tick % c->decimation != 0) continue;
+                hdr.dropped = c->dropped;
+                memcpy(frame, &hdr, sizeof(hdr));
+                if (queue_frame(c, L7NH_CTL_STATUS, 0, frame, len) != 0) c->dropped++;
+            }
+        }
+    }
+}
+
+int l7nh_ctl_open(l7nh_ctl_t *ctl, const char *path, l7nh_core_t *core, const l7nh_config_t *cfg,
+                  l7nh_event_t event, void *user) {
+    struct sockaddr_un addr;
+
+    memset(ctl, 0, sizeof(*ctl));
+    for (int k = 0; k < L7NH_CTL_CLIENTS; k++) ctl->client[k].fd = -1;
+    ctl->core = core;
+    ctl->cfg = *cfg;
+    ctl->event = event;
+    ctl->user = user;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    snprintf(ctl->path, sizeof(ctl->path), "%s", path);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, strlen(path));
+
+    ctl->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (ctl->fd < 0) return -1;
+    unlink(path);
+    if (bind(ctl->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(ctl->fd, L7NH_CTL_CLIENTS) != 0 ||
+        set_nonblock(ctl->fd) != 0) {
+        int err = errno;
+        close(ctl->fd);
+        ctl->fd = -1;
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+void l7nh_ctl_poll(l7nh_ctl_t *ctl, int64_t timeout_ns) {
+    struct pollfd pfd[1 + L7NH_CTL_CLIENTS];
+    int slot[1 + L7NH_CTL_CLIENTS], n = 1;
+
+    l7nh_state_t state = l7nh_state(ctl->core);
+    if (ctl->decimation && (state == L7NH_RUNNING || state == L7NH_STOPPING)) {
+        int64_t every = ctl->core->cfg.cycle_ns * (int64_t)ctl->decimation;
+        int64_t wait = ctl->next_status_ns - ec_cycle_now_ns();
+        if (wait <= 0 || wait > every) wait = every;    // none yet, or late: one interval
+        if (wait < timeout_ns) timeout_ns = wait;
+    }
+    pfd[0].fd = ctl->fd;
+    pfd[0].events = POLLIN;
+    for (int k = 0; k < L7NH_CTL_CLIENTS; k++) {
+        if (ctl->client[k].fd < 0) continue;
+        pfd[n].fd = ctl->client[k].fd;
+        pfd[n].events = (short)(POLLIN | (ctl->client[k].tx_len ? POLLOUT : 0));
+        slot[n++] = k;
+    }
+    struct timespec ts = { (time_t)(timeout_ns / 1000000000LL), (long)(timeout_ns % 1000000000LL) };
+    if (ppoll(pfd, (nfds_t)n, &ts, NULL) > 0) {
+        if (pfd[0].revents & POLLIN) accept_clients(ctl);
+        for (int p = 1; p < n; p++) {
+            l7nh_ctl_client_t *c = &ctl->client[slot[p]];
+            if (c->fd >= 0 && (pfd[p].revents & (POLLIN | POLLHUP | POLLERR))) read_client(ctl, c);
+        }
+    }
+    forward_status(ctl);
+    for (int k = 0; k < L7NH_CTL_CLIENTS; k++) {
+        if (ctl->client[k].fd >= 0 && ctl->client[k].tx_len) flush_client(ctl, &ctl->client[k]);
+    }
+}
+
+void l7nh_ctl_close(l7nh_ctl_t *ctl) {
+    for (int k = 0; k < L7NH_CTL_CLIENTS; k++) {
+        if (ctl->client[k].fd >= 0) close(ctl->client[k].fd);
+        ctl->client[k].fd = -1;
+    }
+    if (ctl->fd >= 0) {
+        close(ctl->fd);
+        unlink(ctl->path);
+    }
+    ctl->fd = -1;
+}
+
+int l7nh_ctl_dial(const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, strlen(path));
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int xfer(int fd, void *buf, size_t len, int out) {
+    uint8_t *p = (uint8_t *)buf;
+    while (len) {
+        ssize_t n = out ? send(fd, p, len, MSG_NOSIGNAL) : recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int l7nh_ctl_send(int fd, uint8_t type, uint8_t flags, uint32_t id, const void *payload, uint16_t len) {
+    uint8_t frame[L7NH_CTL_FRAME_MAX];
+    l7nh_ctl_hdr_t hdr;
+
+    if (sizeof(hdr) + len > sizeof(frame)) return -1;
+    hdr.len = (uint16_t)(sizeof(hdr) + len);
+    hdr.type = type;
+    hdr.flags = flags;
+    hdr.id = id;
+    memcpy(frame, &hdr, sizeof(hdr));
+    if (len) memcpy(frame + sizeof(hdr), payload, len);
+    return xfer(fd, frame, hdr.len, 1);
+}
+
+int l7nh_ctl_recv(int fd, void *buf, uint32_t size) {
+    l7nh_ctl_hdr_t hdr;
+
+    if (size < sizeof(hdr) || xfer(fd, buf, sizeof(hdr), 0) != 0) return -1;
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (hdr.len < sizeof(hdr) || hdr.len > size) return -1;
+    if (xfer(fd, (uint8_t *)buf + sizeof(hdr), hdr.len - sizeof(hdr), 0) != 0) return -1;
+    return hdr.len;
+}
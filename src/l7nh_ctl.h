@@ -0,0 +1,140 @@
+// l7nh_ctl.h
+// Local control API of the control core over a Unix domain stream socket (POSIX), and its wire format.
+// - The server runs on the service thread of the core: l7nh_ctl_poll() replaces the sleep of the service
+//   loop, waits on the sockets and serves every complete request at once. Connect and disconnect are
+//   carried out there, enable / stop become the requests of l7nh_start() / l7nh_stop(), and setpoints go
+//   to the cyclic threads through the lock-free command queues (l7nh_set(), ec_cmdq.c).
+// - Framing: every frame starts with l7nh_ctl_hdr_t, len counting the header; the payload follows.
+//   Native endian and naturally aligned, as the socket never leaves the machine.
+// - Client -> server; every request is answered by an ACK with the same id:
+//   CONNECT     l7nh_ctl_connect_t: interfaces as for l7nh_connect(), flag VELOCITY for the velocity PI.
+//               ACK result: number of axes, or L7NH_CTL_ECONNECT
+//   ENABLE      start the run: the drives are enabled from inside the cycle
+//   SET         1..L7NH_CTL_SET_MAX l7nh_ctl_set_t: one axis, or a batch that a segment applies in one
+//               cycle; flag VELOCITY when the values are rpm. ACK result: L7NH_SET_* (l7nh_core.h) once
+//               queued; the STATUS of the cycle that took it shows id as applied
+//   STOP        stop ramp and quick stop
+//   DISCONNECT  stop if needed, then close the segments
+//   SUBSCRIBE   uint32_t decimation: a STATUS per segment every decimation cycles while the cycle runs
+//               (0 = none)
+// - Server -> client: ACK (l7nh_ctl_ack_t) and STATUS (l7nh_ctl_status_t + one l7nh_ctl_axis_t per axis).
+//   A subscriber that does not read fast enough loses STATUS frames (counted), never the cycle's time;
+//   one whose ACKs do not fit any more is disconnected.
+
+#ifndef L7NH_CTL_H
+#define L7NH_CTL_H
+
+#include <stdint.h>
+
+#include "l7nh_core.h"
+
+#define L7NH_CTL_PATH       "/tmp/l7nhd.sock"
+#define L7NH_CTL_CLIENTS    8
+#define L7NH_CTL_SET_MAX    (EC_SEGMENT_MAX * EC_AXES_MAX)
+#define L7NH_CTL_FRAME_MAX  (sizeof(l7nh_ctl_hdr_t) + L7NH_CTL_SET_MAX * sizeof(l7nh_ctl_set_t))
+#define L7NH_CTL_TX_BYTES   65536       // per client: ACKs and STATUS frames not sent yet
+
+// l7nh_ctl_hdr_t.type
+enum {
+    L7NH_CTL_CONNECT = 1,
+    L7NH_CTL_ENABLE,
+    L7NH_CTL_SET,
+    L7NH_CTL_STOP,
+    L7NH_CTL_DISCONNECT,
+    L7NH_CTL_SUBSCRIBE,
+    L7NH_CTL_ACK = 0x80,
+    L7NH_CTL_STATUS
+};
+
+// l7nh_ctl_hdr_t.flags
+#define L7NH_CTL_VELOCITY   0x01
+
+// ACK results besides L7NH_SET_* and the axis count of CONNECT
+#define L7NH_CTL_OK         0
+#define L7NH_CTL_ESTATE     -10         // the request does not fit the state of the core
+#define L7NH_CTL_EFRAME     -11         // unknown type or bad length
+#define L7NH_CTL_ECONNECT   -12         // connect failed (the reason went to the event callback)
+
+typedef struct {
+    uint16_t len;                       // of the frame, header included
+    uint8_t type;
+    uint8_t flags;
+    uint32_t id;                        // chosen by the client, echoed in the ACK
+} l7nh_ctl_hdr_t;
+
+typedef struct {
+    uint32_t cycle_us;                  // 0 = the server's
+    char ifnames[124];                  // NUL terminated
+} l7nh_ctl_connect_t;
+
+typedef struct {
+    uint16_t axis;                      // over all segments
+    uint16_t reserved;
+    int32_t value;                      // 0x6071 torque, or rpm with L7NH_CTL_VELOCITY
+} l7nh_ctl_set_t;
+
+typedef struct {
+    int32_t result;
+    uint32_t state;                     // l7nh_state_t once served (ENABLE / STOP take effect later)
+} l7nh_ctl_ack_t;
+
+typedef struct {
+    uint8_t segment;
+    uint8_t flags;                      // EC_CMDQ_* (ec_cmdq.h)
+    uint16_t axes;
+    uint32_t tick;                      // deadline index of the cycle
+    int64_t time_ns;                    // cycle wakeup (monotonic clock of the server)
+    int32_t wkc;
+    uint32_t applied;                   // id of the last SET this segment took
+    uint32_t dropped;                   // STATUS frames this client lost so far
+    uint32_t reserved;
+} l7nh_ctl_status_t;
+
+typedef struct {
+    uint16_t statusword;
+    int16_t target_torque;
+    int16_t actual_torque;
+    uint16_t reserved;
+    int32_t velocity;
+    int32_t position;
+} l7nh_ctl_axis_t;
+
+typedef struct {
+    int fd;                             // -1 = free slot
+    uint32_t decimation;                // 0 = not subscribed
+    uint32_t dropped;
+    uint32_t rx_len, tx_len;
+    uint8_t rx[2 * L7NH_CTL_FRAME_MAX];
+    uint8_t tx[L7NH_CTL_TX_BYTES];
+} l7nh_ctl_client_t;
+
+typedef struct {
+    int fd;                             // listening socket
+    char path[108];
+    l7nh_core_t *core;
+    l7nh_config_t cfg;                  // CONNECT starts from this
+    l7nh_event_t event;
+    void *user;
+    uint32_t decimation;                // the core's: gcd of the subscriptions
+    int64_t next_status_ns;             // when the next status record should be there
+    l7nh_ctl_client_t client[L7NH_CTL_CLIENTS];
+} l7nh_ctl_t;
+
+// Listen on path (an old socket file there is replaced). Returns 0, or -1 with errno set.
+int l7nh_ctl_open(l7nh_ctl_t *ctl, const char *path, l7nh_core_t *core, const l7nh_config_t *cfg,
+                  l7nh_event_t event, void *user);
+
+// Service thread, in place of its sleep: wait up to timeout_ns for requests, serve them and send the
+// status. While somebody is subscribed the wait ends a quarter period after the wakeup of the cycle
+// that should have the next status record, so it goes out right after that cycle.
+void l7nh_ctl_poll(l7nh_ctl_t *ctl, int64_t timeout_ns);
+
+void l7nh_ctl_close(l7nh_ctl_t *ctl);
+
+// Clients (blocking): connect to the server at path, send one frame, receive the next one into buf
+// (size >= L7NH_CTL_FRAME_MAX is always enough). Return the socket / 0 / the frame length, or -1.
+int l7nh_ctl_dial(const char *path);
+int l7nh_ctl_send(int fd, uint8_t type, uint8_t flags, uint32_t id, const void *payload, uint16_t len);
+int l7nh_ctl_recv(int fd, void *buf, uint32_t size);
+
+#endif // L7NH_CTL_H
@@ -0,0 +1,163 @@
+// l7nhd.c
+// Linux daemon around the headless control core (l7nh_core.c): connects the given NICs, starts the
+// drives, prints the telemetry once a second and stops them again on SIGINT / SIGTERM or after -d
+// seconds. The main thread is the service thread of the core; the cyclic threads run SCHED_FIFO.
+// With -l it also serves the local control API on a Unix domain socket (l7nh_ctl.h) and keeps running
+// while disconnected, so clients may connect, enable, set and stop; the interfaces are then optional.
+// Built against the simulator (L7NH_SIM) unless configured with -DL7NH_WITH_SOEM=ON; "sim0" then
+// stands in for a NIC.
+// With -R it replays recordings instead (ec_replay.h) and exits once they are over.
+// Usage: l7nhd [-c cycle_us] [-t torque] [-s speed_rpm] [-p prio] [-C cpu0] [-a sim_axes] [-n] [-f]
+//              [-w missing,partial,late] [-R rec[,rec...]] [-b torque,velocity,position] [-l socket]
+//              [-d seconds] [ifname[/ifname2][,ifname...]]
+//   -s runs the velocity PI to speed_rpm instead of torque control, -n disables the recorder and the
+//   scope, -f connects cold instead of from the topology fingerprint, -C -1 leaves the cyclic threads
+//   unpinned, -w sets how many bad frames in a row drop the torque (0 = never, see ec_wkc.h), -l listens
+//   for control clients on socket (e.g. /tmp/l7nhd.sock), -R plays one recording per segment (e.g.
+//   l7nh_seg0.rec of an earlier run) and writes l7nh_replay_seg<N>.txt, -b sets the bands of the
+//   feedback compared against it.
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "l7nh_core.h"
+#include "l7nh_ctl.h"
+
+#ifdef L7NH_SIM
+#include "sim_soem.h"
+#endif
+
+#define POLL_NS         1000000L        // service loop period
+#define REPORT_NS       1000000000LL    // telemetry print period
+
+static volatile sig_atomic_t quit;
+static l7nh_core_t core;
+static l7nh_ctl_t ctl;
+
+static void on_signal(int sig) {
+    (void)sig;
+    quit = 1;
+}
+
+static void on_event(void *user, l7nh_event_kind_t kind, const char *msg) {
+    (void)user;
+    printf("%s %s\n", kind == L7NH_EVENT_STATE ? "[state]" : "[info] ", msg);
+    fflush(stdout);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: l7nhd [-c cycle_us] [-t torque] [-s speed_rpm] [-p prio] [-C cpu0] [-a sim_axes] [-n] [-f]\n"
+                    "             [-w missing,partial,late] [-R rec[,rec...]] [-b torque,velocity,position] [-l socket]\n"
+                    "             [-d seconds] [ifname[/ifname2][,ifname...]]\n");
+}
+
+int main(int argc, char **argv) {
+    l7nh_config_t cfg;
+    struct sigaction sa;
+    double duration_s = 0.0;
+    int sim_axes = 1, opt;
+    const char *ctl_path = NULL;
+    char line1[256], line2[256];
+
+    l7nh_config_default(&cfg);
+    while ((opt = getopt(argc, argv, "c:t:s:p:C:a:nfw:R:b:l:d:")) != -1) {
+        switch (opt) {
+        case 'c': cfg.cycle_ns = atoll(optarg) * 1000; break;
+        case 't': cfg.torque_set = (int16_t)atoi(optarg); break;
+        case 's': cfg.speed_set_rpm = atoi(optarg); cfg.speed_control = 1; break;
+        case 'p': cfg.priority = atoi(optarg); break;
+        case 'C': cfg.cpu0 = atoi(optarg); break;
+        case 'a': sim_axes = atoi(optarg); break;
+        case 'n': cfg.record = 0; cfg.scope = 0; break;
+        case 'f': cfg.topo_cache = 0; break;
+        case 'w':
+            if (sscanf(optarg, "%u,%u,%u", &cfg.missing_limit, &cfg.partial_limit, &cfg.late_limit) != 3) {
+                usage();
+                return 1;
+            }
+            break;
+        case 'R': snprintf(cfg.replay, sizeof(cfg.replay), "%s", optarg); break;
+        case 'b':
+            if (sscanf(optarg, "%d,%d,%d", &cfg.replay_torque_band, &cfg.replay_velocity_band,
+                       &cfg.replay_position_band) != 3) {
+                usage();
+                return 1;
+            }
+            break;
+        case 'l': ctl_path = optarg; break;
+        case 'd': duration_s = atof(optarg); break;
+        default: usage(); return 1;
+        }
+    }
+    if (optind < argc - 1 || (optind == argc && !ctl_path) || !ec_cycle_valid_period(cfg.cycle_ns)) {
+        usage();
+        return 1;
+    }
+#ifdef L7NH_SIM
+    sim_setup(sim_axes);
+#else
+    (void)sim_axes;
+#endif
+
+    // no page faults in the cyclic threads; without the privilege it only costs determinism
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) perror("mlockall");
+#ifdef MCL_ONFAULT
+    // a recording to replay streams through its mapping (ec_replay.c) instead of being read in and locked whole
+    else if (cfg.replay[0]) mlockall(MCL_FUTURE | MCL_ONFAULT);
+#endif
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (ctl_path && l7nh_ctl_open(&ctl, ctl_path, &core, &cfg, on_event, NULL) != 0) {
+        perror(ctl_path);
+        return 1;
+    }
+    if (optind < argc) {
+        if (l7nh_connect(&core, argv[optind], &cfg, on_event, NULL) < 0 && !ctl_path) return 1;
+        l7nh_start(&core);
+    }
+
+    int64_t t0 = ec_cycle_now_ns(), next_report = t0 + REPORT_NS;
+    int stopping = 0;
+    struct timespec ts = { 0, POLL_NS };
+    for (;;) {
+        // disconnected: done, unless clients may still connect
+        if (!l7nh_poll(&core) && (!ctl_path || quit || stopping)) break;
+        int64_t now = ec_cycle_now_ns();
+        l7nh_state_t state = l7nh_state(&core);
+        int replayed = cfg.replay[0] && !ctl_path && state == L7NH_CONNECTED;    // played, or could not start
+        if (!stopping && (quit || replayed || (duration_s > 0.0 && now - t0 > (int64_t)(duration_s * 1e9)))) {
+            // cycle latency of the whole run, then stop ramp and quick stop; disconnect waits for them
+            static char latency[2048];
+            if (state != L7NH_IDLE) {
+                l7nh_latency(&core, latency, sizeof(latency));
+                fputs(latency, stdout);
+            }
+            l7nh_stop(&core);
+            l7nh_disconnect(&core);
+            stopping = 1;
+        }
+        if (now >= next_report) {
+            next_report += REPORT_NS;
+            if ((state == L7NH_RUNNING || state == L7NH_STOPPING) &&
+                l7nh_telemetry(&core, line1, sizeof(line1), line2, sizeof(line2), NULL)) {
+                printf("%s | %s\n", line1, line2);
+                fflush(stdout);
+            }
+        }
+        if (ctl_path) {
+            l7nh_ctl_poll(&ctl, POLL_NS);
+        } else {
+            nanosleep(&ts, NULL);
+        }
+    }
+    if (ctl_path) l7nh_ctl_close(&ctl);
+    return 0;
+}
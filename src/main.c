@@ -11,6 +11,8 @@
 #include <math.h>
 #include <stdint.h>
 
+#include "telemetry.h"
+
 // SOEM 기능에 대한 전방 선언
 // 실제 구현에서는 SOEM 헤더에서 가져옴
 typedef struct {
@@ -29,6 +31,7 @@ static BOOL isConnected = FALSE;
 static BOOL inOperation = FALSE;
 static int32_t currentRPM = 0;
 static int32_t targetTorque = 100;  // 0.1% 단위의 10.0% 토크
+static telemetry_ring_t telemetry;   // 시뮬레이션 스레드 -> GUI (잠금 없는 SPSC 링)
 
 // 창 크기
 #define WINDOW_WIDTH 450
@@ -44,6 +47,11 @@ static int32_t targetTorque = 100;  // 0.1% 단위의 10.0% 토크
 #define IDC_RPM_LABEL 103
 #define IDC_STATUS_LABEL 104
 
+// GUI 갱신 타이머 (링 버퍼를 화면 주기로 비움)
+#define IDT_TELEMETRY 1
+#define GUI_REFRESH_MS 50
+#define SIM_PERIOD_MS 50
+
 // CiA 402 토크 제어 상수
 #define MODE_TORQUE          0x04
 #define CW_SHUTDOWN          0x0006
@@ -185,7 +193,24 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                 50, 150, 350, LABEL_HEIGHT,
                 hwnd, (HMENU)IDC_STATUS_LABEL, ((LPCREATESTRUCT)lParam)->hInstance, NULL
             );
-            
+
+            // 제어 스레드는 링에 기록만 하고, 화면 갱신은 GUI 스레드의 타이머에서 수행
+            telemetry_init(&telemetry);
+            SetTimer(hwnd, IDT_TELEMETRY, GUI_REFRESH_MS, NULL);
+            break;
+        }
+
+        case WM_TIMER:
+        {
+            telemetry_summary_t sum;
+            if (wParam == IDT_TELEMETRY && telemetry_drain(&telemetry, &sum) > 0) {
+                wchar_t rpmText[64];
+                swprintf_s(rpmText, 64, L"%d RPM", (int)sum.last.velocity);
+                SetWindowText(hRPMLabel, rpmText);
+                if (sum.flags & TELEMETRY_F_REFUSED) {
+                    SetWindowText(hStatusLabel, L"\uc5f0\uacb0\ub418\uc9c0 \uc54a\uc74c - \uc11c\ubcf8\uc744 \uc2dc\uc791\ud560 \uc218 \uc5c6\uc2b5\ub2c8\ub2e4");  // Not connected - Cannot start servo
+                }
+            }
             break;
         }
 
@@ -237,6 +262,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 
         case WM_DESTROY:
         {
+            KillTimer(hwnd, IDT_TELEMETRY);
             PostQuitMessage(0);
             break;
         }
@@ -259,22 +285,20 @@ BOOL ConnectToServo()
 DWORD WINAPI SimulationThreadProc(LPVOID lpParam)
 {
     int counter = 0;
+    LARGE_INTEGER freq, prev, now;
+    telemetry_rec_t rec = {0};
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&prev);
 
     while (TRUE) {
         if (inOperation && isConnected) {
             // 토크 제어에 따른 RPM 시뮬레이션
             // 실제 애플리케이션에서는 서보와 이더캣을 통해 통신
             currentRPM = (int32_t)(targetTorque * 50.0 * sin(counter * 0.1)); // 시뮬레이션 RPM
-            
-            // RPM 디스플레이 업데이트
-            wchar_t rpmText[32];
-            swprintf_s(rpmText, 32, L"%d RPM", currentRPM);
-            
-            // 메인 스레드에서 RPM 레이블 업데이트
-            SendMessage(hRPMLabel, WM_SETTEXT, 0, (LPARAM)rpmText);
         } else if (inOperation && !isConnected) {
-            // 연결되지 않은 상태에서 작동 시도 시 오류 표시
-            SetWindowText(hStatusLabel, L"\uc5f0\uacb0\ub418\uc9c0 \uc54a\uc74c - \uc11c\ubcf8\uc744 \uc2dc\uc791\ud560 \uc218 \uc5c6\uc2b5\ub2c8\ub2e4");  // Not connected - Cannot start servo
+            // 연결되지 않은 상태에서 작동 시도: 오류 표시는 GUI 타이머가 이 플래그를 보고 수행
+            rec.flags |= TELEMETRY_F_REFUSED;
             inOperation = FALSE;
         } else {
             // 정지 시 천천히 감속
@@ -283,15 +307,20 @@ DWORD WINAPI SimulationThreadProc(LPVOID lpParam)
             } else {
                 currentRPM = 0;
             }
-            
-            // 정지 시에도 RPM 디스플레이 업데이트
-            wchar_t rpmText[32];
-            swprintf_s(rpmText, 32, L"%d RPM", currentRPM);
-            SendMessage(hRPMLabel, WM_SETTEXT, 0, (LPARAM)rpmText);
         }
-        
+
+        // RPM 기록을 링에 넣음 (GUI 메시지 펌프를 기다리지 않음)
+        QueryPerformanceCounter(&now);
+        rec.timestamp_ns = (int64_t)(now.QuadPart * 1000000000.0 / freq.QuadPart);
+        rec.late_ns = (int32_t)((now.QuadPart - prev.QuadPart) * 1000000000.0 / freq.QuadPart) - SIM_PERIOD_MS * 1000000;
+        rec.velocity = currentRPM;
+        rec.torque = (int16_t)(inOperation ? targetTorque : 0);
+        telemetry_push(&telemetry, &rec);
+        rec.flags = 0;
+        prev = now;
+
         counter++;
-        Sleep(50); // 50ms마다 업데이트
+        Sleep(SIM_PERIOD_MS); // 50ms마다 업데이트
     }
     
     return 0;
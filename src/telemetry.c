@@ -0,0 +1,49 @@
+// telemetry.c
+// Wait-free SPSC telemetry ring (see telemetry.h).
+
+#include "telemetry.h"
+
+#include <string.h>
+#include "ec_atomic.h"
+
+#define RING_MASK (TELEMETRY_RING_SIZE - 1)
+
+void telemetry_init(telemetry_ring_t *ring) {
+    memset(ring, 0, sizeof(*ring));
+}
+
+int telemetry_push(telemetry_ring_t *ring, const telemetry_rec_t *rec) {
+    uint32_t head = ring->head;     // only we write head
+    uint32_t tail = ec_atomic_load_u32(&ring->tail);
+    if (head - tail >= TELEMETRY_RING_SIZE) {
+        ec_atomic_add_u32(&ring->dropped, 1);
+        return 0;
+    }
+    ring->rec[head & RING_MASK] = *rec;
+    ec_atomic_store_u32(&ring->head, head + 1);   // publish after the record is written
+    return 1;
+}
+
+int telemetry_pop(telemetry_ring_t *ring, telemetry_rec_t *rec) {
+    uint32_t tail = ring->tail;     // only we write tail
+    uint32_t head = ec_atomic_load_u32(&ring->head);
+    if (tail == head) return 0;
+    *rec = ring->rec[tail & RING_MASK];
+    ec_atomic_store_u32(&ring->tail, tail + 1);   // release the slot after the copy
+    return 1;
+}
+
+uint32_t telemetry_drain(telemetry_ring_t *ring, telemetry_summary_t *sum) {
+    telemetry_rec_t rec;
+    memset(sum, 0, sizeof(*sum));
+    sum->min_wkc = INT32_MAX;
+    while (telemetry_pop(ring, &rec)) {
+        if (rec.late_ns > sum->max_late_ns) sum->max_late_ns = rec.late_ns;
+        if (rec.wkc < sum->min_wkc) sum->min_wkc = rec.wkc;
+        sum->flags |= rec.flags;
+        sum->last = rec;
+        sum->count++;
+    }
+    if (sum->count == 0) sum->min_wkc = 0;
+    return sum->count;
+}
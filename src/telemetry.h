@@ -0,0 +1,63 @@
+// telemetry.h
+// Wait-free single-producer / single-consumer ring carrying fixed-size telemetry records from the
+// cyclic thread to the GUI.
+// - The producer (cyclic thread) never blocks: when the ring is full the record is dropped and counted.
+// - The consumer (GUI thread) drains the ring on its own timer at display rate.
+// - Records carry the wakeup lateness of their cycle, so the GUI can show the jitter the control
+//   thread actually sees while the window is being dragged or resized.
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+#define TELEMETRY_RING_SIZE 4096    // records, power of two (~4 s at 1 kHz)
+#define TELEMETRY_CACHELINE 64
+
+// telemetry_rec_t.flags: conditions the GUI shows next to the values
+#define TELEMETRY_F_TRIPPED     0x0001  // torque dropped after a run of bad frames (ec_wkc.c)
+#define TELEMETRY_F_NO_VELOCITY 0x0002  // the velocity could not be read, the value is stale
+#define TELEMETRY_F_REFUSED     0x0004  // operation was requested without a connection
+
+typedef struct {
+    int64_t timestamp_ns;   // cycle wakeup time (monotonic)
+    int32_t velocity;       // 0x606C
+    int32_t wkc;            // working counter of the cycle
+    int32_t late_ns;        // wakeup lateness of the cycle
+    int32_t dc_offset_ns;   // DC phase offset (0 when not in DC mode)
+    uint16_t statusword;    // 0x6041
+    int16_t torque;         // 0x6077 (actual) or commanded torque when not mapped
+    uint32_t flags;         // TELEMETRY_F_*
+} telemetry_rec_t;
+
+typedef struct {
+    volatile uint32_t head;     // next slot to write (producer only)
+    uint8_t pad0[TELEMETRY_CACHELINE - sizeof(uint32_t)];
+    volatile uint32_t tail;     // next slot to read (consumer only)
+    uint8_t pad1[TELEMETRY_CACHELINE - sizeof(uint32_t)];
+    volatile uint32_t dropped;  // records lost because the consumer fell behind
+    uint8_t pad2[TELEMETRY_CACHELINE - sizeof(uint32_t)];
+    telemetry_rec_t rec[TELEMETRY_RING_SIZE];
+} telemetry_ring_t;
+
+// Summary of one drain pass
+typedef struct {
+    uint32_t count;             // records drained
+    telemetry_rec_t last;       // most recent record
+    int32_t max_late_ns;        // worst wakeup lateness among drained records
+    int32_t min_wkc;            // lowest WKC among drained records
+    uint32_t flags;             // TELEMETRY_F_* of any drained record
+} telemetry_summary_t;
+
+void telemetry_init(telemetry_ring_t *ring);
+
+// Producer side. Returns 1 if stored, 0 if the ring was full (record dropped).
+int telemetry_push(telemetry_ring_t *ring, const telemetry_rec_t *rec);
+
+// Consumer side. Returns 1 and fills rec if a record was available.
+int telemetry_pop(telemetry_ring_t *ring, telemetry_rec_t *rec);
+
+// Consumer side: pop everything currently queued and summarise it. Returns number drained.
+uint32_t telemetry_drain(telemetry_ring_t *ring, telemetry_summary_t *sum);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,168 @@
+// test_cia402.c
+// CiA402 state machine (src/cia402.c) against the simulated drives. Exits nonzero on the first failure.
+// - reached: a quick stop is reached only at standstill, not on entering quick stop active.
+// - enable: every drive of a segment reaches operation enabled, and switch on disabled again, through the
+//   controlword alone, in fixed-step simulation time.
+// - stop: the control core ramps spinning drives down and quick-stops them; when the run is over every
+//   drive stands still or is in switch on disabled.
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "sim_soem.h"
+#include "cia402.h"
+#include "ec_axes.h"
+#include "ec_pdocfg.h"
+#include "l7nh_core.h"
+
+#define AXES            2
+#define SPIN_MS         300         // Start: the motors well above standstill, yet stopped within the stop timeout
+#define WAIT_MS         5000
+#define TORQUE          100         // well below the overspeed trip of the simulated motors after SPIN_MS
+#define SW_QUICK_STOP   0x0017      // quick stop active, voltage enabled
+#define SW_SOD          0x0040      // switch on disabled
+#define STEP_NS         1000000LL
+#define TRANSITION_CYCLES 1000      // a transition of every drive must be done within this many cycles
+
+static l7nh_core_t core;
+static uint8 iomap[1 << 12];
+static int failures;
+
+#define CHECK(cond, ...) do { if (!(cond)) { fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); failures++; } } while (0)
+
+static void sleep_ms(int ms) {
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static void on_event(void *user, l7nh_event_kind_t kind, const char *msg) {
+    (void)user;
+    (void)kind;
+    (void)msg;
+}
+
+static int serve(l7nh_state_t state, int ms) {
+    for (int t = 0; t < ms; t++) {
+        l7nh_poll(&core);
+        if (l7nh_state(&core) == state) return 0;
+        sleep_ms(1);
+    }
+    return -1;
+}
+
+static void test_reached(void) {
+    cia402_t sm;
+    cia402_init(&sm);
+    cia402_command(&sm, CIA402_TARGET_QUICK_STOP, 0);
+    cia402_update(&sm, SW_QUICK_STOP, 1000);
+    CHECK(!cia402_reached(&sm, 1500), "reached: quick stop active at 1500 rpm counted as reached");
+    CHECK(!cia402_reached(&sm, -1500), "reached: quick stop active at -1500 rpm counted as reached");
+    CHECK(!cia402_reached(&sm, CIA402_VELOCITY_UNKNOWN), "reached: quick stop active, velocity unknown, counted as reached");
+    CHECK(cia402_reached(&sm, CIA402_STANDSTILL), "reached: quick stop active at standstill not reached");
+    CHECK(sm.error == 0, "reached: error 0x%x while braking", (unsigned)sm.error);
+    cia402_update(&sm, SW_SOD, 2000);
+    CHECK(cia402_reached(&sm, 1500), "reached: switch on disabled after a quick stop not reached");
+}
+
+// Cycle the segment until every axis reached target; returns the cycles taken, or -1.
+static int cycle_until(ec_axes_t *ax, cia402_target_t target) {
+    ec_axes_command(ax, target, sim_time_ns());
+    for (int c = 1; c <= TRANSITION_CYCLES; c++) {
+        ec_send_processdata();
+        ec_receive_processdata(EC_TIMEOUTRET);
+        ec_axes_unpack(ax);
+        int reached = ec_axes_update(ax, sim_time_ns());
+        for (int i = 0; i < ax->count; i++) ax->target_torque[i] = 0;
+        ec_axes_pack(ax);
+        if (reached == ax->count) return c;
+    }
+    return -1;
+}
+
+static void test_enable(void) {
+    static ec_axes_t ax;
+    sim_setup(AXES);
+    sim_set_fixed_step(STEP_NS);
+    if (!ec_init("sim") || ec_config_init(FALSE) != AXES) {
+        CHECK(0, "enable: no segment of %d drives", AXES);
+        return;
+    }
+    for (int s = 1; s <= AXES; s++) ec_pdocfg_install((uint16_t)s);
+    ec_config_map(iomap);
+    CHECK(ec_axes_discover(&ax, L7NH_VENDOR) == AXES, "enable: not every drive is an axis");
+    for (int s = 0; s <= ec_slavecount; s++) ec_slave[s].state = EC_STATE_OPERATIONAL;
+    ec_writestate(0);
+    ec_statecheck(0, EC_STATE_OPERATIONAL, EC_TIMEOUTSTATE);
+    for (int i = 0; i < ax.count; i++) ax.mode[i] = 10;
+
+    CHECK(cycle_until(&ax, CIA402_TARGET_ENABLED) > 0, "enable: not every drive reached operation enabled");
+    for (int i = 0; i < ax.count; i++) {
+        CHECK(ax.sm[i].state == CIA402_OPERATION_ENABLED && ax.enabled[i] && ax.sm[i].error == 0,
+            "enable: axis %d in %s, error 0x%x", i, cia402_state_name(ax.sm[i].state), (unsigned)ax.sm[i].error);
+        CHECK(sim_drive((uint16)(i + 1))->state == L7NH_ST_OPERATION_ENABLED, "enable: drive %d not enabled", i + 1);
+    }
+    CHECK(cycle_until(&ax, CIA402_TARGET_DISABLED) > 0, "disable: not every drive reached switch on disabled");
+    for (int i = 0; i < ax.count; i++) {
+        CHECK(ax.sm[i].state == CIA402_SWITCH_ON_DISABLED && !ax.enabled[i], "disable: axis %d in %s", i,
+            cia402_state_name(ax.sm[i].state));
+        CHECK(sim_drive((uint16)(i + 1))->state == L7NH_ST_SWITCH_ON_DISABLED, "disable: drive %d not disabled", i + 1);
+    }
+    ec_close();
+}
+
+static void test_stop(void) {
+    l7nh_config_t cfg;
+    l7nh_config_default(&cfg);
+    cfg.record = 0;
+    cfg.scope = 0;
+    cfg.shm = 0;
+    cfg.topo_cache = 0;
+    cfg.cpu0 = -1;
+    cfg.torque_set = TORQUE;
+    sim_setup(AXES);
+    sim_set_fixed_step(cfg.cycle_ns);
+
+    if (l7nh_connect(&core, "sim0", &cfg, on_event, NULL) < 0 || serve(L7NH_CONNECTED, WAIT_MS) != 0) {
+        CHECK(0, "stop: connect failed");
+        return;
+    }
+    l7nh_start(&core);
+    CHECK(serve(L7NH_RUNNING, WAIT_MS) == 0, "stop: the run did not start");
+    serve(L7NH_IDLE, SPIN_MS);
+    ec_axes_t *ax = &core.segments[0].axes;
+    for (int i = 0; i < ax->count; i++) {
+        CHECK(ax->actual_velocity[i] > 10 * CIA402_STANDSTILL, "stop: axis %d only at %d rpm before the stop", i,
+            (int)ax->actual_velocity[i]);
+    }
+    l7nh_stop(&core);
+    CHECK(serve(L7NH_CONNECTED, WAIT_MS) == 0, "stop: the run did not end");
+    for (int i = 0; i < ax->count; i++) {
+        int32_t v = ax->actual_velocity[i];
+        CHECK(ax->sm[i].state == CIA402_SWITCH_ON_DISABLED || (v >= -CIA402_STANDSTILL && v <= CIA402_STANDSTILL),
+            "stop: axis %d left in %s at %d rpm", i, cia402_state_name(ax->sm[i].state), (int)v);
+    }
+    l7nh_disconnect(&core);
+    while (l7nh_poll(&core)) sleep_ms(1);
+}
+
+int main(void) {
+    test_reached();
+    test_enable();
+    test_stop();
+    if (failures) fprintf(stderr, "test_cia402: %d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
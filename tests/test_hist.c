@@ -0,0 +1,125 @@
+// test_hist.c
+// Bucket math of the latency histograms (src/ec_hist.c), through records and snapshots. Exits nonzero on
+// the first failure.
+// - exact: every value below 8 ns has a bucket of its own, negative values count as 0.
+// - edges: around a few powers of two, 2^k starts bucket (k - 2) * 8 and 2^k - 1 ends the one before;
+//   the bucket of 2^k reaches 2^k + 2^(k-3) - 1.
+// - saturation: from 15 * 2^30 ns up every value lands in the last bucket, which ends at 2^34 - 1 ns.
+// - percentile: nearest rank, the upper edge of its bucket, capped by the recorded maximum.
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ec_hist.h"
+
+#define LAST            (EC_HIST_BUCKETS - 1)
+#define SATURATE_NS     (15LL << 30)
+
+static ec_hist_t hist;
+static int failures;
+
+#define CHECK(cond, ...) do { if (!(cond)) { fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); failures++; } } while (0)
+
+// Bucket a single value lands in, or -1.
+static int bucket_of(int64_t value_ns) {
+    ec_hist_snap_t snap;
+    ec_hist_init(&hist);
+    ec_hist_record(&hist, value_ns);
+    ec_hist_snapshot(&hist, &snap);
+    for (int b = 0; b < EC_HIST_BUCKETS; b++) {
+        if (snap.bucket[b]) return snap.count == 1 && snap.bucket[b] == 1 ? b : -1;
+    }
+    return -1;
+}
+
+// Upper edge of the bucket of value_ns: the median of it and a far larger sample, so the cap by the
+// maximum does not apply.
+static int64_t bucket_high(int64_t value_ns) {
+    ec_hist_snap_t snap;
+    ec_hist_init(&hist);
+    ec_hist_record(&hist, value_ns);
+    ec_hist_record(&hist, INT64_MAX);
+    ec_hist_snapshot(&hist, &snap);
+    return ec_hist_percentile(&snap, 500);
+}
+
+// Nonzero if the bucket of value_ns starts at low_ns: it lies entirely above low_ns - 1, not above low_ns.
+static int starts_at(int64_t value_ns, int64_t low_ns) {
+    ec_hist_snap_t snap;
+    ec_hist_init(&hist);
+    ec_hist_record(&hist, value_ns);
+    ec_hist_snapshot(&hist, &snap);
+    return ec_hist_above(&snap, low_ns - 1) == 1 && ec_hist_above(&snap, low_ns) == 0;
+}
+
+static void test_exact(void) {
+    for (int64_t v = 0; v < 8; v++) {
+        CHECK(bucket_of(v) == (int)v, "exact: %lld ns in bucket %d", (long long)v, bucket_of(v));
+        CHECK(bucket_high(v) == v, "exact: bucket of %lld ns ends at %lld", (long long)v, (long long)bucket_high(v));
+    }
+    CHECK(bucket_of(-5) == 0, "exact: -5 ns in bucket %d", bucket_of(-5));
+}
+
+static void test_edges(void) {
+    static const int powers[] = { 3, 4, 10, 20, 30 };
+    for (unsigned i = 0; i < sizeof(powers) / sizeof(powers[0]); i++) {
+        int k = powers[i];
+        int64_t p = 1LL << k;
+        CHECK(bucket_of(p) == (k - 2) * 8, "edges: 2^%d ns in bucket %d, expected %d", k, bucket_of(p), (k - 2) * 8);
+        CHECK(bucket_of(p - 1) == (k - 2) * 8 - 1, "edges: 2^%d - 1 ns in bucket %d, expected %d", k,
+            bucket_of(p - 1), (k - 2) * 8 - 1);
+        CHECK(starts_at(p + (p >> 4), p), "edges: bucket of 2^%d + 2^%d ns does not start at 2^%d", k, k - 4, k);
+        CHECK(bucket_high(p) == p + (p >> 3) - 1, "edges: bucket of 2^%d ns ends at %lld, expected %lld", k,
+            (long long)bucket_high(p), (long long)(p + (p >> 3) - 1));
+        CHECK(bucket_of(p + (p >> 3)) == (k - 2) * 8 + 1, "edges: 2^%d + 2^%d ns in bucket %d", k, k - 3,
+            bucket_of(p + (p >> 3)));
+    }
+}
+
+static void test_saturation(void) {
+    CHECK(bucket_of(SATURATE_NS - 1) == LAST - 1, "saturation: 15 * 2^30 - 1 ns in bucket %d",
+        bucket_of(SATURATE_NS - 1));
+    CHECK(bucket_of(SATURATE_NS) == LAST, "saturation: 15 * 2^30 ns in bucket %d", bucket_of(SATURATE_NS));
+    CHECK(bucket_of(1LL << 34) == LAST, "saturation: 2^34 ns in bucket %d", bucket_of(1LL << 34));
+    CHECK(bucket_of(INT64_MAX) == LAST, "saturation: INT64_MAX ns in bucket %d", bucket_of(INT64_MAX));
+    CHECK(bucket_high(SATURATE_NS) == (1LL << 34) - 1, "saturation: last bucket ends at %lld",
+        (long long)bucket_high(SATURATE_NS));
+}
+
+static void test_percentile(void) {
+    ec_hist_snap_t snap;
+    ec_hist_summary_t sum;
+
+    ec_hist_init(&hist);
+    ec_hist_snapshot(&hist, &snap);
+    CHECK(ec_hist_percentile(&snap, 500) == 0, "percentile: empty histogram gave %lld",
+        (long long)ec_hist_percentile(&snap, 500));
+
+    // 1..100 ns: rank 50 is 50 ns in [48, 51]; ranks 99 and 100 are in [96, 103], capped at 100
+    for (int64_t v = 1; v <= 100; v++) ec_hist_record(&hist, v);
+    ec_hist_summarize(&hist, 96, &sum);
+    CHECK(sum.count == 100 && sum.max == 100 && sum.mean == 50, "percentile: count %llu, max %lld, mean %lld",
+        (unsigned long long)sum.count, (long long)sum.max, (long long)sum.mean);
+    CHECK(sum.p50 == 51, "percentile: p50 %lld, expected 51", (long long)sum.p50);
+    CHECK(sum.p99 == 100 && sum.p999 == 100, "percentile: p99 %lld, p99.9 %lld, expected the maximum 100",
+        (long long)sum.p99, (long long)sum.p999);
+    CHECK(sum.over == 0, "percentile: %llu samples counted above 96 ns, their bucket starts at 96",
+        (unsigned long long)sum.over);
+    ec_hist_snapshot(&hist, &snap);
+    CHECK(ec_hist_percentile(&snap, 0) == 1, "percentile: p0 %lld, expected 1", (long long)ec_hist_percentile(&snap, 0));
+
+    // a single sample inside a wide bucket: the maximum, not the edge
+    ec_hist_init(&hist);
+    ec_hist_record(&hist, 1000);
+    ec_hist_snapshot(&hist, &snap);
+    CHECK(ec_hist_percentile(&snap, 990) == 1000, "percentile: one sample of 1000 ns gave p99 %lld",
+        (long long)ec_hist_percentile(&snap, 990));
+}
+
+int main(void) {
+    test_exact();
+    test_edges();
+    test_saturation();
+    test_percentile();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+// test_sdoasync.c
+// Non-blocking SDO engine (src/ec_sdoasync.c) against the mailbox of a simulated drive. Exits nonzero on
+// the first failure.
+// - read: an expedited upload of 0x606C returns the drive's value and size.
+// - write: an expedited download of 0x6071 lands in the drive; a 6-byte write goes out as a normal
+//   transfer and comes back with the drive's length abort.
+// - late reply: a read that times out on a slow mailbox, then a read of the same object after the drive's
+//   value changed: the second read gets the new value, the late reply is taken out of the mailbox.
+// - cancel: a request cancelled while queued never reaches the drive; one cancelled on the wire fails and
+//   its reply does not complete the next read of the same object.
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "sim_soem.h"
+#include "ec_sdoasync.h"
+
+#define DRIVE           1
+#define WAIT_MS         1000
+#define MBX_DELAY_NS    1000000LL   // default turnaround of the simulated mailbox
+#define SLOW_TIMEOUT_NS 50000000LL  // late replies: the read times out after 50 ms,
+#define SLOW_DELAY_NS   75000000LL  // its reply comes 25 ms later, well within one more timeout
+
+static ec_sdoasync_t eng;
+static int failures;
+
+#define CHECK(cond, ...) do { if (!(cond)) { fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); failures++; } } while (0)
+
+static void sleep_us(int us) {
+#ifdef _WIN32
+    Sleep((DWORD)((us + 999) / 1000));
+#else
+    struct timespec ts = { 0, (long)us * 1000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// Poll the engine one step at a time, as the cycle does, until req has finished. Returns its status.
+static uint32_t complete(ec_sdo_req_t *req) {
+    for (int t = 0; t < WAIT_MS * 10 && !ec_sdo_req_finished(req); t++) {
+        ec_sdoasync_poll(&eng, 1);
+        sleep_us(100);
+    }
+    return req->status;
+}
+
+static uint32_t read_s32(uint16_t index, int32_t *value) {
+    ec_sdo_req_t req;
+    ec_sdo_req_read(&req, DRIVE, index, 0, sizeof(*value));
+    if (ec_sdoasync_post(&eng, &req) != 0) return EC_SDO_IDLE;
+    uint32_t st = complete(&req);
+    if (st == EC_SDO_DONE && req.size == (int)sizeof(*value)) memcpy(value, req.data, sizeof(*value));
+    return st;
+}
+
+static void test_read(void) {
+    int32_t v = 0;
+    sim_drive(DRIVE)->actual_velocity = -1234;
+    CHECK(read_s32(0x606C, &v) == EC_SDO_DONE && v == -1234, "read: 0x606C gave %d, expected -1234", (int)v);
+
+    ec_sdo_req_t req;
+    ec_sdo_req_read(&req, DRIVE, 0x6072, 0, 4);
+    sim_drive(DRIVE)->max_torque = 3000;
+    ec_sdoasync_post(&eng, &req);
+    uint16_t max = 0;
+    CHECK(complete(&req) == EC_SDO_DONE && req.size == 2, "read: 0x6072 status %u, %d bytes", (unsigned)req.status,
+        req.size);
+    memcpy(&max, req.data, sizeof(max));
+    CHECK(max == 3000, "read: 0x6072 gave %u, expected 3000", (unsigned)max);
+}
+
+static void test_write(void) {
+    ec_sdo_req_t req;
+    int16_t torque = 150;
+    ec_sdo_req_write(&req, DRIVE, 0x6071, 0, &torque, sizeof(torque));
+    ec_sdoasync_post(&eng, &req);
+    CHECK(complete(&req) == EC_SDO_DONE, "write: 0x6071 status %u", (unsigned)req.status);
+    CHECK(sim_drive(DRIVE)->target_torque == 150, "write: drive has 0x6071 = %d", sim_drive(DRIVE)->target_torque);
+
+    uint8_t six[6] = { 1, 2, 3, 4, 5, 6 };
+    ec_sdo_req_write(&req, DRIVE, 0x607A, 0, six, sizeof(six));
+    ec_sdoasync_post(&eng, &req);
+    CHECK(complete(&req) == EC_SDO_ABORTED && req.abort_code == L7NH_ABORT_LENGTH,
+        "write: normal transfer status %u, abort 0x%08x", (unsigned)req.status, (unsigned)req.abort_code);
+}
+
+static void test_late_reply(void) {
+    int32_t v = 0;
+    uint32_t discarded = eng.discarded;
+
+    sim_set_mbx_delay(SLOW_DELAY_NS);
+    eng.timeout_ns = SLOW_TIMEOUT_NS;
+    sim_drive(DRIVE)->actual_velocity = 111;
+    CHECK(read_s32(0x606C, &v) == EC_SDO_TIMEOUT, "late reply: the slow read did not time out");
+    sim_drive(DRIVE)->actual_velocity = 222;
+    sim_set_mbx_delay(MBX_DELAY_NS);
+    v = 0;
+    CHECK(read_s32(0x606C, &v) == EC_SDO_DONE && v == 222, "late reply: next read gave %d, expected 222", (int)v);
+    CHECK(eng.discarded == discarded + 1, "late reply: %u replies discarded, expected 1",
+        (unsigned)(eng.discarded - discarded));
+    eng.timeout_ns = EC_SDOASYNC_TIMEOUT_NS;
+}
+
+static void test_cancel(void) {
+    ec_sdo_req_t first, queued;
+    int16_t torque = 0;
+    uint16_t max = 2500;
+
+    // queued behind an active request: removed, never sent
+    sim_drive(DRIVE)->max_torque = 3000;
+    ec_sdo_req_write(&first, DRIVE, 0x6071, 0, &torque, sizeof(torque));
+    ec_sdo_req_write(&queued, DRIVE, 0x6072, 0, &max, sizeof(max));
+    ec_sdoasync_post(&eng, &first);
+    ec_sdoasync_post(&eng, &queued);
+    ec_sdoasync_poll(&eng, 1);
+    CHECK(first.status == EC_SDO_BUSY && queued.status == EC_SDO_QUEUED, "cancel: not one active, one queued");
+    CHECK(ec_sdoasync_cancel(&eng, &queued) == EC_SDO_FAILED, "cancel: queued request status %u", (unsigned)queued.status);
+    CHECK(complete(&first) == EC_SDO_DONE, "cancel: the active request did not complete");
+    for (int t = 0; t < 100; t++) {
+        ec_sdoasync_poll(&eng, 1);
+        sleep_us(100);
+    }
+    CHECK(!ec_sdoasync_busy(&eng), "cancel: engine still busy");
+    CHECK(sim_drive(DRIVE)->max_torque == 3000, "cancel: the cancelled write reached the drive");
+
+    // on the wire: fails at once, its reply does not complete the next read
+    int32_t v = 0;
+    ec_sdo_req_t active;
+    sim_drive(DRIVE)->actual_velocity = 333;
+    ec_sdo_req_read(&active, DRIVE, 0x606C, 0, sizeof(v));
+    ec_sdoasync_post(&eng, &active);
+    ec_sdoasync_poll(&eng, 1);
+    CHECK(active.status == EC_SDO_BUSY, "cancel: read not on the wire");
+    CHECK(ec_sdoasync_cancel(&eng, &active) == EC_SDO_FAILED, "cancel: active request status %u", (unsigned)active.status);
+    CHECK(!ec_sdoasync_busy(&eng), "cancel: engine still holds the cancelled request");
+    sim_drive(DRIVE)->actual_velocity = 444;
+    CHECK(read_s32(0x606C, &v) == EC_SDO_DONE && v == 444, "cancel: next read gave %d, expected 444", (int)v);
+}
+
+int main(void) {
+    sim_setup(1);
+    if (!ec_init("sim") || ec_config_init(FALSE) != 1) {
+        fprintf(stderr, "no simulated drive\n");
+        return 1;
+    }
+    ec_sdoasync_init(&eng);
+
+    test_read();
+    test_write();
+    test_late_reply();
+    test_cancel();
+    ec_sdoasync_flush(&eng);
+    ec_close();
+    return failures ? 1 : 0;
+}
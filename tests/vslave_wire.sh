@@ -0,0 +1,24 @@
+#!/bin/sh
+# vslave_wire.sh
+# Wire-level test (ctest): ecat_vslave serves two slaves on one end of a veth pair, bench_vslave checks
+# their answers and measures frame round trips from the other end. Needs root for the pair and the raw
+# sockets; exits 77 (skipped) without them.
+#   vslave_wire.sh <veth_setup.sh> <ecat_vslave> <bench_vslave>
+
+SETUP=$1
+VSLAVE=$2
+PROBE=$3
+MASTER_IF=l7nhw0
+SLAVE_IF=l7nhw1
+SLAVES=2
+
+if [ "$(id -u)" != 0 ] || ! sh "$SETUP" up "$MASTER_IF" "$SLAVE_IF" >/dev/null 2>&1; then
+    ip link del "$MASTER_IF" 2>/dev/null
+    echo "no veth pair (not root?): skipped"
+    exit 77
+fi
+"$VSLAVE" "$SLAVE_IF" -n "$SLAVES" >/dev/null &
+PID=$!
+trap 'kill $PID 2>/dev/null; wait $PID 2>/dev/null; sh "$SETUP" down "$MASTER_IF" >/dev/null' EXIT
+
+"$PROBE" "$MASTER_IF" "$SLAVES" 2000
@@ -0,0 +1,104 @@
+// l7nh_shm.c
+// Client of the shared process image of a running segment (src/ec_shm.h), as another process sees it.
+// Usage: l7nh_shm <segment>                       print the status of the last cycle
+//        l7nh_shm <segment> set <axis>=<value>... drive these axes (values: torque or rpm, see the header)
+//                 [-r <ms>]                       and repeat the commit every ms until interrupted, so the
+//                                                 input does not lapse
+//        l7nh_shm <segment> release               hand every axis back to the owner
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "ec_shm.h"
+
+static void sleep_ms(int ms) {
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static void print_status(const ec_shm_t *m) {
+    const ec_shm_area_t *a = m->area;
+    ec_shm_status_t st;
+
+    ec_shm_snapshot(m, &st);
+    printf("segment %d: %u axes, period %lld us, input %s, cycle %u, wkc %d%s%s%s%s\n", a->segment, a->axes,
+           (long long)(a->period_ns / 1000), a->setpoint_rpm ? "rpm" : "torque", st.tick, st.wkc,
+           st.flags & EC_SHM_RUNNING ? "" : ", stopped", st.flags & EC_SHM_WKC_OK ? "" : ", WKC mismatch",
+           st.flags & EC_SHM_DROPPED ? ", torque dropped" : "", st.flags & EC_SHM_LAPSED ? ", input lapsed" : "");
+    printf("input: %u commits, %u taken, %u torn, %u lapsed\n", a->input.commits, a->input.taken, a->input.torn,
+           a->input.lapsed);
+    printf("axis\tslave\tinput\tstatusword\tcontrolword\ttarget_torque\tactual_torque\tvelocity\tposition\terror\tenabled\n");
+    for (uint32_t i = 0; i < a->axes && i < EC_AXES_MAX; i++) {
+        printf("%u\t%u\t%d\t0x%04X\t0x%04X\t%d\t%d\t%ld\t%ld\t0x%04X\t%u\n", i, a->slave[i],
+               (int)((st.input_mask >> i) & 1u), st.statusword[i], st.controlword[i], st.target_torque[i],
+               st.actual_torque[i], (long)st.velocity[i], (long)st.position[i], st.error_code[i], st.enabled[i]);
+    }
+}
+
+int main(int argc, char **argv) {
+    ec_shm_t m;
+    uint64_t mask = 0;
+    int32_t value[EC_AXES_MAX] = { 0 };
+    int repeat_ms = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: l7nh_shm <segment> [set <axis>=<value>... [-r ms] | release]\n");
+        return 2;
+    }
+    if (ec_shm_attach(&m, atoi(argv[1])) != 0) {
+        fprintf(stderr, "no process image for segment %s (is the program running?)\n", argv[1]);
+        return 1;
+    }
+    if (argc == 2) {
+        print_status(&m);
+        ec_shm_close(&m);
+        return 0;
+    }
+
+    if (strcmp(argv[2], "set") == 0) {
+        for (int k = 3; k < argc; k++) {
+            int axis;
+            long v;
+            if (strcmp(argv[k], "-r") == 0 && k + 1 < argc) {
+                repeat_ms = atoi(argv[++k]);
+            } else if (sscanf(argv[k], "%d=%ld", &axis, &v) == 2 && axis >= 0 && (uint32_t)axis < m.area->axes) {
+                mask |= 1ull << axis;
+                value[axis] = (int32_t)v;
+            } else {
+                fprintf(stderr, "bad argument '%s' (axis 0..%u)\n", argv[k], m.area->axes - 1);
+                ec_shm_close(&m);
+                return 2;
+            }
+        }
+    } else if (strcmp(argv[2], "release") != 0) {
+        fprintf(stderr, "unknown command '%s'\n", argv[2]);
+        ec_shm_close(&m);
+        return 2;
+    }
+
+    do {
+        if (ec_shm_set(&m, mask, value) != 0) {
+            fprintf(stderr, "another writer holds the input\n");
+            ec_shm_close(&m);
+            return 1;
+        }
+        if (repeat_ms > 0) sleep_ms(repeat_ms);
+    } while (repeat_ms > 0);
+    ec_shm_close(&m);
+    return 0;
+}
@@ -0,0 +1,92 @@
+// rec_export.c
+// Offline export of a process-data recording (src/ec_recorder.h) or a triggered capture (src/ec_scope.h)
+// to CSV.
+// Reads the file with plain stdio, so it works on a copy, on a recording whose program crashed and
+// on one that is still being written (records overwritten meanwhile may come out newer than asked).
+// Usage: rec_export <file.rec> [from_s] [to_s] [axis]
+//   from_s / to_s: time range in seconds since the start of the recording, or since the trigger for a
+//   capture (pre-trigger cycles are negative); default: everything kept
+//   axis: only this axis (default: all)
+// Output on stdout: t_s,cycle,axis,statusword,controlword,target_torque,actual_torque,velocity,position,wkc_ok,enabled
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ec_recorder.h"
+
+#define CHUNK 4096      // records read per fread
+
+static int seek_record(FILE *f, const ec_rec_header_t *hdr, uint64_t slot) {
+    long long off = (long long)hdr->header_size + (long long)(slot * hdr->record_size);
+#ifdef _WIN32
+    return _fseeki64(f, off, SEEK_SET);
+#else
+    return fseeko(f, (off_t)off, SEEK_SET);
+#endif
+}
+
+int main(int argc, char **argv) {
+    static ec_rec_t buf[CHUNK];
+    ec_rec_header_t hdr;
+    FILE *f;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: rec_export <file.rec> [from_s] [to_s] [axis]\n");
+        return 2;
+    }
+    double from_s = argc > 2 ? atof(argv[2]) : -1e300;
+    double to_s = argc > 3 ? atof(argv[3]) : 1e300;
+    int only_axis = argc > 4 ? atoi(argv[4]) : -1;
+
+    f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, EC_REC_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != EC_REC_VERSION || hdr.record_size != sizeof(ec_rec_t) || hdr.capacity == 0 ||
+        (hdr.capacity & (hdr.capacity - 1)) != 0) {
+        fprintf(stderr, "%s: not a recording of this version\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+
+    uint64_t head = hdr.head;
+    uint64_t first = head > hdr.capacity ? head - hdr.capacity : 0;
+    fprintf(stderr, "%s: %u axes, period %lld us, %llu records kept of %llu written, started at unix %lld\n",
+        argv[1], (unsigned)hdr.axes, (long long)(hdr.period_ns / 1000), (unsigned long long)(head - first),
+        (unsigned long long)head, (long long)hdr.start_unix_s);
+    if (hdr.trigger) {
+        fprintf(stderr, "%s: capture, trigger 0x%X on axis %d at t = 0\n", argv[1], (unsigned)hdr.trigger,
+            (int)hdr.trigger_axis);
+    }
+
+    printf("t_s,cycle,axis,statusword,controlword,target_torque,actual_torque,velocity,position,wkc_ok,enabled\n");
+    for (uint64_t n = first; n < head;) {
+        uint64_t slot = n & (hdr.capacity - 1);
+        uint64_t count = head - n;
+        if (count > CHUNK) count = CHUNK;
+        if (count > hdr.capacity - slot) count = hdr.capacity - slot;     // up to the end of the ring
+        if (seek_record(f, &hdr, slot) != 0 || fread(buf, sizeof(ec_rec_t), (size_t)count, f) != count) {
+            fprintf(stderr, "%s: truncated\n", argv[1]);
+            fclose(f);
+            return 1;
+        }
+        for (uint64_t i = 0; i < count; i++) {
+            const ec_rec_t *r = &buf[i];
+            double t = (double)(r->time_ns - hdr.start_ns) * 1e-9;
+            if (t < from_s || t > to_s || (only_axis >= 0 && r->axis != only_axis)) continue;
+            printf("%.6f,%u,%u,0x%04X,0x%04X,%d,%d,%ld,%ld,%d,%d\n", t, (unsigned)r->cycle, (unsigned)r->axis,
+                (unsigned)r->statusword, (unsigned)r->controlword, (int)r->target_torque, (int)r->actual_torque,
+                (long)r->velocity, (long)r->position, (r->flags & EC_REC_WKC_OK) != 0, (r->flags & EC_REC_ENABLED) != 0);
+        }
+        n += count;
+    }
+    fclose(f);
+    return 0;
+}